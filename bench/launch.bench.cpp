@@ -0,0 +1,136 @@
+#include "async_process.h"
+
+#include "boost/asio/io_context.hpp"
+#include "boost/asio/thread_pool.hpp"
+#include "boost/process/v2/environment.hpp"
+#include "boost/process/v2/process.hpp"
+
+#ifndef _WIN32
+#include "boost/process/v2/posix/vfork_launcher.hpp"
+#endif
+
+#include "benchmark/benchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+namespace bp = boost::process;
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int LAUNCHES = 1000;
+
+// A process which exits at once, so that only the launch is measured.
+std::string fake_executable()
+{
+#ifndef _WIN32
+    return bp::environment::find_executable("true").string();
+#else
+    return bp::environment::find_executable("cmd").string();
+#endif
+}
+
+std::vector<std::string> fake_args()
+{
+#ifndef _WIN32
+    return {};
+#else
+    return {"/c", "exit"};
+#endif
+}
+
+// Memory touched by the app, which makes fork slower as its page tables are copied.
+std::vector<char> make_ballast(benchmark::State const& state)
+{
+    return std::vector<char>(static_cast<std::size_t>(state.range(0)) * 1024 * 1024, 1);
+}
+
+void report_percentiles(benchmark::State& state, std::vector<Clock::duration>& latencies)
+{
+    std::ranges::sort(latencies);
+
+    auto percentile = [&latencies](double p) {
+        auto index = static_cast<std::size_t>(p * static_cast<double>(latencies.size() - 1));
+        return std::chrono::duration<double, std::micro>(latencies[index]).count();
+    };
+    state.counters["p50_us"] = percentile(0.50);
+    state.counters["p99_us"] = percentile(0.99);
+}
+
+template <typename Launcher>
+void launch_many(benchmark::State& state)
+{
+    auto ballast = make_ballast(state);
+    auto executable = fake_executable();
+    auto args = fake_args();
+
+    boost::asio::io_context context;
+    std::vector<Clock::duration> latencies;
+
+    for (auto _ : state)
+    {
+        for (int i = 0; i < LAUNCHES; ++i)
+        {
+            auto start = Clock::now();
+            auto process = Launcher{}(context, executable, args);
+            latencies.push_back(Clock::now() - start);
+
+            process.wait();
+        }
+    }
+
+    benchmark::DoNotOptimize(ballast.data());
+    report_percentiles(state, latencies);
+}
+
+} // anonymous namespace
+
+// The launcher of boost.process, which forks on POSIX. The argument is the memory touched by the app in MiB.
+static void BM_LaunchDefault(benchmark::State& state)
+{
+    launch_many<bp::default_process_launcher>(state);
+}
+BENCHMARK(BM_LaunchDefault)->Arg(0)->Arg(1024)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+#ifndef _WIN32
+static void BM_LaunchVfork(benchmark::State& state)
+{
+    launch_many<bp::posix::vfork_launcher>(state);
+}
+BENCHMARK(BM_LaunchVfork)->Arg(0)->Arg(1024)->Iterations(1)->Unit(benchmark::kMillisecond);
+#endif
+
+// The launch of `AsyncProcess` as measured by itself, including its pipes.
+static void BM_LaunchAsyncProcess(benchmark::State& state)
+{
+    auto ballast = make_ballast(state);
+    auto executable = fake_executable();
+    auto args = fake_args();
+
+    boost::asio::thread_pool pool{1};
+    std::vector<Clock::duration> latencies;
+
+    for (auto _ : state)
+    {
+        for (int i = 0; i < LAUNCHES; ++i)
+        {
+            auto process = std::make_shared<ytweb::AsyncProcess>(
+                pool.get_executor(), executable, args,
+                [](ytweb::AsyncProcess::Stream /* stream */, std::string_view /* line */) {}, [] {}
+            );
+            process->start();
+            process->wait();
+
+            latencies.push_back(process->timings().spawn);
+        }
+    }
+
+    benchmark::DoNotOptimize(ballast.data());
+    report_percentiles(state, latencies);
+}
+BENCHMARK(BM_LaunchAsyncProcess)->Arg(0)->Arg(1024)->Iterations(1)->Unit(benchmark::kMillisecond);
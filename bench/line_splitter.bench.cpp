@@ -0,0 +1,180 @@
+#include "async_process.h"
+#include "line_splitter.h"
+
+#include "boost/asio/thread_pool.hpp"
+#include "boost/process/v2/environment.hpp"
+
+#include "benchmark/benchmark.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+constexpr std::size_t READ_SIZE = 64 * 1024;
+
+std::string make_output(std::size_t line_length, char delimiter = '\n')
+{
+    std::string line(line_length - 1, 'x');
+    line.push_back(delimiter);
+
+    std::string output;
+    while (output.size() < 16 * 1024 * 1024)
+    {
+        output += line;
+    }
+    return output;
+}
+
+} // anonymous namespace
+
+// Split output read in chunks of 64 KiB.
+static void BM_LineSplitter(benchmark::State& state)
+{
+    auto output = make_output(static_cast<std::size_t>(state.range(0)));
+
+    std::size_t lines{};
+    for (auto _ : state)
+    {
+        ytweb::LineSplitter splitter;
+        for (std::size_t pos = 0; pos < output.size();)
+        {
+            auto buffer = splitter.prepare();
+            auto size = std::min({buffer.size(), output.size() - pos, READ_SIZE});
+            std::copy_n(output.data() + pos, size, buffer.data());
+            pos += size;
+
+            splitter.commit(size, [&lines](std::string_view line) { benchmark::DoNotOptimize(line.data()); ++lines; });
+        }
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * output.size()));
+    benchmark::DoNotOptimize(lines);
+}
+BENCHMARK(BM_LineSplitter)->Arg(80)->Arg(200)->Arg(4096);
+
+// Split progress lines ended by '\r' only, e.g. of ffmpeg, which should be as fast as lines ended by '\n'.
+static void BM_LineSplitterCarriageReturn(benchmark::State& state)
+{
+    auto output = make_output(static_cast<std::size_t>(state.range(0)), '\r');
+
+    std::size_t lines{};
+    for (auto _ : state)
+    {
+        ytweb::LineSplitter splitter;
+        for (std::size_t pos = 0; pos < output.size();)
+        {
+            auto buffer = splitter.prepare();
+            auto size = std::min({buffer.size(), output.size() - pos, READ_SIZE});
+            std::copy_n(output.data() + pos, size, buffer.data());
+            pos += size;
+
+            splitter.commit(size, [&lines](std::string_view line) { benchmark::DoNotOptimize(line.data()); ++lines; });
+        }
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * output.size()));
+    benchmark::DoNotOptimize(lines);
+}
+BENCHMARK(BM_LineSplitterCarriageReturn)->Arg(80)->Arg(200);
+
+// The former approach: find a line break, then erase the line from the front of the buffer.
+static void BM_EraseFrontSplitter(benchmark::State& state)
+{
+    auto output = make_output(static_cast<std::size_t>(state.range(0)));
+
+    std::size_t lines{};
+    for (auto _ : state)
+    {
+        std::vector<char> buffer;
+        for (std::size_t pos = 0; pos < output.size();)
+        {
+            auto size = std::min(output.size() - pos, READ_SIZE);
+            buffer.insert(buffer.end(), output.data() + pos, output.data() + pos + size);
+            pos += size;
+
+            for (auto it = std::find(buffer.begin(), buffer.end(), '\n'); it != buffer.end();
+                 it = std::find(buffer.begin(), buffer.end(), '\n'))
+            {
+                benchmark::DoNotOptimize(buffer.data());
+                ++lines;
+                buffer.erase(buffer.begin(), it + 1);
+            }
+        }
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * output.size()));
+    benchmark::DoNotOptimize(lines);
+}
+BENCHMARK(BM_EraseFrontSplitter)->Arg(80)->Arg(200)->Arg(4096);
+
+// Read the output of a fake yt-dlp which writes 256 MiB as fast as possible. The argument is the line length.
+static void BM_AsyncProcessThroughput(benchmark::State& state)
+{
+    constexpr int MEGABYTES = 256;
+
+    auto python = boost::process::environment::find_executable("python").string();
+    boost::asio::thread_pool pool{1};
+
+    std::int64_t total_lines{};
+    for (auto _ : state)
+    {
+        std::size_t bytes{};
+        std::int64_t lines{};
+        auto process = std::make_shared<ytweb::AsyncProcess>(
+            pool.get_executor(), python,
+            std::vector<std::string>{
+                YT_DLP_WEB_FAKE_BIN, "--megabytes", std::to_string(MEGABYTES), "--line-length",
+                std::to_string(state.range(0))
+            },
+            [&bytes, &lines](ytweb::AsyncProcess::Stream /* stream */, std::string_view line) {
+                bytes += line.size() + 1;
+                ++lines;
+            },
+            [] {}
+        );
+        process->start();
+        process->wait();
+
+        if (bytes < MEGABYTES * 1024 * 1024)
+        {
+            state.SkipWithError("output is incomplete");
+        }
+        total_lines += lines;
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) * MEGABYTES * 1024 * 1024);
+    state.SetItemsProcessed(total_lines);
+}
+BENCHMARK(BM_AsyncProcessThroughput)->Arg(80)->Arg(200)->Arg(4096)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Read the progress of a fake download at a fixed rate, and measure the CPU time the app spends on it,
+// which should stay flat however slowly the lines come. The argument is the rate in lines per second.
+static void BM_AsyncProcessPaced(benchmark::State& state)
+{
+    constexpr int LINES = 2000;
+
+    auto python = boost::process::environment::find_executable("python").string();
+    boost::asio::thread_pool pool{1};
+
+    for (auto _ : state)
+    {
+        int lines{};
+        auto process = std::make_shared<ytweb::AsyncProcess>(
+            pool.get_executor(), python,
+            std::vector<std::string>{
+                YT_DLP_WEB_FAKE_BIN, "--progress", "--lines", std::to_string(LINES), "--rate",
+                std::to_string(state.range(0))
+            },
+            [&lines](ytweb::AsyncProcess::Stream /* stream */, std::string_view /* line */) { ++lines; }, [] {}
+        );
+        process->start();
+        process->wait();
+
+        if (lines != LINES)
+        {
+            state.SkipWithError("output is incomplete");
+        }
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) * LINES);
+}
+BENCHMARK(BM_AsyncProcessPaced)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond)->MeasureProcessCPUTime();
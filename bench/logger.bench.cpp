@@ -0,0 +1,53 @@
+#include "logger.h"
+
+#include "benchmark/benchmark.h"
+#include <cstddef>
+#include <memory>
+#include <string_view>
+
+namespace
+{
+
+// Shared by the threads of a benchmark, as the app shares one logger.
+std::unique_ptr<ytweb::Logger> logger;
+std::size_t sunk{};
+
+// Called once for all the threads of a run.
+void set_up(benchmark::State const& /* state */)
+{
+    logger = std::make_unique<ytweb::Logger>([](std::string_view batch) { sunk += batch.size(); });
+    logger->set_level(ytweb::LogLevel::Info);
+}
+
+void tear_down(benchmark::State const& /* state */)
+{
+    logger.reset();
+}
+
+} // anonymous namespace
+
+// A message as the tasks log it, pushed from one or more threads. Dropped messages are counted.
+static void BM_LoggerEmit(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        logger->info("[Task {}] {}", 42, "[youtube] dQw4w9WgXcQ: Downloading webpage");
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0)
+    {
+        state.counters["dropped"] = static_cast<double>(logger->dropped()); // by all threads
+    }
+}
+BENCHMARK(BM_LoggerEmit)->Setup(set_up)->Teardown(tear_down)->ThreadRange(1, 4)->UseRealTime();
+
+// A message below the level, which is neither formatted nor queued.
+static void BM_LoggerDisabled(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        logger->debug("[Task {}] {}", 42, "[youtube] dQw4w9WgXcQ: Downloading webpage");
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LoggerDisabled)->Setup(set_up)->Teardown(tear_down)->ThreadRange(1, 4)->UseRealTime();
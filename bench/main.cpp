@@ -0,0 +1,39 @@
+#include "benchmark/benchmark.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The results are also written as JSON, unless told otherwise, so that runs can be compared between commits,
+// e.g. by `compare.py` of Google Benchmark.
+int main(int argc, char** argv)
+{
+    constexpr std::string_view OUT_OPTION = "--benchmark_out=";
+
+    std::vector<char*> args(argv, argv + argc);
+
+    bool has_out{false};
+    for (std::string_view arg : args)
+    {
+        has_out = has_out || arg.starts_with(OUT_OPTION);
+    }
+
+    std::string out_option = std::string(OUT_OPTION) + "bench-results.json";
+    std::string format_option = "--benchmark_out_format=json";
+    if (!has_out)
+    {
+        args.push_back(out_option.data());
+        args.push_back(format_option.data());
+    }
+
+    int count = static_cast<int>(args.size());
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data()))
+    {
+        return 1;
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include "media_projection.h"
+
+#include "nlohmann/json.hpp"
+
+#include "benchmark/benchmark.h"
+#include <fstream>
+#include <iterator>
+#include <string>
+
+using Json = nlohmann::json;
+
+namespace
+{
+
+// The fixture is pretty-printed, while `yt-dlp -j` prints a single line.
+std::string const& media_info()
+{
+    static std::string const INFO = [] {
+        std::ifstream file(YT_DLP_WEB_MEDIA_INFO);
+        return Json::parse(std::string(std::istreambuf_iterator<char>(file), {})).dump();
+    }();
+    return INFO;
+}
+
+void report_bytes(benchmark::State& state, std::size_t sent)
+{
+    state.counters["bytes_in"] = static_cast<double>(media_info().size());
+    state.counters["bytes_sent"] = static_cast<double>(sent);
+    state.counters["bytes_saved"] = static_cast<double>(media_info().size() - sent);
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * media_info().size()));
+}
+
+} // anonymous namespace
+
+// Baseline: the whole entry is forwarded to the frontend.
+static void BM_ForwardMediaInfo(benchmark::State& state)
+{
+    std::string out;
+    for (auto _ : state)
+    {
+        out.clear();
+        out.append(media_info());
+        benchmark::DoNotOptimize(out.data());
+    }
+    report_bytes(state, out.size());
+}
+BENCHMARK(BM_ForwardMediaInfo);
+
+static void BM_ProjectMediaInfo(benchmark::State& state)
+{
+    std::string out;
+    for (auto _ : state)
+    {
+        out.clear();
+        ytweb::project_media_info(media_info(), out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    report_bytes(state, out.size());
+}
+BENCHMARK(BM_ProjectMediaInfo);
+
+// The same projection through a DOM, for comparison.
+static void BM_ProjectMediaInfoWithDom(benchmark::State& state)
+{
+    std::string out;
+    for (auto _ : state)
+    {
+        auto info = Json::parse(media_info());
+
+        Json media;
+        for (auto const* field : {"title", "description", "duration_string", "thumbnail", "uploader", "upload_date",
+                                  "like_count", "view_count", "comment_count", "filename", "webpage_url"})
+        {
+            if (info.contains(field))
+            {
+                media[field] = std::move(info[field]);
+            }
+        }
+        for (auto& format : info["formats"])
+        {
+            Json trimmed;
+            for (auto const* field : {"format_id", "ext", "resolution", "fps", "filesize_approx", "protocol", "vcodec",
+                                      "acodec", "tbr", "vbr", "abr"})
+            {
+                if (format.contains(field))
+                {
+                    trimmed[field] = std::move(format[field]);
+                }
+            }
+            media["formats"].push_back(std::move(trimmed));
+        }
+        for (auto& format : info["requested_formats"])
+        {
+            media["requested_formats"].push_back({{"format_id", std::move(format["format_id"])}});
+        }
+
+        out = media.dump();
+        benchmark::DoNotOptimize(out.data());
+    }
+    report_bytes(state, out.size());
+}
+BENCHMARK(BM_ProjectMediaInfoWithDom);
+
+// What the receiver spends on parsing the entry, with the whole entry (0) or the projection (1).
+static void BM_ParseSentMediaInfo(benchmark::State& state)
+{
+    std::string sent;
+    if (state.range(0) == 0)
+    {
+        sent = media_info();
+    }
+    else
+    {
+        ytweb::project_media_info(media_info(), sent);
+    }
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(Json::parse(sent));
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * sent.size()));
+}
+BENCHMARK(BM_ParseSentMediaInfo)->Arg(0)->Arg(1);
@@ -0,0 +1,79 @@
+#include "progress.h"
+#include "progress_coalescer.h"
+
+#include "nlohmann/json.hpp"
+
+#include "benchmark/benchmark.h"
+#include <chrono>
+#include <string>
+
+using Json = nlohmann::json;
+
+// The former `%(progress)j` template, and the compact template with the same progress.
+static constexpr std::string_view JSON_LINE =
+    R"({"status": "downloading", "downloaded_bytes": 1048576, "total_bytes": 10485760, "tmpfilename": )"
+    R"("/home/user/Videos/Some video title [dQw4w9WgXcQ].f137.mp4.part", "filename": )"
+    R"("/home/user/Videos/Some video title [dQw4w9WgXcQ].f137.mp4", "eta": 12, "speed": 786432.25, )"
+    R"("elapsed": 1.3352646827697754, "ctx_id": null, "fragment_index": 3, "fragment_count": 40, )"
+    R"("_eta_str": "00:12", "_speed_str": "768.00KiB/s", "_percent_str": " 10.0%", "_total_bytes_str": )"
+    R"("  10.00MiB", "_elapsed_str": "00:00:01", "_default_template": " 10.0% of   10.00MiB at  768.00KiB/s ETA 00:12"})";
+
+static constexpr std::string_view COMPACT_LINE =
+    "downloading|1048576|10485760|786432.25|12|3|/home/user/Videos/Some video title [dQw4w9WgXcQ].f137.mp4";
+
+// The former path: parse the whole progress, add the task id and dump it again.
+static void BM_ProgressJson(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        auto progress = Json::parse(JSON_LINE);
+        progress["task_id"] = 1;
+        auto out = progress.dump();
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ProgressJson);
+
+static void BM_ProgressDecode(benchmark::State& state)
+{
+    std::string out;
+    for (auto _ : state)
+    {
+        auto progress = ytweb::decode_progress(COMPACT_LINE);
+        out.clear();
+        ytweb::encode_progress(*progress, 1, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ProgressDecode);
+
+// The whole handling of a progress line by the app: decode, encode for the frontend, and coalesce.
+// The argument is the number of downloads reporting at once.
+static void BM_ProgressHandling(benchmark::State& state)
+{
+    auto const tasks = static_cast<int>(state.range(0));
+
+    std::size_t sent{};
+    // Never ticks, so that only the update is measured.
+    ytweb::ProgressCoalescer coalescer(
+        [&sent](std::string_view batch, bool /* terminal */) { sent += batch.size(); }, std::chrono::hours(1)
+    );
+
+    std::string out;
+    int task{};
+    for (auto _ : state)
+    {
+        auto progress = ytweb::decode_progress(COMPACT_LINE);
+        out.clear();
+        ytweb::encode_progress(*progress, task, out);
+        coalescer.update(task, out, progress->terminal());
+        task = (task + 1) % tasks;
+    }
+    coalescer.flush();
+
+    benchmark::DoNotOptimize(sent);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ProgressHandling)->Arg(1)->Arg(16)->Arg(256);
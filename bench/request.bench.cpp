@@ -0,0 +1,275 @@
+#include "request.h"
+
+#include "exception.h"
+#include "nlohmann/json.hpp"
+
+#include "benchmark/benchmark.h"
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using Json = nlohmann::json;
+
+// The options of the cases in `test/request.test.cpp`, as the frontend sends them.
+static constexpr std::string_view MINIMAL_REQUEST =
+    R"({"action": "preview", "yt_dlp_path": "/usr/bin/yt-dlp", "url_input": "https://example.com/video"})";
+
+static constexpr std::string_view FULL_REQUEST = R"json({
+    "action": "preview",
+    "yt_dlp_path": "/usr/bin/yt-dlp",
+    "url_input": "https://example.com/video",
+    "cookies_from_browser": "chrome",
+    "proxy": "socks5://127.0.0.1:7890",
+    "socket_timeout": "10",
+    "source_address": "1.2.3.4",
+    "force_ip_protocol": "ipv4",
+    "enable_file_urls": "on",
+    "playlist_indices": "1,2:3,-6:-1,-5::0",
+    "filesize_min": "50k",
+    "filesize_max": "1G",
+    "date_after": "20230101",
+    "filters": ["duration < 60", "like_count > 100"],
+    "stop_filters": ["!is_live"],
+    "is_playlist": "no",
+    "age_limit": "18",
+    "max_download_number": "10",
+    "download_archive": "/tmp/downloaded.txt",
+    "break_on_existing": "on",
+    "break_per_input": "on",
+    "skip_playlist_after_errors": "8",
+    "concurrent_fragments": "4",
+    "limit_rate": "1M",
+    "throttle_rate": "100",
+    "retries": "15",
+    "file_access_retries": "5",
+    "fragment_retries": "infinite",
+    "retry_sleep": ["linear=1::2", "fragment:exp=1:20"],
+    "abort_on_unavailable_fragment": "on",
+    "keep_fragments": "on",
+    "buffer_size": "10M",
+    "no_resize_buffer": "on",
+    "http_chunk_size": "1M",
+    "hls_use_mpegts": "no",
+    "download_sections": ["*10:15-inf", "intro"],
+    "downloader": ["aria2c", "dash,m3u8:native"],
+    "download_args": ["aria2c:--max-connection-per-server=4"],
+    "output_path": ["/tmp/output", "temp:/tmp/temp"],
+    "output_filename": ["%(title)s.%(ext)s"],
+    "output_na_placeholder": "N/A",
+    "restrict_filename": "on",
+    "windows_filename": "on",
+    "trim_filename": "50",
+    "no_part": "on",
+    "write_info_json": "on",
+    "cache_dir": "/tmp/cache"
+})json";
+
+// The former parser: look up every known key in the parsed object, in the order of the frontend.
+class LegacyRequest
+{
+  public:
+    std::vector<std::string> args;
+    std::string extraction_key;
+
+    explicit LegacyRequest(std::string_view json)
+    {
+        data_ = Json::parse(json);
+        yt_dlp_path_ = data_.at("yt_dlp_path").get<std::string>();
+        args.emplace_back(data_.at("url_input").get<std::string>());
+
+        check_argument_option("cookies_from_browser", "--cookies-from-browser");
+        check_argument_option("cookies_from_file", "--cookies");
+
+        check_argument_option("proxy", "--proxy");
+        check_argument_option("socket_timeout", "--socket-timeout");
+        check_argument_option("source_address", "--source-address");
+        map_option("force_ip_protocol", {{"ipv4", "--force-ipv4"}, {"ipv6", "--force-ipv6"}});
+        check_option("enable_file_urls", "--enable-file-urls");
+
+        check_argument_option("playlist_indices", "--playlist-items");
+        check_argument_option("filesize_min", "--min-filesize");
+        check_argument_option("filesize_max", "--max-filesize");
+        check_argument_option("date", "--date");
+        check_argument_option("date_before", "--datebefore");
+        check_argument_option("date_after", "--dateafter");
+        check_multiple_argument_option("filters", "--match-filters");
+        check_multiple_argument_option("stop_filters", "--break-match-filters");
+        map_option("is_playlist", {{"yes", "--yes-playlist"}, {"no", "--no-playlist"}});
+        check_argument_option("age_limit", "--age-limit");
+        check_argument_option("max_download_number", "--max-downloads");
+        check_argument_option("download_archive", "--download-archive");
+        check_option("break_on_existing", "--break-on-existing");
+        check_option("break_per_input", "--break-per-input");
+        check_argument_option("skip_playlist_after_errors", "--skip-playlist-after-errors");
+
+        auto download_options_begin = args.size();
+        check_argument_option("concurrent_fragments", "--concurrent-fragments");
+        check_argument_option("limit_rate", "--limit-rate");
+        check_argument_option("throttle_rate", "--throttle-rate");
+        check_argument_option("retries", "--retries");
+        check_argument_option("file_access_retries", "--file-access-retries");
+        check_argument_option("fragment_retries", "--fragment-retries");
+        check_multiple_argument_option("retry_sleep", "--retry-sleep");
+        check_option("abort_on_unavailable_fragment", "--abort-on-unavailable-fragment");
+        check_option("keep_fragments", "--keep-fragments");
+        check_argument_option("buffer_size", "--buffer-size");
+        check_option("no_resize_buffer", "--no-resize-buffer");
+        check_argument_option("http_chunk_size", "--http-chunk-size");
+        check_option("playlist_random", "--playlist-random");
+        check_option("lazy_playlist", "--lazy-playlist");
+        check_option("xattr_set_filesize", "--xattr-set-filesize");
+        map_option("hls_use_mpegts", {{"yes", "--hls-use-mpegts"}, {"no", "--no-hls-use-mpegts"}});
+        check_multiple_argument_option("download_sections", "--download-section");
+        check_multiple_argument_option("downloader", "--downloader");
+        check_multiple_argument_option("download_args", "--downloader-args");
+        auto download_options_end = args.size();
+
+        check_multiple_argument_option("output_path", "-P");
+        check_multiple_argument_option("output_filename", "-o");
+        check_argument_option("output_na_placeholder", "--output-na-placeholder");
+        check_option("restrict_filename", "--restrict-filenames");
+        check_option("windows_filename", "--windows-filenames");
+        check_argument_option("trim_filename", "--trim-filename");
+
+        check_argument_option("batch_file", "--batch-file");
+        map_option("overwrite", {{"never", "--no-overwrites"}, {"always", "--force-overwrites"}});
+        check_option("no_continue", "--no-continue");
+        check_option("no_part", "--no-part");
+        check_option("no_mtime", "--no-mtime");
+        check_option("write_description", "--write-description");
+        check_option("write_info_json", "--write-info-json");
+        check_option("no_write_playlist_metafile", "--no-write-playlist-metafiles");
+        check_option("write_all_info_json", "--no-clean-info-json");
+        check_option("write_comments", "--write-comments");
+        check_argument_option("load_info_json", "--load-info-json");
+        check_argument_option("cache_dir", "--cache-dir");
+        check_option("no_cache_dir", "--no-cache-dir");
+        check_option("rm_cache_dir", "--rm-cache-dir");
+
+        extraction_key = yt_dlp_path_;
+        for (std::size_t i = 0; i < args.size(); ++i)
+        {
+            if (i < download_options_begin || i >= download_options_end)
+            {
+                extraction_key += '\0';
+                extraction_key += args[i];
+            }
+        }
+
+        args.emplace_back("-j");
+    }
+
+  private:
+    Json data_;
+    std::string yt_dlp_path_;
+
+    void check_argument_option(std::string_view key, std::string_view option)
+    {
+        if (data_.contains(key))
+        {
+            args.emplace_back(option);
+            args.emplace_back(data_[key].get<std::string>());
+        }
+    }
+
+    void check_multiple_argument_option(std::string_view key, std::string_view option)
+    {
+        if (data_.contains(key))
+        {
+            for (auto const& value : data_.at(key))
+            {
+                args.emplace_back(option);
+                args.emplace_back(value.get<std::string>());
+            }
+        }
+    }
+
+    void check_option(std::string_view key, std::string_view option)
+    {
+        if (data_.contains(key))
+        {
+            args.emplace_back(option);
+        }
+    }
+
+    void map_option(std::string_view key, std::map<std::string, std::string> const& options)
+    {
+        if (data_.contains(key))
+        {
+            auto value = data_.at(key).get<std::string>();
+            if (options.contains(value))
+            {
+                args.emplace_back(options.at(value));
+            }
+        }
+    }
+};
+
+// The other shapes of `test/request.test.cpp`, one group of options each.
+static constexpr std::string_view COOKIES_REQUEST =
+    R"({"action": "preview", "url_input": "https://example.com/video", "cookies_from_browser": "chrome",)"
+    R"( "cookies_from_file": "/tmp/cookies.txt"})";
+
+static constexpr std::string_view SELECTION_REQUEST =
+    R"({"action": "preview", "url_input": "https://example.com/playlist", "playlist_indices": "1,2:3,-6:-1",)"
+    R"( "filters": ["like_count>?100", "description~='(?i)\\bcats \\& dogs\\b'"], "stop_filters": ["!is_live"],)"
+    R"( "is_playlist": "yes", "date_before": "now", "filesize_max": "0.2M"})";
+
+static constexpr std::string_view DOWNLOAD_REQUEST =
+    R"({"action": "download", "url_input": "https://example.com/video", "audio_only": true,)"
+    R"( "output_path": ["home:~/Downloads", "temp:~/tmp"], "output_filename": ["%(uploader)s/%(title)s.%(ext)s"],)"
+    R"( "download_archive": "archive.txt", "no_continue": true, "write_info_json": true})";
+
+static constexpr std::string_view BATCH_REQUEST =
+    R"({"action": "download", "url_input": "", "batch_file": "/tmp/batch_file.txt", "overwrite": "never"})";
+
+static constexpr std::string_view INVALID_REQUEST =
+    R"({"action": "preview", "url_input": "https://example.com/video", "force_ip_protocol": "ipv5"})";
+
+static void BM_RequestLegacy(benchmark::State& state, std::string_view json)
+{
+    for (auto _ : state)
+    {
+        LegacyRequest request(json);
+        benchmark::DoNotOptimize(request.args.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_RequestLegacy, minimal, MINIMAL_REQUEST);
+BENCHMARK_CAPTURE(BM_RequestLegacy, full, FULL_REQUEST);
+
+static void BM_RequestTable(benchmark::State& state, std::string_view json)
+{
+    for (auto _ : state)
+    {
+        ytweb::Request request(json);
+        benchmark::DoNotOptimize(request.args().data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_RequestTable, minimal, MINIMAL_REQUEST);
+BENCHMARK_CAPTURE(BM_RequestTable, full, FULL_REQUEST);
+BENCHMARK_CAPTURE(BM_RequestTable, cookies, COOKIES_REQUEST);
+BENCHMARK_CAPTURE(BM_RequestTable, selection, SELECTION_REQUEST);
+BENCHMARK_CAPTURE(BM_RequestTable, download, DOWNLOAD_REQUEST);
+BENCHMARK_CAPTURE(BM_RequestTable, batch, BATCH_REQUEST);
+
+// A request rejected by validation, which throws.
+static void BM_RequestInvalid(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        try
+        {
+            ytweb::Request request(INVALID_REQUEST);
+            benchmark::DoNotOptimize(request.args().data());
+        }
+        catch (ytweb::ParseError const& e)
+        {
+            benchmark::DoNotOptimize(e.what());
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RequestInvalid);
@@ -0,0 +1,85 @@
+#include "task_manager.h"
+
+#include "boost/process/v2/environment.hpp"
+
+#include "benchmark/benchmark.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+using TaskId = ytweb::TaskManager::TaskId;
+
+constexpr int TASKS = 200;
+
+std::string python()
+{
+    return boost::process::environment::find_executable("python").string();
+}
+
+// Launch the tasks at once, so that most of them wait in the queue.
+std::vector<TaskId> launch_many(ytweb::TaskManager& manager, std::vector<std::string> const& args, int count)
+{
+    auto const executable = python();
+
+    std::vector<TaskId> tasks;
+    tasks.reserve(static_cast<std::size_t>(count));
+    for (int i = 0; i < count; ++i)
+    {
+        tasks.push_back(manager.launch(
+            executable, args, [](TaskId /* id */, std::string_view /* line */) {}, [](TaskId /* id */) {}
+        ));
+    }
+    return tasks;
+}
+
+} // anonymous namespace
+
+// Launch and wait for tasks which exit at once, through the queue. The argument is the limit of running tasks.
+static void BM_TaskManagerChurn(benchmark::State& state)
+{
+    auto const limit = static_cast<std::size_t>(state.range(0));
+    std::vector<std::string> const args{YT_DLP_WEB_FAKE_BIN};
+
+    for (auto _ : state)
+    {
+        ytweb::TaskManager manager;
+        manager.set_limits({.total = limit, .preview = limit, .download = limit});
+
+        for (auto task : launch_many(manager, args, TASKS))
+        {
+            manager.wait(task);
+        }
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) * TASKS);
+}
+BENCHMARK(BM_TaskManagerChurn)->Arg(4)->Arg(16)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Launch tasks which print progress until they are killed, then kill them all, running or queued.
+static void BM_TaskManagerKill(benchmark::State& state)
+{
+    auto const limit = static_cast<std::size_t>(state.range(0));
+    std::vector<std::string> const args{
+        YT_DLP_WEB_FAKE_BIN, "--progress", "--lines", "1000000", "--rate", "10", "--runtime", "60"
+    };
+
+    for (auto _ : state)
+    {
+        ytweb::TaskManager manager;
+        manager.set_limits({.total = limit, .preview = limit, .download = limit});
+
+        auto tasks = launch_many(manager, args, TASKS);
+        for (auto task : tasks)
+        {
+            manager.kill(task);
+        }
+        for (auto task : tasks)
+        {
+            manager.wait(task);
+        }
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) * TASKS);
+}
+BENCHMARK(BM_TaskManagerKill)->Arg(4)->Arg(16)->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,74 @@
+# A deterministic fake yt-dlp executable for benchmarking, whose output is configurable.
+# Usage: yt-dlp-fake.py [--lines N] [--megabytes N] [--line-length N] [--rate N] [--runtime S] [--progress]
+#
+# Lines are written until any of the limits of --lines, --megabytes and --runtime is reached, or none at all
+# without a limit, which measures the launch only. With --rate, line i is written at i / rate seconds after
+# the start, otherwise as fast as possible. With --runtime alone, the process only sleeps, e.g. to be killed.
+# With --progress, the lines are progress in the format of `--progress-template`, otherwise filler.
+
+import argparse
+import sys
+import time
+
+parser = argparse.ArgumentParser()
+parser.add_argument("--lines", type=int, default=0)
+parser.add_argument("--megabytes", type=int, default=0)
+parser.add_argument("--line-length", type=int, default=200)
+parser.add_argument("--rate", type=float, default=0, help="lines per second, 0 for no limit")
+parser.add_argument("--runtime", type=float, default=0, help="seconds")
+parser.add_argument("--progress", action="store_true")
+args = parser.parse_args()
+
+start = time.monotonic()
+out = sys.stdout.buffer
+
+
+def make_line(index):
+    if args.progress:
+        total = max(args.lines, 1) * 1024
+        line = f"[Progress]downloading|{(index + 1) * 1024}|{total}|1048576.0|1|NA|/tmp/fake video [{index}].mp4"
+        return line.encode()[: args.line_length - 1] + b"\n"
+    return b"x" * (args.line_length - 1) + b"\n"
+
+
+max_bytes = args.megabytes * 1024 * 1024
+if args.lines == 0 and max_bytes == 0:
+    time.sleep(args.runtime)
+    sys.exit(0)
+
+if not args.progress and args.rate == 0:
+    # Flood in chunks, which costs python the least.
+    line = make_line(0)
+    count = args.lines or -(-max_bytes // len(line))
+    chunk_lines = max(1, (1024 * 1024) // len(line))
+    written = 0
+    while written < count:
+        if args.runtime and time.monotonic() - start >= args.runtime:
+            break
+        lines = min(chunk_lines, count - written)
+        out.write(line * lines)
+        written += lines
+    out.flush()
+    sys.exit(0)
+
+index = 0
+written_bytes = 0
+while True:
+    if args.lines and index >= args.lines:
+        break
+    if max_bytes and written_bytes >= max_bytes:
+        break
+    if args.runtime and time.monotonic() - start >= args.runtime:
+        break
+
+    if args.rate:
+        delay = start + index / args.rate - time.monotonic()
+        if delay > 0:
+            out.flush()
+            time.sleep(delay)
+
+    line = make_line(index)
+    out.write(line)
+    written_bytes += len(line)
+    index += 1
+out.flush()
@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+# A simulated yt-dlp for load tests, which replays the output of real runs with its timing.
+#
+# Usage: yt-dlp-sim.py <trace>[?option=value&...] [arguments of yt-dlp, which are ignored]
+#        yt-dlp-sim.py --record <trace file> <yt-dlp> [arguments...]
+#
+# The URL of a request names the trace, so that the app runs the simulator in place of yt-dlp unchanged.
+# A trace is a file of JSON lines {"t": seconds since the start, "fd": 1 or 2, "line": "..."}, as written by
+# --record, or a generated one:
+#   progress:N     a download of one video with N progress lines, 10 per second
+#   playlist:N     the `-j` output of a playlist with N entries, 100 per second
+#
+# Options:
+#   speed=F        replay F times as fast, 0 for as fast as possible (default: 1)
+#   repeat=N       replay the trace N times in a row, e.g. for a storm of progress (default: 1)
+#   fail_after=N   print an error and exit with 1 after N lines, as yt-dlp does when a download breaks
+#   exit=N         the exit code once replayed (default: 0)
+#   sigint=M       on SIGINT, "exit" with 1 as yt-dlp does (default), or "ignore" it to be escalated
+#   stamp=1        append " @@<CLOCK_MONOTONIC in ns>@@" to each line but JSON, when it is written,
+#                  from which the load driver measures the latency of events
+# Unknown options are ignored, e.g. "n=42" to make requests distinct.
+
+import json
+import signal
+import subprocess
+import sys
+import threading
+import time
+
+
+def parse_spec(spec):
+    name, _, query = spec.partition("?")
+    options = {}
+    for pair in filter(None, query.split("&")):
+        key, _, value = pair.partition("=")
+        options[key] = value
+    return name, options
+
+
+def generate_progress(count):
+    filename = "/tmp/yt-dlp-sim/Simulated video [sim00000001].mp4"
+    events = [
+        (0.00, 1, "Extract URL: https://www.youtube.com/watch?v=sim00000001"),
+        (0.05, 1, '[youtube] sim00000001: "137+140" with format "137 - 1920x1080 (1080p)+140 - audio only"'),
+        (0.05, 1, "Archive entry: Youtube sim00000001"),
+        (0.06, 1, "Start download..."),
+    ]
+    total = count * 65536
+    for i in range(count):
+        downloaded = (i + 1) * 65536
+        eta = (total - downloaded) // 655360
+        events.append((0.1 + i / 10, 1, f"[Progress]downloading|{downloaded}|{total}|655360.0|{eta}|NA|{filename}"))
+    end = 0.1 + count / 10
+    events.append((end, 1, f"[Progress]finished|{total}|{total}|NA|NA|NA|{filename}"))
+    events.append((end + 0.01, 1, "Finished downloading"))
+    events.append((end + 0.02, 1, "Start post processing..."))
+    events.append((end + 0.05, 1, "Finished post processing"))
+    events.append((end + 0.05, 1, f'Save video to "{filename}"'))
+    return events
+
+
+def generate_playlist(count):
+    events = []
+    for i in range(count):
+        entry = {
+            "id": f"sim{i:08d}",
+            "title": f"Simulated video {i + 1}",
+            "extractor": "youtube",
+            "webpage_url": f"https://www.youtube.com/watch?v=sim{i:08d}",
+            "duration": 60 + i % 600,
+            "playlist_index": i + 1,
+            "playlist_count": count,
+        }
+        events.append((i / 100, 1, json.dumps(entry)))
+    return events
+
+
+def load_trace(name):
+    kind, _, count = name.partition(":")
+    if kind == "progress" and count.isdigit():
+        return generate_progress(int(count))
+    if kind == "playlist" and count.isdigit():
+        return generate_playlist(int(count))
+
+    events = []
+    with open(name, encoding="utf-8") as file:
+        for line in file:
+            if line.strip():
+                record = json.loads(line)
+                events.append((float(record["t"]), int(record.get("fd", 1)), record["line"]))
+    return events
+
+
+def replay(spec):
+    name, options = parse_spec(spec)
+    speed = float(options.get("speed", 1))
+    repeat = int(options.get("repeat", 1))
+    fail_after = int(options["fail_after"]) if "fail_after" in options else None
+    stamp = options.get("stamp") == "1"
+
+    if options.get("sigint") == "ignore":
+        signal.signal(signal.SIGINT, signal.SIG_IGN)
+
+    events = load_trace(name)
+    streams = {1: sys.stdout, 2: sys.stderr}
+    span = events[-1][0] if events else 0
+
+    try:
+        start = time.monotonic()
+        written = 0
+        for round_index in range(repeat):
+            for t, fd, line in events:
+                if fail_after is not None and written >= fail_after:
+                    print("ERROR: Simulated failure after {} lines".format(written), file=sys.stderr, flush=True)
+                    return 1
+
+                if speed > 0:
+                    delay = start + (round_index * span + t) / speed - time.monotonic()
+                    if delay > 0:
+                        time.sleep(delay)
+
+                if stamp and not line.startswith("{"):
+                    line = f"{line} @@{time.monotonic_ns()}@@"
+                print(line, file=streams.get(fd, sys.stdout), flush=True)
+                written += 1
+    except KeyboardInterrupt:
+        print("\nERROR: Interrupted by user", file=sys.stderr, flush=True)
+        return 1
+    except BrokenPipeError:
+        return 1
+    return int(options.get("exit", 0))
+
+
+def record(path, command):
+    start = time.monotonic()
+    lock = threading.Lock()
+    process = subprocess.Popen(command, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+
+    with open(path, "w", encoding="utf-8") as file:
+
+        def pump(stream, fd):
+            for raw in stream:
+                line = raw.decode("utf-8", "replace").rstrip("\r\n")
+                record = {"t": round(time.monotonic() - start, 4), "fd": fd, "line": line}
+                with lock:
+                    file.write(json.dumps(record) + "\n")
+
+        threads = [
+            threading.Thread(target=pump, args=(process.stdout, 1)),
+            threading.Thread(target=pump, args=(process.stderr, 2)),
+        ]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+    return process.wait()
+
+
+if __name__ == "__main__":
+    if len(sys.argv) >= 4 and sys.argv[1] == "--record":
+        sys.exit(record(sys.argv[2], sys.argv[3:]))
+    if len(sys.argv) < 2:
+        print("Usage: yt-dlp-sim.py <trace>[?option=value&...] | --record <trace file> <yt-dlp> [arguments...]",
+              file=sys.stderr)
+        sys.exit(2)
+    sys.exit(replay(sys.argv[1]))
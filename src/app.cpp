@@ -1,129 +1,649 @@
 #include "app.h"
 
 #include "boost/algorithm/string/join.hpp"
+#include "download_archive.h"
 #include "exception.h"
-#include "nlohmann/json.hpp"
+#include "executable_cache.h"
+#include "http_server.h"
+#include "json_text.h"
+#include "load_driver.h"
+#include "preview_stream.h"
+#include "progress.h"
 #include "request.h"
+#include "single_flight.h"
+#include "task_journal.h"
 #include "task_manager.h"
+#include "telemetry.h"
 #include "webui.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <filesystem>
 #include <format>
+#include <fstream>
+#include <memory>
 #include <optional>
-#include <thread>
+#include <random>
+#include <ranges>
+#include <vector>
 
 namespace ytweb
 {
 
 namespace fs = std::filesystem;
 
-using Json = nlohmann::json;
-
 using TaskId = TaskManager::TaskId;
 
+namespace
+{
+
+auto to_task_priority(Request::Priority priority) -> TaskManager::Priority
+{
+    switch (priority)
+    {
+    case Request::Priority::High:
+        return TaskManager::Priority::High;
+    case Request::Priority::Low:
+        return TaskManager::Priority::Low;
+    default:
+        return TaskManager::Priority::Normal;
+    }
+}
+
+// The lines printed by the `-O` templates of downloads, see `Request`, which mark the phases of each video.
+auto phase_mark(std::string_view line) -> std::optional<TaskManager::Mark>
+{
+    if (line.starts_with("Extract URL: "))
+    {
+        return TaskManager::Mark::Extracted;
+    }
+    if (line == "Start download...")
+    {
+        return TaskManager::Mark::DownloadStarted;
+    }
+    if (line == "Finished downloading")
+    {
+        return TaskManager::Mark::DownloadFinished;
+    }
+    if (line == "Finished post processing")
+    {
+        return TaskManager::Mark::Moved;
+    }
+    return std::nullopt;
+}
+
+// A temporary file which is removed with its last owner.
+class TempFile
+{
+  public:
+    explicit TempFile(fs::path path) : path_(std::move(path))
+    {
+    }
+
+    ~TempFile()
+    {
+        std::error_code ec;
+        fs::remove(path_, ec);
+    }
+
+    TempFile(TempFile const&) = delete;
+    TempFile& operator=(TempFile const&) = delete;
+    TempFile(TempFile&&) = delete;
+    TempFile& operator=(TempFile&&) = delete;
+
+    auto path() const -> fs::path const&
+    {
+        return path_;
+    }
+
+  private:
+    fs::path path_;
+};
+
+// Return `nullptr` if the file can't be written.
+auto write_temp_file(std::string_view content, std::string_view extension) -> std::shared_ptr<TempFile>
+{
+    static std::atomic<unsigned> counter{0};
+    static unsigned const INSTANCE = std::random_device{}();
+
+    std::error_code ec;
+    auto directory = fs::temp_directory_path(ec) / "yt-dlp-web";
+    fs::create_directories(directory, ec);
+
+    auto file = std::make_shared<TempFile>(directory / std::format("{:08x}-{}{}", INSTANCE, counter++, extension));
+
+    std::ofstream stream(file->path(), std::ios::binary);
+    stream << content;
+    return stream ? file : nullptr;
+}
+
+// What is left to download once the videos in the download archive are skipped.
+struct ArchiveFilter
+{
+    bool nothing_left{false};
+    bool served{false};                   // the backend records the downloaded videos instead of yt-dlp
+    std::size_t skipped{0};               // the URLs skipped from the batch file
+    std::shared_ptr<TempFile> batch_file; // the batch file without them
+};
+
+// Skip the videos in the download archive before launching yt-dlp, where they are known up front:
+// by the information of a previous preview, or by the URL of a video downloaded since the archive was loaded.
+// If all videos are known, the archive is not passed to yt-dlp, which would otherwise read the whole file.
+auto filter_archived(Request& request, DownloadArchive const& archive, std::optional<std::string> const& preview)
+    -> ArchiveFilter
+{
+    ArchiveFilter filter;
+
+    if (!request.batch_file().empty())
+    {
+        std::ifstream stream(request.batch_file(), std::ios::binary);
+        std::string left;
+        std::size_t urls{0};
+        for (std::string line; std::getline(stream, line);)
+        {
+            auto url = std::string_view(line);
+            if (url.ends_with('\r'))
+            {
+                url.remove_suffix(1);
+            }
+
+            // Comments start with '#', ';' or ']' in a batch file.
+            bool const comment = url.empty() || url.starts_with('#') || url.starts_with(';') || url.starts_with(']');
+            if (!comment && archive.contains_url(url))
+            {
+                ++filter.skipped;
+                continue;
+            }
+            urls += comment ? 0 : 1;
+            left.append(line).push_back('\n');
+        }
+
+        if (filter.skipped > 0)
+        {
+            filter.nothing_left = urls == 0;
+            filter.batch_file = filter.nothing_left ? nullptr : write_temp_file(left, ".txt");
+            if (filter.batch_file)
+            {
+                request.set_batch_file(filter.batch_file->path().string());
+            }
+        }
+        return filter;
+    }
+
+    // A single video, or the items of a playlist.
+    if (preview)
+    {
+        std::vector<MediaIdentity> entries;
+        for (auto line : std::views::split(*preview, '\n'))
+        {
+            auto identity = identify_media(std::string_view(line.begin(), line.end()));
+            if (!identity)
+            {
+                entries.clear();
+                break;
+            }
+            entries.push_back(std::move(*identity));
+        }
+
+        if (entries.size() == 1)
+        {
+            filter.nothing_left = archive.contains(entries.front().extractor, entries.front().id);
+            filter.served = true;
+        }
+        else if (entries.size() > 1 && !request.has_playlist_items() &&
+                 std::ranges::all_of(entries, [](auto const& entry) { return entry.playlist_index.has_value(); }))
+        {
+            std::string items;
+            for (auto const& entry : entries)
+            {
+                if (!archive.contains(entry.extractor, entry.id))
+                {
+                    items += items.empty() ? "" : ",";
+                    items += std::to_string(*entry.playlist_index);
+                }
+            }
+
+            filter.nothing_left = items.empty();
+            filter.served = true;
+            request.set_playlist_items(items);
+        }
+
+        if (filter.served)
+        {
+            request.drop_download_archive();
+            return filter;
+        }
+    }
+
+    filter.nothing_left = archive.contains_url(request.url());
+    return filter;
+}
+
+// Identical requests share a task, and so do downloads writing the same files, which would otherwise race on
+// them. The key is taken before the arguments are tied to a request, e.g. by a temporary info file.
+auto flight_key(Request const& request) -> std::string
+{
+    if (request.action() == Request::Action::Download)
+    {
+        return std::string("download") + '\0' + request.output_key();
+    }
+
+    std::string key(request.yt_dlp_path());
+    for (auto const& arg : request.args())
+    {
+        key += '\0';
+        key += arg;
+    }
+    return key;
+}
+
+} // anonymous namespace
+
 void App::handle_request(webui::window::event* event)
 {
     logger_.debug("Received request: {}", event->get_string_view());
 
+    if (auto task = submit(event->get_string_view()))
+    {
+        event->return_int(*task);
+    }
+}
+
+auto App::submit(std::string_view request_json, std::optional<TaskJournal::Key> resumes) -> std::optional<TaskId>
+{
+    auto parse_start = std::chrono::steady_clock::now();
+
     std::optional<Request> request;
     try
     {
-        request.emplace(event->get_string_view());
+        request.emplace(request_json);
     }
     catch (ParseError const& e)
     {
         logger_.error("Error parsing request: {}", e.what());
-        return;
+        return std::nullopt;
     }
 
-    TaskId task{};
+    // Whatever has been downloaded by the interrupted task is kept.
+    if (resumes)
+    {
+        request->continue_partial();
+    }
+
+    auto parse_time = std::chrono::steady_clock::now() - parse_start;
+
+    // Identical requests share a task, keyed before the arguments are tied to this request.
+    auto request_key = flight_key(*request);
+    auto task = manager_.reserve_id();
 
     if (request->action() == Request::Action::Preview)
     {
-        auto response = std::make_shared<std::string>();
+        if (auto cached = preview_cache_.get(request->extraction_key()))
+        {
+            auto stats = preview_cache_.stats();
+            logger_.info("[Task {}] Preview served from cache (hits: {}, misses: {}).", task, stats.hits, stats.misses);
+
+            auto stream = make_preview_stream(task);
+            for (auto entry : std::views::split(*cached, '\n'))
+            {
+                stream.append(std::string_view(entry.begin(), entry.end()));
+            }
+            stream.finish();
+            report_completion(task, {});
+            return task;
+        }
+    }
 
-        task = manager_.launch(
-            request->yt_dlp_path(), request->args(),
-            [response](TaskId /* id */, std::string_view line) { response->append(line); },
-            [response, this](TaskId id) {
-                logger_.info("[Task {}] Preview completed.", id);
-                show_preview_info(*response);
-                report_completion(id);
+    // The information of a previous preview, which tells what a download is about to get.
+    std::optional<std::string> preview;
+    if (request->action() == Request::Action::Download &&
+        (request->can_load_info_json() || !request->download_archive().empty()))
+    {
+        preview = preview_cache_.peek(request->extraction_key());
+    }
+
+    std::shared_ptr<ArchiveRecorder> recorder;
+    ArchiveFilter archive_filter;
+    if (request->action() == Request::Action::Download && !request->download_archive().empty())
+    {
+        if (auto archive = archives_.get(request->download_archive()))
+        {
+            archive_filter = filter_archived(*request, *archive, preview);
+            if (archive_filter.nothing_left)
+            {
+                logger_.info("[Task {}] Everything has been downloaded, according to the download archive.", task);
+                report_completion(task, {});
+                journal_finished(task, request_json, resumes);
+                return task;
             }
+
+            if (archive_filter.skipped > 0)
+            {
+                logger_.info("[Task {}] Skip {} archived URLs of the batch file.", task, archive_filter.skipped);
+            }
+            if (archive_filter.served)
+            {
+                logger_.info("[Task {}] Skip the archived videos, and record the downloaded ones.", task);
+            }
+            recorder = std::make_shared<ArchiveRecorder>(archive, archive_filter.served);
+        }
+        else
+        {
+            logger_.warning("[Task {}] Can't read the download archive: {}", task, request->download_archive());
+        }
+    }
+
+    if (auto shared = flights_.join(request_key, task); shared != task)
+    {
+        logger_.info(
+            "[Task {}] Subscribed to task {}, which runs the same request or writes the same files.", task, shared
+        );
+        if (auto state = manager_.state(shared))
+        {
+            report_state(task, *state);
+        }
+
+        // The shared task is journaled itself.
+        journal_finished(task, request_json, resumes);
+        return task;
+    }
+
+    if (request->action() == Request::Action::Preview)
+    {
+        auto fan_out = std::make_shared<PreviewFanOut>(
+            [this](TaskId id) { return make_preview_stream(id); }, preview_cache_.max_entry_bytes()
+        );
+
+        manager_.launch(
+            task, request->yt_dlp_path(), request->args(),
+            [fan_out, this](TaskId id, std::string_view line) {
+                telemetry_.record_event();
+                manager_.mark(id, TaskManager::Mark::Extracted); // each entry is printed once extracted
+                fan_out->append(flights_.subscribers(id), line);
+                flush_preview_later(id, fan_out);
+            },
+            [fan_out, key = request->extraction_key(), this](TaskId id) {
+                logger_.info("[Task {}] Preview completed.", id);
+
+                auto subscribers = flights_.land(id);
+                fan_out->finish(subscribers);
+
+                if (auto const& kept = fan_out->kept(); kept && !kept->empty())
+                {
+                    preview_cache_.put(key, *kept);
+                }
+
+                auto stderr_tail = manager_.stderr_tail(id);
+                for (auto subscriber : subscribers)
+                {
+                    report_completion(subscriber, stderr_tail);
+                }
+            },
+            TaskManager::TaskType::Preview, to_task_priority(request->priority())
         );
     }
     else
     {
-        task = manager_.launch(
-            request->yt_dlp_path(), request->args(),
-            [this](TaskId id, std::string_view line) {
-                constexpr std::string_view PROGRESS_PREFIX = "[Progress]";
+        if (journal_)
+        {
+            journal_->enqueued(task, request_json, resumes);
+        }
+
+        // Reuse the information of a previous preview of a single video, which saves a full round of extraction.
+        std::shared_ptr<TempFile> info_json;
+        if (request->can_load_info_json())
+        {
+            if (preview && preview->find('\n') == std::string::npos)
+            {
+                info_json = write_temp_file(*preview, ".info.json");
+            }
+
+            if (info_json)
+            {
+                request->load_info_json(info_json->path().string());
+                logger_.info("Reuse the information of the previous preview: {}", info_json->path().string());
+            }
+        }
+
+        manager_.launch(
+            task, request->yt_dlp_path(), request->args(),
+            // The temporary files are removed along with the callback when the task is finished.
+            [this, info_json, batch_file = archive_filter.batch_file, recorder](TaskId id, std::string_view line) {
+                telemetry_.record_event();
 
                 if (line.starts_with(PROGRESS_PREFIX))
                 {
                     line.remove_prefix(PROGRESS_PREFIX.size());
 
-                    try
+                    auto progress = decode_progress(line);
+                    if (!progress)
                     {
-                        auto progress = Json::parse(line);
-                        progress["task_id"] = id;
+                        logger_.error("[Task {}] Error parsing downloading progress: {}", id, line);
+                        return;
+                    }
+                    record_progress(id, *progress);
 
-                        show_download_progress(progress.dump());
+                    // Reused across lines, so that the hot path doesn't allocate.
+                    thread_local std::string json;
+                    for (auto subscriber : flights_.subscribers(id))
+                    {
+                        json.clear();
+                        encode_progress(*progress, subscriber, json);
+                        progress_.update(subscriber, json, progress->terminal());
                     }
-                    catch (Json::parse_error const& e)
+
+                    if (journal_ && progress->downloaded_bytes)
                     {
-                        logger_.error("[Task {}] Error parsing downloading progress: {}", id, e.what());
+                        journal_->checkpoint(
+                            id, *progress->downloaded_bytes, progress->total_bytes, progress->filename
+                        );
                     }
                 }
                 else
                 {
+                    if (auto mark = phase_mark(line))
+                    {
+                        manager_.mark(id, *mark);
+                    }
+                    if (recorder && recorder->feed(line))
+                    {
+                        logger_.debug("[Task {}] Recorded in the download archive.", id);
+                    }
                     if (!line.empty())
                     {
                         logger_.debug("[Task {}] {}", id, line);
-                        show_download_info(line);
+                        show_download_info(id, line);
                     }
                 }
             },
             [this](TaskId id) {
                 logger_.info("[Task {}] Download completed.", id);
-                report_completion(id);
-            }
+                progress_.flush(); // the last progress goes before the completion
+                if (journal_)
+                {
+                    journal_->completed(id);
+                }
+
+                auto stderr_tail = manager_.stderr_tail(id);
+                for (auto subscriber : flights_.land(id))
+                {
+                    report_completion(subscriber, stderr_tail);
+                }
+            },
+            TaskManager::TaskType::Download, to_task_priority(request->priority())
         );
     }
 
     logger_.info("[Task {}] Successfully parsed request.", task);
+    logger_.debug(
+        "[Task {}] Parsed the request in {} us, including {} us to find yt-dlp.", task,
+        std::chrono::duration_cast<std::chrono::microseconds>(parse_time).count(),
+        std::chrono::duration_cast<std::chrono::microseconds>(request->resolve_time()).count()
+    );
     logger_.debug(
         "[Task {}] Run command: {} {}", task, request->yt_dlp_path(), boost::algorithm::join(request->args(), " ")
     );
+    return task;
+}
 
-    // Use a detached thread so that the thread id can be returned immediately.
-    std::thread{[this, task] { manager_.wait(task); }}.detach();
-
-    event->return_int(task);
+// A resumed download which is served without a task of its own is over at once.
+void App::journal_finished(TaskId task, std::string_view request_json, std::optional<TaskJournal::Key> resumes)
+{
+    if (journal_ && resumes)
+    {
+        journal_->enqueued(task, request_json, resumes);
+        journal_->completed(task);
+    }
 }
 
 void App::handle_interrupt(webui::window::event* event)
 {
-    auto task = static_cast<TaskId>(event->get_int());
+    interrupt(static_cast<TaskId>(event->get_int()));
+}
+
+void App::interrupt(TaskId task)
+{
     logger_.info("[Task {}] Received interrupt request.", task);
 
-    if (manager_.is_running(task))
+    auto departure = flights_.leave(task);
+    if (!departure)
     {
-        manager_.kill(task);
+        logger_.info("[Task {}] The task is neither running nor queued, so it can't be interrupted.", task);
+        return;
+    }
 
+    // A task shared by other requests goes on for them.
+    if (departure->last)
+    {
+        manager_.kill(departure->task);
+        if (journal_)
+        {
+            journal_->interrupted(departure->task);
+        }
         logger_.info("[Task {}] Interrupted.", task);
-        report_interruption(task);
     }
     else
     {
-        logger_.info("[Task {}] The task is not running, so it can't be interrupted.", task);
+        logger_.info("[Task {}] Unsubscribed from task {}, which other requests still share.", task, departure->task);
     }
+    report_interruption(task, manager_.stderr_tail(departure->task));
+}
+
+void App::handle_metrics(webui::window::event* event)
+{
+    event->return_string(telemetry_.to_json());
+}
+
+void App::handle_pause(webui::window::event* event)
+{
+    pause(static_cast<TaskId>(event->get_int()));
+}
+
+bool App::pause(TaskId task)
+{
+    logger_.info("[Task {}] Received pause request.", task);
+
+    // A shared task is paused for all requests subscribed to it.
+    if (manager_.pause(flights_.task_of(task).value_or(task)))
+    {
+        logger_.info("[Task {}] Paused.", task);
+        return true;
+    }
+    logger_.info("[Task {}] The task is not running, or can't be paused on this platform.", task);
+    return false;
+}
+
+void App::handle_resume(webui::window::event* event)
+{
+    resume(static_cast<TaskId>(event->get_int()));
+}
+
+bool App::resume(TaskId task)
+{
+    logger_.info("[Task {}] Received resume request.", task);
+
+    if (manager_.resume(flights_.task_of(task).value_or(task)))
+    {
+        logger_.info("[Task {}] Resumed.", task);
+        return true;
+    }
+    logger_.info("[Task {}] The task is not paused, so it can't be resumed.", task);
+    return false;
 }
 
 void App::init()
 {
+    manager_.set_on_state_change([this](TaskId id, TaskManager::TaskState state) { fan_out_state(id, state); });
+    manager_.set_on_stderr([this](TaskId id, std::string_view line) {
+        if (!line.empty())
+        {
+            logger_.warning("[Task {}] {}", id, line);
+        }
+    });
+    manager_.set_on_timings([this](TaskId id, TaskManager::Timings const& timings) {
+        using std::chrono::duration_cast;
+        using std::chrono::microseconds;
+        using std::chrono::milliseconds;
+
+        telemetry_.record(timings);
+
+        if (!timings.process)
+        {
+            return;
+        }
+
+        auto const& process = *timings.process;
+        if (process.first_output)
+        {
+            logger_.debug(
+                "[Task {}] Spawned in {} us, first output after {} ms.", id,
+                duration_cast<microseconds>(process.spawn).count(),
+                duration_cast<milliseconds>(*process.first_output).count()
+            );
+        }
+        else
+        {
+            logger_.debug(
+                "[Task {}] Spawned in {} us, no output.", id, duration_cast<microseconds>(process.spawn).count()
+            );
+        }
+    });
+    manager_.set_on_cancelled([this](TaskId id, AsyncProcess::Cancellation cancellation) {
+        auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(cancellation.latency);
+        switch (cancellation.signal)
+        {
+        case AsyncProcess::Signal::Interrupt:
+            logger_.info("[Task {}] Stopped {} ms after the interrupt request.", id, latency.count());
+            break;
+        case AsyncProcess::Signal::Terminate:
+            logger_.warning(
+                "[Task {}] Ignored SIGINT, terminated {} ms after the interrupt request.", id, latency.count()
+            );
+            break;
+        case AsyncProcess::Signal::Kill:
+            logger_.warning(
+                "[Task {}] Ignored SIGTERM, killed {} ms after the interrupt request.", id, latency.count()
+            );
+            break;
+        }
+    });
+
     window_.bind("handleRequest", [](webui::window::event* event) { App::instance().handle_request(event); });
     window_.bind("handleInterrupt", [](webui::window::event* event) { App::instance().handle_interrupt(event); });
+    window_.bind("handlePause", [](webui::window::event* event) { App::instance().handle_pause(event); });
+    window_.bind("handleResume", [](webui::window::event* event) { App::instance().handle_resume(event); });
+    window_.bind("getMetrics", [](webui::window::event* event) { App::instance().handle_metrics(event); });
+
+    telemetry_.start({
+        .prometheus_file = metrics_file_,
+        .load = [this] { return Telemetry::Load{.queued = manager_.queued(), .running = manager_.running()}; },
+    });
+
+    if (journal_)
+    {
+        resume_unfinished();
+    }
 }
 
 void App::set_server_dir(std::filesystem::path const& server_dir)
@@ -147,35 +667,252 @@ void App::set_server_dir(std::filesystem::path const& server_dir)
     window_.set_root_folder(server_dir.string());
 }
 
+void App::set_journal(std::filesystem::path const& path)
+{
+    journal_ = std::make_unique<TaskJournal>(TaskJournal::Options{.path = path});
+    logger_.info("Journal the tasks in: {}", path.string());
+    if (journal_->skipped() > 0)
+    {
+        logger_.warning("Skipped {} invalid records of the task journal.", journal_->skipped());
+    }
+}
+
+// The downloads left unfinished by a crash or an exit are started again, before the frontend is shown,
+// so they run without a page to report to.
+void App::resume_unfinished()
+{
+    for (auto const& unfinished : journal_->unfinished())
+    {
+        auto task = submit(unfinished.request, unfinished.key);
+        if (!task)
+        {
+            continue;
+        }
+
+        if (unfinished.checkpoint)
+        {
+            logger_.info(
+                "[Task {}] Resume the download of run {}, task {}, from {} bytes of {}.", *task, unfinished.key.run,
+                unfinished.key.id, unfinished.checkpoint->downloaded_bytes, unfinished.checkpoint->filename
+            );
+        }
+        else
+        {
+            logger_.info(
+                "[Task {}] Restart the download of run {}, task {}, which had not made progress.", *task,
+                unfinished.key.run, unfinished.key.id
+            );
+        }
+    }
+}
+
+void App::set_cache_dir(std::filesystem::path const& cache_dir)
+{
+    preview_cache_.set_options({.directory = cache_dir / "preview"});
+}
+
+void App::set_workers(std::filesystem::path const& python, std::filesystem::path const& script)
+{
+    manager_.set_workers({
+        .python = python.string(),
+        .script = script.string(),
+        // The same as requests without `yt_dlp_path`.
+        .command = find_executable_cached("yt-dlp"),
+    });
+    logger_.info("Run yt-dlp in resident helpers: {} {}", python.string(), script.string());
+}
+
 void App::run()
 {
     window_.show_browser("index.html", static_cast<unsigned int>(runtime_));
     webui::wait();
+    stop();
+}
+
+std::string App::run_load_test(LoadDriver& driver)
+{
+    auto report = driver.run({
+        .submit = [this](std::string_view request) { return submit(request); },
+        .interrupt = [this](TaskId task) { interrupt(task); },
+        .residue = [this] { return LoadDriver::Residue{.tasks = manager_.size(), .flights = flights_.size()}; },
+    });
+    stop();
+    return report;
 }
 
-void App::show_download_progress(std::string_view data)
+void App::serve(HttpServer& server)
 {
-    window_.send_raw("showDownloadProgress", data.data(), data.size());
+    server.start({
+        .submit = [this](std::string_view request) { return submit(request); },
+        .interrupt = [this](TaskId task) { interrupt(task); },
+        .pause = [this](TaskId task) { return pause(task); },
+        .resume = [this](TaskId task) { return resume(task); },
+        .metrics = [this] { return telemetry_.to_json(); },
+    });
+    logger_.info("Serve the API on port {}.", server.port());
+
+    server.wait();
+    stop();
 }
 
-void App::show_download_info(std::string_view data)
+void App::stop()
 {
-    window_.send_raw("showDownloadInfo", data.data(), data.size());
+    // Sampling asks the manager, which is gone first.
+    telemetry_.stop();
+
+    // The tasks killed from now on are resumed by the next run.
+    if (journal_)
+    {
+        journal_->close();
+    }
+}
+
+void App::send(std::string_view function, std::string_view data)
+{
+    if (frontend_)
+    {
+        frontend_->send(function, data);
+        return;
+    }
+    window_.send_raw(function, data.data(), data.size());
+}
+
+void App::run_script(std::string_view script)
+{
+    if (frontend_)
+    {
+        frontend_->run(script);
+        return;
+    }
+    window_.run(script);
 }
 
-void App::show_preview_info(std::string_view data)
+// Progress is superseded by later progress, and info lines are only informative, so both may be dropped.
+// But not terminal progress, e.g. the final 100%, which nothing supersedes.
+void App::show_download_progress(std::string_view data, bool terminal)
 {
-    window_.send_raw("showPreviewInfo", data.data(), data.size());
+    auto const policy = terminal ? EventBus::Policy::Lossless : EventBus::Policy::DropOldest;
+    bus_.send("showDownloadProgress", data, policy, EventBus::Merge::JsonArray);
 }
 
-void App::report_completion(TaskId id)
+void App::show_download_info(TaskId id, std::string_view line)
 {
-    window_.run(std::format(R"js(reportCompletion({}))js", id));
+    bus_.send("showDownloadInfo", line, EventBus::Policy::DropOldest, EventBus::Merge::Lines, id);
 }
 
-void App::report_interruption(TaskId id)
+void App::show_preview_entries(TaskId id, std::string_view data)
 {
-    window_.run(std::format(R"js(reportInterruption({}))js", id));
+    bus_.send("showPreviewEntries", data, EventBus::Policy::Lossless, EventBus::Merge::None, id);
+}
+
+auto App::make_preview_stream(TaskId id) -> PreviewStream
+{
+    return {id, [this, id](std::string_view batch) { show_preview_entries(id, batch); }};
+}
+
+// The timer runs in the event loop of the task, so it never races the entries arriving.
+void App::flush_preview_later(TaskId id, std::shared_ptr<PreviewFanOut> const& fan_out)
+{
+    auto when = fan_out->arm(flights_.subscribers(id));
+    if (!when)
+    {
+        return;
+    }
+
+    auto on_timer = [this, id, fan_out] {
+        fan_out->on_timer(flights_.subscribers(id));
+        flush_preview_later(id, fan_out);
+    };
+    if (!manager_.defer(id, *when, std::move(on_timer)))
+    {
+        fan_out->disarm(); // the process is not known yet, so the next entry tries again
+    }
+}
+
+// The tail of stderr is attached to the report, as it usually tells why a task has failed.
+void App::report_completion(TaskId id, std::string_view stderr_tail)
+{
+    auto script = std::format("reportCompletion({}, ", id);
+    append_json_string(script, stderr_tail);
+    script.push_back(')');
+    bus_.run(script);
+}
+
+void App::report_interruption(TaskId id, std::string_view stderr_tail)
+{
+    auto script = std::format("reportInterruption({}, ", id);
+    append_json_string(script, stderr_tail);
+    script.push_back(')');
+    bus_.run(script);
+}
+
+void App::report_state(TaskId id, TaskManager::TaskState state)
+{
+    std::string_view name;
+    switch (state)
+    {
+    case TaskManager::TaskState::Queued:
+        name = "queued";
+        break;
+    case TaskManager::TaskState::Running:
+        name = "running";
+        break;
+    case TaskManager::TaskState::Paused:
+        name = "paused";
+        break;
+    case TaskManager::TaskState::Failed:
+        name = "error";
+        break;
+    }
+
+    bus_.run(std::format(R"js(reportTaskState({}, "{}"))js", id, name));
+}
+
+void App::record_progress(TaskId id, Progress const& progress)
+{
+    if (progress.status == "finished")
+    {
+        telemetry_.record_downloaded(progress.downloaded_bytes.value_or(0));
+        return;
+    }
+
+    if (progress.speed)
+    {
+        telemetry_.record_speed(*progress.speed);
+    }
+    if (progress.downloaded_bytes.value_or(0) > 0)
+    {
+        manager_.mark(id, TaskManager::Mark::FirstByte);
+    }
+}
+
+void App::fan_out_state(TaskId task, TaskManager::TaskState state)
+{
+    if (state == TaskManager::TaskState::Failed)
+    {
+        logger_.error("[Task {}] Failed to launch the process, or the job of the helper failed.", task);
+        invalidate_executable_cache(); // yt-dlp may have been moved
+        if (journal_)
+        {
+            journal_->failed(task);
+        }
+
+        // The task is over, and so is its flight.
+        for (auto subscriber : flights_.land(task))
+        {
+            report_state(subscriber, state);
+        }
+        return;
+    }
+
+    if (journal_ && state == TaskManager::TaskState::Running)
+    {
+        journal_->started(task);
+    }
+    for (auto subscriber : flights_.subscribers(task))
+    {
+        report_state(subscriber, state);
+    }
 }
 
 } // namespace ytweb
@@ -1,11 +1,28 @@
 #pragma once
 
+#include "download_archive.h"
+#include "event_bus.h"
+#include "http_server.h"
+#include "load_driver.h"
 #include "logger.h"
+#include "preview_cache.h"
+#include "preview_stream.h"
+#include "progress.h"
+#include "progress_coalescer.h"
 #include "runtime.h"
+#include "single_flight.h"
+#include "task_journal.h"
 #include "task_manager.h"
+#include "telemetry.h"
 #include "webui.hpp"
 
+#include <chrono>
 #include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
 
 namespace ytweb
 {
@@ -19,9 +36,31 @@ class App
         return app;
     }
 
+    // Where the events for the frontend go instead of the window, e.g. to a load test.
+    struct Frontend
+    {
+        // Call the function of the page with the data.
+        std::function<void(std::string_view function, std::string_view data)> send;
+        std::function<void(std::string_view script)> run;
+    };
+
     void init();
     void run();
 
+    // Drive the app by the load driver instead of a page, until its tasks are over, and return its report.
+    // The driver must be the frontend.
+    std::string run_load_test(LoadDriver& driver);
+
+    // Serve the API of the server instead of showing the frontend, until it is stopped.
+    // The server must be the frontend. Throw `boost::system::system_error` if it can't listen.
+    void serve(HttpServer& server);
+
+    // Set before anything else, as the log is sent there too.
+    void set_frontend(Frontend frontend)
+    {
+        frontend_ = std::move(frontend);
+    }
+
     void set_runtime(Runtime runtime)
     {
         runtime_ = runtime;
@@ -29,26 +68,145 @@ class App
 
     void set_server_dir(std::filesystem::path const& server_dir);
 
+    // Persist preview results under the directory.
+    void set_cache_dir(std::filesystem::path const& cache_dir);
+
+    // Journal the downloads, and resume the unfinished ones of previous runs on `init()`.
+    // Throw `PathError` if the journal can't be opened.
+    void set_journal(std::filesystem::path const& path);
+
+    void set_task_limits(TaskManager::Limits limits)
+    {
+        manager_.set_limits(limits);
+    }
+
+    // Set how long an interrupted task may take to exit before it is stopped by force.
+    void set_escalation(AsyncProcess::Escalation escalation)
+    {
+        manager_.set_escalation(escalation);
+    }
+
+    // Run yt-dlp as jobs of resident helpers, which saves the startup of python for each task.
+    // Throw if the helpers can't be launched.
+    void set_workers(std::filesystem::path const& python, std::filesystem::path const& script);
+
+    void set_log_level(LogLevel level)
+    {
+        logger_.set_level(level);
+    }
+
+    // Also write the log to a rotating file.
+    bool set_log_file(std::filesystem::path const& path)
+    {
+        return logger_.set_file({.path = path});
+    }
+
+    // Also write the metrics to a file in the text format of Prometheus, which is rewritten periodically.
+    void set_metrics_file(std::filesystem::path const& path)
+    {
+        metrics_file_ = path;
+    }
+
+    // Set how often the progress of downloads is sent to the frontend.
+    void set_progress_interval(std::chrono::milliseconds interval)
+    {
+        progress_.set_tick(interval);
+    }
+
   private:
     App() = default;
 
     Runtime runtime_{Runtime::Webview};
 
     webui::window window_;
+    std::optional<Frontend> frontend_;
+
+    // Stopped by `stop()`, before the manager is gone.
+    Telemetry telemetry_;
+
+    // The events for the frontend, sent by one thread. Outlives the logger and the tasks which queue them.
+    EventBus bus_{
+        {
+            .send = [this](std::string_view function, std::string_view data) { send(function, data); },
+            .run = [this](std::string_view script) { run_script(script); },
+        },
+        {
+            .on_sent = [this](std::span<EventBus::Clock::duration const> latencies) {
+                telemetry_.record_outbound(latencies);
+            },
+            .on_dropped = [this] { telemetry_.record_outbound_dropped(); },
+        },
+    };
+
+    // Outlive the tasks which use them.
+    Logger logger_{[this](std::string_view batch) {
+        bus_.send("logMessage", batch, EventBus::Policy::DropOldest, EventBus::Merge::JsonArray);
+    }};
+    ProgressCoalescer progress_{
+        [this](std::string_view batch, bool terminal) { show_download_progress(batch, terminal); }
+    };
+    std::unique_ptr<TaskJournal> journal_;
+
+    // Identical requests in flight share one task.
+    SingleFlight flights_;
+
+    PreviewCache preview_cache_;
+
+    // Loaded once and shared by the downloads which use them.
+    DownloadArchives archives_;
 
     TaskManager manager_;
 
-    Logger logger_{window_};
+    std::optional<std::filesystem::path> metrics_file_;
+
+    // Call the frontend directly, only from the sender of `bus_`.
+    void send(std::string_view function, std::string_view data);
+    void run_script(std::string_view script);
+
+    void show_download_progress(std::string_view data, bool terminal);
+    void show_download_info(TaskManager::TaskId id, std::string_view line);
+    void show_preview_entries(TaskManager::TaskId id, std::string_view data);
+
+    PreviewStream make_preview_stream(TaskManager::TaskId id);
+
+    // Send the pending entries of a preview once due, even if yt-dlp goes quiet meanwhile.
+    void flush_preview_later(TaskManager::TaskId id, std::shared_ptr<PreviewFanOut> const& fan_out);
 
-    void show_download_progress(std::string_view data);
-    void show_download_info(std::string_view data);
-    void show_preview_info(std::string_view data);
+    void report_completion(TaskManager::TaskId id, std::string_view stderr_tail);
+    void report_interruption(TaskManager::TaskId id, std::string_view stderr_tail);
+    void report_state(TaskManager::TaskId id, TaskManager::TaskState state);
 
-    void report_completion(TaskManager::TaskId id);
-    void report_interruption(TaskManager::TaskId id);
+    // Report the state to every request subscribed to the task.
+    void fan_out_state(TaskManager::TaskId task, TaskManager::TaskState state);
+
+    // Record the speed and the first bytes of a download.
+    void record_progress(TaskManager::TaskId id, Progress const& progress);
+
+    // Interrupt the task of a request, or only unsubscribe it if other requests share the task.
+    void interrupt(TaskManager::TaskId task);
+
+    // Return whether the task of a request has been paused or resumed.
+    bool pause(TaskManager::TaskId task);
+    bool resume(TaskManager::TaskId task);
 
     void handle_interrupt(webui::window::event* event);
+    void handle_metrics(webui::window::event* event);
+    void handle_pause(webui::window::event* event);
+    void handle_resume(webui::window::event* event);
     void handle_request(webui::window::event* event);
+
+    // Parse and start the request, and return the id of its task, or `std::nullopt` if the request is invalid.
+    // `resumes` is the unfinished download of a previous run which the request takes over.
+    std::optional<TaskManager::TaskId> submit(
+        std::string_view request_json, std::optional<TaskJournal::Key> resumes = std::nullopt
+    );
+    void journal_finished(
+        TaskManager::TaskId task, std::string_view request_json, std::optional<TaskJournal::Key> resumes
+    );
+    void resume_unfinished();
+
+    // Once the frontend is gone, before the tasks are killed.
+    void stop();
 };
 
 } // namespace ytweb
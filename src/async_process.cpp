@@ -1,62 +1,467 @@
 #include "async_process.h"
 
-#include "boost/asio/read_until.hpp"
+#include "boost/asio/buffer.hpp"
+#include "boost/asio/dispatch.hpp"
+#include "boost/asio/post.hpp"
+#include "boost/asio/write.hpp"
 #include "boost/process/v2/stdio.hpp"
 
+#ifndef _WIN32
+#include "boost/process/v2/posix/vfork_launcher.hpp"
+#endif
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
 namespace ytweb
 {
 
+namespace
+{
+
+#ifndef _WIN32
+// Make the process lead a new group, so that its children can be signaled along with it.
+struct NewProcessGroup
+{
+    template <typename Launcher>
+    auto on_exec_setup(
+        Launcher& /* launcher */, bp::filesystem::path const& /* executable */, char const* const*& /* argv */
+    ) -> boost::system::error_code
+    {
+        if (::setpgid(0, 0) != 0)
+        {
+            return {errno, boost::system::system_category()};
+        }
+        return {};
+    }
+};
+#else
+struct NewProcessGroup
+{
+};
+#endif
+
+// Once an interrupted process has exited, how long to keep reading the rest of its stderr,
+// which may be held open by a child that left its group.
+constexpr std::chrono::milliseconds DRAIN_TIMEOUT{200};
+
+#ifndef _WIN32
+// vfork doesn't copy the page tables of the app, so launching doesn't get slower as the app grows.
+using Launcher = bp::posix::vfork_launcher;
+#else
+using Launcher = bp::default_process_launcher;
+#endif
+
+} // anonymous namespace
+
 AsyncProcess::AsyncProcess(
-    std::string_view path, std::vector<std::string> const& args, CallbackOnLinebreak on_linebreak, CallbackOnEof on_eof
+    asio::any_io_executor const& executor,
+    std::string_view path,
+    std::vector<std::string> const& args,
+    CallbackOnLinebreak on_linebreak,
+    CallbackOnEof on_eof,
+    CallbackOnExit on_exit,
+    std::size_t max_line_length,
+    bool pipe_stdin
 )
-    : process_(std::make_unique<bp::process>(io_context_, path, args, bp::process_stdio{.out = pipe_})),
+    : strand_(asio::make_strand(executor)),
+      out_lines_(max_line_length),
+      err_lines_(max_line_length),
+      process_(launch(path, args, pipe_stdin)),
       on_linebreak_(std::move(on_linebreak)),
-      on_eof_(std::move(on_eof))
+      on_eof_(std::move(on_eof)),
+      on_exit_(std::move(on_exit))
+{
+}
+
+auto AsyncProcess::launch(std::string_view path, std::vector<std::string> const& args, bool pipe_stdin) -> bp::process
 {
-    read_output();
+    launched_at_ = std::chrono::steady_clock::now();
+    auto process = Launcher{}(strand_, bp::filesystem::path(path), args, make_stdio(pipe_stdin), NewProcessGroup{});
+    spawn_time_ = std::chrono::steady_clock::now() - launched_at_;
+    return process;
 }
 
-void AsyncProcess::read_output()
+auto AsyncProcess::make_stdio(bool pipe_stdin) -> bp::process_stdio
 {
-    asio::async_read_until(
-        pipe_, asio::dynamic_buffer(buffer_), '\n',
-        [this](boost::system::error_code ec, std::size_t bytes_transferred) {
-            if (interrupted_)
+    if (pipe_stdin)
+    {
+        return {.in = in_pipe_, .out = out_pipe_, .err = err_pipe_};
+    }
+    return {.out = out_pipe_, .err = err_pipe_};
+}
+
+void AsyncProcess::start()
+{
+    asio::dispatch(strand_, [this, self = shared_from_this()] {
+        read_output(Stream::Stdout);
+        read_output(Stream::Stderr);
+    });
+}
+
+void AsyncProcess::read_output(Stream stream)
+{
+    auto& pipe = stream == Stream::Stdout ? out_pipe_ : err_pipe_;
+    auto& lines = stream == Stream::Stdout ? out_lines_ : err_lines_;
+
+    auto buffer = lines.prepare();
+    pipe.async_read_some(
+        asio::buffer(buffer.data(), buffer.size()),
+        [this, self = shared_from_this(), stream, &lines](boost::system::error_code ec, std::size_t bytes_transferred) {
+            // The last errors of an interrupted process, e.g. "Interrupted by user", are still read.
+            if (interrupted_ && stream == Stream::Stdout)
             {
-                io_context_.stop();
-                process_->terminate();
-                process_.reset();
+                close_stream(false);
                 return;
             }
 
             if (!ec)
             {
-                on_linebreak_(std::string_view(buffer_.begin(), buffer_.begin() + bytes_transferred - 1)
-                ); // -1 to exclude '\n'
+                if (!received_output_)
+                {
+                    received_output_ = true;
 
-                buffer_.erase(buffer_.begin(), buffer_.begin() + bytes_transferred);
-                read_output(); // Read the next line.
+                    std::lock_guard lock(mutex_);
+                    first_output_ = std::chrono::steady_clock::now() - launched_at_;
+                }
+                lines.commit(bytes_transferred, [this, stream](std::string_view line) { on_linebreak_(stream, line); });
+                read_output(stream); // Read the next chunk.
+                return;
             }
-            else if (ec == asio::error::eof)
+
+            if (ec == asio::error::eof)
             {
-                on_linebreak_(std::string_view(buffer_.begin(), buffer_.end()));
-                on_eof_();
+                // An empty last line of stdout is reported as before, while stderr is usually empty.
+                if (auto rest = lines.rest(); stream == Stream::Stdout || !rest.empty())
+                {
+                    on_linebreak_(stream, rest);
+                }
             }
+            close_stream(ec == asio::error::eof);
         }
     );
 }
 
-void AsyncProcess::wait()
+void AsyncProcess::close_stream(bool eof)
 {
-    if (process_)
+    reached_eof_ = reached_eof_ && eof;
+    if (--open_streams_ > 0)
     {
-        io_context_.run();
-        if (process_)
+        return;
+    }
+
+    if (reached_eof_ && !interrupted_)
+    {
+        on_eof_();
+    }
+
+    if (reaped_)
+    {
+        finish();
+    }
+    else
+    {
+        wait_for_exit();
+    }
+}
+
+void AsyncProcess::write(std::string data)
+{
+    asio::dispatch(strand_, [this, self = shared_from_this(), data = std::move(data)]() mutable {
+        if (stdin_closing_)
+        {
+            return;
+        }
+
+        pending_writes_.push_back(std::move(data));
+        if (pending_writes_.size() == 1)
+        {
+            write_pending();
+        }
+    });
+}
+
+void AsyncProcess::close_stdin()
+{
+    asio::dispatch(strand_, [this, self = shared_from_this()] {
+        stdin_closing_ = true;
+        if (pending_writes_.empty())
+        {
+            boost::system::error_code ignored;
+            in_pipe_.close(ignored);
+        }
+    });
+}
+
+void AsyncProcess::write_pending()
+{
+    asio::async_write(
+        in_pipe_, asio::buffer(pending_writes_.front()),
+        [this, self = shared_from_this()](boost::system::error_code ec, std::size_t /* bytes_transferred */) {
+            pending_writes_.pop_front();
+            if (ec)
+            {
+                pending_writes_.clear(); // the process has closed its stdin, or exited
+                return;
+            }
+
+            if (!pending_writes_.empty())
+            {
+                write_pending();
+            }
+            else if (stdin_closing_)
+            {
+                boost::system::error_code ignored;
+                in_pipe_.close(ignored);
+            }
+        }
+    );
+}
+
+void AsyncProcess::set_escalation(Escalation escalation)
+{
+    asio::dispatch(strand_, [this, self = shared_from_this(), escalation] { escalation_ = escalation; });
+}
+
+void AsyncProcess::defer(std::chrono::steady_clock::time_point when, std::function<void()> callback)
+{
+    auto timer = std::make_shared<asio::steady_timer>(strand_, when);
+    timer->async_wait([timer, callback = std::move(callback)](boost::system::error_code ec) {
+        if (!ec)
         {
-            process_->wait();
-            process_.reset();
+            callback();
         }
+    });
+}
+
+void AsyncProcess::interrupt()
+{
+    interrupted_ = true;
+
+    // Don't wait for the next output, which may never come.
+    asio::post(strand_, [this, self = shared_from_this()] { cancel(); });
+}
+
+auto AsyncProcess::cancellation() const -> std::optional<Cancellation>
+{
+    std::lock_guard lock(mutex_);
+    return cancellation_;
+}
+
+auto AsyncProcess::timings() const -> Timings
+{
+    std::lock_guard lock(mutex_);
+    return {.spawn = spawn_time_, .first_output = first_output_};
+}
+
+void AsyncProcess::cancel()
+{
+    if (cancelling_ || !running_)
+    {
+        return;
+    }
+    cancelling_ = true;
+    interrupted_at_ = std::chrono::steady_clock::now();
+
+    // Stop reading stdout and writing stdin, but keep the pipes open until the process has exited,
+    // so that its last writes don't fail.
+    boost::system::error_code ignored;
+    out_pipe_.cancel(ignored);
+    in_pipe_.cancel(ignored);
+
+    // Children of the process may hold the pipes even after it has exited, so don't wait for them to be closed.
+    wait_for_exit();
+
+    send_signal(Signal::Interrupt);
+#ifndef _WIN32
+    if (paused_)
+    {
+        // A stopped process doesn't handle the signal until continued.
+        signal_group(SIGCONT);
+        paused_ = false;
+    }
+#endif
+    escalate_after(escalation_.interrupt_grace, Signal::Terminate);
+}
+
+void AsyncProcess::send_signal(Signal signal)
+{
+    last_signal_ = signal;
+
+#ifndef _WIN32
+    // The children, e.g. ffmpeg and aria2c, are stopped along with the process.
+    switch (signal)
+    {
+    case Signal::Interrupt:
+        signal_group(SIGINT);
+        break;
+    case Signal::Terminate:
+        signal_group(SIGTERM);
+        break;
+    case Signal::Kill:
+        signal_group(SIGKILL);
+        break;
+    }
+#else
+    boost::system::error_code ignored;
+    switch (signal)
+    {
+    case Signal::Interrupt:
+        process_.interrupt(ignored);
+        break;
+    case Signal::Terminate:
+        process_.request_exit(ignored);
+        break;
+    case Signal::Kill:
+        process_.terminate(ignored);
+        break;
+    }
+#endif
+}
+
+void AsyncProcess::escalate_after(std::chrono::milliseconds grace, Signal next)
+{
+    escalation_timer_.expires_after(grace);
+    escalation_timer_.async_wait([this, self = shared_from_this(), next](boost::system::error_code ec) {
+        if (ec || !running_)
+        {
+            return; // the process has exited
+        }
+
+        send_signal(next);
+        if (next == Signal::Terminate)
+        {
+            escalate_after(escalation_.terminate_grace, Signal::Kill);
+        }
+    });
+}
+
+bool AsyncProcess::pause()
+{
+#ifndef _WIN32
+    asio::dispatch(strand_, [this, self = shared_from_this()] {
+        if (running_ && !cancelling_ && !paused_)
+        {
+            signal_group(SIGSTOP);
+            paused_ = true;
+        }
+    });
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool AsyncProcess::resume()
+{
+#ifndef _WIN32
+    asio::dispatch(strand_, [this, self = shared_from_this()] {
+        if (running_ && paused_)
+        {
+            signal_group(SIGCONT);
+            paused_ = false;
+        }
+    });
+    return true;
+#else
+    return false;
+#endif
+}
+
+void AsyncProcess::signal_group(int signal)
+{
+#ifndef _WIN32
+    // The process is not reaped yet, as this runs in the strand while it is running, so its id is not reused.
+    // Right after it is reaped, the id is not reused either while the rest of its group is alive.
+    ::kill(-static_cast<pid_t>(process_.id()), signal);
+#else
+    (void)signal;
+#endif
+}
+
+void AsyncProcess::wait_for_exit()
+{
+    if (waiting_)
+    {
+        return;
+    }
+    waiting_ = true;
+
+    process_.async_wait([this, self = shared_from_this()](boost::system::error_code /* ec */, int /* exit_code */) {
+        reap();
+    });
+}
+
+void AsyncProcess::reap()
+{
+    reaped_ = true;
+    running_ = false;
+    paused_ = false;
+    escalation_timer_.cancel();
+
+    if (cancelling_)
+    {
+        {
+            std::lock_guard lock(mutex_);
+            cancellation_ = Cancellation{
+                .signal = last_signal_,
+                .latency = std::chrono::steady_clock::now() - interrupted_at_,
+            };
+        }
+
+#ifndef _WIN32
+        // The children left are killed, so they don't keep writing the files of an interrupted download.
+        signal_group(SIGKILL);
+#endif
+    }
+
+    if (open_streams_ == 0)
+    {
+        finish();
+        return;
     }
+
+    // Only an interrupted process is reaped before its streams are closed. Read the rest of stderr for a while.
+    escalation_timer_.expires_after(DRAIN_TIMEOUT);
+    escalation_timer_.async_wait([this, self = shared_from_this()](boost::system::error_code ec) {
+        if (!ec)
+        {
+            boost::system::error_code ignored;
+            out_pipe_.close(ignored);
+            err_pipe_.close(ignored);
+        }
+    });
+}
+
+void AsyncProcess::finish()
+{
+    escalation_timer_.cancel();
+
+    boost::system::error_code ignored;
+    out_pipe_.close(ignored);
+    err_pipe_.close(ignored);
+    in_pipe_.close(ignored);
+
+    if (on_exit_)
+    {
+        on_exit_();
+    }
+
+    {
+        std::lock_guard lock(mutex_);
+        exited_ = true;
+    }
+    exited_cv_.notify_all();
+}
+
+void AsyncProcess::wait()
+{
+    std::unique_lock lock(mutex_);
+    exited_cv_.wait(lock, [this] { return exited_; });
 }
 
 } // namespace ytweb
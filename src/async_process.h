@@ -1,12 +1,23 @@
 #pragma once
 
-#include "boost/asio/io_context.hpp"
+#include "boost/asio/any_io_executor.hpp"
 #include "boost/asio/readable_pipe.hpp"
+#include "boost/asio/steady_timer.hpp"
+#include "boost/asio/strand.hpp"
+#include "boost/asio/writable_pipe.hpp"
 #include "boost/process/v2/process.hpp"
+#include "line_splitter.h"
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
 #include <string_view>
 
 namespace ytweb
@@ -15,66 +26,213 @@ namespace ytweb
 namespace bp = boost::process;
 namespace asio = boost::asio;
 
-class AsyncProcess
+class AsyncProcess : public std::enable_shared_from_this<AsyncProcess>
 {
   public:
-    using CallbackOnLinebreak = std::function<void(std::string_view)>;
+    enum class Stream : std::uint8_t
+    {
+        Stdout,
+        Stderr,
+    };
+
+    // The signals sent to stop the process, in order of escalation.
+    // On Windows, they are mapped to a Ctrl+C event, a close request and a forced termination.
+    enum class Signal : std::uint8_t
+    {
+        Interrupt, // SIGINT, which lets yt-dlp clean up
+        Terminate, // SIGTERM
+        Kill,      // SIGKILL
+    };
+
+    // How long to wait after each signal before sending the next one.
+    struct Escalation
+    {
+        std::chrono::milliseconds interrupt_grace{3000};
+        std::chrono::milliseconds terminate_grace{2000};
+    };
+
+    // How an interrupted process was stopped: the last signal sent, and the time from `interrupt()` to its exit.
+    struct Cancellation
+    {
+        Signal signal;
+        std::chrono::steady_clock::duration latency;
+    };
+
+    // How long the launch took, and when the first output came, counted from the launch.
+    struct Timings
+    {
+        std::chrono::steady_clock::duration spawn{};
+        std::optional<std::chrono::steady_clock::duration> first_output;
+    };
+
+    using CallbackOnLinebreak = std::function<void(Stream stream, std::string_view line)>;
     using CallbackOnEof = std::function<void()>;
+    using CallbackOnExit = std::function<void()>;
 
     // Launch a process with the given request.
+    // Both stdout and stderr are read on `executor`, which is usually shared by many processes.
+    // No output is read until `start()` is called.
+    // Both '\n' and '\r' end a line, and lines longer than `max_line_length` are truncated.
+    // If `pipe_stdin` is set, the stdin of the process is a pipe fed by `write()`, otherwise it is inherited.
     AsyncProcess(
+        asio::any_io_executor const& executor,
         std::string_view path,
         std::vector<std::string> const& args,
         CallbackOnLinebreak on_linebreak,
-        CallbackOnEof on_eof
+        CallbackOnEof on_eof,
+        CallbackOnExit on_exit = {},
+        std::size_t max_line_length = LineSplitter::DEFAULT_MAX_LINE_LENGTH,
+        bool pipe_stdin = false
     );
 
-    // Wait for the process to finish before destruction.
-    ~AsyncProcess()
-    {
-        wait();
-    }
-
     // Disable copy and move operations.
     AsyncProcess(AsyncProcess const&) = delete;
     AsyncProcess& operator=(AsyncProcess const&) = delete;
     AsyncProcess(AsyncProcess&&) noexcept = delete;
     AsyncProcess& operator=(AsyncProcess&&) noexcept = delete;
 
-    // Block until the process is finished.
+    ~AsyncProcess() = default;
+
+    // Start reading the output. The process keeps itself alive until it has exited.
+    void start();
+
+    // Block until the process is finished and `on_exit` has returned.
+    // Note: never call it from a thread of the executor, or it may wait for itself.
     void wait();
 
-    // Send a signal to interrupt the process.
+    // Write to the stdin of the process, in the order of the calls.
+    // Only valid if the process is launched with `pipe_stdin`.
+    void write(std::string data);
+
+    // The process sees the end of its stdin once the pending writes are done.
+    void close_stdin();
+
+    // Only affects later interruptions.
+    void set_escalation(Escalation escalation);
+
+    // Call `callback` in the strand at `when`, so never at the same time as the callbacks of the output,
+    // e.g. to send what they have buffered once the process goes quiet.
+    void defer(std::chrono::steady_clock::time_point when, std::function<void()> callback);
+
+    // Stop reading stdout at once, and stop the process with escalating signals, sent to its children too on POSIX.
+    // The rest of stderr is still read until the process has exited.
     // Note: you should call `wait()` after `interrupt()` to make sure the process is terminated properly.
-    void interrupt()
+    void interrupt();
+
+    // `std::nullopt` if the process has not been interrupted, or has not exited yet.
+    std::optional<Cancellation> cancellation() const;
+
+    Timings timings() const;
+
+    // Suspend and continue the process along with its children, e.g. ffmpeg, by SIGSTOP and SIGCONT.
+    // Return false if not supported on this platform. Does nothing once the process is interrupted or exited.
+    bool pause();
+    bool resume();
+
+    bool paused() const
     {
-        interrupted_ = true;
+        return paused_;
     }
 
     // Check if the process is running.
     bool running() const
     {
-        return process_ != nullptr;
+        return running_;
     }
 
   private:
-    asio::io_context io_context_;
-    std::vector<char> buffer_;
-    asio::readable_pipe pipe_{io_context_};
-    std::unique_ptr<bp::process> process_;
+    // All handlers of one process are serialized by the strand, even if the executor has many threads.
+    asio::strand<asio::any_io_executor> strand_;
+
+    LineSplitter out_lines_;
+    LineSplitter err_lines_;
+    asio::readable_pipe out_pipe_{strand_};
+    asio::readable_pipe err_pipe_{strand_};
+    asio::writable_pipe in_pipe_{strand_};
+
+    // Set while launching the process.
+    std::chrono::steady_clock::time_point launched_at_;
+    std::chrono::steady_clock::duration spawn_time_{};
+
+    bp::process process_;
+
+    // Data waiting to be written to stdin, only touched in the strand.
+    std::deque<std::string> pending_writes_;
+    bool stdin_closing_{false};
+
+    // The number of streams not closed yet, and whether all of them have reached the end.
+    // Only touched in the strand.
+    int open_streams_{2};
+    bool reached_eof_{true};
+
+    // Whether the exit of the process is awaited, and whether it has exited. Only touched in the strand.
+    bool waiting_{false};
+    bool reaped_{false};
+
+    // State of the cancellation, only touched in the strand.
+    Escalation escalation_;
+    asio::steady_timer escalation_timer_{strand_};
+    bool cancelling_{false};
+    Signal last_signal_{Signal::Interrupt};
+    std::chrono::steady_clock::time_point interrupted_at_;
+
+    // Set in the strand, and only while the process is running.
+    std::atomic<bool> paused_{false};
 
     // callback functions when reading output
     CallbackOnLinebreak on_linebreak_;
     CallbackOnEof on_eof_;
 
+    // callback function when the process has been reaped
+    CallbackOnExit on_exit_;
+
     // flag that indicates the process is interrupted
     std::atomic<bool> interrupted_{false};
 
-    // Allocate a task in `io_context` to read a line.
-    // If there is no error, call `on_linebreak_` and read the next line.
-    // When the end of the stream is reached, call `on_eof_`.
+    std::atomic<bool> running_{true};
+
+    // signaled once the process has been reaped
+    mutable std::mutex mutex_;
+    std::condition_variable exited_cv_;
+    bool exited_{false};
+    std::optional<Cancellation> cancellation_;
+    std::optional<std::chrono::steady_clock::duration> first_output_;
+
+    // Only touched in the strand.
+    bool received_output_{false};
+
+    // Allocate a task in the strand to read a chunk of a stream.
+    // If there is no error, call `on_linebreak_` for each complete line and read the next chunk.
+    // When the end of both streams is reached, call `on_eof_`.
     // When `interrupted_` is set, stop reading the output and terminate the process.
-    void read_output();
+    void read_output(Stream stream);
+
+    // Once both streams are closed, wait for the process to exit, or finish if it has exited.
+    void close_stream(bool eof);
+
+    // Called while constructing `process_`, after the pipes.
+    bp::process launch(std::string_view path, std::vector<std::string> const& args, bool pipe_stdin);
+    bp::process_stdio make_stdio(bool pipe_stdin);
+
+    // Write the first pending data, then the rest.
+    void write_pending();
+
+    // Cancel the pending read of stdout, wait for the process to exit and send the first signal.
+    void cancel();
+    void send_signal(Signal signal);
+    void escalate_after(std::chrono::milliseconds grace, Signal next);
+
+    // Send a signal to the process group, which is led by the process.
+    void signal_group(int signal);
+
+    // Reap the process asynchronously (pidfd or SIGCHLD, depending on the platform), then call `reap()`.
+    void wait_for_exit();
+
+    // Kill what is left of an interrupted process group, then call `finish()` once both streams are closed.
+    void reap();
+
+    // Close the pipes and call `on_exit_`.
+    void finish();
 };
 
 } // namespace ytweb
@@ -0,0 +1,214 @@
+#include "download_archive.h"
+
+#include "exception.h"
+#include "nlohmann/json.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+
+namespace ytweb
+{
+
+namespace fs = std::filesystem;
+
+using Json = nlohmann::json;
+
+namespace
+{
+
+constexpr std::string_view EXTRACT_URL_PREFIX = "Extract URL: ";
+constexpr std::string_view ARCHIVE_ENTRY_PREFIX = "Archive entry: ";
+constexpr std::string_view FINISHED_LINE = "Finished post processing";
+
+std::string to_lower(std::string_view str)
+{
+    std::string lower;
+    lower.reserve(str.size());
+    std::ranges::transform(str, std::back_inserter(lower), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    return lower;
+}
+
+// The archive keys a video by the extractor in lower case and its id.
+std::string make_entry(std::string_view extractor, std::string_view id)
+{
+    auto entry = to_lower(extractor);
+    entry.push_back(' ');
+    entry.append(id);
+    return entry;
+}
+
+} // anonymous namespace
+
+DownloadArchive::DownloadArchive(fs::path path) : path_(std::move(path))
+{
+    std::error_code ec;
+    if (!fs::exists(path_, ec))
+    {
+        return;
+    }
+
+    std::ifstream stream(path_, std::ios::binary);
+    if (!stream)
+    {
+        throw PathError("Can't read the download archive: {}", path_.string());
+    }
+
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        if (!line.empty())
+        {
+            entries_.insert(std::move(line));
+        }
+    }
+}
+
+bool DownloadArchive::contains(std::string_view extractor, std::string_view id) const
+{
+    auto entry = make_entry(extractor, id);
+
+    std::shared_lock lock(mutex_);
+    return entries_.contains(entry);
+}
+
+bool DownloadArchive::contains_url(std::string_view url) const
+{
+    std::shared_lock lock(mutex_);
+    auto it = urls_.find(url);
+    return it != urls_.end() && entries_.contains(it->second);
+}
+
+bool DownloadArchive::record(std::string_view extractor, std::string_view id, std::string_view url, bool append)
+{
+    auto entry = make_entry(extractor, id);
+
+    std::lock_guard lock(mutex_);
+
+    if (!url.empty())
+    {
+        urls_.insert_or_assign(std::string(url), entry);
+    }
+
+    auto [it, inserted] = entries_.insert(std::move(entry));
+    if (!inserted)
+    {
+        return false;
+    }
+
+    if (append)
+    {
+        // A whole line in one write, as yt-dlp may append to the same file from other processes.
+        std::string line = *it + '\n';
+        std::ofstream stream(path_, std::ios::binary | std::ios::app);
+        stream.write(line.data(), static_cast<std::streamsize>(line.size()));
+    }
+    return true;
+}
+
+std::size_t DownloadArchive::size() const
+{
+    std::shared_lock lock(mutex_);
+    return entries_.size();
+}
+
+auto DownloadArchives::get(fs::path const& path) -> std::shared_ptr<DownloadArchive>
+{
+    // yt-dlp runs in the same working directory.
+    std::error_code ec;
+    auto absolute = fs::absolute(path, ec).lexically_normal();
+
+    std::lock_guard lock(mutex_);
+
+    auto& archive = archives_[absolute];
+    if (!archive)
+    {
+        try
+        {
+            archive = std::make_shared<DownloadArchive>(absolute);
+        }
+        catch (PathError const& /* e */)
+        {
+            archives_.erase(absolute);
+            return nullptr;
+        }
+    }
+    return archive;
+}
+
+auto identify_media(std::string_view info) -> std::optional<MediaIdentity>
+{
+    // Only the top-level fields of interest are kept, which skips most of the information, e.g. the formats.
+    auto json = Json::parse(
+        info,
+        [](int depth, Json::parse_event_t event, Json& parsed) {
+            if (event == Json::parse_event_t::key && depth == 1)
+            {
+                return parsed == "extractor_key" || parsed == "id" || parsed == "playlist_index";
+            }
+            return true;
+        },
+        false
+    );
+
+    if (!json.is_object())
+    {
+        return std::nullopt;
+    }
+
+    auto extractor = json.find("extractor_key");
+    auto id = json.find("id");
+    if (extractor == json.end() || !extractor->is_string() || id == json.end() || !id->is_string())
+    {
+        return std::nullopt;
+    }
+
+    MediaIdentity identity;
+    identity.extractor = to_lower(extractor->get_ref<std::string const&>());
+    identity.id = id->get<std::string>();
+    if (auto index = json.find("playlist_index"); index != json.end() && index->is_number_integer())
+    {
+        identity.playlist_index = index->get<int>();
+    }
+    return identity;
+}
+
+bool ArchiveRecorder::feed(std::string_view line)
+{
+    if (line.starts_with(EXTRACT_URL_PREFIX))
+    {
+        url_ = line.substr(EXTRACT_URL_PREFIX.size());
+        return false;
+    }
+
+    // "Archive entry: <extractor key> <id>"
+    if (line.starts_with(ARCHIVE_ENTRY_PREFIX))
+    {
+        auto entry = line.substr(ARCHIVE_ENTRY_PREFIX.size());
+        if (auto extractor_end = entry.find(' '); extractor_end != std::string_view::npos)
+        {
+            extractor_ = entry.substr(0, extractor_end);
+            id_ = entry.substr(extractor_end + 1);
+        }
+        return false;
+    }
+
+    if (line == FINISHED_LINE && !id_.empty())
+    {
+        bool recorded = archive_->record(extractor_, id_, url_, append_);
+        url_.clear();
+        extractor_.clear();
+        id_.clear();
+        return recorded;
+    }
+    return false;
+}
+
+} // namespace ytweb
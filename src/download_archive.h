@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ytweb
+{
+
+// An in-memory index of a download archive of yt-dlp, a text file with a line for each downloaded video:
+// "<extractor> <id>", where the extractor is in lower case.
+//
+// It is loaded once and shared by all tasks, so that archived videos are skipped before launching yt-dlp,
+// which otherwise reads the whole file in every process. The URLs of the videos recorded meanwhile are indexed too,
+// as they are known before extracting anything.
+class DownloadArchive
+{
+  public:
+    // Load the archive. A missing file is an empty archive, which is created by the first record.
+    // Throw `PathError` if the file can't be read.
+    explicit DownloadArchive(std::filesystem::path path);
+
+    auto path() const -> std::filesystem::path const&
+    {
+        return path_;
+    }
+
+    bool contains(std::string_view extractor, std::string_view id) const;
+
+    // Whether the video at the URL has been recorded since the archive was loaded.
+    bool contains_url(std::string_view url) const;
+
+    // Record a downloaded video, found at `url` if not empty.
+    // The entry is appended to the file only if `append` is set, as yt-dlp writes it itself if given the archive.
+    // Return false if the video is already archived.
+    bool record(std::string_view extractor, std::string_view id, std::string_view url, bool append);
+
+    std::size_t size() const;
+
+  private:
+    struct Hash
+    {
+        using is_transparent = void;
+
+        std::size_t operator()(std::string_view str) const
+        {
+            return std::hash<std::string_view>{}(str);
+        }
+    };
+
+    std::filesystem::path path_;
+
+    // Appending to the file is serialized by the exclusive lock.
+    mutable std::shared_mutex mutex_;
+    std::unordered_set<std::string, Hash, std::equal_to<>> entries_;
+    std::unordered_map<std::string, std::string, Hash, std::equal_to<>> urls_; // to entries
+};
+
+// The archives used by requests, each loaded at the first use.
+class DownloadArchives
+{
+  public:
+    // Return `nullptr` if the archive can't be read.
+    std::shared_ptr<DownloadArchive> get(std::filesystem::path const& path);
+
+  private:
+    std::mutex mutex_;
+    std::map<std::filesystem::path, std::shared_ptr<DownloadArchive>> archives_;
+};
+
+// The identity of a video in its information (a line of `yt-dlp -j`).
+struct MediaIdentity
+{
+    std::string extractor; // in lower case, as in the archive
+    std::string id;
+    std::optional<int> playlist_index;
+};
+
+// Return `std::nullopt` if the information is invalid or has no extractor or id.
+std::optional<MediaIdentity> identify_media(std::string_view info);
+
+// Follow the output of a download (see `Request`), and record each video once it is finished:
+// the "Extract URL: " line gives its URL, the "Archive entry: <extractor key> <id>" line its identity,
+// and the "Finished post processing" line tells that it has been saved.
+class ArchiveRecorder
+{
+  public:
+    ArchiveRecorder(std::shared_ptr<DownloadArchive> archive, bool append)
+        : archive_(std::move(archive)), append_(append)
+    {
+    }
+
+    // Return true if a video has been recorded by the line.
+    bool feed(std::string_view line);
+
+  private:
+    std::shared_ptr<DownloadArchive> archive_;
+    bool append_;
+
+    std::string url_;
+    std::string extractor_;
+    std::string id_;
+};
+
+} // namespace ytweb
@@ -0,0 +1,287 @@
+#include "event_bus.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace ytweb
+{
+
+namespace
+{
+
+// Fewer dropped events are not worth erasing.
+constexpr std::size_t MIN_COMPACTED = 64;
+
+// Append the elements of a JSON array to the elements of another, without parsing them.
+void append_elements(std::string& merged, std::string_view array)
+{
+    auto first = array.find('[');
+    auto last = array.rfind(']');
+    if (first == std::string_view::npos || last == std::string_view::npos || last <= first)
+    {
+        return;
+    }
+
+    auto elements = array.substr(first + 1, last - first - 1);
+    if (elements.find_first_not_of(" \t\r\n") == std::string_view::npos || !merged.ends_with(']'))
+    {
+        return;
+    }
+
+    merged.pop_back(); // ']'
+    if (merged.size() > 1)
+    {
+        merged.push_back(',');
+    }
+    merged.append(elements).push_back(']');
+}
+
+} // anonymous namespace
+
+EventBus::EventBus(Sink sink, Options options)
+    : sink_(std::move(sink)), options_(std::move(options)), sender_([this] { run_sender(); })
+{
+}
+
+EventBus::~EventBus()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    sender_.join();
+}
+
+void EventBus::send(
+    std::string_view function, std::string_view data, Policy policy, Merge merge, std::optional<int> task
+)
+{
+    push({
+        .function = std::string(function),
+        .data = std::string(data),
+        .policy = policy,
+        .merge = merge,
+        .task = task,
+        .queued = Clock::now(),
+    });
+}
+
+void EventBus::run(std::string_view script)
+{
+    push({.function = {}, .data = std::string(script), .policy = Policy::Lossless, .queued = Clock::now()});
+}
+
+void EventBus::push(Event event)
+{
+    bool was_empty{};
+    {
+        std::lock_guard lock(mutex_);
+        was_empty = queue_.empty();
+
+        auto const number = queued_++;
+        auto const droppable = event.policy == Policy::DropOldest;
+        auto const task = event.task;
+        auto const size = event.data.size();
+        event.number = number;
+        queue_.push_back(std::move(event));
+
+        if (droppable)
+        {
+            if (task)
+            {
+                auto& of_task = by_task_[*task];
+                of_task.push_back(number);
+                while (of_task.size() > options_.max_per_task)
+                {
+                    drop(of_task.front());
+                    of_task.pop_front();
+                }
+            }
+
+            droppable_.push_back(number);
+            droppable_bytes_ += size;
+            while (droppable_bytes_ > options_.max_bytes && !droppable_.empty())
+            {
+                drop(droppable_.front());
+                droppable_.pop_front();
+            }
+        }
+
+        if (tombstones_ >= MIN_COMPACTED && tombstones_ * 2 >= queue_.size())
+        {
+            compact();
+        }
+    }
+
+    if (was_empty)
+    {
+        cv_.notify_all();
+    }
+}
+
+void EventBus::drop(std::uint64_t number)
+{
+    // The events are in the order of their numbers.
+    auto it = std::ranges::lower_bound(queue_, number, {}, &Event::number);
+    if (it == queue_.end() || it->number != number || it->dropped)
+    {
+        return; // erased or dropped already
+    }
+
+    auto& event = *it;
+    event.dropped = true;
+    droppable_bytes_ -= event.data.size();
+    event.data = std::string();
+    ++tombstones_;
+
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    if (options_.on_dropped)
+    {
+        options_.on_dropped();
+    }
+}
+
+// Erase the dropped events, and the numbers of those which are left in the indices.
+void EventBus::compact()
+{
+    std::erase_if(queue_, [](Event const& event) { return event.dropped; });
+    tombstones_ = 0;
+
+    droppable_.clear();
+    by_task_.clear();
+    for (auto const& event : queue_)
+    {
+        if (event.policy != Policy::DropOldest)
+        {
+            continue;
+        }
+        droppable_.push_back(event.number);
+        if (event.task)
+        {
+            by_task_[*event.task].push_back(event.number);
+        }
+    }
+}
+
+void EventBus::flush()
+{
+    std::unique_lock lock(mutex_);
+    auto const end = queued_;
+    sent_cv_.wait(lock, [this, end] { return sent_ >= end; });
+}
+
+auto EventBus::stats() const -> Stats
+{
+    return {
+        .events = events_.load(std::memory_order_relaxed),
+        .calls = calls_.load(std::memory_order_relaxed),
+        .dropped = dropped_.load(std::memory_order_relaxed),
+        .queued = [this] {
+            std::lock_guard lock(mutex_);
+            return queue_.size();
+        }(),
+    };
+}
+
+// Take the whole queue at once, after lingering for more events, and send it.
+void EventBus::run_sender()
+{
+    std::deque<Event> events;
+
+    std::unique_lock lock(mutex_);
+    while (true)
+    {
+        cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty())
+        {
+            return; // stopping
+        }
+
+        if (options_.linger.count() > 0)
+        {
+            cv_.wait_for(lock, options_.linger, [this] { return stopping_; });
+        }
+
+        events.swap(queue_);
+        auto const taken = queued_;
+        tombstones_ = 0;
+        droppable_.clear();
+        by_task_.clear();
+        droppable_bytes_ = 0;
+
+        lock.unlock();
+        deliver(events);
+        events.clear();
+        lock.lock();
+
+        sent_ = taken;
+        sent_cv_.notify_all();
+    }
+}
+
+void EventBus::deliver(std::deque<Event>& events)
+{
+    std::vector<Clock::duration> latencies;
+    std::string merged;
+
+    for (auto it = events.begin(); it != events.end();)
+    {
+        if (it->dropped)
+        {
+            ++it;
+            continue;
+        }
+
+        auto const now = Clock::now();
+        latencies.assign(1, now - it->queued);
+
+        // The following events of the same function, skipping the dropped ones.
+        auto next = std::next(it);
+        if (it->merge != Merge::None && !it->function.empty())
+        {
+            merged = it->data;
+            for (; next != events.end(); ++next)
+            {
+                if (next->dropped)
+                {
+                    continue;
+                }
+                if (next->function != it->function || next->merge != it->merge)
+                {
+                    break;
+                }
+
+                if (it->merge == Merge::JsonArray)
+                {
+                    append_elements(merged, next->data);
+                }
+                else
+                {
+                    merged.append("\n").append(next->data);
+                }
+                latencies.push_back(now - next->queued);
+            }
+        }
+
+        auto const& data = latencies.size() > 1 ? merged : it->data;
+        if (it->function.empty())
+        {
+            sink_.run(data);
+        }
+        else
+        {
+            sink_.send(it->function, data);
+        }
+
+        events_.fetch_add(latencies.size(), std::memory_order_relaxed);
+        calls_.fetch_add(1, std::memory_order_relaxed);
+        if (options_.on_sent)
+        {
+            options_.on_sent(latencies);
+        }
+        it = next;
+    }
+}
+
+} // namespace ytweb
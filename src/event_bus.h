@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+namespace ytweb
+{
+
+// The events for the frontend, queued by the tasks and sent by one background thread, so that a slow or gone
+// frontend never holds up the threads which read the output of yt-dlp.
+//
+// Events which are superseded or only informative, e.g. progress and log, are dropped oldest first once the queue
+// is full: beyond `max_per_task` events of a task, or `max_bytes` of all. The others, e.g. the reports of tasks,
+// are never dropped. Events are sent in order, and consecutive events of the same function are merged into one
+// call where their format allows it.
+class EventBus
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    // Where the events go, e.g. the window.
+    struct Sink
+    {
+        std::function<void(std::string_view function, std::string_view data)> send;
+        std::function<void(std::string_view script)> run;
+    };
+
+    enum class Policy : std::uint8_t
+    {
+        DropOldest,
+        Lossless,
+    };
+
+    // How the data of consecutive events of a function are merged.
+    enum class Merge : std::uint8_t
+    {
+        None,
+        JsonArray, // the elements of JSON arrays are concatenated
+        Lines,     // the data are joined by line breaks
+    };
+
+    struct Options
+    {
+        std::size_t max_per_task{32}; // droppable events
+        std::size_t max_bytes{8 * 1024 * 1024}; // of the droppable events
+        // How long the sender waits for more events before sending, so that events arriving together are merged.
+        std::chrono::milliseconds linger{2};
+
+        // Called by the sender for each call of the sink, with how long each of its events has been queued.
+        std::function<void(std::span<Clock::duration const> latencies)> on_sent;
+        std::function<void()> on_dropped;
+    };
+
+    struct Stats
+    {
+        std::uint64_t events{};  // sent
+        std::uint64_t calls{};   // of the sink
+        std::uint64_t dropped{};
+        std::size_t queued{}; // including dropped events not erased yet
+    };
+
+    explicit EventBus(Sink sink) : EventBus(std::move(sink), Options{})
+    {
+    }
+
+    EventBus(Sink sink, Options options);
+
+    // Send the remaining events.
+    ~EventBus();
+
+    EventBus(EventBus const&) = delete;
+    EventBus& operator=(EventBus const&) = delete;
+    EventBus(EventBus&&) = delete;
+    EventBus& operator=(EventBus&&) = delete;
+
+    // Call the function of the frontend with the data. Never blocks on the frontend.
+    // `task` is the task the event is about, if any, which is bounded by `max_per_task`.
+    void send(
+        std::string_view function, std::string_view data, Policy policy, Merge merge = Merge::None,
+        std::optional<int> task = std::nullopt
+    );
+
+    // Run the script in the frontend, which is never dropped.
+    void run(std::string_view script);
+
+    // Block until the events queued so far are sent.
+    void flush();
+
+    auto stats() const -> Stats;
+
+  private:
+    struct Event
+    {
+        std::string function; // empty for a script
+        std::string data;
+        Policy policy{Policy::Lossless};
+        Merge merge{Merge::None};
+        std::optional<int> task;
+        Clock::time_point queued;
+        std::uint64_t number{}; // in the order of queueing
+        bool dropped{false};
+    };
+
+    Sink sink_;
+    Options options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable sent_cv_;
+
+    // Dropped events are kept until they are as many as the others, then erased at once.
+    std::deque<Event> queue_;
+    std::size_t tombstones_{0};
+    std::uint64_t queued_{0}; // the number of the next event
+    std::uint64_t sent_{0};   // events numbered below are sent
+
+    // The droppable events in the queue by number, oldest first, of all and of each task.
+    // Dropped events are skipped.
+    std::deque<std::uint64_t> droppable_;
+    std::unordered_map<int, std::deque<std::uint64_t>> by_task_;
+    std::size_t droppable_bytes_{0};
+
+    bool stopping_{false};
+
+    std::atomic<std::uint64_t> events_{0};
+    std::atomic<std::uint64_t> calls_{0};
+    std::atomic<std::uint64_t> dropped_{0};
+
+    std::thread sender_;
+
+    void push(Event event);
+    void drop(std::uint64_t number);
+    void compact();
+
+    void run_sender();
+    void deliver(std::deque<Event>& events);
+};
+
+} // namespace ytweb
@@ -0,0 +1,59 @@
+#include "executable_cache.h"
+
+#include "boost/process/v2/environment.hpp"
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+
+namespace ytweb
+{
+
+namespace
+{
+
+struct ExecutableCache
+{
+    std::shared_mutex mutex;
+    std::map<std::string, std::string, std::less<>> paths; // only a few entries
+};
+
+ExecutableCache& cache()
+{
+    static ExecutableCache instance;
+    return instance;
+}
+
+} // anonymous namespace
+
+std::string find_executable_cached(std::string_view name)
+{
+    auto& [mutex, paths] = cache();
+
+    {
+        std::shared_lock lock(mutex);
+        if (auto it = paths.find(name); it != paths.end())
+        {
+            return it->second;
+        }
+    }
+
+    auto path = boost::process::environment::find_executable(name).string();
+    if (!path.empty())
+    {
+        std::lock_guard lock(mutex);
+        paths.insert_or_assign(std::string(name), path);
+    }
+    return path;
+}
+
+void invalidate_executable_cache()
+{
+    auto& [mutex, paths] = cache();
+
+    std::lock_guard lock(mutex);
+    paths.clear();
+}
+
+} // namespace ytweb
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace ytweb
+{
+
+// Look up an executable in `PATH`, like `boost::process::environment::find_executable()`,
+// but only once, as scanning `PATH` takes many system calls for each request.
+// Only found executables are cached, so one installed later is found by the next lookup.
+// Return an empty string if not found. Safe to call from many threads.
+std::string find_executable_cached(std::string_view name);
+
+// Forget the cached executables, e.g. after one has failed to launch.
+void invalidate_executable_cache();
+
+} // namespace ytweb
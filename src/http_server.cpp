@@ -0,0 +1,633 @@
+#include "http_server.h"
+
+#include "boost/asio/dispatch.hpp"
+#include "boost/asio/post.hpp"
+#include "boost/asio/strand.hpp"
+#include "boost/asio/write.hpp"
+#include "boost/beast/core/flat_buffer.hpp"
+#include "boost/beast/core/tcp_stream.hpp"
+#include "boost/beast/http.hpp"
+#include "nlohmann/json.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <csignal>
+#include <deque>
+#include <format>
+#include <iterator>
+#include <ranges>
+
+namespace ytweb
+{
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+
+using tcp = asio::ip::tcp;
+using Json = nlohmann::json;
+
+namespace
+{
+
+// How long a connection may stay idle between requests.
+constexpr auto IDLE_TIMEOUT = std::chrono::seconds(60);
+
+constexpr std::string_view EVENT_STREAM_HEADER = "HTTP/1.1 200 OK\r\n"
+                                                 "Content-Type: text/event-stream\r\n"
+                                                 "Cache-Control: no-cache\r\n"
+                                                 "Connection: close\r\n"
+                                                 "\r\n";
+
+// Superseded by later progress, so the oldest may be dropped for a slow client.
+constexpr std::string_view DROPPABLE_EVENT = "showDownloadProgress";
+
+using Request = http::request<http::string_body>;
+using Response = http::response<http::string_body>;
+
+// A server-sent event, with a "data" field for each line.
+std::string make_frame(std::string_view event, std::string_view data)
+{
+    std::string frame = std::format("event: {}\n", event);
+    for (auto range : std::views::split(data, '\n'))
+    {
+        std::string_view line(range.begin(), range.end());
+        if (line.ends_with('\r'))
+        {
+            line.remove_suffix(1);
+        }
+        frame.append("data: ").append(line).push_back('\n');
+    }
+    frame.push_back('\n');
+    return frame;
+}
+
+// Running any binary is up to the user of the app, not to its clients, which run yt-dlp from `$PATH`.
+constexpr std::string_view FORBIDDEN_KEY = "yt_dlp_path";
+
+bool is_json(beast::string_view content_type)
+{
+    auto type = content_type.substr(0, content_type.find(';'));
+    while (type.ends_with(' '))
+    {
+        type.remove_suffix(1);
+    }
+    return beast::iequals(type, "application/json");
+}
+
+// Parse a request to submit, or return a discarded value if it is invalid or sets a forbidden key.
+Json parse_request(std::string_view body)
+{
+    auto request = Json::parse(body, nullptr, false);
+    if (request.is_object() && request.contains(FORBIDDEN_KEY))
+    {
+        return Json(Json::value_t::discarded);
+    }
+    return request;
+}
+
+Response make_response(http::status status, Json const& body)
+{
+    Response response{status, 11};
+    response.set(http::field::content_type, "application/json");
+    response.body() = body.dump();
+    return response;
+}
+
+Response make_error(http::status status, std::string_view message)
+{
+    return make_response(status, {{"error", message}});
+}
+
+} // anonymous namespace
+
+// The events for a client, which has sent `GET /api/events`. The connection is closed by the client,
+// or on overflow.
+class EventStream : public std::enable_shared_from_this<EventStream>
+{
+  public:
+    EventStream(HttpServer& server, tcp::socket socket) : server_(server), socket_(std::move(socket))
+    {
+        queue_.push_back({std::make_shared<std::string const>(EVENT_STREAM_HEADER), false});
+    }
+
+    void start()
+    {
+        asio::post(socket_.get_executor(), [self = shared_from_this()] {
+            self->watch();
+            self->write_next();
+        });
+    }
+
+    void push(std::shared_ptr<std::string const> const& frame, bool droppable)
+    {
+        std::lock_guard lock(mutex_);
+        if (closed_)
+        {
+            return;
+        }
+
+        queue_.push_back({frame, droppable});
+        queued_bytes_ += frame->size();
+
+        // Drop the oldest progress first, and give up on the client if the rest doesn't fit.
+        for (auto it = queue_.begin(); queued_bytes_ > server_.options_.max_queued_bytes;)
+        {
+            it = std::find_if(it, queue_.end(), [](Frame const& frame) { return frame.droppable; });
+            if (it == queue_.end())
+            {
+                close_locked();
+                server_.disconnected_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            queued_bytes_ -= it->text->size();
+            it = queue_.erase(it);
+            ++dropped_;
+            server_.dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (!writing_)
+        {
+            writing_ = true;
+            asio::post(socket_.get_executor(), [self = shared_from_this()] { self->write_next(); });
+        }
+    }
+
+    bool closed() const
+    {
+        std::lock_guard lock(mutex_);
+        return closed_;
+    }
+
+  private:
+    struct Frame
+    {
+        std::shared_ptr<std::string const> text; // shared by the clients
+        bool droppable{false};
+    };
+
+    HttpServer& server_;
+    tcp::socket socket_;
+
+    mutable std::mutex mutex_;
+    std::deque<Frame> queue_;
+    std::size_t queued_bytes_{0};
+    std::uint64_t dropped_{0}; // since the last "dropped" event
+    bool writing_{true};       // until the header is written
+    bool closed_{false};
+
+    // Being written, on the strand of the socket.
+    std::vector<Frame> batch_;
+    std::vector<asio::const_buffer> buffers_;
+    std::array<char, 64> discarded_{};
+
+    // Everything queued is written in one go.
+    void write_next()
+    {
+        batch_.clear();
+        buffers_.clear();
+        {
+            std::lock_guard lock(mutex_);
+            if (closed_ || queue_.empty())
+            {
+                writing_ = false;
+                return;
+            }
+
+            std::ranges::move(queue_, std::back_inserter(batch_));
+            queue_.clear();
+            queued_bytes_ = 0;
+
+            if (dropped_ > 0)
+            {
+                auto notice = make_frame("dropped", std::to_string(dropped_));
+                batch_.push_back({std::make_shared<std::string const>(std::move(notice))});
+                dropped_ = 0;
+            }
+        }
+
+        for (auto const& frame : batch_)
+        {
+            buffers_.push_back(asio::buffer(*frame.text));
+        }
+        asio::async_write(socket_, buffers_, [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec)
+            {
+                self->close();
+                return;
+            }
+            self->write_next();
+        });
+    }
+
+    // Nothing more is expected from the client, but the end of the connection.
+    void watch()
+    {
+        auto on_read = [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec)
+            {
+                self->close();
+                return;
+            }
+            self->watch();
+        };
+        socket_.async_read_some(asio::buffer(discarded_), std::move(on_read));
+    }
+
+    void close()
+    {
+        std::lock_guard lock(mutex_);
+        close_locked();
+    }
+
+    void close_locked()
+    {
+        if (closed_)
+        {
+            return;
+        }
+        closed_ = true;
+        queue_.clear();
+        queued_bytes_ = 0;
+        asio::post(socket_.get_executor(), [self = shared_from_this()] {
+            beast::error_code ec;
+            self->socket_.shutdown(tcp::socket::shutdown_both, ec);
+            self->socket_.close(ec);
+        });
+    }
+};
+
+// A connection serving requests one after another, until it is idle for too long, or it turns into events.
+class HttpSession : public std::enable_shared_from_this<HttpSession>
+{
+  public:
+    HttpSession(HttpServer& server, tcp::socket socket) : server_(server), stream_(std::move(socket))
+    {
+    }
+
+    void start()
+    {
+        asio::dispatch(stream_.get_executor(), [self = shared_from_this()] { self->read(); });
+    }
+
+  private:
+    HttpServer& server_;
+    beast::tcp_stream stream_;
+    beast::flat_buffer buffer_;
+    std::optional<http::request_parser<http::string_body>> parser_;
+    Response response_;
+
+    void read()
+    {
+        parser_.emplace();
+        parser_->body_limit(server_.options_.max_body_bytes);
+
+        stream_.expires_after(IDLE_TIMEOUT);
+        http::async_read(stream_, buffer_, *parser_, [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            self->on_read(ec);
+        });
+    }
+
+    void on_read(beast::error_code ec)
+    {
+        if (ec == http::error::body_limit)
+        {
+            respond(make_error(http::status::payload_too_large, "The body is too large."), false);
+            return;
+        }
+        if (ec)
+        {
+            close();
+            return;
+        }
+
+        auto request = parser_->release();
+        auto target = std::string_view(request.target().data(), request.target().size());
+        target = target.substr(0, target.find('?'));
+
+        // Browsers tell the page which sent a request. No page is served here, so every page is foreign, and
+        // mustn't drive the API, e.g. by a form posted to localhost.
+        if (request.find(http::field::origin) != request.end())
+        {
+            respond(make_error(http::status::forbidden, "Requests from web pages are not allowed."), false);
+            return;
+        }
+
+        if (target == "/api/events" && request.method() == http::verb::get)
+        {
+            stream_.expires_never();
+            auto events = std::make_shared<EventStream>(server_, stream_.release_socket());
+            server_.add_stream(events);
+            events->start();
+            return;
+        }
+
+        Response response;
+        try
+        {
+            response = route(request, target);
+        }
+        catch (std::exception const& e)
+        {
+            response = make_error(http::status::internal_server_error, e.what());
+        }
+        respond(std::move(response), request.keep_alive());
+    }
+
+    void respond(Response response, bool keep_alive)
+    {
+        response_ = std::move(response);
+        response_.keep_alive(keep_alive);
+        response_.prepare_payload();
+
+        http::async_write(stream_, response_, [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec || !self->response_.keep_alive())
+            {
+                self->close();
+                return;
+            }
+            self->read();
+        });
+    }
+
+    void close()
+    {
+        beast::error_code ec;
+        stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+        stream_.close();
+    }
+
+    Response route(Request const& request, std::string_view target)
+    {
+        auto const& handlers = server_.handlers_;
+        auto const method = request.method();
+        auto const& body = request.body();
+
+        if (target == "/api/requests" || target == "/api/requests/bulk")
+        {
+            if (method != http::verb::post)
+            {
+                return make_error(http::status::method_not_allowed, "Use POST.");
+            }
+            if (!is_json(request[http::field::content_type]))
+            {
+                return make_error(http::status::unsupported_media_type, "Expect application/json.");
+            }
+            if (target == "/api/requests/bulk")
+            {
+                return submit_bulk(body);
+            }
+
+            if (parse_request(body).is_discarded())
+            {
+                return make_error(
+                    http::status::bad_request, std::format("Invalid request, or \"{}\" is set.", FORBIDDEN_KEY)
+                );
+            }
+            if (auto task = handlers.submit(body))
+            {
+                return make_response(http::status::created, {{"task", *task}});
+            }
+            return make_error(http::status::bad_request, "Invalid request, see the log.");
+        }
+
+        if (target == "/api/metrics")
+        {
+            if (method != http::verb::get)
+            {
+                return make_error(http::status::method_not_allowed, "Use GET.");
+            }
+            auto stats = server_.stats();
+            return make_response(
+                http::status::ok, {
+                                      {"tasks", Json::parse(handlers.metrics())},
+                                      {"events",
+                                       {
+                                           {"clients", stats.clients},
+                                           {"dropped", stats.dropped},
+                                           {"disconnected", stats.disconnected},
+                                       }},
+                                  }
+            );
+        }
+
+        // "/api/tasks/<id>/<action>"
+        constexpr std::string_view TASKS = "/api/tasks/";
+        if (target.starts_with(TASKS))
+        {
+            if (method != http::verb::post)
+            {
+                return make_error(http::status::method_not_allowed, "Use POST.");
+            }
+
+            auto rest = target.substr(TASKS.size());
+            HttpServer::TaskId task{};
+            auto [end, ec] = std::from_chars(rest.data(), rest.data() + rest.size(), task);
+            auto action = std::string_view(end, rest.data() + rest.size());
+            if (ec != std::errc{})
+            {
+                return make_error(http::status::not_found, "Invalid task.");
+            }
+
+            if (action == "/interrupt")
+            {
+                handlers.interrupt(task);
+                return {http::status::no_content, 11};
+            }
+            if (action == "/pause" || action == "/resume")
+            {
+                bool const done = action == "/pause" ? handlers.pause(task) : handlers.resume(task);
+                return done ? Response{http::status::no_content, 11}
+                            : make_error(http::status::conflict, "The task is not in a state to do so.");
+            }
+        }
+
+        return make_error(http::status::not_found, "Not found.");
+    }
+
+    Response submit_bulk(std::string const& body)
+    {
+        Json data;
+        try
+        {
+            data = Json::parse(body);
+        }
+        catch (Json::exception const& e)
+        {
+            return make_error(http::status::bad_request, e.what());
+        }
+
+        auto const& submit = server_.handlers_.submit;
+        auto tasks = Json::array();
+        auto add = [&tasks](std::optional<HttpServer::TaskId> task) {
+            tasks.push_back(task ? Json(*task) : Json(nullptr));
+        };
+
+        if (auto urls = data.find("urls"); urls != data.end() && urls->is_array())
+        {
+            auto request = data.value("request", Json::object());
+            if (!request.is_object() || request.contains(FORBIDDEN_KEY))
+            {
+                auto message = std::format(R"("request" must be an object without "{}".)", FORBIDDEN_KEY);
+                return make_error(http::status::bad_request, message);
+            }
+            for (auto const& url : *urls)
+            {
+                if (!url.is_string())
+                {
+                    add(std::nullopt);
+                    continue;
+                }
+                request["url_input"] = url;
+                add(submit(request.dump()));
+            }
+        }
+        else if (auto requests = data.find("requests"); requests != data.end() && requests->is_array())
+        {
+            for (auto const& request : *requests)
+            {
+                auto body = request.is_string() ? request.get<std::string>() : request.dump();
+                add(parse_request(body).is_discarded() ? std::nullopt : submit(body));
+            }
+        }
+        else
+        {
+            return make_error(http::status::bad_request, R"(Expect "urls" or "requests".)");
+        }
+
+        return make_response(http::status::created, {{"tasks", std::move(tasks)}});
+    }
+};
+
+HttpServer::HttpServer(Options options) : options_(std::move(options))
+{
+}
+
+HttpServer::~HttpServer()
+{
+    stop();
+    wait();
+}
+
+void HttpServer::start(Handlers handlers)
+{
+    handlers_ = std::move(handlers);
+
+    tcp::endpoint endpoint{asio::ip::make_address(options_.address), options_.port};
+    acceptor_.open(endpoint.protocol());
+    acceptor_.set_option(asio::socket_base::reuse_address(true));
+    acceptor_.bind(endpoint);
+    acceptor_.listen();
+    port_ = acceptor_.local_endpoint().port();
+
+    signals_.add(SIGINT);
+    signals_.add(SIGTERM);
+    signals_.async_wait([this](beast::error_code ec, int /* signal */) {
+        if (!ec)
+        {
+            stop();
+        }
+    });
+
+    accept();
+    for (std::size_t i = 0; i < std::max<std::size_t>(options_.threads, 1); ++i)
+    {
+        threads_.emplace_back([this] { io_context_.run(); });
+    }
+}
+
+void HttpServer::wait()
+{
+    for (auto& thread : threads_)
+    {
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    }
+}
+
+void HttpServer::stop()
+{
+    io_context_.stop();
+}
+
+void HttpServer::publish(std::string_view event, std::string_view data)
+{
+    std::vector<std::shared_ptr<EventStream>> streams;
+    {
+        std::lock_guard lock(streams_mutex_);
+        if (streams_.empty())
+        {
+            return;
+        }
+
+        std::erase_if(streams_, [](auto const& stream) { return stream.expired(); });
+        for (auto const& stream : streams_)
+        {
+            if (auto locked = stream.lock())
+            {
+                streams.push_back(std::move(locked));
+            }
+        }
+    }
+
+    auto frame = std::make_shared<std::string const>(make_frame(event, data));
+    for (auto const& stream : streams)
+    {
+        stream->push(frame, event == DROPPABLE_EVENT);
+    }
+}
+
+void HttpServer::publish_call(std::string_view script)
+{
+    auto open = script.find('(');
+    if (open == std::string_view::npos || !script.ends_with(')'))
+    {
+        return;
+    }
+
+    auto args = script.substr(open + 1, script.size() - open - 2);
+    publish(script.substr(0, open), std::format("[{}]", args));
+}
+
+auto HttpServer::stats() const -> Stats
+{
+    Stats stats{
+        .dropped = dropped_.load(std::memory_order_relaxed),
+        .disconnected = disconnected_.load(std::memory_order_relaxed),
+    };
+
+    std::lock_guard lock(streams_mutex_);
+    for (auto const& stream : streams_)
+    {
+        auto locked = stream.lock();
+        stats.clients += locked && !locked->closed() ? 1 : 0;
+    }
+    return stats;
+}
+
+void HttpServer::accept()
+{
+    acceptor_.async_accept(asio::make_strand(io_context_), [this](beast::error_code ec, tcp::socket socket) {
+        if (!ec)
+        {
+            std::make_shared<HttpSession>(*this, std::move(socket))->start();
+        }
+        if (acceptor_.is_open())
+        {
+            accept();
+        }
+    });
+}
+
+void HttpServer::add_stream(std::shared_ptr<EventStream> const& stream)
+{
+    std::lock_guard lock(streams_mutex_);
+    streams_.push_back(stream);
+}
+
+} // namespace ytweb
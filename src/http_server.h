@@ -0,0 +1,129 @@
+#pragma once
+
+#include "boost/asio/io_context.hpp"
+#include "boost/asio/ip/tcp.hpp"
+#include "boost/asio/signal_set.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace ytweb
+{
+
+class EventStream;
+
+// An HTTP API in place of the frontend, e.g. for automation without a browser.
+//
+//   POST /api/requests                   submit a request as sent by the frontend, return {"task": <id>}
+//   POST /api/requests/bulk              submit {"request": {...}, "urls": [...]}, one task per URL with the options
+//                                        of the request, or {"requests": [...]}, return {"tasks": [<id or null>...]}
+//   POST /api/tasks/<id>/interrupt       also "pause" and "resume"
+//   GET  /api/metrics                    the metrics of tasks, and of the event streams
+//   GET  /api/events                     the events of all tasks, as server-sent events named like the functions of
+//                                        the frontend, e.g. "showDownloadProgress" or "reportCompletion"
+//
+// Requests to submit must be `application/json`, and can't set "yt_dlp_path": yt-dlp is run from `$PATH`.
+// Requests from web pages, which tell their `Origin`, are rejected, so that a page visited by the user can't
+// drive the API on localhost.
+//
+// Each client of the events has a bounded queue. Once full, its oldest progress is dropped, which is superseded
+// by later progress anyway, and a "dropped" event tells how many. A client which can't keep up with the other
+// events, which are never dropped, is disconnected.
+class HttpServer
+{
+  public:
+    using TaskId = int;
+
+    struct Options
+    {
+        std::string address{"127.0.0.1"};
+        std::uint16_t port{8080}; // 0 for any free port, see `port()`
+        std::size_t threads{2};
+        std::size_t max_body_bytes{64 * 1024 * 1024};
+        std::size_t max_queued_bytes{1024 * 1024}; // of the events for each client
+    };
+
+    // The entry points of the app, called from the threads of the server.
+    struct Handlers
+    {
+        std::function<std::optional<TaskId>(std::string_view request)> submit;
+        std::function<void(TaskId task)> interrupt;
+        std::function<bool(TaskId task)> pause;
+        std::function<bool(TaskId task)> resume;
+        std::function<std::string()> metrics;
+    };
+
+    struct Stats
+    {
+        std::size_t clients{};        // of the events
+        std::uint64_t dropped{};      // progress events dropped for slow clients
+        std::uint64_t disconnected{}; // slow clients
+    };
+
+    explicit HttpServer(Options options);
+
+    // Stop serving.
+    ~HttpServer();
+
+    HttpServer(HttpServer const&) = delete;
+    HttpServer& operator=(HttpServer const&) = delete;
+    HttpServer(HttpServer&&) = delete;
+    HttpServer& operator=(HttpServer&&) = delete;
+
+    // Listen and serve in the background, until `stop()`, SIGINT or SIGTERM.
+    // Throw `boost::system::system_error` if the address can't be listened on.
+    void start(Handlers handlers);
+
+    // Block until the server is stopped.
+    void wait();
+
+    void stop();
+
+    // The port listened on, once started.
+    auto port() const -> std::uint16_t
+    {
+        return port_.load();
+    }
+
+    // Send an event to every client of the events, from any thread.
+    void publish(std::string_view event, std::string_view data);
+
+    // Send a call of a function of the frontend, e.g. `reportCompletion(1, "")`, as an event named like
+    // the function, whose data is the JSON array of the arguments.
+    void publish_call(std::string_view script);
+
+    auto stats() const -> Stats;
+
+  private:
+    Options options_;
+    Handlers handlers_;
+
+    boost::asio::io_context io_context_;
+    boost::asio::ip::tcp::acceptor acceptor_{io_context_};
+    boost::asio::signal_set signals_{io_context_};
+    std::vector<std::thread> threads_;
+    std::atomic<std::uint16_t> port_{0};
+
+    mutable std::mutex streams_mutex_;
+    std::vector<std::weak_ptr<EventStream>> streams_;
+
+    std::atomic<std::uint64_t> dropped_{0};
+    std::atomic<std::uint64_t> disconnected_{0};
+
+    friend class HttpSession;
+    friend class EventStream;
+
+    void accept();
+    void add_stream(std::shared_ptr<EventStream> const& stream);
+};
+
+} // namespace ytweb
@@ -0,0 +1,46 @@
+#include "json_text.h"
+
+namespace ytweb
+{
+
+void append_json_string(std::string& out, std::string_view str)
+{
+    constexpr std::string_view HEX = "0123456789abcdef";
+
+    out.push_back('"');
+    for (char c : str)
+    {
+        switch (c)
+        {
+        case '"':
+            out.append(R"(\")");
+            break;
+        case '\\':
+            out.append(R"(\\)");
+            break;
+        case '\n':
+            out.append(R"(\n)");
+            break;
+        case '\r':
+            out.append(R"(\r)");
+            break;
+        case '\t':
+            out.append(R"(\t)");
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                out.append(R"(\u00)");
+                out.push_back(HEX[static_cast<unsigned char>(c) >> 4]);
+                out.push_back(HEX[static_cast<unsigned char>(c) & 0xF]);
+            }
+            else
+            {
+                out.push_back(c);
+            }
+        }
+    }
+    out.push_back('"');
+}
+
+} // namespace ytweb
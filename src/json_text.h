@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace ytweb
+{
+
+// Append a string as a quoted and escaped JSON string. UTF-8 is kept as it is.
+void append_json_string(std::string& out, std::string_view str);
+
+} // namespace ytweb
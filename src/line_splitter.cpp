@@ -0,0 +1,54 @@
+#include "line_splitter.h"
+
+#include <algorithm>
+
+namespace ytweb
+{
+
+namespace
+{
+
+// Read at least this many bytes at once.
+constexpr std::size_t MIN_READ_SIZE = 4096;
+
+} // anonymous namespace
+
+LineSplitter::LineSplitter(std::size_t max_line_length)
+    : max_line_length_(std::max<std::size_t>(max_line_length, 1)),
+      buffer_(std::min(INITIAL_CAPACITY, max_line_length_ + MIN_READ_SIZE))
+{
+}
+
+std::span<char> LineSplitter::prepare()
+{
+    if (begin_ == end_)
+    {
+        begin_ = scan_ = end_ = lf_ = 0;
+        lf_found_ = false;
+    }
+    else if (buffer_.size() - end_ < MIN_READ_SIZE && begin_ > 0)
+    {
+        // Move the partial line to the front.
+        std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+        if (lf_ < scan_)
+        {
+            lf_ = scan_;
+            lf_found_ = false;
+        }
+        lf_ -= begin_;
+        scan_ -= begin_;
+        end_ -= begin_;
+        begin_ = 0;
+    }
+
+    // The partial line is shorter than the maximum length, so the buffer never grows beyond it much.
+    if (buffer_.size() - end_ < MIN_READ_SIZE)
+    {
+        auto doubled = std::min(buffer_.size() * 2, max_line_length_ + MIN_READ_SIZE);
+        buffer_.resize(std::max(doubled, end_ + MIN_READ_SIZE));
+    }
+
+    return {buffer_.data() + end_, buffer_.size() - end_};
+}
+
+} // namespace ytweb
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace ytweb
+{
+
+// Split a stream of output into lines, without copying them.
+// Data is read directly into the buffer (`prepare()` then `commit()`), and each complete line is handed out
+// as a view into the buffer. Only the last partial line is moved when the buffer is compacted.
+//
+// Both '\n' and '\r' end a line, and "\r\n" counts as a single line break. The delimiters are not included.
+// A line longer than the maximum length is truncated, and the rest of it is discarded.
+class LineSplitter
+{
+  public:
+    // Well beyond the information of a video (a line of `yt-dlp -j`), which is rarely larger than 2 MiB.
+    static constexpr std::size_t DEFAULT_MAX_LINE_LENGTH = 8 * 1024 * 1024;
+
+    // Most processes only print short lines, so the buffer starts small and doubles as needed.
+    static constexpr std::size_t INITIAL_CAPACITY = 4 * 1024;
+
+    explicit LineSplitter(std::size_t max_line_length = DEFAULT_MAX_LINE_LENGTH);
+
+    // A writable buffer to read data into. Never empty.
+    std::span<char> prepare();
+
+    // Take `size` bytes written into the prepared buffer, and call `on_line(std::string_view)` for each line.
+    // The views are valid until the next call to `prepare()`.
+    template <typename OnLine>
+    void commit(std::size_t size, OnLine&& on_line)
+    {
+        end_ += size;
+
+        while (true)
+        {
+            if (skip_lf_ && begin_ < end_)
+            {
+                skip_lf_ = false;
+                if (buffer_[begin_] == '\n')
+                {
+                    scan_ = ++begin_;
+                }
+            }
+
+            char const* delimiter = find_delimiter();
+            if (delimiter == nullptr)
+            {
+                scan_ = end_;
+                break;
+            }
+
+            auto pos = static_cast<std::size_t>(delimiter - buffer_.data());
+            if (discarding_)
+            {
+                discarding_ = false; // the rest of a truncated line
+            }
+            else
+            {
+                on_line(std::string_view(buffer_.data() + begin_, std::min(pos - begin_, max_line_length_)));
+            }
+
+            skip_lf_ = *delimiter == '\r';
+            begin_ = scan_ = pos + 1;
+        }
+
+        if (discarding_)
+        {
+            begin_ = scan_ = end_;
+        }
+        else if (end_ - begin_ > max_line_length_)
+        {
+            on_line(std::string_view(buffer_.data() + begin_, max_line_length_));
+            discarding_ = true;
+            begin_ = scan_ = end_;
+        }
+    }
+
+    // The last line, which has no line break. Empty if it has been truncated.
+    std::string_view rest() const
+    {
+        return discarding_ ? std::string_view() : std::string_view(buffer_.data() + begin_, end_ - begin_);
+    }
+
+    std::size_t capacity() const
+    {
+        return buffer_.size();
+    }
+
+  private:
+    std::size_t max_line_length_;
+
+    std::vector<char> buffer_;
+
+    // Unconsumed data is in [begin_, end_), of which [begin_, scan_) has no line break.
+    std::size_t begin_{0};
+    std::size_t scan_{0};
+    std::size_t end_{0};
+
+    bool skip_lf_{false};    // the last line ended with '\r'
+    bool discarding_{false}; // the current line has been truncated
+
+    // Where the last search for '\n' stopped: the '\n' found, or the end of the data then.
+    // [scan_, lf_) has no '\n', so lines ended by '\r' don't search the same data for '\n' again.
+    std::size_t lf_{0};
+    bool lf_found_{false};
+
+    // Find the first '\n' or '\r' in [scan_, end_), with `memchr` which is vectorized.
+    char const* find_delimiter()
+    {
+        if (lf_ < scan_)
+        {
+            lf_ = scan_;
+            lf_found_ = false;
+        }
+        if (!lf_found_ && lf_ < end_)
+        {
+            auto const* lf = static_cast<char const*>(std::memchr(buffer_.data() + lf_, '\n', end_ - lf_));
+            lf_found_ = lf != nullptr;
+            lf_ = lf_found_ ? static_cast<std::size_t>(lf - buffer_.data()) : end_;
+        }
+
+        char const* first = buffer_.data() + scan_;
+        auto const* cr = static_cast<char const*>(std::memchr(first, '\r', lf_ - scan_));
+        if (cr != nullptr)
+        {
+            return cr;
+        }
+        return lf_found_ ? buffer_.data() + lf_ : nullptr;
+    }
+};
+
+} // namespace ytweb
@@ -0,0 +1,423 @@
+#include "load_driver.h"
+
+#include "exception.h"
+#include "nlohmann/json.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <utility>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+namespace ytweb
+{
+
+using Json = nlohmann::ordered_json;
+
+namespace
+{
+
+constexpr std::string_view STAMP_MARK = "@@";
+constexpr auto SAMPLE_INTERVAL = std::chrono::milliseconds(100);
+
+// How long the app may take to reap the children and flush the log once the tasks are over.
+constexpr auto SETTLE_TIME = std::chrono::seconds(1);
+
+#ifndef _WIN32
+double to_seconds(timeval const& time)
+{
+    return static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_usec) / 1e6;
+}
+
+// The clock of `time.monotonic_ns()` in python.
+std::int64_t monotonic_ns()
+{
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<std::int64_t>(now.tv_sec) * 1'000'000'000 + now.tv_nsec;
+}
+#endif
+
+// Call `f(stamp)` for each " @@<ns>@@" in the data.
+template <typename F>
+void for_each_stamp(std::string_view data, F&& f)
+{
+    for (auto pos = data.find(STAMP_MARK); pos != std::string_view::npos; pos = data.find(STAMP_MARK, pos))
+    {
+        pos += STAMP_MARK.size();
+        std::int64_t stamp{};
+        auto [end, ec] = std::from_chars(data.data() + pos, data.data() + data.size(), stamp);
+        if (ec == std::errc{} && std::string_view(end, data.data() + data.size()).starts_with(STAMP_MARK))
+        {
+            f(stamp);
+            pos = static_cast<std::size_t>(end - data.data()) + STAMP_MARK.size();
+        }
+    }
+}
+
+// The task of a script such as "reportCompletion(42, ...)".
+std::optional<int> script_task(std::string_view script, std::string_view function)
+{
+    if (!script.starts_with(function) || !script.substr(function.size()).starts_with('('))
+    {
+        return std::nullopt;
+    }
+    auto args = script.substr(function.size() + 1);
+
+    int task{};
+    auto [end, ec] = std::from_chars(args.data(), args.data() + args.size(), task);
+    return ec == std::errc{} ? std::optional(task) : std::nullopt;
+}
+
+Json summarize(std::vector<double> latencies)
+{
+    Json summary = {{"count", latencies.size()}};
+    if (latencies.empty())
+    {
+        return summary;
+    }
+
+    std::ranges::sort(latencies);
+    auto percentile = [&latencies](double p) {
+        auto rank = static_cast<std::size_t>(std::ceil(p * static_cast<double>(latencies.size())));
+        return latencies[std::clamp<std::size_t>(rank, 1, latencies.size()) - 1];
+    };
+    summary["p50"] = percentile(0.5);
+    summary["p90"] = percentile(0.9);
+    summary["p99"] = percentile(0.99);
+    summary["max"] = latencies.back();
+    return summary;
+}
+
+} // anonymous namespace
+
+ProcessStats ProcessStats::sample()
+{
+    ProcessStats stats;
+
+#ifdef __linux__
+    std::ifstream status("/proc/self/status");
+    for (std::string line; std::getline(status, line);)
+    {
+        std::string_view field(line);
+        auto value = [&field](std::string_view name) -> std::optional<std::uint64_t> {
+            if (!field.starts_with(name))
+            {
+                return std::nullopt;
+            }
+            auto digits = field.substr(name.size());
+            digits.remove_prefix(std::min(digits.find_first_not_of(" \t"), digits.size()));
+            std::uint64_t number{};
+            std::from_chars(digits.data(), digits.data() + digits.size(), number);
+            return number;
+        };
+
+        if (auto kilobytes = value("VmRSS:"))
+        {
+            stats.rss_bytes = *kilobytes * 1024;
+        }
+        else if (auto threads = value("Threads:"))
+        {
+            stats.threads = *threads;
+        }
+    }
+
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it("/proc/self/fd", ec), end; !ec && it != end; it.increment(ec))
+    {
+        ++stats.open_files;
+    }
+#endif
+
+#ifndef _WIN32
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        stats.user_seconds = to_seconds(usage.ru_utime);
+        stats.system_seconds = to_seconds(usage.ru_stime);
+    }
+    if (getrusage(RUSAGE_CHILDREN, &usage) == 0)
+    {
+        stats.children_seconds = to_seconds(usage.ru_utime) + to_seconds(usage.ru_stime);
+    }
+#endif
+
+    return stats;
+}
+
+auto LoadDriver::parse_options(std::string_view json) -> Options
+{
+    Options options;
+    try
+    {
+        auto data = Json::parse(json);
+        options.tasks = data.value("tasks", options.tasks);
+        options.rate = data.value("rate", options.rate);
+        options.interrupt_every = data.value("interrupt_every", options.interrupt_every);
+        options.interrupt_after = std::chrono::milliseconds(
+            data.value("interrupt_after_ms", options.interrupt_after.count())
+        );
+        options.drain_timeout = std::chrono::seconds(data.value("drain_timeout_s", options.drain_timeout.count()));
+
+        auto const& request = data.at("request");
+        options.request = request.is_string() ? request.get<std::string>() : request.dump();
+    }
+    catch (Json::exception const& e)
+    {
+        throw ParseError("Invalid options of the load test: {}", e.what());
+    }
+
+    if (options.rate <= 0)
+    {
+        throw ParseError("Invalid rate of the load test: {}", options.rate);
+    }
+    return options;
+}
+
+LoadDriver::LoadDriver(Options options) : options_(std::move(options))
+{
+}
+
+void LoadDriver::on_send(std::string_view function, std::string_view data)
+{
+    record_sent(function, data, true);
+}
+
+void LoadDriver::on_script(std::string_view script)
+{
+    // The stderr attached to reports is old news, so its stamps are not measured.
+    record_sent(script.substr(0, script.find('(')), script, false);
+
+    if (auto task = script_task(script, "reportCompletion"))
+    {
+        report(*task, Outcome::Completed);
+    }
+    else if (auto task = script_task(script, "reportInterruption"))
+    {
+        report(*task, Outcome::Interrupted);
+    }
+    else if (auto task = script_task(script, "reportTaskState"); task && script.ends_with(R"js("error"))js"))
+    {
+        report(*task, Outcome::Failed);
+    }
+}
+
+void LoadDriver::record_sent(std::string_view function, std::string_view data, bool measure)
+{
+#ifndef _WIN32
+    auto now = monotonic_ns();
+#endif
+
+    std::lock_guard lock(mutex_);
+    auto it = channels_.find(function);
+    if (it == channels_.end())
+    {
+        it = channels_.emplace(function, Channel{}).first;
+    }
+    ++it->second.calls;
+    it->second.bytes += data.size();
+
+    if (!measure)
+    {
+        return;
+    }
+#ifndef _WIN32
+    for_each_stamp(data, [&it, now](std::int64_t stamp) {
+        it->second.latencies.push_back(static_cast<double>(now - stamp) / 1000);
+    });
+#endif
+}
+
+void LoadDriver::report(TaskId task, Outcome outcome)
+{
+    std::lock_guard lock(mutex_);
+    if (outcomes_.emplace(task, outcome).second && submitted_.contains(task))
+    {
+        ++over_;
+        over_cv_.notify_all();
+    }
+}
+
+std::string LoadDriver::run(Handlers const& handlers)
+{
+    auto const start = Clock::now();
+    auto const interval = std::chrono::duration<double>(1 / options_.rate);
+    auto const before = ProcessStats::sample();
+    peak_ = before;
+    sampled_ = start;
+
+    std::deque<std::pair<Clock::time_point, TaskId>> interrupts; // in order, as the delay is the same
+    auto interrupt_due = [&](Clock::time_point until) {
+        while (!interrupts.empty() && interrupts.front().first <= until)
+        {
+            sleep_until(interrupts.front().first);
+            handlers.interrupt(interrupts.front().second);
+            interrupts.pop_front();
+        }
+    };
+
+    std::size_t rejected{0};
+    std::optional<ProcessStats> warm; // once a tenth of the requests are submitted, when the app has warmed up
+    for (std::size_t n = 0; n < options_.tasks; ++n)
+    {
+        auto due = start + std::chrono::duration_cast<Clock::duration>(interval * static_cast<double>(n));
+        interrupt_due(due);
+        sleep_until(due);
+
+        auto request = options_.request;
+        for (auto pos = request.find("{n}"); pos != std::string::npos; pos = request.find("{n}", pos))
+        {
+            auto number = std::to_string(n);
+            request.replace(pos, 3, number);
+            pos += number.size();
+        }
+
+        auto task = handlers.submit(request);
+        if (!task)
+        {
+            ++rejected;
+            continue;
+        }
+
+        {
+            std::lock_guard lock(mutex_);
+            submitted_.insert(*task);
+            if (outcomes_.contains(*task))
+            {
+                ++over_;
+            }
+        }
+
+        if (options_.interrupt_every > 0 && n % options_.interrupt_every == options_.interrupt_every - 1)
+        {
+            interrupts.emplace_back(Clock::now() + options_.interrupt_after, *task);
+        }
+        if (!warm && n + 1 >= options_.tasks / 10)
+        {
+            warm = ProcessStats::sample();
+        }
+    }
+    auto const submitted = Clock::now();
+    interrupt_due(Clock::time_point::max());
+
+    // Wait for the tasks to be over.
+    bool drained{false};
+    for (auto deadline = Clock::now() + options_.drain_timeout; !drained && Clock::now() < deadline;)
+    {
+        {
+            std::unique_lock lock(mutex_);
+            drained = over_cv_.wait_for(lock, SAMPLE_INTERVAL, [this] { return over_ == submitted_.size(); });
+        }
+        sample_if_due();
+    }
+    auto const drained_at = Clock::now();
+
+    sleep_until(Clock::now() + SETTLE_TIME);
+    auto const after = ProcessStats::sample();
+    auto const residue = handlers.residue();
+
+    std::lock_guard lock(mutex_);
+
+    std::size_t completed{0};
+    std::size_t interrupted{0};
+    std::size_t failed{0};
+    for (auto task : submitted_)
+    {
+        auto it = outcomes_.find(task);
+        if (it != outcomes_.end())
+        {
+            completed += it->second == Outcome::Completed ? 1 : 0;
+            interrupted += it->second == Outcome::Interrupted ? 1 : 0;
+            failed += it->second == Outcome::Failed ? 1 : 0;
+        }
+    }
+
+    auto seconds = [](Clock::duration duration) { return std::chrono::duration<double>(duration).count(); };
+    auto const& baseline = warm.value_or(before);
+
+    Json report = {
+        {"tasks",
+         {
+             {"submitted", submitted_.size()},
+             {"rejected", rejected},
+             {"completed", completed},
+             {"interrupted", interrupted},
+             {"failed", failed},
+             {"unfinished", submitted_.size() - over_},
+         }},
+        {"seconds",
+         {
+             {"submitting", seconds(submitted - start)},
+             {"draining", seconds(drained_at - submitted)},
+         }},
+        {"rate", static_cast<double>(submitted_.size() + rejected) / std::max(seconds(submitted - start), 1e-9)},
+        {"rss_bytes",
+         {
+             {"start", before.rss_bytes},
+             {"warm", baseline.rss_bytes},
+             {"peak", peak_.rss_bytes},
+             {"end", after.rss_bytes},
+         }},
+        {"threads", {{"start", before.threads}, {"peak", peak_.threads}, {"end", after.threads}}},
+        {"cpu_seconds",
+         {
+             {"user", after.user_seconds - before.user_seconds},
+             {"system", after.system_seconds - before.system_seconds},
+             {"children", after.children_seconds - before.children_seconds},
+         }},
+        {"sent", Json::object()},
+        // Left behind by the tasks, which should be nothing but the growth of memory since warming up.
+        {"leaks",
+         {
+             {"tasks", residue.tasks},
+             {"flights", residue.flights},
+             {"open_files", static_cast<std::int64_t>(after.open_files) - static_cast<std::int64_t>(before.open_files)},
+             {"threads", static_cast<std::int64_t>(after.threads) - static_cast<std::int64_t>(before.threads)},
+             {"rss_bytes", static_cast<std::int64_t>(after.rss_bytes) - static_cast<std::int64_t>(baseline.rss_bytes)},
+         }},
+    };
+    for (auto const& [function, channel] : channels_)
+    {
+        report["sent"][function] = {
+            {"calls", channel.calls},
+            {"bytes", channel.bytes},
+            {"latency_us", summarize(channel.latencies)},
+        };
+    }
+    return report.dump(2);
+}
+
+void LoadDriver::sample_if_due()
+{
+    auto now = Clock::now();
+    if (now - sampled_ < SAMPLE_INTERVAL)
+    {
+        return;
+    }
+    sampled_ = now;
+
+    auto stats = ProcessStats::sample();
+    peak_.rss_bytes = std::max(peak_.rss_bytes, stats.rss_bytes);
+    peak_.threads = std::max(peak_.threads, stats.threads);
+    peak_.open_files = std::max(peak_.open_files, stats.open_files);
+}
+
+void LoadDriver::sleep_until(Clock::time_point time)
+{
+    for (auto now = Clock::now(); now < time; now = Clock::now())
+    {
+        sample_if_due();
+        std::this_thread::sleep_until(std::min(time, now + SAMPLE_INTERVAL));
+    }
+    sample_if_due();
+}
+
+} // namespace ytweb
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ytweb
+{
+
+// The resources used by this process. Zero where the platform doesn't tell.
+struct ProcessStats
+{
+    std::uint64_t rss_bytes{};
+    std::size_t threads{};
+    std::size_t open_files{};
+    double user_seconds{};
+    double system_seconds{};
+    double children_seconds{}; // user and system, of the children which have been waited for
+
+    static ProcessStats sample();
+};
+
+// Submit requests to the app at a target rate, as the frontend would but without a browser, and report how it
+// holds up: memory, threads and CPU, the latency of events from yt-dlp to the frontend, and what is left once
+// all tasks are over, which should be nothing.
+//
+// The latency is measured for lines stamped by `bench/yt-dlp-sim.py` with `stamp=1`, on the same monotonic clock.
+class LoadDriver
+{
+  public:
+    using TaskId = int;
+
+    struct Options
+    {
+        std::size_t tasks{1000};
+        double rate{50}; // requests per second
+
+        // A request as sent by the frontend, where "{n}" is replaced with the number of the request,
+        // e.g. to keep identical requests from sharing a task.
+        std::string request;
+
+        // One task of every `interrupt_every` is interrupted, once it has run for `interrupt_after`. 0 for none.
+        std::size_t interrupt_every{0};
+        std::chrono::milliseconds interrupt_after{500};
+
+        // How long to wait for the tasks to be over once all have been submitted.
+        std::chrono::seconds drain_timeout{300};
+    };
+
+    // From a JSON object with the same keys, but "interrupt_after_ms" and "drain_timeout_s",
+    // where "request" is an object or a string. Throw `ParseError` if invalid.
+    static Options parse_options(std::string_view json);
+
+    // What is left of the tasks.
+    struct Residue
+    {
+        std::size_t tasks{};
+        std::size_t flights{};
+    };
+
+    // The entry points of the app, which back `handleRequest` and `handleInterrupt`.
+    struct Handlers
+    {
+        std::function<std::optional<TaskId>(std::string_view request)> submit;
+        std::function<void(TaskId task)> interrupt;
+        std::function<Residue()> residue;
+    };
+
+    explicit LoadDriver(Options options);
+
+    // Called with what the app sends to the frontend, from any thread.
+    void on_send(std::string_view function, std::string_view data);
+    void on_script(std::string_view script);
+
+    // Submit the requests and wait for their tasks to be over. Return the report as JSON.
+    std::string run(Handlers const& handlers);
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Channel
+    {
+        std::uint64_t calls{};
+        std::uint64_t bytes{};
+        std::vector<double> latencies; // microseconds
+    };
+
+    Options options_;
+
+    enum class Outcome
+    {
+        Completed,
+        Interrupted,
+        Failed,
+    };
+
+    std::mutex mutex_;
+    std::condition_variable over_cv_;
+    std::set<TaskId> submitted_;
+    std::map<TaskId, Outcome> outcomes_; // the first report of each task, which may come before it is submitted
+    std::size_t over_{0};                // of the submitted tasks
+    std::map<std::string, Channel, std::less<>> channels_;
+
+    // Sampled while running.
+    ProcessStats peak_;
+    Clock::time_point sampled_;
+
+    void record_sent(std::string_view function, std::string_view data, bool measure);
+    void report(TaskId task, Outcome outcome);
+
+    void sample_if_due();
+
+    // Sleep until the time, sampling on the way.
+    void sleep_until(Clock::time_point time);
+};
+
+} // namespace ytweb
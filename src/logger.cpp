@@ -0,0 +1,213 @@
+#include "logger.h"
+
+#include "json_text.h"
+
+#include <array>
+#include <charconv>
+
+namespace ytweb
+{
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+constexpr std::array LEVEL_NAMES = std::to_array<std::string_view>({"debug", "info", "warning", "error"});
+
+} // anonymous namespace
+
+std::string_view to_string(LogLevel level)
+{
+    return LEVEL_NAMES.at(static_cast<std::size_t>(level));
+}
+
+std::optional<LogLevel> parse_log_level(std::string_view name)
+{
+    for (std::size_t i = 0; i < LEVEL_NAMES.size(); ++i)
+    {
+        if (LEVEL_NAMES[i] == name)
+        {
+            return static_cast<LogLevel>(i);
+        }
+    }
+    return std::nullopt;
+}
+
+Logger::Logger(Sink sink, Options options)
+    : sink_(std::move(sink)),
+      flush_interval_(options.flush_interval),
+      queue_(options.capacity),
+      flusher_([this] { run(); })
+{
+}
+
+Logger::~Logger()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    stop_cv_.notify_all();
+
+    pending_.store(1, std::memory_order_release);
+    pending_.notify_one();
+
+    flusher_.join();
+}
+
+bool Logger::set_file(FileOptions options)
+{
+    std::lock_guard lock(file_mutex_);
+
+    std::error_code ec;
+    if (options.path.has_parent_path())
+    {
+        fs::create_directories(options.path.parent_path(), ec);
+    }
+
+    file_.close();
+    file_.clear();
+    file_.open(options.path, std::ios::binary | std::ios::app);
+    if (!file_)
+    {
+        file_options_.reset();
+        return false;
+    }
+
+    auto size = fs::file_size(options.path, ec);
+    file_size_ = ec ? 0 : static_cast<std::size_t>(size);
+    file_options_ = std::move(options);
+    return true;
+}
+
+void Logger::push(Record record)
+{
+    if (!queue_.try_push(std::move(record)))
+    {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Only the first message since the last drain needs to wake the flusher.
+    if (pending_.load(std::memory_order_relaxed) == 0 && pending_.exchange(1, std::memory_order_release) == 0)
+    {
+        pending_.notify_one();
+    }
+}
+
+// Wait for a message, then wait a little longer so that messages logged together are flushed together.
+void Logger::run()
+{
+    while (true)
+    {
+        pending_.wait(0, std::memory_order_acquire);
+
+        bool stopping{};
+        {
+            std::unique_lock lock(mutex_);
+            stopping = stop_cv_.wait_for(lock, flush_interval_, [this] { return stopping_; });
+        }
+
+        pending_.store(0, std::memory_order_relaxed);
+        drain();
+
+        if (stopping)
+        {
+            return;
+        }
+    }
+}
+
+void Logger::drain()
+{
+    std::string batch;
+    std::string lines;
+
+    auto append = [&](LogLevel level, Clock::time_point time, std::string_view message) {
+        auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+
+        batch.append(batch.empty() ? "[" : ",");
+        batch.append(R"({"level":)");
+        append_json_string(batch, to_string(level));
+        batch.append(R"(,"time":)");
+        std::array<char, 24> buffer{};
+        auto [end, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), millis);
+        batch.append(buffer.data(), end);
+        batch.append(R"(,"message":)");
+        append_json_string(batch, message);
+        batch.push_back('}');
+
+        lines.append(std::format(
+            "{:%F %T}Z [{}] {}\n", std::chrono::floor<std::chrono::milliseconds>(time), to_string(level), message
+        ));
+    };
+
+    while (auto record = queue_.try_pop())
+    {
+        append(record->level, record->time, record->message);
+    }
+
+    if (auto dropped = dropped_.load(std::memory_order_relaxed); dropped > reported_drops_)
+    {
+        append(LogLevel::Warning, Clock::now(), std::format("{} log messages were dropped.", dropped - reported_drops_));
+        reported_drops_ = dropped;
+    }
+
+    if (batch.empty())
+    {
+        return;
+    }
+    batch.push_back(']');
+
+    sink_(batch);
+    write_file(lines);
+}
+
+void Logger::write_file(std::string_view lines)
+{
+    std::lock_guard lock(file_mutex_);
+    if (!file_options_)
+    {
+        return;
+    }
+
+    if (file_size_ > 0 && file_size_ + lines.size() > file_options_->max_bytes)
+    {
+        rotate_file();
+    }
+
+    file_.write(lines.data(), static_cast<std::streamsize>(lines.size()));
+    file_.flush();
+    file_size_ += lines.size();
+}
+
+// Shift "log.1" to "log.2" and so on, dropping the oldest, and start a new file.
+void Logger::rotate_file()
+{
+    auto const& path = file_options_->path;
+    auto rotated = [&path](std::size_t index) { return fs::path(path).concat(std::format(".{}", index)); };
+
+    file_.close();
+
+    std::error_code ec;
+    if (file_options_->max_files == 0)
+    {
+        fs::remove(path, ec);
+    }
+    else
+    {
+        fs::remove(rotated(file_options_->max_files), ec);
+        for (auto i = file_options_->max_files; i > 1; --i)
+        {
+            fs::rename(rotated(i - 1), rotated(i), ec);
+        }
+        fs::rename(path, rotated(1), ec);
+    }
+
+    file_.clear();
+    file_.open(path, std::ios::binary | std::ios::trunc);
+    file_size_ = 0;
+}
+
+} // namespace ytweb
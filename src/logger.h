@@ -1,60 +1,178 @@
 #pragma once
 
-#include "nlohmann/json.hpp"
-#include "webui.hpp"
+#include "mpsc_ring.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
 #include <format>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
 #include <string_view>
+#include <thread>
+
+// Messages below the level are compiled out: 0 for debug, 1 for info, 2 for warning and 3 for error.
+#ifndef YT_DLP_WEB_MIN_LOG_LEVEL
+#    define YT_DLP_WEB_MIN_LOG_LEVEL 0
+#endif
 
 namespace ytweb
 {
 
-using Json = nlohmann::json;
+enum class LogLevel : std::uint8_t
+{
+    Debug,
+    Info,
+    Warning,
+    Error,
+};
+
+inline constexpr auto MIN_LOG_LEVEL = static_cast<LogLevel>(YT_DLP_WEB_MIN_LOG_LEVEL);
+
+std::string_view to_string(LogLevel level);
+std::optional<LogLevel> parse_log_level(std::string_view name);
 
+// An asynchronous logger.
+// Messages below the level are dropped before being formatted. The others are pushed to a bounded lock-free queue,
+// which a background thread drains in batches to the sink, and optionally to a rotating log file.
+// A message is dropped, and counted, rather than blocking the caller when the queue is full.
+//
+// Each batch sent to the sink is a JSON array: [{"level": "info", "time": 1700000000000, "message": "..."}],
+// where the time is in milliseconds since epoch.
 class Logger
 {
   public:
-    explicit Logger(webui::window& window) : window_(&window)
+    using Sink = std::function<void(std::string_view batch)>;
+
+    struct Options
+    {
+        std::size_t capacity{4096};
+        std::chrono::milliseconds flush_interval{50};
+    };
+
+    struct FileOptions
+    {
+        std::filesystem::path path;
+        std::size_t max_bytes{10 * 1024 * 1024};
+        std::size_t max_files{3}; // rotated files kept besides the current one
+    };
+
+    explicit Logger(Sink sink) : Logger(std::move(sink), Options{})
     {
     }
 
+    Logger(Sink sink, Options options);
+
+    // Flush the remaining messages.
+    ~Logger();
+
+    Logger(Logger const&) = delete;
+    Logger& operator=(Logger const&) = delete;
+    Logger(Logger&&) = delete;
+    Logger& operator=(Logger&&) = delete;
+
+    void set_level(LogLevel level)
+    {
+        level_.store(level, std::memory_order_relaxed);
+    }
+
+    bool enabled(LogLevel level) const
+    {
+        return level >= MIN_LOG_LEVEL && level >= level_.load(std::memory_order_relaxed);
+    }
+
+    // Also write the messages to a file. Return false if the file can't be opened.
+    bool set_file(FileOptions options);
+
+    // The number of messages dropped for a full queue.
+    std::uint64_t dropped() const
+    {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
     template <typename... Args>
     void debug(std::format_string<Args...> format, Args&&... args)
     {
-        log("debug", format, std::forward<Args>(args)...);
+        log<LogLevel::Debug>(format, std::forward<Args>(args)...);
     }
 
     template <typename... Args>
     void info(std::format_string<Args...> format, Args&&... args)
     {
-        log("info", format, std::forward<Args>(args)...);
+        log<LogLevel::Info>(format, std::forward<Args>(args)...);
     }
 
     template <typename... Args>
     void warning(std::format_string<Args...> format, Args&&... args)
     {
-        log("warning", format, std::forward<Args>(args)...);
+        log<LogLevel::Warning>(format, std::forward<Args>(args)...);
     }
 
     template <typename... Args>
     void error(std::format_string<Args...> format, Args&&... args)
     {
-        log("error", format, std::forward<Args>(args)...);
+        log<LogLevel::Error>(format, std::forward<Args>(args)...);
     }
 
   private:
-    webui::window* window_;
+    using Clock = std::chrono::system_clock;
 
-    template <typename... Args>
-    void log(std::string_view level, std::format_string<Args...> format, Args&&... args)
+    struct Record
     {
-        Json json;
-        json.emplace("level", level);
-        json.emplace("message", std::format(format, std::forward<Args>(args)...));
+        LogLevel level{};
+        Clock::time_point time;
+        std::string message;
+    };
+
+    Sink sink_;
+    std::chrono::milliseconds flush_interval_;
+
+    std::atomic<LogLevel> level_{LogLevel::Debug};
+
+    MpscRing<Record> queue_;
+    std::atomic<std::uint64_t> dropped_{0};
+    std::uint64_t reported_drops_{0};
 
-        std::string raw = json.dump();
-        window_->send_raw("logMessage", raw.data(), raw.size());
+    // Set when a message is pushed, to wake the flusher.
+    std::atomic<std::uint32_t> pending_{0};
+
+    std::mutex mutex_;
+    std::condition_variable stop_cv_;
+    bool stopping_{false};
+
+    // Written by the flusher only, except in `set_file()`.
+    std::mutex file_mutex_;
+    std::optional<FileOptions> file_options_;
+    std::ofstream file_;
+    std::size_t file_size_{0};
+
+    std::thread flusher_;
+
+    template <LogLevel Level, typename... Args>
+    void log(std::format_string<Args...> format, Args&&... args)
+    {
+        if constexpr (Level >= MIN_LOG_LEVEL)
+        {
+            if (enabled(Level))
+            {
+                push({.level = Level, .time = Clock::now(), .message = std::format(format, std::forward<Args>(args)...)});
+            }
+        }
     }
+
+    void push(Record record);
+
+    void run();
+    void drain();
+
+    void write_file(std::string_view lines);
+    void rotate_file();
 };
 
 } // namespace ytweb
@@ -1,11 +1,22 @@
 #include "app.h"
 #include "boost/algorithm/string/join.hpp"
+#include "boost/process/v2/environment.hpp"
 #include "exception.h"
+#include "http_server.h"
+#include "load_driver.h"
 #include "runtime.h"
 #include "syscmdline/parser.h"
 #include "syscmdline/system.h"
 
+#include <chrono>
+#include <cstdint>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 
 namespace SCL = SysCmdLine;
 
@@ -47,13 +58,179 @@ int main()
     auto server_dir = std::filesystem::absolute(SCL::appDirectory()) / "server";
     server_dir_option.addArgument(SCL::Argument("path").default_value(server_dir.string()));
 
+    SCL::Option cache_dir_option({"--cache-dir", "-c"}, "Set the directory to persist caches, e.g. preview results.");
+    cache_dir_option.setRequired(false);
+    cache_dir_option.addArgument(SCL::Argument("path"));
+
+    ytweb::TaskManager::Limits const default_limits;
+
+    SCL::Option max_tasks_option({"--max-tasks"}, "Set the maximum number of running tasks.");
+    max_tasks_option.setRequired(false);
+    max_tasks_option.addArgument(SCL::Argument("number").default_value(std::to_string(default_limits.total)));
+
+    SCL::Option max_previews_option({"--max-previews"}, "Set the maximum number of running preview tasks.");
+    max_previews_option.setRequired(false);
+    max_previews_option.addArgument(SCL::Argument("number").default_value(std::to_string(default_limits.preview)));
+
+    SCL::Option max_downloads_option({"--max-downloads"}, "Set the maximum number of running download tasks.");
+    max_downloads_option.setRequired(false);
+    max_downloads_option.addArgument(SCL::Argument("number").default_value(std::to_string(default_limits.download)));
+
+    SCL::Option progress_interval_option(
+        {"--progress-interval"}, "Set the interval in milliseconds to send the progress of downloads."
+    );
+    progress_interval_option.setRequired(false);
+    progress_interval_option.addArgument(
+        SCL::Argument("ms").default_value(std::to_string(ytweb::ProgressCoalescer::DEFAULT_TICK.count()))
+    );
+
+    ytweb::AsyncProcess::Escalation const default_escalation;
+
+    SCL::Option interrupt_grace_option(
+        {"--interrupt-grace"}, "Set how long in milliseconds an interrupted task may take to exit before SIGTERM."
+    );
+    interrupt_grace_option.setRequired(false);
+    interrupt_grace_option.addArgument(
+        SCL::Argument("ms").default_value(std::to_string(default_escalation.interrupt_grace.count()))
+    );
+
+    SCL::Option terminate_grace_option(
+        {"--terminate-grace"}, "Set how long in milliseconds a task may take to exit after SIGTERM before SIGKILL."
+    );
+    terminate_grace_option.setRequired(false);
+    terminate_grace_option.addArgument(
+        SCL::Argument("ms").default_value(std::to_string(default_escalation.terminate_grace.count()))
+    );
+
+    SCL::Option worker_option(
+        {"--worker"}, "Run yt-dlp in resident helpers started from the script, which saves the startup of python."
+    );
+    worker_option.setRequired(false);
+    worker_option.addArgument(SCL::Argument("script"));
+
+    SCL::Option worker_python_option(
+        {"--worker-python"}, "Set the python interpreter of the helpers, which must be able to import yt_dlp."
+    );
+    worker_python_option.setRequired(false);
+    worker_python_option.addArgument(SCL::Argument("path"));
+
+    SCL::Option journal_option(
+        {"--journal"}, "Journal the downloads in the file, and resume the unfinished ones when started again."
+    );
+    journal_option.setRequired(false);
+    journal_option.addArgument(SCL::Argument("path"));
+
+    SCL::Option metrics_file_option(
+        {"--metrics-file"}, "Write the metrics of tasks to a Prometheus text file, which is rewritten periodically."
+    );
+    metrics_file_option.setRequired(false);
+    metrics_file_option.addArgument(SCL::Argument("path"));
+
+    SCL::Option load_test_option(
+        {"--load-test"}, "Run the load test described by the JSON file instead of showing the frontend,\n"
+                         "and print its report. See 'bench/load-test.json'."
+    );
+    load_test_option.setRequired(false);
+    load_test_option.addArgument(SCL::Argument("path"));
+
+    ytweb::HttpServer::Options const default_server;
+
+    SCL::Option serve_option(
+        {"--serve"}, "Serve an HTTP API on the port instead of showing the frontend, e.g. for automation.\n"
+                     "Requests are posted to '/api/requests', and events are streamed from '/api/events'."
+    );
+    serve_option.setRequired(false);
+    serve_option.addArgument(SCL::Argument("port").default_value(std::to_string(default_server.port)));
+
+    SCL::Option serve_address_option({"--serve-address"}, "Set the address to serve the HTTP API on.");
+    serve_address_option.setRequired(false);
+    serve_address_option.addArgument(SCL::Argument("address").default_value(default_server.address));
+
+    SCL::Option log_level_option({"--log-level"}, "Set the minimum level of log messages.");
+    log_level_option.setRequired(false);
+    log_level_option.addArgument(
+        SCL::Argument("level").expect({"debug", "info", "warning", "error"}).default_value("debug")
+    );
+
+    SCL::Option log_file_option({"--log-file"}, "Also write the log to a file, which is rotated when too large.");
+    log_file_option.setRequired(false);
+    log_file_option.addArgument(SCL::Argument("path"));
+
     SCL::Command root_command("yt-dlp-web");
     root_command.addHelpOption();
     root_command.addOptions({runtime_option, browser_option, webview_option});
-    root_command.addOptions({server_dir_option});
+    root_command.addOptions({server_dir_option, cache_dir_option});
+    root_command.addOptions({max_tasks_option, max_previews_option, max_downloads_option});
+    root_command.addOptions({progress_interval_option});
+    root_command.addOptions({interrupt_grace_option, terminate_grace_option});
+    root_command.addOptions({worker_option, worker_python_option});
+    root_command.addOptions({journal_option, metrics_file_option, load_test_option});
+    root_command.addOptions({serve_option, serve_address_option});
+    root_command.addOptions({log_level_option, log_file_option});
     root_command.setHandler([&](SCL::ParseResult const& result) {
         auto& app = ytweb::App::instance();
 
+        // The driver takes the place of the frontend before anything is sent to it.
+        std::shared_ptr<ytweb::LoadDriver> load_driver;
+        if (result.isOptionSet(load_test_option))
+        {
+            auto path = result.valueForOption(load_test_option).toString();
+            std::ifstream file(path, std::ios::binary);
+            if (!file)
+            {
+                std::cerr << "Failed to open the load test: " << path << "\n";
+                return 1;
+            }
+
+            try
+            {
+                std::string json{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+                load_driver = std::make_shared<ytweb::LoadDriver>(ytweb::LoadDriver::parse_options(json));
+            }
+            catch (ytweb::ParseError const& e)
+            {
+                std::cerr << e.what() << "\n";
+                return 1;
+            }
+
+            // Shared with the frontend, as the log may still be flushed once the test is over.
+            app.set_frontend({
+                .send = [load_driver](std::string_view function, std::string_view data) {
+                    load_driver->on_send(function, data);
+                },
+                .run = [load_driver](std::string_view script) { load_driver->on_script(script); },
+            });
+        }
+
+        std::shared_ptr<ytweb::HttpServer> server;
+        if (result.isOptionSet(serve_option) && !load_driver)
+        {
+            try
+            {
+                auto port = std::stoul(result.valueForOption(serve_option).toString());
+                if (port > 65535)
+                {
+                    throw std::out_of_range("port");
+                }
+                server = std::make_shared<ytweb::HttpServer>(ytweb::HttpServer::Options{
+                    .address = result.valueForOption(serve_address_option).toString(),
+                    .port = static_cast<std::uint16_t>(port),
+                });
+            }
+            catch (std::logic_error const& e)
+            {
+                std::cerr << "Invalid port: " << e.what() << "\n";
+                return 1;
+            }
+
+            app.set_frontend({
+                .send = [server](std::string_view function, std::string_view data) {
+                    server->publish(function, data);
+                },
+                .run = [server](std::string_view script) { server->publish_call(script); },
+            });
+        }
+
         if (result.isOptionSet(browser_option))
         {
             app.set_runtime(ytweb::Runtime::AnyBrowser);
@@ -73,8 +250,12 @@ int main()
 
         try
         {
-            auto server_dir = std::filesystem::absolute(result.valueForOption(server_dir_option).toString());
-            app.set_server_dir(server_dir);
+            // Not served without the frontend.
+            if (!load_driver && !server)
+            {
+                auto server_dir = std::filesystem::absolute(result.valueForOption(server_dir_option).toString());
+                app.set_server_dir(server_dir);
+            }
         }
         catch (ytweb::PathError const& e)
         {
@@ -82,7 +263,121 @@ int main()
             return 1;
         }
 
+        if (result.isOptionSet(cache_dir_option))
+        {
+            app.set_cache_dir(std::filesystem::absolute(result.valueForOption(cache_dir_option).toString()));
+        }
+
+        try
+        {
+            app.set_task_limits({
+                .total = std::stoul(result.valueForOption(max_tasks_option).toString()),
+                .preview = std::stoul(result.valueForOption(max_previews_option).toString()),
+                .download = std::stoul(result.valueForOption(max_downloads_option).toString()),
+            });
+        }
+        catch (std::logic_error const& e) // std::invalid_argument or std::out_of_range
+        {
+            std::cerr << "Invalid task limit: " << e.what() << "\n";
+            return 1;
+        }
+
+        try
+        {
+            auto interval = std::stoul(result.valueForOption(progress_interval_option).toString());
+            app.set_progress_interval(std::chrono::milliseconds(interval));
+        }
+        catch (std::logic_error const& e)
+        {
+            std::cerr << "Invalid progress interval: " << e.what() << "\n";
+            return 1;
+        }
+
+        try
+        {
+            app.set_escalation({
+                .interrupt_grace = std::chrono::milliseconds(
+                    std::stoul(result.valueForOption(interrupt_grace_option).toString())
+                ),
+                .terminate_grace = std::chrono::milliseconds(
+                    std::stoul(result.valueForOption(terminate_grace_option).toString())
+                ),
+            });
+        }
+        catch (std::logic_error const& e)
+        {
+            std::cerr << "Invalid grace period: " << e.what() << "\n";
+            return 1;
+        }
+
+        if (auto level = ytweb::parse_log_level(result.valueForOption(log_level_option).toString()))
+        {
+            app.set_log_level(*level);
+        }
+
+        if (result.isOptionSet(log_file_option))
+        {
+            auto log_file = std::filesystem::absolute(result.valueForOption(log_file_option).toString());
+            if (!app.set_log_file(log_file))
+            {
+                std::cerr << "Failed to open the log file: " << log_file.string() << "\n";
+                return 1;
+            }
+        }
+
+        if (result.isOptionSet(worker_option))
+        {
+            auto python = result.isOptionSet(worker_python_option)
+                              ? std::filesystem::path(result.valueForOption(worker_python_option).toString())
+                              : boost::process::environment::find_executable("python3");
+            try
+            {
+                app.set_workers(python, std::filesystem::absolute(result.valueForOption(worker_option).toString()));
+            }
+            catch (std::exception const& e)
+            {
+                std::cerr << "Failed to start the helpers: " << e.what() << "\n";
+                return 1;
+            }
+        }
+
+        if (result.isOptionSet(journal_option))
+        {
+            try
+            {
+                app.set_journal(std::filesystem::absolute(result.valueForOption(journal_option).toString()));
+            }
+            catch (ytweb::PathError const& e)
+            {
+                std::cerr << e.what() << "\n";
+                return 1;
+            }
+        }
+
+        if (result.isOptionSet(metrics_file_option))
+        {
+            app.set_metrics_file(std::filesystem::absolute(result.valueForOption(metrics_file_option).toString()));
+        }
+
         app.init();
+        if (load_driver)
+        {
+            std::cout << app.run_load_test(*load_driver) << "\n";
+            return 0;
+        }
+        if (server)
+        {
+            try
+            {
+                app.serve(*server);
+            }
+            catch (boost::system::system_error const& e)
+            {
+                std::cerr << "Failed to serve the API: " << e.what() << "\n";
+                return 1;
+            }
+            return 0;
+        }
         app.run();
 
         return 0;
@@ -0,0 +1,323 @@
+#include "media_projection.h"
+
+#include "json_text.h"
+#include "nlohmann/json.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <vector>
+
+namespace ytweb
+{
+
+using Json = nlohmann::json;
+
+namespace
+{
+
+// Fields of `MediaData`.
+constexpr std::array MEDIA_FIELDS = std::to_array<std::string_view>({
+    "comment_count",
+    "description",
+    "duration_string",
+    "filename",
+    "formats",
+    "like_count",
+    "requested_formats",
+    "thumbnail",
+    "title",
+    "upload_date",
+    "uploader",
+    "view_count",
+    "webpage_url",
+});
+
+// Fields of `MediaFormat`.
+constexpr std::array FORMAT_FIELDS = std::to_array<std::string_view>({
+    "abr",
+    "acodec",
+    "ext",
+    "filesize_approx",
+    "format_id",
+    "fps",
+    "protocol",
+    "resolution",
+    "tbr",
+    "vbr",
+    "vcodec",
+});
+
+// Which fields of a value are kept.
+enum class Schema : std::uint8_t
+{
+    Skip,
+    All,
+    Media,
+    FormatList,
+    Format,
+    RequestedFormatList,
+    RequestedFormat,
+};
+
+bool contains(auto const& fields, std::string_view field)
+{
+    return std::find(fields.begin(), fields.end(), field) != fields.end();
+}
+
+// Write the kept values as JSON text while receiving SAX events.
+class ProjectionWriter
+{
+  public:
+    explicit ProjectionWriter(std::string& out) : out_(&out)
+    {
+    }
+
+    bool null()
+    {
+        if (begin_value())
+        {
+            out_->append("null");
+        }
+        return true;
+    }
+
+    bool boolean(bool value)
+    {
+        if (begin_value())
+        {
+            out_->append(value ? "true" : "false");
+        }
+        return true;
+    }
+
+    bool number_integer(Json::number_integer_t value)
+    {
+        write_integer(value);
+        return true;
+    }
+
+    bool number_unsigned(Json::number_unsigned_t value)
+    {
+        write_integer(value);
+        return true;
+    }
+
+    // Keep the original text of the number, which never loses precision.
+    bool number_float(Json::number_float_t /* value */, Json::string_t const& text)
+    {
+        if (begin_value())
+        {
+            out_->append(text);
+        }
+        return true;
+    }
+
+    bool string(Json::string_t& value)
+    {
+        if (begin_value())
+        {
+            write_string(value);
+        }
+        return true;
+    }
+
+    bool binary(Json::binary_t& /* value */)
+    {
+        return false; // never appears in JSON text
+    }
+
+    bool start_object(std::size_t /* size */)
+    {
+        start_container(Frame::Kind::Object, '{');
+        return true;
+    }
+
+    bool key(Json::string_t& key)
+    {
+        auto& frame = frames_.back();
+
+        pending_schema_ = child_schema(frame.schema, key);
+        if (pending_schema_ != Schema::Skip)
+        {
+            separate(frame);
+            write_string(key);
+            out_->push_back(':');
+        }
+        return true;
+    }
+
+    bool end_object()
+    {
+        end_container('}');
+        return true;
+    }
+
+    bool start_array(std::size_t /* size */)
+    {
+        start_container(Frame::Kind::Array, '[');
+        return true;
+    }
+
+    bool end_array()
+    {
+        end_container(']');
+        return true;
+    }
+
+    bool parse_error(std::size_t /* position */, std::string const& /* last_token */, Json::exception const& /* e */)
+    {
+        return false;
+    }
+
+  private:
+    struct Frame
+    {
+        enum class Kind : std::uint8_t
+        {
+            Object,
+            Array,
+        };
+
+        Kind kind;
+        Schema schema;
+        bool first{true};
+    };
+
+    std::string* out_;
+    std::vector<Frame> frames_;
+
+    // The schema of the value following the last key.
+    Schema pending_schema_{Schema::Skip};
+
+    // The schema of a field of an object.
+    static Schema child_schema(Schema schema, std::string_view key)
+    {
+        switch (schema)
+        {
+        case Schema::All:
+            return Schema::All;
+        case Schema::Media:
+            if (key == "formats")
+            {
+                return Schema::FormatList;
+            }
+            if (key == "requested_formats")
+            {
+                return Schema::RequestedFormatList;
+            }
+            return contains(MEDIA_FIELDS, key) ? Schema::All : Schema::Skip;
+        case Schema::Format:
+            return contains(FORMAT_FIELDS, key) ? Schema::All : Schema::Skip;
+        case Schema::RequestedFormat:
+            return key == "format_id" ? Schema::All : Schema::Skip;
+        default:
+            return Schema::Skip;
+        }
+    }
+
+    // The schema of an element of an array.
+    static Schema element_schema(Schema schema)
+    {
+        switch (schema)
+        {
+        case Schema::All:
+            return Schema::All;
+        case Schema::FormatList:
+            return Schema::Format;
+        case Schema::RequestedFormatList:
+            return Schema::RequestedFormat;
+        default:
+            return Schema::Skip;
+        }
+    }
+
+    void separate(Frame& frame)
+    {
+        if (!frame.first)
+        {
+            out_->push_back(',');
+        }
+        frame.first = false;
+    }
+
+    // Return the schema of the value to begin, and write the separator if it is kept.
+    Schema value_schema()
+    {
+        if (frames_.empty())
+        {
+            return Schema::Media;
+        }
+
+        auto& frame = frames_.back();
+        if (frame.kind == Frame::Kind::Object)
+        {
+            return pending_schema_; // the key has been written
+        }
+
+        auto schema = element_schema(frame.schema);
+        if (schema != Schema::Skip)
+        {
+            separate(frame);
+        }
+        return schema;
+    }
+
+    bool begin_value()
+    {
+        return value_schema() != Schema::Skip;
+    }
+
+    void start_container(Frame::Kind kind, char open)
+    {
+        auto schema = value_schema();
+        frames_.push_back({.kind = kind, .schema = schema});
+        if (schema != Schema::Skip)
+        {
+            out_->push_back(open);
+        }
+    }
+
+    void end_container(char close)
+    {
+        if (frames_.back().schema != Schema::Skip)
+        {
+            out_->push_back(close);
+        }
+        frames_.pop_back();
+    }
+
+    template <typename Integer>
+    void write_integer(Integer value)
+    {
+        if (begin_value())
+        {
+            std::array<char, 24> buffer{};
+            auto [end, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+            out_->append(buffer.data(), end);
+        }
+    }
+
+    void write_string(std::string_view str)
+    {
+        append_json_string(*out_, str);
+    }
+};
+
+} // anonymous namespace
+
+bool project_media_info(std::string_view json, std::string& out)
+{
+    auto size = out.size();
+
+    ProjectionWriter writer(out);
+    if (!Json::sax_parse(json, &writer))
+    {
+        out.resize(size);
+        return false;
+    }
+    return true;
+}
+
+} // namespace ytweb
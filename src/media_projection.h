@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace ytweb
+{
+
+// Project the information of a media (a line of `yt-dlp -j`) down to the fields rendered by the frontend
+// (see `web/src/types/MediaData.types.ts`), with a trimmed list of formats.
+// Most of the size of the information is dropped, e.g. format URLs, thumbnails, captions and HTTP headers.
+//
+// The JSON is processed as a stream of SAX events, without building a DOM.
+// The projection is appended to `out`. Return false if the JSON is invalid, in which case `out` is left unchanged.
+bool project_media_info(std::string_view json, std::string& out);
+
+} // namespace ytweb
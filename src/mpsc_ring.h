@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <optional>
+
+namespace ytweb
+{
+
+// A bounded lock-free queue for many producers and a single consumer.
+// Each slot carries a sequence number telling whether it is free or filled for the current lap,
+// so producers only contend on one counter, and never block: a push fails when the queue is full.
+template <typename T>
+class MpscRing
+{
+  public:
+    // The capacity is rounded up to a power of two.
+    explicit MpscRing(std::size_t capacity)
+        : mask_(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1),
+          slots_(std::make_unique<Slot[]>(mask_ + 1))
+    {
+        for (std::size_t i = 0; i <= mask_; ++i)
+        {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRing(MpscRing const&) = delete;
+    MpscRing& operator=(MpscRing const&) = delete;
+    MpscRing(MpscRing&&) = delete;
+    MpscRing& operator=(MpscRing&&) = delete;
+
+    // Return false if the queue is full. Safe to call from any thread.
+    bool try_push(T value)
+    {
+        auto pos = tail_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            auto& slot = slots_[pos & mask_];
+            auto sequence = slot.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+
+            if (diff == 0)
+            {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    slot.value = std::move(value);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // the slot is not consumed yet
+            }
+            else
+            {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Return `std::nullopt` if the queue is empty. Must be called from the consumer only.
+    std::optional<T> try_pop()
+    {
+        auto& slot = slots_[head_ & mask_];
+        if (slot.sequence.load(std::memory_order_acquire) != head_ + 1)
+        {
+            return std::nullopt;
+        }
+
+        std::optional<T> value(std::move(slot.value));
+        slot.sequence.store(head_ + mask_ + 1, std::memory_order_release);
+        ++head_;
+        return value;
+    }
+
+    std::size_t capacity() const
+    {
+        return mask_ + 1;
+    }
+
+  private:
+    struct Slot
+    {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    std::size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+
+    // Keep the counters on their own cache lines.
+    alignas(64) std::atomic<std::size_t> tail_{0};
+    alignas(64) std::size_t head_{0};
+};
+
+} // namespace ytweb
@@ -0,0 +1,410 @@
+#include "preview_cache.h"
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace ytweb
+{
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+// FNV-1a, which is stable across runs and platforms, unlike `std::hash`.
+std::uint64_t stable_hash(std::string_view str)
+{
+    constexpr std::uint64_t OFFSET_BASIS = 14695981039346656037ULL;
+    constexpr std::uint64_t PRIME = 1099511628211ULL;
+
+    std::uint64_t hash = OFFSET_BASIS;
+    for (char c : str)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= PRIME;
+    }
+    return hash;
+}
+
+constexpr std::string_view FILE_EXTENSION = ".preview";
+constexpr std::string_view TEMP_EXTENSION = ".tmp";
+
+} // anonymous namespace
+
+PreviewCache::PreviewCache(Options options)
+{
+    set_options(std::move(options));
+}
+
+void PreviewCache::set_options(Options options)
+{
+    std::scoped_lock lock(mutex_, io_mutex_);
+
+    options_ = std::move(options);
+    file_owners_.clear();
+    index_.clear();
+    entries_.clear();
+    stats_.entries = 0;
+    stats_.bytes = 0;
+    cold_index_.clear();
+    cold_files_.clear();
+    cold_bytes_ = 0;
+
+    if (!options_.directory.empty())
+    {
+        std::error_code ec;
+        fs::create_directories(options_.directory, ec);
+        prune_directory();
+    }
+}
+
+std::optional<std::string> PreviewCache::get(std::string_view key)
+{
+    return lookup(key, true);
+}
+
+std::optional<std::string> PreviewCache::peek(std::string_view key)
+{
+    return lookup(key, false);
+}
+
+std::optional<std::string> PreviewCache::lookup(std::string_view key, bool count)
+{
+    std::unique_lock lock(mutex_);
+    auto hit = [&] {
+        if (count)
+        {
+            ++stats_.hits;
+        }
+    };
+    auto miss = [&] {
+        if (count)
+        {
+            ++stats_.misses;
+        }
+    };
+
+    if (auto it = index_.find(key); it != index_.end())
+    {
+        if (it->second->expires > Clock::now())
+        {
+            entries_.splice(entries_.begin(), entries_, it->second);
+            hit();
+            return entries_.front().value;
+        }
+
+        // The file holds the same entry, or that of another key.
+        FileChanges changes;
+        erase(it->second, changes);
+        miss();
+        apply(lock, std::move(changes));
+        return std::nullopt;
+    }
+
+    if (options_.directory.empty())
+    {
+        miss();
+        return std::nullopt;
+    }
+
+    auto path = file_of(key);
+    std::optional<Entry> loaded;
+    {
+        std::lock_guard io_lock(io_mutex_);
+        lock.unlock();
+        loaded = load(path, key);
+    }
+    lock.lock();
+
+    if (loaded)
+    {
+        forget_cold(path); // accounted for by the entry in memory from now on, or gone
+    }
+
+    // Put meanwhile.
+    if (auto it = index_.find(key); it != index_.end())
+    {
+        entries_.splice(entries_.begin(), entries_, it->second);
+        hit();
+        return entries_.front().value;
+    }
+
+    if (!loaded || loaded->expires <= Clock::now())
+    {
+        miss();
+        return std::nullopt;
+    }
+
+    hit();
+    FileChanges changes;
+    insert(std::move(*loaded), changes);
+    auto value = entries_.front().value;
+    apply(lock, std::move(changes));
+    return value;
+}
+
+void PreviewCache::put(std::string_view key, std::string value)
+{
+    std::unique_lock lock(mutex_);
+    FileChanges changes;
+
+    if (auto it = index_.find(key); it != index_.end())
+    {
+        erase(it->second, changes);
+    }
+    else if (!options_.directory.empty())
+    {
+        forget_cold(file_of(key)); // overwritten or removed below
+    }
+
+    Entry entry{.key = std::string(key), .value = std::move(value), .expires = Clock::now() + options_.ttl};
+    if (entry.size() > std::min(options_.max_bytes, options_.max_entry_bytes))
+    {
+        // Remove a file left by a previous run, unless it's that of another entry.
+        if (!options_.directory.empty() && !file_owners_.contains(stable_hash(key)))
+        {
+            changes.removals.push_back(file_of(key));
+        }
+        apply(lock, std::move(changes));
+        return;
+    }
+
+    insert(std::move(entry), changes);
+    if (owns_file(key))
+    {
+        changes.store = entries_.front();
+        changes.store_path = file_of(key);
+    }
+    apply(lock, std::move(changes));
+}
+
+std::size_t PreviewCache::max_entry_bytes() const
+{
+    std::lock_guard lock(mutex_);
+    return options_.max_entry_bytes;
+}
+
+auto PreviewCache::stats() const -> Stats
+{
+    std::lock_guard lock(mutex_);
+    return stats_;
+}
+
+void PreviewCache::insert(Entry entry, FileChanges& changes)
+{
+    stats_.bytes += entry.size();
+    ++stats_.entries;
+
+    entries_.push_front(std::move(entry));
+    auto const& key = entries_.front().key;
+    index_.emplace(key, entries_.begin());
+    if (!options_.directory.empty())
+    {
+        file_owners_.try_emplace(stable_hash(key), key); // unless another entry has the file
+    }
+
+    // The cold files haven't been used by this run, so they go first.
+    while (stats_.bytes + cold_bytes_ > options_.max_bytes && !cold_files_.empty())
+    {
+        auto& cold = cold_files_.front();
+        cold_index_.erase(cold.path.string());
+        cold_bytes_ -= cold.size;
+        changes.removals.push_back(std::move(cold.path));
+        cold_files_.pop_front();
+        ++stats_.evictions;
+    }
+    while (stats_.bytes > options_.max_bytes && !entries_.empty())
+    {
+        erase(std::prev(entries_.end()), changes);
+        ++stats_.evictions;
+    }
+}
+
+void PreviewCache::erase(std::list<Entry>::iterator it, FileChanges& changes)
+{
+    stats_.bytes -= it->size();
+    --stats_.entries;
+
+    if (owns_file(it->key))
+    {
+        changes.removals.push_back(file_of(it->key));
+        file_owners_.erase(stable_hash(it->key));
+    }
+    index_.erase(it->key);
+    entries_.erase(it);
+}
+
+void PreviewCache::apply(std::unique_lock<std::mutex>& lock, FileChanges changes)
+{
+    if (changes.removals.empty() && !changes.store)
+    {
+        lock.unlock();
+        return;
+    }
+
+    std::lock_guard io_lock(io_mutex_);
+    lock.unlock();
+
+    for (auto const& path : changes.removals)
+    {
+        std::error_code ec;
+        fs::remove(path, ec);
+    }
+    if (changes.store)
+    {
+        store(changes.store_path, *changes.store);
+    }
+}
+
+bool PreviewCache::owns_file(std::string_view key) const
+{
+    auto it = file_owners_.find(stable_hash(key));
+    return it != file_owners_.end() && it->second == key;
+}
+
+fs::path PreviewCache::file_of(std::string_view key) const
+{
+    return options_.directory / std::format("{:016x}{}", stable_hash(key), FILE_EXTENSION);
+}
+
+void PreviewCache::forget_cold(fs::path const& path)
+{
+    if (auto it = cold_index_.find(path.string()); it != cold_index_.end())
+    {
+        cold_bytes_ -= it->second->size;
+        cold_files_.erase(it->second);
+        cold_index_.erase(it);
+    }
+}
+
+// Remove the expired entries and temporary files left by previous runs, then the least recently used entries
+// beyond `max_bytes`. The others are kept as cold files.
+void PreviewCache::prune_directory()
+{
+    struct File
+    {
+        fs::path path;
+        fs::file_time_type used;
+        std::size_t size;
+    };
+    std::vector<File> files;
+
+    std::error_code ec;
+    for (auto const& file : fs::directory_iterator(options_.directory, ec))
+    {
+        auto const& path = file.path();
+        if (path.extension() == TEMP_EXTENSION && path.stem().extension() == FILE_EXTENSION)
+        {
+            fs::remove(path, ec);
+            continue;
+        }
+        if (path.extension() != FILE_EXTENSION)
+        {
+            continue;
+        }
+
+        std::ifstream stream(path, std::ios::binary);
+        std::int64_t expires{};
+        std::size_t key_size{};
+        if (!(stream >> expires >> key_size) || stream.get() != '\n' ||
+            Clock::time_point(std::chrono::seconds(expires)) <= Clock::now())
+        {
+            stream.close();
+            fs::remove(path, ec);
+            continue;
+        }
+
+        // Counted as the key and the value, the same as an entry in memory.
+        auto header = static_cast<std::uintmax_t>(stream.tellg());
+        std::error_code size_ec;
+        std::error_code time_ec;
+        auto size = file.file_size(size_ec);
+        auto used = file.last_write_time(time_ec);
+        if (!size_ec && !time_ec && size >= header)
+        {
+            files.push_back({.path = path, .used = used, .size = static_cast<std::size_t>(size - header)});
+        }
+    }
+
+    // The most recently used first.
+    std::ranges::sort(files, std::ranges::greater{}, &File::used);
+    for (auto& file : files)
+    {
+        if (cold_bytes_ + file.size > options_.max_bytes)
+        {
+            fs::remove(file.path, ec);
+            continue;
+        }
+        cold_bytes_ += file.size;
+        cold_files_.push_front({.path = std::move(file.path), .size = file.size});
+        cold_index_.emplace(cold_files_.front().path.string(), cold_files_.begin());
+    }
+}
+
+// The file starts with a line of the expiration time in seconds since epoch and the key length,
+// followed by the key and the value. An expired entry is returned without its value, and its file removed.
+auto PreviewCache::load(fs::path const& path, std::string_view key) -> std::optional<Entry>
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        return std::nullopt;
+    }
+
+    std::int64_t expires{};
+    std::size_t key_size{};
+    if (!(file >> expires >> key_size) || file.get() != '\n' || key_size != key.size())
+    {
+        return std::nullopt;
+    }
+
+    Entry entry{.expires = Clock::time_point(std::chrono::seconds(expires))};
+    entry.key.resize(key_size);
+    if (!file.read(entry.key.data(), static_cast<std::streamsize>(key_size)) || entry.key != key)
+    {
+        return std::nullopt; // hash collision
+    }
+
+    if (entry.expires <= Clock::now())
+    {
+        file.close();
+        std::error_code ec;
+        fs::remove(path, ec);
+        return entry;
+    }
+
+    entry.value.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    // The time of the file tells the next run which entries were used last.
+    std::error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    return entry;
+}
+
+void PreviewCache::store(fs::path const& path, Entry const& entry)
+{
+    // Write to a temporary file first, so that a crash never leaves a truncated entry.
+    auto temp = fs::path(path).concat(TEMP_EXTENSION);
+    bool written{};
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        auto expires = std::chrono::duration_cast<std::chrono::seconds>(entry.expires.time_since_epoch()).count();
+        file << expires << ' ' << entry.key.size() << '\n' << entry.key << entry.value;
+        written = file.flush().good();
+    }
+
+    std::error_code ec;
+    if (written)
+    {
+        fs::rename(temp, path, ec);
+    }
+    if (!written || ec)
+    {
+        fs::remove(temp, ec);
+    }
+}
+
+} // namespace ytweb
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ytweb
+{
+
+// A LRU cache of preview results (the output of `yt-dlp -j`), keyed by `Request::extraction_key()`.
+// Entries expire after a TTL, and the least recently used ones are evicted when the memory cap is exceeded.
+// If a directory is given, entries are also persisted there and survive a restart. The files of evicted entries
+// are removed, and those left by previous runs count towards `max_bytes` until loaded, so the directory stays
+// within it too.
+class PreviewCache
+{
+  public:
+    struct Options
+    {
+        std::size_t max_bytes{64 * 1024 * 1024};
+        std::size_t max_entry_bytes{8 * 1024 * 1024};
+        std::chrono::seconds ttl{std::chrono::minutes(30)};
+
+        // Keep the cache in memory only if empty.
+        std::filesystem::path directory;
+    };
+
+    struct Stats
+    {
+        std::uint64_t hits{};
+        std::uint64_t misses{};
+        std::uint64_t evictions{};
+        std::size_t entries{};
+        std::size_t bytes{};
+    };
+
+    PreviewCache() : PreviewCache(Options{})
+    {
+    }
+
+    explicit PreviewCache(Options options);
+
+    // Drop all entries in memory and apply the new options.
+    void set_options(Options options);
+
+    std::optional<std::string> get(std::string_view key);
+    // Like `get`, but not counted as a hit or a miss, e.g. for a download reusing a preview.
+    std::optional<std::string> peek(std::string_view key);
+
+    // An entry larger than `max_entry_bytes` is not stored.
+    void put(std::string_view key, std::string value);
+
+    std::size_t max_entry_bytes() const;
+
+    Stats stats() const;
+
+  private:
+    using Clock = std::chrono::system_clock;
+
+    struct Entry
+    {
+        std::string key;
+        std::string value;
+        Clock::time_point expires;
+
+        std::size_t size() const
+        {
+            return key.size() + value.size();
+        }
+    };
+
+    mutable std::mutex mutex_;
+    // Taken before `mutex_` is released to change the directory, so the changes are made in order while the
+    // entries in memory are served.
+    std::mutex io_mutex_;
+
+    Options options_;
+
+    // The most recently used entry is at the front.
+    std::list<Entry> entries_;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index_; // keys refer to `entries_`
+    // The key whose entry is in the file of a hash, as two keys may share one. Keys refer to `entries_`.
+    std::unordered_map<std::uint64_t, std::string_view> file_owners_;
+
+    Stats stats_;
+
+    // The files left by previous runs and not loaded yet, the least recently used first.
+    struct ColdFile
+    {
+        std::filesystem::path path;
+        std::size_t size{};
+    };
+    std::list<ColdFile> cold_files_;
+    std::unordered_map<std::string, std::list<ColdFile>::iterator> cold_index_; // by the path
+    std::size_t cold_bytes_{0};
+
+    // The changes to the directory to make once the lock is released.
+    struct FileChanges
+    {
+        std::vector<std::filesystem::path> removals;
+        std::optional<Entry> store;
+        std::filesystem::path store_path;
+    };
+
+    std::optional<std::string> lookup(std::string_view key, bool count);
+
+    // Insert at the front and evict from the back, cold files first. The lock must be held.
+    void insert(Entry entry, FileChanges& changes);
+    // Also remove the file of the entry, if it owns the file.
+    void erase(std::list<Entry>::iterator it, FileChanges& changes);
+    // Release the lock and make the changes.
+    void apply(std::unique_lock<std::mutex>& lock, FileChanges changes);
+
+    bool owns_file(std::string_view key) const;
+    std::filesystem::path file_of(std::string_view key) const;
+    void forget_cold(std::filesystem::path const& path);
+    void prune_directory();
+
+    static std::optional<Entry> load(std::filesystem::path const& path, std::string_view key);
+    static void store(std::filesystem::path const& path, Entry const& entry);
+};
+
+} // namespace ytweb
@@ -0,0 +1,207 @@
+#include "preview_stream.h"
+
+#include "media_projection.h"
+
+#include <format>
+#include <ranges>
+
+namespace ytweb
+{
+
+PreviewStream::PreviewStream(int task_id, Sender send, Limits limits)
+    : task_id_(task_id),
+      send_(std::move(send)),
+      limits_(limits)
+{
+}
+
+void PreviewStream::append(std::string_view entry)
+{
+    if (entry.empty())
+    {
+        return;
+    }
+
+    // Only the fields rendered by the frontend are sent.
+    // The projection is written after the separator, which is removed again if the entry is invalid.
+    if (batch_entries_ == 0)
+    {
+        open_batch();
+    }
+    else
+    {
+        batch_.push_back(',');
+    }
+    if (!project_media_info(entry, batch_))
+    {
+        if (batch_entries_ == 0)
+        {
+            batch_.clear();
+        }
+        else
+        {
+            batch_.pop_back();
+        }
+        return;
+    }
+    ++batch_entries_;
+
+    if (first_batch_ || batch_entries_ >= limits_.max_entries || batch_.size() >= limits_.max_bytes ||
+        Clock::now() - last_sent_ >= limits_.max_delay)
+    {
+        flush();
+    }
+}
+
+void PreviewStream::finish()
+{
+    if (batch_entries_ > 0)
+    {
+        flush();
+    }
+    else if (first_batch_)
+    {
+        // Let the receiver know that the preview is empty.
+        open_batch();
+        flush();
+    }
+}
+
+auto PreviewStream::deadline() const -> std::optional<Clock::time_point>
+{
+    if (batch_entries_ == 0)
+    {
+        return std::nullopt;
+    }
+    return last_sent_ + limits_.max_delay;
+}
+
+void PreviewStream::flush_due()
+{
+    if (auto due = deadline(); due && Clock::now() >= *due)
+    {
+        flush();
+    }
+}
+
+void PreviewStream::open_batch()
+{
+    batch_ = std::format(R"({{"task_id":{},"first":{},"entries":[)", task_id_, first_batch_);
+}
+
+void PreviewStream::flush()
+{
+    batch_.append("]}");
+    send_(batch_);
+
+    batch_.clear();
+    batch_entries_ = 0;
+    first_batch_ = false;
+    last_sent_ = Clock::now();
+}
+
+PreviewFanOut::PreviewFanOut(StreamFactory make_stream, std::size_t max_kept_bytes)
+    : make_stream_(std::move(make_stream)),
+      max_kept_bytes_(max_kept_bytes)
+{
+}
+
+void PreviewFanOut::append(std::vector<int> const& subscribers, std::string_view entry)
+{
+    if (entry.empty())
+    {
+        return;
+    }
+
+    for (auto id : subscribers)
+    {
+        stream(id).append(entry);
+    }
+
+    if (kept_)
+    {
+        if (kept_->size() + entry.size() + 1 > max_kept_bytes_)
+        {
+            kept_.reset();
+        }
+        else
+        {
+            if (!kept_->empty())
+            {
+                kept_->push_back('\n');
+            }
+            kept_->append(entry);
+        }
+    }
+}
+
+void PreviewFanOut::finish(std::vector<int> const& subscribers)
+{
+    for (auto id : subscribers)
+    {
+        stream(id).finish();
+    }
+}
+
+auto PreviewFanOut::deadline(std::vector<int> const& subscribers) const
+    -> std::optional<PreviewStream::Clock::time_point>
+{
+    std::optional<PreviewStream::Clock::time_point> earliest;
+    for (auto id : subscribers)
+    {
+        auto it = streams_.find(id);
+        if (it == streams_.end())
+        {
+            continue;
+        }
+        if (auto due = it->second.deadline(); due && (!earliest || *due < *earliest))
+        {
+            earliest = due;
+        }
+    }
+    return earliest;
+}
+
+auto PreviewFanOut::arm(std::vector<int> const& subscribers) -> std::optional<PreviewStream::Clock::time_point>
+{
+    auto due = deadline(subscribers);
+    if (!due || (armed_ && *armed_ <= *due))
+    {
+        return std::nullopt;
+    }
+    armed_ = due;
+    return due;
+}
+
+void PreviewFanOut::on_timer(std::vector<int> const& subscribers)
+{
+    armed_.reset();
+    for (auto id : subscribers)
+    {
+        if (auto it = streams_.find(id); it != streams_.end())
+        {
+            it->second.flush_due();
+        }
+    }
+}
+
+auto PreviewFanOut::stream(int task_id) -> PreviewStream&
+{
+    auto it = streams_.find(task_id);
+    if (it != streams_.end())
+    {
+        return it->second;
+    }
+
+    auto& stream = streams_.emplace(task_id, make_stream_(task_id)).first->second;
+    if (kept_ && !kept_->empty())
+    {
+        for (auto entry : std::views::split(*kept_, '\n'))
+        {
+            stream.append(std::string_view(entry.begin(), entry.end()));
+        }
+    }
+    return stream;
+}
+
+} // namespace ytweb
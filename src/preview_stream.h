@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ytweb
+{
+
+// Deliver the entries of a preview (one JSON object per line of `yt-dlp -j`) in batches, as they arrive,
+// so that the first entries of a large playlist are shown at once.
+//
+// Each batch is a JSON object: {"task_id": 1, "first": true, "entries": [...]}, where the entries are projected
+// by `project_media_info()`. Invalid entries are dropped.
+class PreviewStream
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+    using Sender = std::function<void(std::string_view batch)>;
+
+    // A batch is sent when any of the limits is reached. The first entry is always sent alone.
+    struct Limits
+    {
+        std::size_t max_entries{64};
+        std::size_t max_bytes{1024 * 1024};
+        std::chrono::milliseconds max_delay{200};
+    };
+
+    PreviewStream(int task_id, Sender send, Limits limits);
+
+    PreviewStream(int task_id, Sender send) : PreviewStream(task_id, std::move(send), Limits{})
+    {
+    }
+
+    void append(std::string_view entry);
+
+    // Send the remaining entries. An empty batch is sent if nothing has been sent yet.
+    void finish();
+
+    // When the pending entries are due, if any. Past it, they are sent by the next `append()` or `flush_due()`.
+    auto deadline() const -> std::optional<Clock::time_point>;
+
+    // Send the pending entries if they are due, e.g. once yt-dlp has gone quiet.
+    void flush_due();
+
+  private:
+    int task_id_;
+    Sender send_;
+
+    Limits limits_;
+
+    std::string batch_;
+    std::size_t batch_entries_{0};
+    bool first_batch_{true};
+    Clock::time_point last_sent_{Clock::now()};
+
+    void open_batch();
+    void flush();
+};
+
+// Deliver the entries of a preview shared by several tasks to a stream for each of them.
+// A task which subscribes late is sent the earlier entries first, unless there were too many to keep.
+// The whole entries are also kept for the preview cache, until they exceed `max_kept_bytes`.
+class PreviewFanOut
+{
+  public:
+    using StreamFactory = std::function<PreviewStream(int task_id)>;
+
+    PreviewFanOut(StreamFactory make_stream, std::size_t max_kept_bytes);
+
+    void append(std::vector<int> const& subscribers, std::string_view entry);
+
+    void finish(std::vector<int> const& subscribers);
+
+    // The earliest deadline of the streams of the subscribers, see `PreviewStream::deadline()`.
+    auto deadline(std::vector<int> const& subscribers) const -> std::optional<PreviewStream::Clock::time_point>;
+
+    // When to set a timer which calls `on_timer()`, if entries are pending and no timer is set for them yet.
+    auto arm(std::vector<int> const& subscribers) -> std::optional<PreviewStream::Clock::time_point>;
+
+    // Forget the timer of `arm()`, e.g. if it couldn't be set.
+    void disarm()
+    {
+        armed_.reset();
+    }
+
+    // Send the entries which are due.
+    void on_timer(std::vector<int> const& subscribers);
+
+    // All entries, one per line, or `std::nullopt` if they have been dropped for exceeding the limit.
+    // Invalid entries are kept too, and dropped by the streams they are replayed to.
+    std::optional<std::string> const& kept() const
+    {
+        return kept_;
+    }
+
+  private:
+    StreamFactory make_stream_;
+    std::map<int, PreviewStream> streams_;
+
+    std::size_t max_kept_bytes_;
+    std::optional<std::string> kept_{std::in_place};
+
+    std::optional<PreviewStream::Clock::time_point> armed_;
+
+    PreviewStream& stream(int task_id);
+};
+
+} // namespace ytweb
@@ -0,0 +1,156 @@
+#include "progress.h"
+
+#include "json_text.h"
+
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <type_traits>
+
+namespace ytweb
+{
+
+namespace
+{
+
+constexpr char DELIMITER = '|';
+constexpr std::string_view MISSING = "NA";
+
+// Take the field before the next delimiter. Return false if there is no delimiter.
+bool next_field(std::string_view& line, std::string_view& field)
+{
+    auto pos = line.find(DELIMITER);
+    if (pos == std::string_view::npos)
+    {
+        return false;
+    }
+
+    field = line.substr(0, pos);
+    line.remove_prefix(pos + 1);
+    return true;
+}
+
+// Return false if the field is neither a number nor missing.
+template <typename Number>
+bool parse_number(std::string_view field, std::optional<Number>& number)
+{
+    if (field == MISSING || field.empty())
+    {
+        number.reset();
+        return true;
+    }
+
+    Number value{};
+    auto [end, ec] = std::from_chars(field.data(), field.data() + field.size(), value);
+    if (ec != std::errc{} || end != field.data() + field.size())
+    {
+        return false;
+    }
+
+    if constexpr (std::is_floating_point_v<Number>)
+    {
+        if (!std::isfinite(value))
+        {
+            return false;
+        }
+    }
+
+    number = value;
+    return true;
+}
+
+// yt-dlp prints the bytes as floats in some cases, e.g. "1024.0".
+bool parse_bytes(std::string_view field, std::optional<std::uint64_t>& bytes)
+{
+    if (parse_number(field, bytes))
+    {
+        return true;
+    }
+
+    std::optional<double> value;
+    if (!parse_number(field, value) || *value < 0)
+    {
+        return false;
+    }
+    bytes = static_cast<std::uint64_t>(*value);
+    return true;
+}
+
+template <typename Number>
+void append_number(std::string& out, std::optional<Number> const& number)
+{
+    if (!number)
+    {
+        out.append("null");
+        return;
+    }
+
+    std::array<char, 32> buffer{};
+    auto [end, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), *number);
+    out.append(buffer.data(), end);
+}
+
+} // anonymous namespace
+
+std::optional<Progress> decode_progress(std::string_view line)
+{
+    Progress progress;
+    std::string_view field;
+
+    if (!next_field(line, progress.status) || progress.status.empty() || progress.status == MISSING)
+    {
+        return std::nullopt;
+    }
+
+    if (!next_field(line, field) || !parse_bytes(field, progress.downloaded_bytes))
+    {
+        return std::nullopt;
+    }
+    if (!next_field(line, field) || !parse_bytes(field, progress.total_bytes))
+    {
+        return std::nullopt;
+    }
+    if (!next_field(line, field) || !parse_number(field, progress.speed))
+    {
+        return std::nullopt;
+    }
+    if (!next_field(line, field) || !parse_number(field, progress.eta))
+    {
+        return std::nullopt;
+    }
+    if (!next_field(line, field) || !parse_number(field, progress.fragment_index))
+    {
+        return std::nullopt;
+    }
+
+    progress.filename = line; // the rest of the line
+    if (progress.filename == MISSING)
+    {
+        progress.filename = {};
+    }
+
+    return progress;
+}
+
+void encode_progress(Progress const& progress, int task_id, std::string& out)
+{
+    out.append(R"({"task_id":)");
+    append_number(out, std::optional<int>(task_id));
+    out.append(R"(,"status":)");
+    append_json_string(out, progress.status);
+    out.append(R"(,"downloaded_bytes":)");
+    append_number(out, progress.downloaded_bytes);
+    out.append(R"(,"total_bytes":)");
+    append_number(out, progress.total_bytes);
+    out.append(R"(,"speed":)");
+    append_number(out, progress.speed);
+    out.append(R"(,"eta":)");
+    append_number(out, progress.eta);
+    out.append(R"(,"fragment_index":)");
+    append_number(out, progress.fragment_index);
+    out.append(R"(,"filename":)");
+    append_json_string(out, progress.filename);
+    out.push_back('}');
+}
+
+} // namespace ytweb
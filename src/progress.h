@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace ytweb
+{
+
+// The `--progress-template` of downloads: the fields of the progress separated by '|', after a prefix.
+// The filename goes last, as it may contain the delimiter. A missing field is printed as "NA".
+inline constexpr std::string_view PROGRESS_PREFIX = "[Progress]";
+inline constexpr std::string_view PROGRESS_TEMPLATE =
+    "download:[Progress]%(progress.status)s|%(progress.downloaded_bytes)s|"
+    "%(progress.total_bytes,progress.total_bytes_estimate)s|%(progress.speed)s|%(progress.eta)s|"
+    "%(progress.fragment_index)s|%(progress.filename)s";
+
+// A progress decoded from a line printed with `PROGRESS_TEMPLATE`, without the prefix.
+// The strings refer to the line.
+struct Progress
+{
+    std::string_view status;
+    std::optional<std::uint64_t> downloaded_bytes;
+    std::optional<std::uint64_t> total_bytes;
+    std::optional<double> speed; // bytes per second
+    std::optional<std::int64_t> eta; // seconds
+    std::optional<std::uint64_t> fragment_index;
+    std::string_view filename;
+
+    // The last progress of a file, e.g. "finished" or "error".
+    bool terminal() const
+    {
+        return status != "downloading";
+    }
+};
+
+// Return `std::nullopt` if the line is malformed. Never allocates.
+std::optional<Progress> decode_progress(std::string_view line);
+
+// Append the progress as a JSON object for the frontend, with the task id.
+// Never allocates once `out` has enough capacity.
+void encode_progress(Progress const& progress, int task_id, std::string& out);
+
+} // namespace ytweb
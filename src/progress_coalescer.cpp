@@ -0,0 +1,126 @@
+#include "progress_coalescer.h"
+
+namespace ytweb
+{
+
+ProgressCoalescer::ProgressCoalescer(Sender send, std::chrono::milliseconds tick)
+    : send_(std::move(send)),
+      tick_(tick),
+      ticker_([this] { run(); })
+{
+}
+
+ProgressCoalescer::~ProgressCoalescer()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    ticker_.join();
+
+    flush();
+}
+
+void ProgressCoalescer::set_tick(std::chrono::milliseconds tick)
+{
+    std::lock_guard lock(mutex_);
+    tick_ = tick;
+}
+
+void ProgressCoalescer::update(int task_id, std::string_view progress, bool terminal)
+{
+    bool was_empty{};
+    {
+        std::lock_guard lock(mutex_);
+        was_empty = pending_.empty();
+
+        auto& pending = pending_[task_id];
+        if (terminal)
+        {
+            pending.terminal.emplace_back(progress);
+            pending.latest.reset();
+        }
+        else if (pending.latest)
+        {
+            pending.latest->assign(progress); // reuse the buffer
+        }
+        else
+        {
+            pending.latest.emplace(progress);
+        }
+    }
+
+    if (was_empty)
+    {
+        cv_.notify_all();
+    }
+}
+
+void ProgressCoalescer::flush()
+{
+    std::lock_guard send_lock(send_mutex_);
+
+    std::unordered_map<int, Pending> pending;
+    {
+        std::lock_guard lock(mutex_);
+        pending.swap(pending_);
+    }
+
+    if (pending.empty())
+    {
+        return;
+    }
+
+    // The progress objects are valid JSON, so the batch is assembled without parsing them.
+    std::string batch = "[";
+    auto append = [&batch](std::string const& progress) {
+        if (batch.size() > 1)
+        {
+            batch.push_back(',');
+        }
+        batch.append(progress);
+    };
+
+    bool terminal{false};
+    for (auto const& [id, task] : pending)
+    {
+        for (auto const& progress : task.terminal)
+        {
+            append(progress);
+        }
+        if (task.latest)
+        {
+            append(*task.latest);
+        }
+        terminal = terminal || !task.terminal.empty();
+    }
+    batch.push_back(']');
+
+    send_(batch, terminal);
+}
+
+// Sleep until some progress is pending, then flush once per tick.
+void ProgressCoalescer::run()
+{
+    std::unique_lock lock(mutex_);
+    while (true)
+    {
+        cv_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+        if (stopping_)
+        {
+            return;
+        }
+
+        if (cv_.wait_for(lock, tick_, [this] { return stopping_; }))
+        {
+            return;
+        }
+
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
+
+} // namespace ytweb
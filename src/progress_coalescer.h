@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace ytweb
+{
+
+// Coalesce the progress of downloads, which yt-dlp reports for every chunk.
+// Only the latest progress of each task is kept, and all tasks are flushed together on every tick
+// as one batch, a JSON array of the progress objects.
+// Terminal progress (e.g. "finished" or "error") is never overwritten, so it is always delivered.
+class ProgressCoalescer
+{
+  public:
+    // `terminal` tells whether the batch holds terminal progress, which must not be lost further on either.
+    using Sender = std::function<void(std::string_view batch, bool terminal)>;
+
+    static constexpr std::chrono::milliseconds DEFAULT_TICK{100};
+
+    explicit ProgressCoalescer(Sender send, std::chrono::milliseconds tick = DEFAULT_TICK);
+
+    // Flush the remaining progress.
+    ~ProgressCoalescer();
+
+    ProgressCoalescer(ProgressCoalescer const&) = delete;
+    ProgressCoalescer& operator=(ProgressCoalescer const&) = delete;
+    ProgressCoalescer(ProgressCoalescer&&) = delete;
+    ProgressCoalescer& operator=(ProgressCoalescer&&) = delete;
+
+    void set_tick(std::chrono::milliseconds tick);
+
+    // `progress` is a JSON object.
+    void update(int task_id, std::string_view progress, bool terminal = false);
+
+    // Send the pending progress at once, e.g. before reporting the completion of a task.
+    void flush();
+
+  private:
+    struct Pending
+    {
+        std::vector<std::string> terminal;
+        std::optional<std::string> latest; // newer than all terminal progress
+    };
+
+    Sender send_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::chrono::milliseconds tick_;
+    std::unordered_map<int, Pending> pending_;
+    bool stopping_{false};
+
+    // Keep batches in order when flushed by several threads.
+    std::mutex send_mutex_;
+
+    std::thread ticker_;
+
+    void run();
+};
+
+} // namespace ytweb
@@ -1,83 +1,315 @@
 #include "request.h"
 
-#include "boost/process/v2/environment.hpp"
 #include "exception.h"
+#include "executable_cache.h"
 #include "nlohmann/json.hpp"
-
+#include "progress.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
 #include <map>
+#include <optional>
 #include <string_view>
+#include <utility>
 
 namespace ytweb
 {
 
 using Json = nlohmann::json;
 
+namespace
+{
+
+// How the value of a key becomes arguments of yt-dlp.
+enum class Kind : std::uint8_t
+{
+    Flag,     // the option alone, unless the value is `false`
+    Argument, // the option followed by the value, which is a string
+    Multiple, // the option followed by each value, which is a string or an array of strings
+    Choice,   // the option selected by the value, which is a string
+};
+
+// The groups of options in the frontend.
+enum class Group : std::uint8_t
+{
+    Cookies,
+    Network,
+    VideoSelection,
+    Download, // don't change the extracted information
+    Output,
+    Filesystem,
+    PostProcessing, // only for downloads, and don't change the extracted information either
+};
+
+struct Choice
+{
+    std::string_view value;
+    std::string_view option;
+};
+
+struct OptionSpec
+{
+    std::string_view key;
+    Kind kind;
+    Group group;
+    std::string_view option;         // for all but choices
+    std::array<Choice, 2> choices{}; // for choices
+};
+
+constexpr OptionSpec flag(Group group, std::string_view key, std::string_view option)
+{
+    return {.key = key, .kind = Kind::Flag, .group = group, .option = option};
+}
+
+constexpr OptionSpec argument(Group group, std::string_view key, std::string_view option)
+{
+    return {.key = key, .kind = Kind::Argument, .group = group, .option = option};
+}
+
+constexpr OptionSpec multiple(Group group, std::string_view key, std::string_view option)
+{
+    return {.key = key, .kind = Kind::Multiple, .group = group, .option = option};
+}
+
+constexpr OptionSpec choice(Group group, std::string_view key, Choice first, Choice second)
+{
+    return {.key = key, .kind = Kind::Choice, .group = group, .choices = {first, second}};
+}
+
+// Keys of the request and the options of yt-dlp they map to, in the order of the frontend.
+constexpr auto OPTION_TABLE = std::to_array<OptionSpec>({
+    argument(Group::Cookies, "cookies_from_browser", "--cookies-from-browser"),
+    argument(Group::Cookies, "cookies_from_file", "--cookies"),
+
+    argument(Group::Network, "proxy", "--proxy"),
+    argument(Group::Network, "socket_timeout", "--socket-timeout"),
+    argument(Group::Network, "source_address", "--source-address"),
+    choice(Group::Network, "force_ip_protocol", {"ipv4", "--force-ipv4"}, {"ipv6", "--force-ipv6"}),
+    flag(Group::Network, "enable_file_urls", "--enable-file-urls"),
+
+    argument(Group::VideoSelection, "playlist_indices", "--playlist-items"),
+    argument(Group::VideoSelection, "filesize_min", "--min-filesize"),
+    argument(Group::VideoSelection, "filesize_max", "--max-filesize"),
+    argument(Group::VideoSelection, "date", "--date"),
+    argument(Group::VideoSelection, "date_before", "--datebefore"),
+    argument(Group::VideoSelection, "date_after", "--dateafter"),
+    multiple(Group::VideoSelection, "filters", "--match-filters"),
+    multiple(Group::VideoSelection, "stop_filters", "--break-match-filters"),
+    choice(Group::VideoSelection, "is_playlist", {"yes", "--yes-playlist"}, {"no", "--no-playlist"}),
+    argument(Group::VideoSelection, "age_limit", "--age-limit"),
+    argument(Group::VideoSelection, "max_download_number", "--max-downloads"),
+    argument(Group::VideoSelection, "download_archive", "--download-archive"),
+    flag(Group::VideoSelection, "break_on_existing", "--break-on-existing"),
+    flag(Group::VideoSelection, "break_per_input", "--break-per-input"),
+    argument(Group::VideoSelection, "skip_playlist_after_errors", "--skip-playlist-after-errors"),
+
+    argument(Group::Download, "concurrent_fragments", "--concurrent-fragments"),
+    argument(Group::Download, "limit_rate", "--limit-rate"),
+    argument(Group::Download, "throttle_rate", "--throttle-rate"),
+    argument(Group::Download, "retries", "--retries"),
+    argument(Group::Download, "file_access_retries", "--file-access-retries"),
+    argument(Group::Download, "fragment_retries", "--fragment-retries"),
+    multiple(Group::Download, "retry_sleep", "--retry-sleep"),
+    flag(Group::Download, "abort_on_unavailable_fragment", "--abort-on-unavailable-fragment"),
+    flag(Group::Download, "keep_fragments", "--keep-fragments"),
+    argument(Group::Download, "buffer_size", "--buffer-size"),
+    flag(Group::Download, "no_resize_buffer", "--no-resize-buffer"),
+    argument(Group::Download, "http_chunk_size", "--http-chunk-size"),
+    flag(Group::Download, "playlist_random", "--playlist-random"),
+    flag(Group::Download, "lazy_playlist", "--lazy-playlist"),
+    flag(Group::Download, "xattr_set_filesize", "--xattr-set-filesize"),
+    choice(Group::Download, "hls_use_mpegts", {"yes", "--hls-use-mpegts"}, {"no", "--no-hls-use-mpegts"}),
+    multiple(Group::Download, "download_sections", "--download-section"),
+    multiple(Group::Download, "downloader", "--downloader"),
+    multiple(Group::Download, "download_args", "--downloader-args"),
+
+    multiple(Group::Output, "output_path", "-P"),
+    multiple(Group::Output, "output_filename", "-o"),
+    argument(Group::Output, "output_na_placeholder", "--output-na-placeholder"),
+    flag(Group::Output, "restrict_filename", "--restrict-filenames"),
+    flag(Group::Output, "windows_filename", "--windows-filenames"),
+    argument(Group::Output, "trim_filename", "--trim-filename"),
+
+    argument(Group::Filesystem, "batch_file", "--batch-file"),
+    choice(Group::Filesystem, "overwrite", {"never", "--no-overwrites"}, {"always", "--force-overwrites"}),
+    flag(Group::Filesystem, "no_continue", "--no-continue"),
+    flag(Group::Filesystem, "no_part", "--no-part"),
+    flag(Group::Filesystem, "no_mtime", "--no-mtime"),
+    flag(Group::Filesystem, "write_description", "--write-description"),
+    flag(Group::Filesystem, "write_info_json", "--write-info-json"),
+    flag(Group::Filesystem, "no_write_playlist_metafile", "--no-write-playlist-metafiles"),
+    flag(Group::Filesystem, "write_all_info_json", "--no-clean-info-json"),
+    flag(Group::Filesystem, "write_comments", "--write-comments"),
+    argument(Group::Filesystem, "load_info_json", "--load-info-json"),
+    argument(Group::Filesystem, "cache_dir", "--cache-dir"),
+    flag(Group::Filesystem, "no_cache_dir", "--no-cache-dir"),
+    flag(Group::Filesystem, "rm_cache_dir", "--rm-cache-dir"),
+
+    flag(Group::PostProcessing, "audio_only", "--extract-audio"),
+});
+
+// Sorted by key for binary search.
+constexpr auto OPTIONS = [] {
+    auto options = OPTION_TABLE;
+    std::ranges::sort(options, {}, &OptionSpec::key);
+    return options;
+}();
+
+static_assert(
+    std::ranges::adjacent_find(OPTIONS, {}, &OptionSpec::key) == OPTIONS.end(), "Keys of options must be unique"
+);
+
+auto find_option(std::string_view key) -> OptionSpec const*
+{
+    auto it = std::ranges::lower_bound(OPTIONS, key, {}, &OptionSpec::key);
+    return it != OPTIONS.end() && it->key == key ? &*it : nullptr;
+}
+
+// The value of the key, or `std::nullopt` if it is missing.
+auto find_string(Json const& data, std::string_view key) -> std::optional<std::string>
+{
+    auto it = data.find(key);
+    if (it == data.end())
+    {
+        return std::nullopt;
+    }
+    if (!it->is_string())
+    {
+        throw ParseError(std::format("\"{}\" expects a string, but got: {}", key, it->dump()));
+    }
+    return it->get<std::string>();
+}
+
+// The arguments of the output format of downloads.
+constexpr std::size_t DOWNLOAD_OUTPUT_ARGS = 20;
+
+// Resolve a value of "-P" ("[<type>:]<path>") as yt-dlp would, in the same working directory.
+auto resolve_output_path(std::string_view value) -> std::pair<std::string, std::string>
+{
+    namespace fs = std::filesystem;
+
+    // The type is a word, unlike a drive letter. A path without a type is the home path.
+    std::string type = "home:";
+    if (auto colon = value.find(':'); colon != std::string_view::npos && colon > 1 &&
+                                      std::ranges::all_of(value.substr(0, colon), [](unsigned char c) {
+                                          return std::islower(c) != 0 || c == '_';
+                                      }))
+    {
+        type = value.substr(0, colon + 1);
+        value.remove_prefix(colon + 1);
+    }
+
+    fs::path path(value);
+    if (char const* home = std::getenv("HOME"); home != nullptr && value.starts_with('~'))
+    {
+        path = fs::path(home) / fs::path(value.substr(value.starts_with("~/") ? 2 : 1));
+    }
+
+    std::error_code ec;
+    path = fs::absolute(path, ec).lexically_normal();
+    if (!path.has_filename() && path.has_relative_path())
+    {
+        path = path.parent_path(); // without the trailing separator
+    }
+    return {std::move(type), path.string()};
+}
+
+} // anonymous namespace
+
 class Request::Impl
 {
   public:
     Action action{};
+    Priority priority{Priority::Normal};
     std::string yt_dlp_path;
+    std::chrono::nanoseconds resolve_time{};
     std::vector<std::string> args;
+    std::string extraction_key;
+    std::string output_key;
+    bool can_load_info_json{};
+
+    // The options which the backend may serve before launching yt-dlp, empty if not set.
+    std::string url;
+    std::string download_archive;
+    std::string batch_file;
+    bool has_playlist_items{};
+
+    // Replace the value of an argument option, or append it if missing.
+    void set_argument(std::string_view option, std::string_view value);
 
     void parse(std::string_view json);
 
   private:
     Json data_;
 
-    void check_argument_option(std::string_view key, std::string_view option);
-    void check_multiple_argument_option(std::string_view key, std::string_view option);
-    void check_option(std::string_view key, std::string_view option);
-    void map_option(std::string_view key, std::map<std::string, std::string> const& options);
+    // Validate the value against the spec, and append its arguments.
+    void append_option(OptionSpec const& spec, Json const& value);
 
     void set_download_output_format();
-
-    void set_cookies_options();
-    void set_network_options();
-    void set_video_selection_options();
-    void set_download_options();
-    void set_output_options();
-    void set_filesystem_options();
+    void set_output_key();
 };
 
-void Request::Impl::check_argument_option(std::string_view key, std::string_view option)
+void Request::Impl::append_option(OptionSpec const& spec, Json const& value)
 {
-    if (data_.contains(key))
-    {
-        args.emplace_back(option);
-        args.emplace_back(data_[key].get<std::string>());
-    }
-}
+    auto expect_string = [&spec](Json const& value) -> std::string const& {
+        if (!value.is_string())
+        {
+            throw ParseError(std::format("Option \"{}\" expects a string, but got: {}", spec.key, value.dump()));
+        }
+        return value.get_ref<std::string const&>();
+    };
 
-// The value is an array => make multiple argument options.
-void Request::Impl::check_multiple_argument_option(std::string_view key, std::string_view option)
-{
-    if (data_.contains(key))
+    switch (spec.kind)
     {
-        for (auto const& value : data_.at(key))
+    case Kind::Flag:
+        if (value.is_structured())
         {
-            args.emplace_back(option);
-            args.emplace_back(value.get<std::string>());
+            throw ParseError(std::format("Option \"{}\" expects a flag, but got: {}", spec.key, value.dump()));
         }
-    }
-}
+        if (value != false)
+        {
+            args.emplace_back(spec.option);
+        }
+        break;
 
-void Request::Impl::check_option(std::string_view key, std::string_view option)
-{
-    if (data_.contains(key))
-    {
-        args.emplace_back(option);
-    }
-}
+    case Kind::Argument:
+        args.emplace_back(spec.option);
+        args.emplace_back(expect_string(value));
+        break;
 
-void Request::Impl::map_option(std::string_view key, std::map<std::string, std::string> const& options)
-{
-    if (data_.contains(key))
-    {
-        auto value = data_.at(key).get<std::string>();
-        if (options.contains(value))
+    case Kind::Multiple:
+        if (value.is_object())
+        {
+            throw ParseError(std::format("Option \"{}\" expects an array, but got: {}", spec.key, value.dump()));
+        }
+        for (auto const& element : value) // a single string is an array of one
+        {
+            args.emplace_back(spec.option);
+            args.emplace_back(expect_string(element));
+        }
+        break;
+
+    case Kind::Choice: {
+        auto const& selected = expect_string(value);
+        if (selected.empty())
+        {
+            break; // the default of yt-dlp
+        }
+
+        auto it = std::ranges::find(spec.choices, std::string_view(selected), &Choice::value);
+        if (it == spec.choices.end())
         {
-            args.emplace_back(options.at(value));
+            throw ParseError(std::format("Invalid value of option \"{}\": {}", spec.key, selected));
         }
+        args.emplace_back(it->option);
+        break;
+    }
     }
 }
 
@@ -90,6 +322,10 @@ void Request::Impl::set_download_output_format()
     args.emplace_back("-O");
     args.emplace_back("video:[%(extractor)s] %(id)s: %(format_id)q with format %(format)q");
 
+    // The key of the video in a download archive, which is the extractor key rather than the name of the extractor.
+    args.emplace_back("-O");
+    args.emplace_back("video:Archive entry: %(extractor_key)s %(id)s");
+
     args.emplace_back("-O");
     args.emplace_back("before_dl:Start download...");
 
@@ -111,95 +347,10 @@ void Request::Impl::set_download_output_format()
     // Show downloading progress in a new line.
     args.emplace_back("--newline");
 
-    // Show downloading progress as json format.
+    // Show downloading progress in a compact format, which is decoded without parsing JSON.
     // Add a prefix to the progress information to distinguish it from other information.
     args.emplace_back("--progress-template");
-    args.emplace_back("download:[Progress]%(progress)j");
-}
-
-void Request::Impl::set_cookies_options()
-{
-    check_argument_option("cookies_from_browser", "--cookies-from-browser");
-    check_argument_option("cookies_from_file", "--cookies");
-}
-
-void Request::Impl::set_network_options()
-{
-    check_argument_option("proxy", "--proxy");
-    check_argument_option("socket_timeout", "--socket-timeout");
-    check_argument_option("source_address", "--source-address");
-    map_option("force_ip_protocol", {{"ipv4", "--force-ipv4"}, {"ipv6", "--force-ipv6"}});
-    check_option("enable_file_urls", "--enable-file-urls");
-}
-
-void Request::Impl::set_video_selection_options()
-{
-    check_argument_option("playlist_indices", "--playlist-items");
-    check_argument_option("filesize_min", "--min-filesize");
-    check_argument_option("filesize_max", "--max-filesize");
-    check_argument_option("date", "--date");
-    check_argument_option("date_before", "--datebefore");
-    check_argument_option("date_after", "--dateafter");
-    check_multiple_argument_option("filters", "--match-filters");
-    check_multiple_argument_option("stop_filters", "--break-match-filters");
-    map_option("is_playlist", {{"yes", "--yes-playlist"}, {"no", "--no-playlist"}});
-    check_argument_option("age_limit", "--age-limit");
-    check_argument_option("max_download_number", "--max-downloads");
-    check_argument_option("download_archive", "--download-archive");
-    check_option("break_on_existing", "--break-on-existing");
-    check_option("break_per_input", "--break-per-input");
-    check_argument_option("skip_playlist_after_errors", "--skip-playlist-after-errors");
-}
-
-void Request::Impl::set_download_options()
-{
-    check_argument_option("concurrent_fragments", "--concurrent-fragments");
-    check_argument_option("limit_rate", "--limit-rate");
-    check_argument_option("throttle_rate", "--throttle-rate");
-    check_argument_option("retries", "--retries");
-    check_argument_option("file_access_retries", "--file-access-retries");
-    check_argument_option("fragment_retries", "--fragment-retries");
-    check_multiple_argument_option("retry_sleep", "--retry-sleep");
-    check_option("abort_on_unavailable_fragment", "--abort-on-unavailable-fragment");
-    check_option("keep_fragments", "--keep-fragments");
-    check_argument_option("buffer_size", "--buffer-size");
-    check_option("no_resize_buffer", "--no-resize-buffer");
-    check_argument_option("http_chunk_size", "--http-chunk-size");
-    check_option("playlist_random", "--playlist-random");
-    check_option("lazy_playlist", "--lazy-playlist");
-    check_option("xattr_set_filesize", "--xattr-set-filesize");
-    map_option("hls_use_mpegts", {{"yes", "--hls-use-mpegts"}, {"no", "--no-hls-use-mpegts"}});
-    check_multiple_argument_option("download_sections", "--download-section");
-    check_multiple_argument_option("downloader", "--downloader");
-    check_multiple_argument_option("download_args", "--downloader-args");
-}
-
-void Request::Impl::set_output_options()
-{
-    check_multiple_argument_option("output_path", "-P");
-    check_multiple_argument_option("output_filename", "-o");
-    check_argument_option("output_na_placeholder", "--output-na-placeholder");
-    check_option("restrict_filename", "--restrict-filenames");
-    check_option("windows_filename", "--windows-filenames");
-    check_argument_option("trim_filename", "--trim-filename");
-}
-
-void Request::Impl::set_filesystem_options()
-{
-    check_argument_option("batch_file", "--batch-file");
-    map_option("overwrite", {{"never", "--no-overwrites"}, {"always", "--force-overwrites"}});
-    check_option("no_continue", "--no-continue");
-    check_option("no_part", "--no-part");
-    check_option("no_mtime", "--no-mtime");
-    check_option("write_description", "--write-description");
-    check_option("write_info_json", "--write-info-json");
-    check_option("no_write_playlist_metafile", "--no-write-playlist-metafiles");
-    check_option("write_all_info_json", "--no-clean-info-json");
-    check_option("write_comments", "--write-comments");
-    check_argument_option("load_info_json", "--load-info-json");
-    check_argument_option("cache_dir", "--cache-dir");
-    check_option("no_cache_dir", "--no-cache-dir");
-    check_option("rm_cache_dir", "--rm-cache-dir");
+    args.emplace_back(PROGRESS_TEMPLATE);
 }
 
 void Request::Impl::parse(std::string_view json)
@@ -214,36 +365,95 @@ void Request::Impl::parse(std::string_view json)
     }
 
     // If `yt_dlp_path` is not provided, run yt-dlp from `$PATH`
-    yt_dlp_path = data_.value("yt_dlp_path", boost::process::environment::find_executable("yt-dlp").string());
+    if (auto path = find_string(data_, "yt_dlp_path"))
+    {
+        yt_dlp_path = std::move(*path);
+    }
+    else
+    {
+        auto start = std::chrono::steady_clock::now();
+        yt_dlp_path = find_executable_cached("yt-dlp");
+        resolve_time = std::chrono::steady_clock::now() - start;
+    }
 
     // Parse the action.
-    try
+    auto action_str = find_string(data_, "action");
+    if (!action_str)
     {
-        std::string action_str = data_.at("action").get<std::string>();
-        action = (action_str == "preview" ? Action::Preview : Action::Download);
+        throw ParseError("Action is not provided.");
     }
-    catch (Json::out_of_range const& e)
+    action = (*action_str == "preview" ? Action::Preview : Action::Download);
+
+    // Parse the priority in the wait queue. The frontend sends an empty string for the default.
+    auto priority_str = find_string(data_, "priority").value_or("normal");
+    if (priority_str == "high")
     {
-        throw ParseError("Action is not provided.");
+        priority = Priority::High;
+    }
+    else if (priority_str == "low")
+    {
+        priority = Priority::Low;
+    }
+    else if (priority_str == "normal" || priority_str.empty())
+    {
+        priority = Priority::Normal;
+    }
+    else
+    {
+        throw ParseError(std::format("Invalid priority: {}", priority_str));
     }
 
     // Generate arguments for yt-dlp
-    try
+    args.reserve(1 + 2 * data_.size() + DOWNLOAD_OUTPUT_ARGS);
+    auto url_input = find_string(data_, "url_input");
+    if (!url_input)
     {
-        std::string url_input = data_.at("url_input").get<std::string>();
-        args.emplace_back(url_input);
+        throw ParseError("URL input is not provided.");
     }
-    catch (Json::out_of_range const& e)
+    args.emplace_back(std::move(*url_input));
+
+    // Download options (rate limit, retries, downloader...) don't change the extracted information.
+    extraction_key = yt_dlp_path;
+    extraction_key += '\0';
+    extraction_key += args.front();
+
+    // One pass over the keys of the request, which are sorted, so the arguments are in a stable order.
+    for (auto it = data_.begin(); it != data_.end(); ++it)
     {
-        throw ParseError("URL input is not provided.");
+        auto const* spec = find_option(it.key());
+        if (!spec)
+        {
+            continue; // not an option of yt-dlp, e.g. the action
+        }
+        if (spec->group == Group::PostProcessing && action != Action::Download)
+        {
+            continue;
+        }
+
+        auto first = args.size();
+        append_option(*spec, it.value());
+
+        if (spec->group != Group::Download && spec->group != Group::PostProcessing)
+        {
+            for (auto i = first; i < args.size(); ++i)
+            {
+                extraction_key += '\0';
+                extraction_key += args[i];
+            }
+        }
     }
 
-    set_cookies_options();
-    set_network_options();
-    set_video_selection_options();
-    set_download_options();
-    set_output_options();
-    set_filesystem_options();
+    can_load_info_json = !data_.contains("batch_file") && !data_.contains("load_info_json");
+
+    url = args.front();
+    download_archive = data_.value("download_archive", "");
+    batch_file = data_.value("batch_file", "");
+    has_playlist_items = data_.contains("playlist_indices");
+
+    if (action == Request::Action::Download)
+    {
+        set_output_key();
+    }
 
     if (action == Request::Action::Preview)
     {
@@ -252,15 +462,53 @@ void Request::Impl::parse(std::string_view json)
     else
     {
         set_download_output_format();
-
-        // Only download audio.
-        check_option("audio_only", "--extract-audio");
     }
 
     // JSON data is not needed anymore.
     data_.clear();
 }
 
+void Request::Impl::set_output_key()
+{
+    output_key = url;
+    output_key += '\0';
+    output_key += batch_file;
+
+    // A later path of a type replaces the earlier one, and the home path is the working directory by default.
+    std::map<std::string, std::string> paths{resolve_output_path(".")};
+    for (auto const& element : data_.value("output_path", Json::array()))
+    {
+        auto [type, path] = resolve_output_path(element.get_ref<std::string const&>());
+        paths.insert_or_assign(std::move(type), std::move(path));
+    }
+    for (auto const& [type, path] : paths)
+    {
+        output_key += '\0';
+        output_key += type;
+        output_key += path;
+    }
+
+    for (auto const& element : data_.value("output_filename", Json::array()))
+    {
+        output_key += '\0';
+        output_key += element.get_ref<std::string const&>();
+    }
+}
+
+void Request::Impl::set_argument(std::string_view option, std::string_view value)
+{
+    auto it = std::ranges::find(args, option);
+    if (it != args.end() && it + 1 != args.end())
+    {
+        *(it + 1) = value;
+    }
+    else
+    {
+        args.emplace_back(option);
+        args.emplace_back(value);
+    }
+}
+
 /// Implement the `Request` class.
 
 auto Request::action() const -> Action
@@ -268,16 +516,103 @@ auto Request::action() const -> Action
     return impl_->action;
 }
 
+auto Request::priority() const -> Priority
+{
+    return impl_->priority;
+}
+
 auto Request::yt_dlp_path() const -> std::string_view
 {
     return impl_->yt_dlp_path;
 }
 
+auto Request::resolve_time() const -> std::chrono::nanoseconds
+{
+    return impl_->resolve_time;
+}
+
 auto Request::args() const -> std::vector<std::string> const&
 {
     return impl_->args;
 }
 
+auto Request::extraction_key() const -> std::string const&
+{
+    return impl_->extraction_key;
+}
+
+auto Request::output_key() const -> std::string const&
+{
+    return impl_->output_key;
+}
+
+auto Request::can_load_info_json() const -> bool
+{
+    return impl_->can_load_info_json;
+}
+
+void Request::load_info_json(std::string_view path)
+{
+    // The URL is always the first argument.
+    auto& args = impl_->args;
+    args.front() = "--load-info-json";
+    args.emplace(args.begin() + 1, path);
+
+    impl_->can_load_info_json = false;
+}
+
+auto Request::url() const -> std::string const&
+{
+    return impl_->url;
+}
+
+auto Request::download_archive() const -> std::string const&
+{
+    return impl_->download_archive;
+}
+
+auto Request::batch_file() const -> std::string const&
+{
+    return impl_->batch_file;
+}
+
+auto Request::has_playlist_items() const -> bool
+{
+    return impl_->has_playlist_items;
+}
+
+void Request::drop_download_archive()
+{
+    auto& args = impl_->args;
+    if (auto it = std::ranges::find(args, "--download-archive"); it != args.end() && it + 1 != args.end())
+    {
+        args.erase(it, it + 2);
+    }
+    impl_->download_archive.clear();
+}
+
+void Request::set_batch_file(std::string_view path)
+{
+    impl_->set_argument("--batch-file", path);
+    impl_->batch_file = path;
+}
+
+void Request::set_playlist_items(std::string_view items)
+{
+    impl_->set_argument("--playlist-items", items);
+    impl_->has_playlist_items = true;
+}
+
+void Request::continue_partial()
+{
+    auto& args = impl_->args;
+    std::erase(args, "--no-continue");
+    if (std::ranges::find(args, "--continue") == args.end())
+    {
+        args.emplace_back("--continue");
+    }
+}
+
 Request::Request(std::string_view json) : impl_(std::make_unique<Impl>())
 {
     impl_->parse(json);
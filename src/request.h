@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -18,10 +19,62 @@ class Request
         Download,
     };
 
+    enum class Priority : std::uint8_t
+    {
+        High,
+        Normal,
+        Low,
+    };
+
     auto action() const -> Action;
+    auto priority() const -> Priority;
     auto yt_dlp_path() const -> std::string_view;
+
+    // The time spent looking up yt-dlp in `PATH`, zero if the request provides the path.
+    auto resolve_time() const -> std::chrono::nanoseconds;
+
     auto args() const -> std::vector<std::string> const&;
 
+    // Identify the media the request refers to, regardless of the action.
+    // It consists of the yt-dlp path, the URL and the options that change the extracted information,
+    // e.g. cookies, network, video selection and output options.
+    auto extraction_key() const -> std::string const&;
+
+    // Identify what a download writes: the URL input or the batch file, and the output paths and templates,
+    // with the paths resolved in the working directory. Downloads with the same key write the same files,
+    // whatever their other options. Empty for previews.
+    auto output_key() const -> std::string const&;
+
+    // Whether the extracted information can be loaded from a file instead of the URL.
+    // It is not the case if the request reads a batch file or already loads an info file.
+    auto can_load_info_json() const -> bool;
+
+    // Load the extracted information from the file instead of extracting it from the URL.
+    void load_info_json(std::string_view path);
+
+    // The URL input, empty if the request reads a batch file.
+    auto url() const -> std::string const&;
+
+    // The download archive and the batch file, empty if not set.
+    auto download_archive() const -> std::string const&;
+    auto batch_file() const -> std::string const&;
+
+    // Whether the request selects the items of a playlist.
+    auto has_playlist_items() const -> bool;
+
+    // Don't pass the download archive to yt-dlp, as the backend has already skipped the archived videos,
+    // and records the downloaded ones itself.
+    void drop_download_archive();
+
+    // Read the URLs from another batch file, e.g. without the archived ones.
+    void set_batch_file(std::string_view path);
+
+    // Only download the items of a playlist at the indices, e.g. "1,3,4".
+    void set_playlist_items(std::string_view items);
+
+    // Continue the partially downloaded files of an interrupted download, even if the request disabled it.
+    void continue_partial();
+
     explicit Request(std::string_view json);
     ~Request();
 
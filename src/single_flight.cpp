@@ -0,0 +1,96 @@
+#include "single_flight.h"
+
+#include <algorithm>
+
+namespace ytweb
+{
+
+auto SingleFlight::join(std::string_view key, TaskId subscriber) -> TaskId
+{
+    std::lock_guard lock(mutex_);
+
+    auto it = by_key_.find(key);
+    if (it == by_key_.end())
+    {
+        auto flight = std::make_shared<Flight>(Flight{.key = std::string(key), .task = subscriber, .subscribers = {}});
+        it = by_key_.emplace(flight->key, flight).first;
+        by_task_.emplace(subscriber, flight);
+    }
+
+    auto const& flight = it->second;
+    flight->subscribers.push_back(subscriber);
+    by_subscriber_.emplace(subscriber, flight);
+    return flight->task;
+}
+
+auto SingleFlight::subscribers(TaskId task) const -> std::vector<TaskId>
+{
+    std::lock_guard lock(mutex_);
+    auto it = by_task_.find(task);
+    return it != by_task_.end() ? it->second->subscribers : std::vector<TaskId>{};
+}
+
+auto SingleFlight::task_of(TaskId subscriber) const -> std::optional<TaskId>
+{
+    std::lock_guard lock(mutex_);
+    auto it = by_subscriber_.find(subscriber);
+    return it != by_subscriber_.end() ? std::optional(it->second->task) : std::nullopt;
+}
+
+auto SingleFlight::leave(TaskId subscriber) -> std::optional<Departure>
+{
+    std::lock_guard lock(mutex_);
+
+    auto node = by_subscriber_.extract(subscriber);
+    if (node.empty())
+    {
+        return std::nullopt;
+    }
+
+    auto& flight = *node.mapped();
+    std::erase(flight.subscribers, subscriber);
+
+    bool const last = flight.subscribers.empty();
+    if (last)
+    {
+        erase(flight);
+    }
+    return Departure{.task = flight.task, .last = last};
+}
+
+auto SingleFlight::land(TaskId task) -> std::vector<TaskId>
+{
+    std::lock_guard lock(mutex_);
+
+    auto it = by_task_.find(task);
+    if (it == by_task_.end())
+    {
+        return {};
+    }
+
+    auto flight = it->second;
+    erase(*flight);
+    return std::move(flight->subscribers);
+}
+
+std::size_t SingleFlight::size() const
+{
+    std::lock_guard lock(mutex_);
+    return by_key_.size();
+}
+
+void SingleFlight::erase(Flight const& flight)
+{
+    for (auto subscriber : flight.subscribers)
+    {
+        by_subscriber_.erase(subscriber);
+    }
+    by_task_.erase(flight.task);
+
+    if (auto it = by_key_.find(flight.key); it != by_key_.end() && it->second.get() == &flight)
+    {
+        by_key_.erase(it);
+    }
+}
+
+} // namespace ytweb
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ytweb
+{
+
+// Identical requests in flight share one task, e.g. a double click or several clients previewing the same media.
+//
+// The first request of a key launches the task under its own id, and later ones subscribe to it under ids of their
+// own. Everything the task reports is fanned out to all subscribers. A subscriber may leave at any time, and the task
+// is abandoned once the last one has left.
+class SingleFlight
+{
+  public:
+    using TaskId = int;
+
+    struct Departure
+    {
+        TaskId task;
+        bool last; // no one is subscribed anymore, so the task should be killed
+    };
+
+    // Subscribe to the task in flight for `key`, and return its id.
+    // If there is none, a flight is started with `subscriber` as the id of its task, which the caller then launches.
+    TaskId join(std::string_view key, TaskId subscriber);
+
+    // The ids subscribed to the task, to fan out what it reports.
+    // Empty once the flight has landed or been abandoned.
+    std::vector<TaskId> subscribers(TaskId task) const;
+
+    // The task shared by the subscriber, or `std::nullopt` if it is not in flight.
+    std::optional<TaskId> task_of(TaskId subscriber) const;
+
+    // Unsubscribe, or return `std::nullopt` if not in flight.
+    std::optional<Departure> leave(TaskId subscriber);
+
+    // End the flight once its task is finished, and return the subscribers left.
+    // Later requests of the same key start a new flight.
+    std::vector<TaskId> land(TaskId task);
+
+    // The number of flights.
+    std::size_t size() const;
+
+  private:
+    struct Flight
+    {
+        std::string key;
+        TaskId task;
+        std::vector<TaskId> subscribers; // in the order they joined
+    };
+
+    using Handle = std::shared_ptr<Flight>;
+
+    struct KeyHash
+    {
+        using is_transparent = void;
+
+        std::size_t operator()(std::string_view key) const
+        {
+            return std::hash<std::string_view>{}(key);
+        }
+    };
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Handle, KeyHash, std::equal_to<>> by_key_;
+    std::unordered_map<TaskId, Handle> by_task_;
+    std::unordered_map<TaskId, Handle> by_subscriber_;
+
+    // Remove the flight from all indexes. Called with the lock held.
+    void erase(Flight const& flight);
+};
+
+} // namespace ytweb
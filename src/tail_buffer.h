@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+
+namespace ytweb
+{
+
+// Keep the last lines of a stream, up to a total size. The oldest lines are dropped first.
+class TailBuffer
+{
+  public:
+    explicit TailBuffer(std::size_t max_bytes) : max_bytes_(max_bytes)
+    {
+    }
+
+    // A line longer than the limit keeps only its end.
+    void append(std::string_view line)
+    {
+        if (line.size() > max_bytes_)
+        {
+            line.remove_prefix(line.size() - max_bytes_);
+        }
+
+        lines_.emplace_back(line);
+        bytes_ += line.size();
+
+        while (bytes_ > max_bytes_)
+        {
+            bytes_ -= lines_.front().size();
+            lines_.pop_front();
+            ++dropped_;
+        }
+    }
+
+    // The lines joined by '\n'.
+    std::string str() const
+    {
+        std::string str;
+        for (auto const& line : lines_)
+        {
+            if (!str.empty())
+            {
+                str.push_back('\n');
+            }
+            str.append(line);
+        }
+        return str;
+    }
+
+    bool empty() const
+    {
+        return lines_.empty();
+    }
+
+    // The number of lines dropped so far.
+    std::size_t dropped() const
+    {
+        return dropped_;
+    }
+
+  private:
+    std::size_t max_bytes_;
+    std::size_t bytes_{0};
+    std::size_t dropped_{0};
+    std::deque<std::string> lines_;
+};
+
+} // namespace ytweb
@@ -0,0 +1,471 @@
+#include "task_journal.h"
+
+#include "exception.h"
+#include "json_text.h"
+#include "nlohmann/json.hpp"
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+
+#ifdef _WIN32
+#    include <fcntl.h>
+#    include <io.h>
+#else
+#    include <fcntl.h>
+#    include <unistd.h>
+#endif
+
+namespace ytweb
+{
+
+namespace fs = std::filesystem;
+
+using Json = nlohmann::json;
+
+namespace
+{
+
+int open_append(fs::path const& path)
+{
+#ifdef _WIN32
+    return ::_wopen(path.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    return ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+#endif
+}
+
+void close_file(int fd)
+{
+#ifdef _WIN32
+    ::_close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+bool write_all(int fd, std::string_view data)
+{
+    while (!data.empty())
+    {
+#ifdef _WIN32
+        auto written = ::_write(fd, data.data(), static_cast<unsigned>(data.size()));
+#else
+        auto written = ::write(fd, data.data(), data.size());
+#endif
+        if (written < 0)
+        {
+            return false;
+        }
+        data.remove_prefix(static_cast<std::size_t>(written));
+    }
+    return true;
+}
+
+bool sync_file(int fd)
+{
+#ifdef _WIN32
+    return ::_commit(fd) == 0;
+#else
+    return ::fsync(fd) == 0;
+#endif
+}
+
+// Make a rename in the directory durable.
+void sync_directory([[maybe_unused]] fs::path const& directory)
+{
+#ifndef _WIN32
+    int fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        ::fsync(fd);
+        ::close(fd);
+    }
+#endif
+}
+
+void append_record(std::string& out, TaskJournal::Key key, std::string_view event, std::string_view fields)
+{
+    std::format_to(std::back_inserter(out), R"({{"run":{},"id":{},"event":"{}")", key.run, key.id, event);
+    out.append(fields);
+    out.append("}\n");
+}
+
+std::string enqueued_fields(std::string_view request, std::optional<TaskJournal::Key> resumes)
+{
+    std::string fields = R"(,"request":)";
+    append_json_string(fields, request);
+    if (resumes)
+    {
+        std::format_to(std::back_inserter(fields), R"(,"resumes":[{},{}])", resumes->run, resumes->id);
+    }
+    return fields;
+}
+
+std::string checkpoint_fields(TaskJournal::Checkpoint const& checkpoint)
+{
+    auto fields = std::format(R"(,"downloaded_bytes":{})", checkpoint.downloaded_bytes);
+    if (checkpoint.total_bytes)
+    {
+        std::format_to(std::back_inserter(fields), R"(,"total_bytes":{})", *checkpoint.total_bytes);
+    }
+    fields.append(R"(,"filename":)");
+    append_json_string(fields, checkpoint.filename);
+    return fields;
+}
+
+} // anonymous namespace
+
+TaskJournal::TaskJournal(Options options) : options_(std::move(options))
+{
+    std::error_code ec;
+    if (options_.path.has_parent_path())
+    {
+        fs::create_directories(options_.path.parent_path(), ec);
+    }
+
+    replay();
+
+    {
+        std::lock_guard lock(sync_mutex_);
+        if (!compact(snapshot()) && fd_ < 0)
+        {
+            fd_ = open_append(options_.path);
+        }
+    }
+    if (fd_ < 0)
+    {
+        throw PathError("Can't open the task journal: {}", options_.path.string());
+    }
+
+    syncer_ = std::thread([this] { run_syncer(); });
+}
+
+TaskJournal::~TaskJournal()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    syncer_.join();
+
+    // Keeps the last checkpoints, which may not have been recorded.
+    std::string records;
+    std::string pending;
+    {
+        std::lock_guard lock(mutex_);
+        records = snapshot();
+        pending.swap(pending_);
+    }
+    if (!compact(records) && fd_ >= 0 && write_all(fd_, pending))
+    {
+        sync_file(fd_);
+    }
+    if (fd_ >= 0)
+    {
+        close_file(fd_);
+    }
+}
+
+void TaskJournal::replay()
+{
+    std::ifstream stream(options_.path, std::ios::binary);
+
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        auto record = Json::parse(line, nullptr, false);
+        if (!record.is_object() || !record.contains("run") || !record.contains("id") || !record.contains("event"))
+        {
+            ++skipped_;
+            continue;
+        }
+
+        try
+        {
+            Key key{.run = record["run"].get<std::uint64_t>(), .id = record["id"].get<TaskId>()};
+            auto event = record["event"].get<std::string>();
+            run_ = std::max(run_, key.run + 1);
+
+            if (event == "enqueued")
+            {
+                if (auto resumes = record.find("resumes"); resumes != record.end())
+                {
+                    tasks_.erase({.run = resumes->at(0).get<std::uint64_t>(), .id = resumes->at(1).get<TaskId>()});
+                }
+                auto request = record["request"].get<std::string>();
+                tasks_.insert_or_assign(key, Task{.request = std::move(request), .order = next_order_++});
+            }
+            else if (auto it = tasks_.find(key); it == tasks_.end())
+            {
+                // The task has been finished or taken over.
+            }
+            else if (event == "started")
+            {
+                it->second.started = true;
+            }
+            else if (event == "checkpoint")
+            {
+                it->second.checkpoint = Checkpoint{
+                    .downloaded_bytes = record["downloaded_bytes"].get<std::uint64_t>(),
+                    .total_bytes = record.contains("total_bytes")
+                                       ? std::optional(record["total_bytes"].get<std::uint64_t>())
+                                       : std::nullopt,
+                    .filename = record.value("filename", ""),
+                };
+            }
+            else
+            {
+                tasks_.erase(it); // completed, interrupted or failed
+            }
+        }
+        catch (Json::exception const& /* e */)
+        {
+            ++skipped_;
+        }
+    }
+}
+
+auto TaskJournal::unfinished() const -> std::vector<Unfinished>
+{
+    std::vector<std::pair<std::uint64_t, Unfinished>> ordered;
+    {
+        std::lock_guard lock(mutex_);
+        for (auto const& [key, task] : tasks_)
+        {
+            if (key.run < run_)
+            {
+                ordered.emplace_back(task.order, Unfinished{key, task.request, task.started, task.checkpoint});
+            }
+        }
+    }
+    std::ranges::sort(ordered, {}, &std::pair<std::uint64_t, Unfinished>::first);
+
+    std::vector<Unfinished> unfinished;
+    unfinished.reserve(ordered.size());
+    for (auto& [order, task] : ordered)
+    {
+        unfinished.push_back(std::move(task));
+    }
+    return unfinished;
+}
+
+void TaskJournal::enqueued(TaskId id, std::string_view request, std::optional<Key> resumes)
+{
+    {
+        std::lock_guard lock(mutex_);
+        if (closed_)
+        {
+            return;
+        }
+        if (resumes)
+        {
+            tasks_.erase(*resumes);
+        }
+        tasks_.insert_or_assign({.run = run_, .id = id}, Task{.request = std::string(request), .order = next_order_++});
+        append(id, "enqueued", enqueued_fields(request, resumes));
+    }
+    cv_.notify_one();
+}
+
+void TaskJournal::started(TaskId id)
+{
+    std::lock_guard lock(mutex_);
+    if (auto it = tasks_.find({.run = run_, .id = id}); !closed_ && it != tasks_.end())
+    {
+        it->second.started = true;
+        append(id, "started");
+    }
+}
+
+void TaskJournal::checkpoint(
+    TaskId id, std::uint64_t downloaded_bytes, std::optional<std::uint64_t> total_bytes, std::string_view filename
+)
+{
+    std::lock_guard lock(mutex_);
+
+    auto it = tasks_.find({.run = run_, .id = id});
+    if (closed_ || it == tasks_.end())
+    {
+        return;
+    }
+
+    // Updated in place, which reuses the filename of the last checkpoint.
+    auto& task = it->second;
+    if (!task.checkpoint)
+    {
+        task.checkpoint.emplace();
+    }
+    task.checkpoint->downloaded_bytes = downloaded_bytes;
+    task.checkpoint->total_bytes = total_bytes;
+    task.checkpoint->filename = filename;
+
+    auto now = Clock::now();
+    if (now - task.checkpointed >= options_.checkpoint_interval)
+    {
+        append(id, "checkpoint", checkpoint_fields(*task.checkpoint));
+        task.checkpointed = now;
+    }
+}
+
+void TaskJournal::completed(TaskId id)
+{
+    finish(id, "completed");
+}
+
+void TaskJournal::interrupted(TaskId id)
+{
+    finish(id, "interrupted");
+}
+
+void TaskJournal::failed(TaskId id)
+{
+    finish(id, "failed");
+}
+
+void TaskJournal::finish(TaskId id, std::string_view event)
+{
+    {
+        std::lock_guard lock(mutex_);
+        if (closed_ || tasks_.erase({.run = run_, .id = id}) == 0)
+        {
+            return; // not journaled, e.g. a preview
+        }
+        append(id, event);
+    }
+    cv_.notify_one();
+}
+
+void TaskJournal::append(TaskId id, std::string_view event, std::string_view fields)
+{
+    append_record(pending_, {.run = run_, .id = id}, event, fields);
+    ++records_;
+}
+
+auto TaskJournal::snapshot() const -> std::string
+{
+    std::vector<std::pair<Key, Task const*>> tasks;
+    tasks.reserve(tasks_.size());
+    for (auto const& [key, task] : tasks_)
+    {
+        tasks.emplace_back(key, &task);
+    }
+    std::ranges::sort(tasks, {}, [](auto const& task) { return task.second->order; });
+
+    std::string records;
+    for (auto const& [key, task] : tasks)
+    {
+        append_record(records, key, "enqueued", enqueued_fields(task->request, std::nullopt));
+        if (task->started)
+        {
+            append_record(records, key, "started", {});
+        }
+        if (task->checkpoint)
+        {
+            append_record(records, key, "checkpoint", checkpoint_fields(*task->checkpoint));
+        }
+    }
+    return records;
+}
+
+bool TaskJournal::compact(std::string const& records)
+{
+    // Written aside and renamed over the journal, so that a crash leaves either the old or the new one.
+    auto compacted = fs::path(options_.path).concat(".compact");
+
+    std::error_code ec;
+    fs::remove(compacted, ec); // left by a crash
+
+    int fd = open_append(compacted);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    bool const written = write_all(fd, records) && sync_file(fd);
+    close_file(fd);
+
+    if (!written)
+    {
+        fs::remove(compacted, ec);
+        return false;
+    }
+
+    if (fd_ >= 0)
+    {
+        close_file(fd_);
+    }
+    fs::rename(compacted, options_.path, ec);
+    bool const renamed = !ec;
+    if (renamed)
+    {
+        sync_directory(options_.path.parent_path());
+    }
+    else
+    {
+        fs::remove(compacted, ec);
+    }
+
+    fd_ = open_append(options_.path);
+    return renamed && fd_ >= 0;
+}
+
+void TaskJournal::sync()
+{
+    std::lock_guard sync_lock(sync_mutex_);
+
+    std::string records;
+    std::string compacted;
+    bool due{};
+    {
+        std::lock_guard lock(mutex_);
+        records.swap(pending_);
+        due = records_ >= options_.compact_after;
+        if (due)
+        {
+            // The snapshot covers the pending records.
+            compacted = snapshot();
+            records_ = 0;
+        }
+    }
+
+    // If the compaction fails, the journal is still whole with the pending records, and it's retried after
+    // as many records again.
+    if (due && compact(compacted))
+    {
+        return;
+    }
+    if (!records.empty() && fd_ >= 0 && write_all(fd_, records))
+    {
+        sync_file(fd_);
+    }
+}
+
+void TaskJournal::close()
+{
+    {
+        std::lock_guard lock(mutex_);
+        closed_ = true;
+    }
+    sync();
+}
+
+void TaskJournal::run_syncer()
+{
+    std::unique_lock lock(mutex_);
+    while (!stopping_)
+    {
+        cv_.wait_for(lock, options_.sync_interval);
+        if (pending_.empty())
+        {
+            continue;
+        }
+
+        lock.unlock();
+        sync();
+        lock.lock();
+    }
+}
+
+} // namespace ytweb
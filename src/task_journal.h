@@ -0,0 +1,160 @@
+#pragma once
+
+#include <chrono>
+#include <compare>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace ytweb
+{
+
+// An append-only journal of the lifecycle of tasks, which survives a crash of the app or a reboot of the host.
+//
+// Each record is a line of JSON: {"run": 1, "id": 3, "event": "enqueued", ...}, where the run counts the starts of
+// the app, as task ids restart from zero. Records are buffered and written by a background thread, which syncs
+// them to the disk in batches, at most one interval after they are made.
+//
+// The journal is replayed when opened, and the tasks left unfinished by previous runs can be taken over by new ones.
+// It is compacted at the start and after every `compact_after` records, keeping only the unfinished tasks,
+// so that replaying stays fast however many tasks have finished.
+class TaskJournal
+{
+  public:
+    using TaskId = int;
+
+    struct Options
+    {
+        std::filesystem::path path;
+        std::chrono::milliseconds sync_interval{200};
+        std::chrono::milliseconds checkpoint_interval{5000}; // per task
+        std::size_t compact_after{1000};
+    };
+
+    // A task of any run.
+    struct Key
+    {
+        std::uint64_t run;
+        TaskId id;
+
+        auto operator<=>(Key const&) const = default;
+    };
+
+    // How far a download had got.
+    struct Checkpoint
+    {
+        std::uint64_t downloaded_bytes{};
+        std::optional<std::uint64_t> total_bytes;
+        std::string filename;
+    };
+
+    struct Unfinished
+    {
+        Key key;
+        std::string request; // the JSON of the request
+        bool started{false};
+        std::optional<Checkpoint> checkpoint;
+    };
+
+    // Replay and compact the journal, and start a new run.
+    // Throw `PathError` if the journal can't be opened.
+    explicit TaskJournal(Options options);
+
+    // Compact the journal for the last time.
+    ~TaskJournal();
+
+    TaskJournal(TaskJournal const&) = delete;
+    TaskJournal& operator=(TaskJournal const&) = delete;
+    TaskJournal(TaskJournal&&) = delete;
+    TaskJournal& operator=(TaskJournal&&) = delete;
+
+    auto run() const -> std::uint64_t
+    {
+        return run_;
+    }
+
+    // The number of invalid records skipped by the replay, e.g. a line torn by a crash.
+    auto skipped() const -> std::size_t
+    {
+        return skipped_;
+    }
+
+    // The tasks of previous runs which are not finished nor taken over yet, in the order they were enqueued.
+    std::vector<Unfinished> unfinished() const;
+
+    // `resumes` is an unfinished task of a previous run, which is finished by the new one.
+    void enqueued(TaskId id, std::string_view request, std::optional<Key> resumes = std::nullopt);
+    void started(TaskId id);
+
+    // Only recorded once per `checkpoint_interval`, as progress is reported for every chunk.
+    void checkpoint(
+        TaskId id, std::uint64_t downloaded_bytes, std::optional<std::uint64_t> total_bytes, std::string_view filename
+    );
+
+    void completed(TaskId id);
+    void interrupted(TaskId id);
+    void failed(TaskId id); // the process could not be launched, or the job of the helpers failed
+
+    // Write and sync the pending records at once, and compact the journal if due.
+    void sync();
+
+    // Stop recording, so that the tasks killed as the app exits are taken over by the next run.
+    void close();
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Task
+    {
+        std::string request;
+        std::uint64_t order; // keeps the order of enqueueing through compaction
+        bool started{false};
+        std::optional<Checkpoint> checkpoint;
+        Clock::time_point checkpointed{}; // when the checkpoint was last recorded
+    };
+
+    Options options_;
+    std::uint64_t run_{0};
+    std::size_t skipped_{0};
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::map<Key, Task> tasks_; // unfinished
+    std::uint64_t next_order_{0};
+    std::string pending_;
+    std::size_t records_{0}; // since the last compaction
+    bool stopping_{false};
+    bool closed_{false};
+
+    // Only touched by the syncing thread, or before it is started.
+    int fd_{-1};
+    std::mutex sync_mutex_;
+
+    std::thread syncer_;
+
+    void replay();
+
+    // Replace the journal with the records of the unfinished tasks. Called with the sync lock held.
+    // On failure, the journal is left as it was and open for appending if possible.
+    bool compact(std::string const& records);
+
+    // Append a record of the current run. Called with the lock held.
+    void append(TaskId id, std::string_view event, std::string_view fields = {});
+
+    void finish(TaskId id, std::string_view event);
+
+    // The records of the unfinished tasks. Called with the lock held.
+    std::string snapshot() const;
+
+    void run_syncer();
+};
+
+} // namespace ytweb
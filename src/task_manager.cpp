@@ -1,50 +1,574 @@
 #include "task_manager.h"
 
+#include <algorithm>
+#include <exception>
+#include <thread>
+
 namespace ytweb
 {
 
+using Stream = AsyncProcess::Stream;
+
+TaskManager::TaskManager() : TaskManager(std::max(std::thread::hardware_concurrency(), 1U))
+{
+}
+
+TaskManager::TaskManager(std::size_t threads) : pool_(threads)
+{
+}
+
+TaskManager::~TaskManager()
+{
+    std::vector<Handle> queued;
+    {
+        std::lock_guard lock(scheduler_mutex_);
+        for (auto& queue : queues_)
+        {
+            queued.insert(queued.end(), queue.begin(), queue.end());
+            queue.clear();
+        }
+    }
+    for (auto const& task : queued)
+    {
+        remove(task);
+    }
+
+    tasks_.for_each([](TaskId /* id */, Handle const& task) {
+        std::lock_guard lock(task->mutex);
+        task->interrupted = true;
+        if (task->runner)
+        {
+            task->runner.visit([](auto& runner) { runner.interrupt(); });
+        }
+    });
+
+    if (workers_)
+    {
+        workers_->shutdown();
+    }
+
+    // The pool runs until every process has been reaped.
+    pool_.join();
+}
+
+void TaskManager::set_limits(Limits limits)
+{
+    {
+        std::lock_guard lock(scheduler_mutex_);
+        limits_ = limits;
+    }
+    schedule();
+}
+
+void TaskManager::set_escalation(AsyncProcess::Escalation escalation)
+{
+    std::lock_guard lock(scheduler_mutex_);
+    escalation_ = escalation;
+}
+
+void TaskManager::set_workers(WorkerPool::Options options)
+{
+    auto workers = std::make_unique<WorkerPool>(pool_.get_executor(), std::move(options));
+
+    std::lock_guard lock(scheduler_mutex_);
+    if (!workers_)
+    {
+        workers_ = std::move(workers);
+    }
+}
+
+void TaskManager::set_on_state_change(CallbackOnStateChange on_state_change)
+{
+    on_state_change_ = std::move(on_state_change);
+}
+
+void TaskManager::set_on_stderr(CallbackOnStderr on_stderr)
+{
+    on_stderr_ = std::move(on_stderr);
+}
+
+void TaskManager::set_on_cancelled(CallbackOnCancelled on_cancelled)
+{
+    on_cancelled_ = std::move(on_cancelled);
+}
+
+void TaskManager::set_on_timings(CallbackOnTimings on_timings)
+{
+    on_timings_ = std::move(on_timings);
+}
+
 auto TaskManager::launch(
     std::string_view command,
     std::vector<std::string> const& args,
     CallbackOnLinebreak on_linebreak,
-    CallbackOnEof on_eof
+    CallbackOnEof on_eof,
+    TaskType type,
+    Priority priority
 ) -> TaskId
 {
-    TaskId task_id = next_task_id_++;
+    auto id = reserve_id();
+    launch(id, command, args, std::move(on_linebreak), std::move(on_eof), type, priority);
+    return id;
+}
+
+void TaskManager::launch(
+    TaskId id,
+    std::string_view command,
+    std::vector<std::string> const& args,
+    CallbackOnLinebreak on_linebreak,
+    CallbackOnEof on_eof,
+    TaskType type,
+    Priority priority
+)
+{
+    auto task = std::make_shared<Task>();
+    task->id = id;
+    task->type = type;
+    task->command = command;
+    task->args = args;
+    task->on_linebreak = std::move(on_linebreak);
+    task->on_eof = std::move(on_eof);
+    task->timings.type = type;
+    task->timings.queued = Timings::Clock::now();
+
+    tasks_.insert(task->id, task);
+
+    // Before the task can be scheduled, by this thread or by a task finishing, so it is never reported running first.
+    notify(task->id, TaskState::Queued);
+    {
+        std::lock_guard lock(scheduler_mutex_);
+        queues_.at(static_cast<std::size_t>(priority)).push_back(task);
+    }
+
+    schedule();
+}
+
+std::size_t& TaskManager::running_count(TaskType type)
+{
+    return type == TaskType::Preview ? running_previews_ : running_downloads_;
+}
+
+bool TaskManager::has_capacity(TaskType type) const
+{
+    if (running_previews_ + running_downloads_ >= limits_.total)
+    {
+        return false;
+    }
+    return type == TaskType::Preview ? running_previews_ < limits_.preview : running_downloads_ < limits_.download;
+}
+
+void TaskManager::schedule()
+{
+    std::vector<Handle> ready;
+
+    {
+        std::lock_guard lock(scheduler_mutex_);
+
+        for (auto& queue : queues_)
+        {
+            // A task whose type is at its limit doesn't block tasks of the other type behind it.
+            for (auto it = queue.begin(); it != queue.end();)
+            {
+                auto const& task = *it;
+                if (!has_capacity(task->type))
+                {
+                    ++it;
+                    continue;
+                }
+
+                task->state = TaskState::Running;
+                ++running_count(task->type);
+
+                ready.push_back(task);
+                it = queue.erase(it);
+            }
+        }
+    }
+
+    // Launch outside the lock, as spawning a process is slow.
+    for (auto const& task : ready)
+    {
+        start(task);
+    }
+}
+
+void TaskManager::start(Handle const& task)
+{
+    auto task_id = task->id;
+    {
+        std::lock_guard lock(task->mutex);
+        task->timings.started = Timings::Clock::now();
+    }
+
+    WorkerPool* workers{};
+    AsyncProcess::Escalation escalation;
+    {
+        std::lock_guard lock(scheduler_mutex_);
+        workers = workers_ && workers_->serves(task->command) ? workers_.get() : nullptr;
+        escalation = escalation_;
+    }
+
+    auto on_linebreak = [this, task, on_stdout = std::move(task->on_linebreak)](Stream stream, std::string_view line) {
+        if (stream == Stream::Stdout)
+        {
+            on_stdout(task->id, line);
+            return;
+        }
+
+        {
+            std::lock_guard lock(task->mutex);
+            task->stderr_tail.append(line);
+        }
+        if (on_stderr_)
+        {
+            on_stderr_(task->id, line);
+        }
+    };
+    auto on_eof = [task_id, on_eof = std::move(task->on_eof)]() { on_eof(task_id); };
+    auto on_exit = [this, task]() { finish(task); };
+
+    Runner runner;
+    try
+    {
+        if (workers)
+        {
+            // Already started, as the helper runs before the job, so the job may end before `run()` returns.
+            // It is reported running first, and stored before it can finish.
+            notify(task_id, TaskState::Running);
 
-    auto task = std::make_unique<AsyncProcess>(
-        command, args,
-        [task_id, on_linebreak = std::move(on_linebreak)](std::string_view line) { on_linebreak(task_id, line); },
-        [task_id, on_eof = std::move(on_eof), this]() { on_eof(task_id); }
-    );
-    tasks_.emplace(task_id, std::move(task));
+            std::lock_guard lock(task->mutex);
+            runner.job = workers->run(task->args, std::move(on_linebreak), std::move(on_eof), std::move(on_exit));
+            task->runner.job = runner.job;
+        }
+        else
+        {
+            runner.process = std::make_shared<AsyncProcess>(
+                pool_.get_executor(), task->command, task->args, std::move(on_linebreak), std::move(on_eof),
+                std::move(on_exit)
+            );
+        }
+    }
+    catch (std::exception const& /* e */)
+    {
+        {
+            std::lock_guard lock(scheduler_mutex_);
+            task->state = TaskState::Failed;
+        }
+        notify(task_id, TaskState::Failed);
+        finish(task);
+        return;
+    }
 
-    return task_id;
+    task->command.clear();
+    task->args.clear();
+
+    runner.visit([escalation](auto& runner) { runner.set_escalation(escalation); });
+
+    bool interrupted{};
+    {
+        std::lock_guard lock(task->mutex);
+        if (runner.process)
+        {
+            task->runner.process = runner.process;
+        }
+        interrupted = task->interrupted;
+    }
+
+    if (interrupted)
+    {
+        runner.visit([](auto& runner) { runner.interrupt(); });
+    }
+
+    if (runner.process)
+    {
+        notify(task_id, TaskState::Running);
+        runner.process->start();
+    }
+}
+
+void TaskManager::finish(Handle const& task)
+{
+    Runner runner;
+    Timings timings;
+    {
+        std::lock_guard lock(task->mutex);
+        runner = task->runner;
+        task->timings.finished = Timings::Clock::now();
+        if (runner)
+        {
+            task->timings.process = runner.visit([](auto& runner) { return runner.timings(); });
+        }
+        timings = task->timings;
+    }
+
+    if (on_timings_)
+    {
+        on_timings_(task->id, timings);
+    }
+
+    auto cancellation =
+        runner ? runner.visit([](auto& runner) { return runner.cancellation(); }) : std::nullopt;
+    if (cancellation && on_cancelled_)
+    {
+        on_cancelled_(task->id, *cancellation);
+    }
+
+    // A job of the helpers which fails is reported so, unlike a process, whose exit code is not known.
+    if (runner.job && runner.job->failed())
+    {
+        {
+            std::lock_guard lock(scheduler_mutex_);
+            task->state = TaskState::Failed;
+        }
+        notify(task->id, TaskState::Failed);
+    }
+
+    {
+        std::lock_guard lock(scheduler_mutex_);
+        if (!task->paused)
+        {
+            --running_count(task->type);
+        }
+        task->paused = false;
+    }
+
+    remove(task);
+
+    schedule();
+}
+
+void TaskManager::remove(Handle const& task)
+{
+    tasks_.erase(task->id);
+
+    {
+        std::lock_guard lock(task->mutex);
+
+        // The process refers back to the task through its exit callback, so break the cycle.
+        task->runner = {};
+        task->finished = true;
+    }
+    task->finished_cv.notify_all();
+}
+
+void TaskManager::mark(TaskId task_id, Mark mark)
+{
+    auto task = tasks_.find(task_id);
+    if (!task)
+    {
+        return;
+    }
+
+    std::lock_guard lock(task->mutex);
+    if (auto& time = task->timings.marks.at(static_cast<std::size_t>(mark)); !time)
+    {
+        time = Timings::Clock::now();
+    }
 }
 
 void TaskManager::kill(TaskId task_id)
 {
-    auto it = tasks_.find(task_id);
-    if (it != tasks_.end())
+    auto task = tasks_.find(task_id);
+    if (!task)
+    {
+        return;
+    }
+
+    if (task->state == TaskState::Queued)
+    {
+        bool dequeued{};
+        {
+            std::lock_guard lock(scheduler_mutex_);
+            for (auto& queue : queues_)
+            {
+                dequeued = dequeued || std::erase(queue, task) > 0;
+            }
+        }
+
+        if (dequeued)
+        {
+            remove(task);
+            return;
+        }
+        // Otherwise the task has just been taken out of the queue by the scheduler.
+    }
+
+    std::lock_guard lock(task->mutex);
+    task->interrupted = true;
+    if (task->runner)
     {
-        it->second->interrupt();
+        task->runner.visit([](auto& runner) { runner.interrupt(); });
     }
 }
 
 void TaskManager::wait(TaskId task_id)
 {
-    auto it = tasks_.find(task_id);
-    if (it != tasks_.end())
+    // The handle stays valid even if the task is removed meanwhile.
+    if (auto task = tasks_.find(task_id))
     {
-        it->second->wait();
-        tasks_.erase(task_id);
+        std::unique_lock lock(task->mutex);
+        task->finished_cv.wait(lock, [&task] { return task->finished; });
     }
 }
 
+bool TaskManager::pause(TaskId task_id)
+{
+    auto task = tasks_.find(task_id);
+    if (!task || task->state != TaskState::Running)
+    {
+        return false;
+    }
+
+    Runner runner;
+    {
+        std::lock_guard lock(task->mutex);
+        if (task->interrupted)
+        {
+            return false;
+        }
+        runner = task->runner;
+    }
+
+    if (!runner || !runner.visit([](auto& runner) { return runner.running(); }))
+    {
+        return false;
+    }
+
+    {
+        std::lock_guard lock(scheduler_mutex_);
+        if (task->paused || !runner.visit([](auto& runner) { return runner.pause(); }))
+        {
+            return false;
+        }
+        task->paused = true;
+        task->state = TaskState::Paused;
+        --running_count(task->type);
+    }
+
+    notify(task_id, TaskState::Paused);
+    schedule();
+    return true;
+}
+
+bool TaskManager::resume(TaskId task_id)
+{
+    auto task = tasks_.find(task_id);
+    if (!task)
+    {
+        return false;
+    }
+
+    Runner runner;
+    {
+        std::lock_guard lock(task->mutex);
+        runner = task->runner;
+    }
+
+    {
+        std::lock_guard lock(scheduler_mutex_);
+        if (!task->paused)
+        {
+            return false;
+        }
+        task->paused = false;
+        task->state = TaskState::Running;
+        ++running_count(task->type);
+    }
+
+    if (runner)
+    {
+        runner.visit([](auto& runner) { runner.resume(); });
+    }
+
+    notify(task_id, TaskState::Running);
+    return true;
+}
+
+bool TaskManager::defer(TaskId task_id, std::chrono::steady_clock::time_point when, std::function<void()> callback)
+{
+    auto task = tasks_.find(task_id);
+    if (!task)
+    {
+        return false;
+    }
+
+    Runner runner;
+    {
+        std::lock_guard lock(task->mutex);
+        runner = task->runner;
+    }
+
+    if (runner.job)
+    {
+        return runner.job->defer(when, std::move(callback));
+    }
+    if (!runner.process)
+    {
+        return false;
+    }
+
+    runner.process->defer(when, std::move(callback));
+    return true;
+}
+
 bool TaskManager::is_running(TaskId task_id) const
 {
-    auto it = tasks_.find(task_id);
-    return it != tasks_.end() && it->second->running();
+    auto task = tasks_.find(task_id);
+    if (!task)
+    {
+        return false;
+    }
+
+    std::lock_guard lock(task->mutex);
+    return task->runner && task->runner.visit([](auto& runner) { return runner.running(); });
+}
+
+auto TaskManager::state(TaskId task_id) const -> std::optional<TaskState>
+{
+    auto task = tasks_.find(task_id);
+    return task ? std::make_optional(task->state.load()) : std::nullopt;
+}
+
+std::size_t TaskManager::size() const
+{
+    return tasks_.size();
+}
+
+std::size_t TaskManager::queued() const
+{
+    std::lock_guard lock(scheduler_mutex_);
+    std::size_t queued{0};
+    for (auto const& queue : queues_)
+    {
+        queued += queue.size();
+    }
+    return queued;
+}
+
+std::size_t TaskManager::running() const
+{
+    std::lock_guard lock(scheduler_mutex_);
+    return running_previews_ + running_downloads_;
+}
+
+std::string TaskManager::stderr_tail(TaskId task_id) const
+{
+    auto task = tasks_.find(task_id);
+    if (!task)
+    {
+        return {};
+    }
+
+    std::lock_guard lock(task->mutex);
+    return task->stderr_tail.str();
+}
+
+void TaskManager::notify(TaskId task_id, TaskState state) const
+{
+    if (on_state_change_)
+    {
+        on_state_change_(task_id, state);
+    }
 }
 
 } // namespace ytweb
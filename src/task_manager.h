@@ -1,10 +1,21 @@
 #pragma once
 
 #include "async_process.h"
+#include "boost/asio/thread_pool.hpp"
+#include "tail_buffer.h"
+#include "task_registry.h"
+#include "worker_pool.h"
 
+#include <array>
 #include <atomic>
-#include <map>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
 
 namespace ytweb
 {
@@ -14,30 +25,263 @@ class TaskManager
   public:
     using TaskId = int;
 
+    enum class TaskType : std::uint8_t
+    {
+        Preview,
+        Download,
+    };
+
+    // Tasks with a higher priority leave the wait queue first.
+    // Tasks with the same priority are started in FIFO order.
+    enum class Priority : std::uint8_t
+    {
+        High,
+        Normal,
+        Low,
+    };
+
+    enum class TaskState : std::uint8_t
+    {
+        Queued,
+        Running,
+        Paused,
+        Failed, // the process could not be launched, or the job of the helpers failed
+    };
+
+    // Phases marked by the output of a task, see `mark()`.
+    enum class Mark : std::uint8_t
+    {
+        Extracted,        // the information has been extracted
+        DownloadStarted,  // the download is about to start
+        FirstByte,        // the first bytes have been downloaded
+        DownloadFinished, // the download is over, and post processing is about to start
+        Moved,            // the file has been moved to its destination
+    };
+    static constexpr std::size_t MARK_COUNT = 5;
+
+    // When a task went through each phase, reported once it is finished.
+    // Only the first time of each mark is kept, e.g. of the first video of a playlist.
+    struct Timings
+    {
+        using Clock = std::chrono::steady_clock;
+
+        TaskType type{};
+        Clock::time_point queued;
+        std::optional<Clock::time_point> started;     // taken out of the queue
+        std::optional<AsyncProcess::Timings> process; // unless the process failed to launch
+        std::array<std::optional<Clock::time_point>, MARK_COUNT> marks;
+        Clock::time_point finished;
+
+        auto mark(Mark mark) const -> std::optional<Clock::time_point> const&
+        {
+            return marks.at(static_cast<std::size_t>(mark));
+        }
+    };
+
+    // The maximum number of running tasks, in total and for each type.
+    struct Limits
+    {
+        std::size_t total{8};
+        std::size_t preview{4};
+        std::size_t download{4};
+    };
+
+    // The size of the tail of stderr kept for each task.
+    static constexpr std::size_t STDERR_TAIL_BYTES = 16 * 1024;
+
+    // Lines of stdout go to the callback of each task, while lines of stderr go to a callback shared by all tasks.
     using CallbackOnLinebreak = std::function<void(TaskId id, std::string_view line)>;
     using CallbackOnEof = std::function<void(TaskId id)>;
+    using CallbackOnStateChange = std::function<void(TaskId id, TaskState state)>;
+    using CallbackOnStderr = std::function<void(TaskId id, std::string_view line)>;
+    using CallbackOnCancelled = std::function<void(TaskId id, AsyncProcess::Cancellation cancellation)>;
+    using CallbackOnTimings = std::function<void(TaskId id, Timings const& timings)>;
+
+    // All tasks share one event loop, driven by a small pool sized to the core count.
+    TaskManager();
+    explicit TaskManager(std::size_t threads);
 
+    // Drop queued tasks, interrupt running ones and wait for them to finish.
+    ~TaskManager();
+
+    TaskManager(TaskManager const&) = delete;
+    TaskManager& operator=(TaskManager const&) = delete;
+    TaskManager(TaskManager&&) = delete;
+    TaskManager& operator=(TaskManager&&) = delete;
+
+    // Only affects tasks started afterwards.
+    void set_limits(Limits limits);
+
+    // Only affects tasks started afterwards.
+    void set_escalation(AsyncProcess::Escalation escalation);
+
+    // Run the tasks of `options.command` as jobs of resident helpers, instead of launching a process for each.
+    // Only the first call takes effect. Throw if the helpers can't be launched.
+    void set_workers(WorkerPool::Options options);
+
+    // Called whenever a task is queued, started, paused, resumed or fails.
+    void set_on_state_change(CallbackOnStateChange on_state_change);
+
+    // Called for each line the process of a task writes to stderr.
+    void set_on_stderr(CallbackOnStderr on_stderr);
+
+    // Called when the process of a killed task has exited, with how long it took to stop.
+    void set_on_cancelled(CallbackOnCancelled on_cancelled);
+
+    // Called when a task has been started and is finished, with when it went through each phase.
+    void set_on_timings(CallbackOnTimings on_timings);
+
+    // Enqueue a task and return at once. The task is started as soon as the limits allow.
+    // The task is removed from the manager once its process has exited,
+    // so there is no need to wait for it.
     [[nodiscard("Use the return value to manage the task")]]
     TaskId launch(
         std::string_view command,
         std::vector<std::string> const& args,
         CallbackOnLinebreak on_linebreak,
-        CallbackOnEof on_eof
+        CallbackOnEof on_eof,
+        TaskType type = TaskType::Download,
+        Priority priority = Priority::Normal
+    );
+
+    // The same, under an id from `reserve_id()`, e.g. to register the task before it reports anything.
+    void launch(
+        TaskId id,
+        std::string_view command,
+        std::vector<std::string> const& args,
+        CallbackOnLinebreak on_linebreak,
+        CallbackOnEof on_eof,
+        TaskType type = TaskType::Download,
+        Priority priority = Priority::Normal
     );
 
+    // Allocate an id for a request that is served without launching a task, e.g. from a cache.
+    TaskId reserve_id()
+    {
+        return next_task_id_++;
+    }
+
+    // Record that the task has reached a phase, unless it already has.
+    void mark(TaskId id, Mark mark);
+
+    // Call `callback` at `when` in the event loop, serialized with the callbacks of the output of the task.
+    // Return false if the task has no process, e.g. it is queued or finished.
+    bool defer(TaskId id, std::chrono::steady_clock::time_point when, std::function<void()> callback);
+
+    // A queued task is dropped at once, a running one is interrupted.
     void kill(TaskId id);
+
+    // Suspend a running task, which frees its slot for queued tasks until it is resumed.
+    // Return false if the task is not running, or pausing is not supported on this platform.
+    bool pause(TaskId id);
+
+    // Continue a paused task, even if the limits are reached meanwhile.
+    // Return false if the task is not paused.
+    bool resume(TaskId id);
+
+    // Block until the task is finished.
+    // Note: never call it inside a callback, which runs in the event loop.
     void wait(TaskId id);
+
     bool is_running(TaskId id) const;
 
-    std::size_t size() const
-    {
-        return tasks_.size();
-    }
+    // `std::nullopt` if the task is finished or never existed.
+    std::optional<TaskState> state(TaskId id) const;
+
+    std::size_t size() const;
+
+    // The number of tasks waiting in the queues, and of those holding a slot.
+    std::size_t queued() const;
+    std::size_t running() const;
+
+    // The last lines written to stderr by the task, joined by '\n'.
+    // Empty if there is none, or the task is finished or never existed.
+    std::string stderr_tail(TaskId id) const;
 
   private:
+    // What runs a started task: a process of its own, or a job of the helpers.
+    struct Runner
+    {
+        std::shared_ptr<AsyncProcess> process;
+        std::shared_ptr<WorkerPool::Job> job;
+
+        explicit operator bool() const
+        {
+            return process || job;
+        }
+
+        // Call `action` with whichever of them is set. Only valid if one is.
+        template <typename Action>
+        decltype(auto) visit(Action&& action) const
+        {
+            return job ? action(*job) : action(*process);
+        }
+    };
+
+    struct Task
+    {
+        TaskId id;
+        TaskType type;
+        std::atomic<TaskState> state{TaskState::Queued};
+
+        // Only touched by the scheduler, and moved into the process when the task is started.
+        std::string command;
+        std::vector<std::string> args;
+        CallbackOnLinebreak on_linebreak;
+        CallbackOnEof on_eof;
+
+        std::mutex mutex;
+        std::condition_variable finished_cv;
+        Runner runner;                          // reset when finished
+        bool interrupted{false};                // set if killed while the process is being launched
+        bool paused{false};                     // guarded by the scheduler lock, as a paused task holds no slot
+        bool finished{false};
+        TailBuffer stderr_tail{STDERR_TAIL_BYTES};
+        Timings timings;                        // guarded by the mutex
+    };
+
+    using Handle = std::shared_ptr<Task>;
+
+    asio::thread_pool pool_;
+
     std::atomic<TaskId> next_task_id_{0};
 
-    std::map<TaskId, std::unique_ptr<AsyncProcess>> tasks_;
+    CallbackOnStateChange on_state_change_;
+    CallbackOnStderr on_stderr_;
+    CallbackOnCancelled on_cancelled_;
+    CallbackOnTimings on_timings_;
+
+    // Lookups by id go through the registry and never take the scheduler lock.
+    TaskRegistry<TaskId, Task> tasks_;
+
+    // The scheduler lock guards the queues, the limits and the running counts.
+    mutable std::mutex scheduler_mutex_;
+
+    // One FIFO queue per priority.
+    std::array<std::deque<Handle>, 3> queues_;
+
+    Limits limits_;
+    AsyncProcess::Escalation escalation_;
+    std::unique_ptr<WorkerPool> workers_; // kept until the pool is joined
+    std::size_t running_previews_{0};
+    std::size_t running_downloads_{0};
+
+    std::size_t& running_count(TaskType type);
+    bool has_capacity(TaskType type) const;
+
+    // Start as many queued tasks as the limits allow.
+    void schedule();
+
+    // Launch the process of a task that has been taken out of the queue.
+    void start(Handle const& task);
+
+    // Remove a started task and release its slot.
+    void finish(Handle const& task);
+
+    // Remove a task and wake up its waiters.
+    void remove(Handle const& task);
+
+    void notify(TaskId id, TaskState state) const;
 };
 
 } // namespace ytweb
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace ytweb
+{
+
+// A concurrent map from task id to a shared handle of the task.
+// The ids are spread over several shards, each with its own lock, so lookups of different tasks rarely contend.
+// A handle stays valid after its task is erased, as long as someone holds it.
+template <typename Id, typename Task, std::size_t ShardCount = 16>
+class TaskRegistry
+{
+  public:
+    using Handle = std::shared_ptr<Task>;
+
+    void insert(Id id, Handle handle)
+    {
+        auto& shard = shard_of(id);
+        std::lock_guard lock(shard.mutex);
+        if (shard.tasks.insert_or_assign(id, std::move(handle)).second)
+        {
+            ++size_;
+        }
+    }
+
+    // Return `nullptr` if not found.
+    Handle find(Id id) const
+    {
+        auto const& shard = shard_of(id);
+        std::lock_guard lock(shard.mutex);
+        auto it = shard.tasks.find(id);
+        return it != shard.tasks.end() ? it->second : nullptr;
+    }
+
+    // Return the erased handle, or `nullptr` if not found.
+    Handle erase(Id id)
+    {
+        auto& shard = shard_of(id);
+        std::lock_guard lock(shard.mutex);
+        auto node = shard.tasks.extract(id);
+        if (node.empty())
+        {
+            return nullptr;
+        }
+        --size_;
+        return std::move(node.mapped());
+    }
+
+    // Visit all tasks, one shard at a time.
+    // Note: `func` is called with the shard locked, so it must not access the registry.
+    template <typename Func>
+    void for_each(Func func) const
+    {
+        for (auto const& shard : shards_)
+        {
+            std::lock_guard lock(shard.mutex);
+            for (auto const& [id, handle] : shard.tasks)
+            {
+                func(id, handle);
+            }
+        }
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+  private:
+    // Keep each shard on its own cache line.
+    struct alignas(64) Shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<Id, Handle> tasks;
+    };
+
+    std::array<Shard, ShardCount> shards_;
+    std::atomic<std::size_t> size_{0};
+
+    Shard& shard_of(Id id)
+    {
+        return shards_[static_cast<std::size_t>(id) % ShardCount];
+    }
+
+    Shard const& shard_of(Id id) const
+    {
+        return shards_[static_cast<std::size_t>(id) % ShardCount];
+    }
+};
+
+} // namespace ytweb
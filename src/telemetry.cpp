@@ -0,0 +1,346 @@
+#include "telemetry.h"
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <iterator>
+
+namespace ytweb
+{
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+using Mark = TaskManager::Mark;
+
+constexpr std::string_view METRIC_PREFIX = "yt_dlp_web_";
+
+// From a millisecond to an hour.
+std::vector<double> seconds_buckets()
+{
+    return {0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1,    2.5,
+            5,     10,     30,    60,   120,   300,  600, 1800, 3600};
+}
+
+// From 16 KiB/s to 256 MiB/s.
+std::vector<double> speed_buckets()
+{
+    std::vector<double> bounds;
+    for (double bound = 16 * 1024; bound <= 256 * 1024 * 1024; bound *= 4)
+    {
+        bounds.push_back(bound);
+    }
+    return bounds;
+}
+
+std::vector<double> rate_buckets()
+{
+    return {1, 5, 10, 50, 100, 500, 1000, 5000, 10000};
+}
+
+// From 100 microseconds to 10 seconds.
+std::vector<double> latency_buckets()
+{
+    return {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10};
+}
+
+std::vector<double> depth_buckets()
+{
+    return {0, 1, 2, 4, 8, 16, 32, 64, 128};
+}
+
+double to_seconds(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration<double>(duration).count();
+}
+
+void observe_between(
+    Histogram& histogram, std::optional<TaskManager::Timings::Clock::time_point> const& from,
+    std::optional<TaskManager::Timings::Clock::time_point> const& to
+)
+{
+    if (from && to)
+    {
+        histogram.observe(to_seconds(*to - *from));
+    }
+}
+
+} // anonymous namespace
+
+Histogram::Histogram(std::vector<double> bounds) : bounds_(std::move(bounds)), counts_(bounds_.size() + 1)
+{
+}
+
+void Histogram::observe(double value)
+{
+    // A bucket counts the values up to its bound, inclusive.
+    auto index = std::ranges::lower_bound(bounds_, value) - bounds_.begin();
+    counts_[static_cast<std::size_t>(index)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+auto Histogram::snapshot() const -> Snapshot
+{
+    Snapshot snapshot{.bounds = bounds_, .counts = {}, .sum = sum_.load(std::memory_order_relaxed)};
+    snapshot.counts.reserve(counts_.size());
+
+    std::uint64_t cumulative{0};
+    for (auto const& count : counts_)
+    {
+        cumulative += count.load(std::memory_order_relaxed);
+        snapshot.counts.push_back(cumulative);
+    }
+    return snapshot;
+}
+
+Telemetry::Telemetry()
+    : queue_wait_(seconds_buckets()), spawn_(seconds_buckets()), first_output_(seconds_buckets()),
+      extraction_(seconds_buckets()), first_byte_(seconds_buckets()), download_(seconds_buckets()),
+      post_processing_(seconds_buckets()), duration_(seconds_buckets()), speed_(speed_buckets()),
+      events_rate_(rate_buckets()), queue_depth_(depth_buckets()), outbound_latency_(latency_buckets())
+{
+}
+
+Telemetry::~Telemetry()
+{
+    stop();
+}
+
+void Telemetry::start(Options options)
+{
+    std::lock_guard lock(thread_mutex_);
+    if (sampler_.joinable() || stopping_)
+    {
+        return;
+    }
+
+    options_ = std::move(options);
+    sampler_ = std::thread([this] { run_sampler(); });
+}
+
+void Telemetry::stop()
+{
+    {
+        std::lock_guard lock(thread_mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+
+    if (sampler_.joinable())
+    {
+        sampler_.join();
+    }
+}
+
+void Telemetry::record(TaskManager::Timings const& timings)
+{
+    auto& tasks = timings.type == TaskManager::TaskType::Preview ? previews_ : downloads_;
+    tasks.fetch_add(1, std::memory_order_relaxed);
+
+    observe_between(queue_wait_, timings.queued, timings.started);
+
+    if (timings.process)
+    {
+        spawn_.observe(to_seconds(timings.process->spawn));
+        if (timings.process->first_output)
+        {
+            first_output_.observe(to_seconds(*timings.process->first_output));
+        }
+    }
+    else if (timings.started)
+    {
+        failed_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    observe_between(extraction_, timings.started, timings.mark(Mark::Extracted));
+    observe_between(first_byte_, timings.mark(Mark::DownloadStarted), timings.mark(Mark::FirstByte));
+    observe_between(download_, timings.mark(Mark::DownloadStarted), timings.mark(Mark::DownloadFinished));
+    observe_between(post_processing_, timings.mark(Mark::DownloadFinished), timings.mark(Mark::Moved));
+
+    duration_.observe(to_seconds(timings.finished - timings.queued));
+}
+
+void Telemetry::record_speed(double bytes_per_second)
+{
+    speed_.observe(bytes_per_second);
+}
+
+void Telemetry::record_outbound(std::span<Clock::duration const> latencies)
+{
+    outbound_calls_.fetch_add(1, std::memory_order_relaxed);
+    outbound_events_.fetch_add(latencies.size(), std::memory_order_relaxed);
+    for (auto latency : latencies)
+    {
+        outbound_latency_.observe(to_seconds(latency));
+    }
+}
+
+void Telemetry::sample()
+{
+    auto load = options_.load ? options_.load() : Load{};
+    auto events = events_.load(std::memory_order_relaxed);
+    auto now = Clock::now();
+
+    double rate{};
+    {
+        std::lock_guard lock(sample_mutex_);
+        if (auto elapsed = to_seconds(now - sampled_); elapsed > 0)
+        {
+            rate = static_cast<double>(events - sampled_events_) / elapsed;
+        }
+
+        load_ = load;
+        events_per_second_ = rate;
+        sampled_ = now;
+        sampled_events_ = events;
+    }
+
+    events_rate_.observe(rate);
+    queue_depth_.observe(static_cast<double>(load.queued));
+}
+
+template <typename F>
+void Telemetry::for_each_histogram(F&& f) const
+{
+    f("queue_wait_seconds", "Time tasks waited in the queue.", queue_wait_);
+    f("spawn_seconds", "Time to launch the process of a task.", spawn_);
+    f("first_output_seconds", "Time from the launch to the first output.", first_output_);
+    f("extraction_seconds", "Time from the start of a task to the extracted information.", extraction_);
+    f("first_byte_seconds", "Time from the start of a download to its first bytes.", first_byte_);
+    f("download_seconds", "Time to download the files of a video.", download_);
+    f("post_processing_seconds", "Time to post process and move the files of a video.", post_processing_);
+    f("task_duration_seconds", "Time from enqueueing a task to its end.", duration_);
+    f("download_speed_bytes_per_second", "Speed of downloads, sampled by their progress.", speed_);
+    f("events_per_second", "Lines of output of all tasks per second, sampled periodically.", events_rate_);
+    f("queue_depth", "Tasks waiting in the queue, sampled periodically.", queue_depth_);
+    f("outbound_queue_seconds", "Time events for the frontend waited to be sent.", outbound_latency_);
+}
+
+std::string Telemetry::to_json() const
+{
+    Load load;
+    double events_per_second{};
+    {
+        std::lock_guard lock(sample_mutex_);
+        load = load_;
+        events_per_second = events_per_second_;
+    }
+
+    auto json = std::format(
+        R"({{"uptime_seconds":{},"queued":{},"running":{},"events_per_second":{},)"
+        R"("tasks":{{"preview":{},"download":{},"failed":{}}},"events":{},"downloaded_bytes":{},)"
+        R"("outbound":{{"events":{},"calls":{},"dropped":{}}},"histograms":{{)",
+        to_seconds(Clock::now() - started_), load.queued, load.running, events_per_second,
+        previews_.load(std::memory_order_relaxed), downloads_.load(std::memory_order_relaxed),
+        failed_.load(std::memory_order_relaxed), events_.load(std::memory_order_relaxed),
+        downloaded_bytes_.load(std::memory_order_relaxed), outbound_events_.load(std::memory_order_relaxed),
+        outbound_calls_.load(std::memory_order_relaxed), outbound_dropped_.load(std::memory_order_relaxed)
+    );
+
+    auto out = std::back_inserter(json);
+    bool first{true};
+    for_each_histogram([&](std::string_view name, std::string_view /* help */, Histogram const& histogram) {
+        auto snapshot = histogram.snapshot();
+        std::format_to(
+            out, R"({}"{}":{{"count":{},"sum":{},"buckets":[)", first ? "" : ",", name, snapshot.count(), snapshot.sum
+        );
+        for (std::size_t i = 0; i < snapshot.bounds.size(); ++i)
+        {
+            std::format_to(out, "{}[{},{}]", i == 0 ? "" : ",", snapshot.bounds[i], snapshot.counts[i]);
+        }
+        json.append("]}");
+        first = false;
+    });
+    json.append("}}");
+    return json;
+}
+
+std::string Telemetry::to_prometheus() const
+{
+    Load load;
+    {
+        std::lock_guard lock(sample_mutex_);
+        load = load_;
+    }
+
+    std::string text;
+    auto out = std::back_inserter(text);
+
+    auto counter = [&](std::string_view name, std::string_view help, std::atomic<std::uint64_t> const& value) {
+        std::format_to(out, "# HELP {0}{1} {2}\n# TYPE {0}{1} counter\n", METRIC_PREFIX, name, help);
+        std::format_to(out, "{}{} {}\n", METRIC_PREFIX, name, value.load(std::memory_order_relaxed));
+    };
+    auto gauge = [&](std::string_view name, std::string_view help, double value) {
+        std::format_to(out, "# HELP {0}{1} {2}\n# TYPE {0}{1} gauge\n", METRIC_PREFIX, name, help);
+        std::format_to(out, "{}{} {}\n", METRIC_PREFIX, name, value);
+    };
+
+    std::format_to(
+        out, "# HELP {0}tasks_total Finished tasks.\n# TYPE {0}tasks_total counter\n"
+             "{0}tasks_total{{type=\"preview\"}} {1}\n{0}tasks_total{{type=\"download\"}} {2}\n",
+        METRIC_PREFIX, previews_.load(std::memory_order_relaxed), downloads_.load(std::memory_order_relaxed)
+    );
+    counter("failed_tasks_total", "Tasks whose process could not be launched.", failed_);
+    counter("events_total", "Lines of output of all tasks.", events_);
+    counter("downloaded_bytes_total", "Bytes of the downloaded files.", downloaded_bytes_);
+    counter("outbound_events_total", "Events sent to the frontend.", outbound_events_);
+    counter("outbound_calls_total", "Calls to the frontend, each sending a batch of events.", outbound_calls_);
+    counter("outbound_dropped_total", "Events for the frontend dropped as it fell behind.", outbound_dropped_);
+    gauge("queued_tasks", "Tasks waiting in the queue.", static_cast<double>(load.queued));
+    gauge("running_tasks", "Tasks holding a slot.", static_cast<double>(load.running));
+    gauge("uptime_seconds", "Time since the app started.", to_seconds(Clock::now() - started_));
+
+    for_each_histogram([&](std::string_view name, std::string_view help, Histogram const& histogram) {
+        auto snapshot = histogram.snapshot();
+        std::format_to(out, "# HELP {0}{1} {2}\n# TYPE {0}{1} histogram\n", METRIC_PREFIX, name, help);
+        for (std::size_t i = 0; i < snapshot.bounds.size(); ++i)
+        {
+            std::format_to(
+                out, "{}{}_bucket{{le=\"{}\"}} {}\n", METRIC_PREFIX, name, snapshot.bounds[i], snapshot.counts[i]
+            );
+        }
+        std::format_to(out, "{}{}_bucket{{le=\"+Inf\"}} {}\n", METRIC_PREFIX, name, snapshot.count());
+        std::format_to(out, "{}{}_sum {}\n", METRIC_PREFIX, name, snapshot.sum);
+        std::format_to(out, "{}{}_count {}\n", METRIC_PREFIX, name, snapshot.count());
+    });
+    return text;
+}
+
+void Telemetry::write_prometheus_file() const
+{
+    auto const& path = *options_.prometheus_file;
+
+    // Written aside and renamed, so that a scraper never reads half a file.
+    auto temp = fs::path(path).concat(".tmp");
+    {
+        auto text = to_prometheus();
+        std::ofstream stream(temp, std::ios::binary | std::ios::trunc);
+        stream.write(text.data(), static_cast<std::streamsize>(text.size()));
+        if (!stream)
+        {
+            return;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(temp, path, ec);
+}
+
+void Telemetry::run_sampler()
+{
+    std::unique_lock lock(thread_mutex_);
+    while (!cv_.wait_for(lock, options_.interval, [this] { return stopping_; }))
+    {
+        lock.unlock();
+        sample();
+        if (options_.prometheus_file)
+        {
+            write_prometheus_file();
+        }
+        lock.lock();
+    }
+}
+
+} // namespace ytweb
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "task_manager.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ytweb
+{
+
+// A histogram with fixed buckets, which any thread may observe without locking.
+class Histogram
+{
+  public:
+    struct Snapshot
+    {
+        std::vector<double> bounds;
+        std::vector<std::uint64_t> counts; // cumulative, with one more for the values above all bounds
+        double sum{};
+
+        auto count() const -> std::uint64_t
+        {
+            return counts.back();
+        }
+    };
+
+    // The upper bounds of the buckets, in ascending order.
+    explicit Histogram(std::vector<double> bounds);
+
+    void observe(double value);
+
+    Snapshot snapshot() const;
+
+  private:
+    std::vector<double> bounds_;
+    std::vector<std::atomic<std::uint64_t>> counts_;
+    std::atomic<double> sum_{0};
+};
+
+// Counters and histograms of where the time of tasks goes, for the frontend as JSON,
+// and for Prometheus as a text file which is rewritten periodically.
+class Telemetry
+{
+  public:
+    // How many tasks are waiting and running.
+    struct Load
+    {
+        std::size_t queued{};
+        std::size_t running{};
+    };
+
+    struct Options
+    {
+        // How often the load and the rates are sampled, and the file is rewritten.
+        std::chrono::milliseconds interval{5000};
+        std::optional<std::filesystem::path> prometheus_file;
+        std::function<Load()> load;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    Telemetry();
+
+    // Stop sampling.
+    ~Telemetry();
+
+    Telemetry(Telemetry const&) = delete;
+    Telemetry& operator=(Telemetry const&) = delete;
+    Telemetry(Telemetry&&) = delete;
+    Telemetry& operator=(Telemetry&&) = delete;
+
+    // Sample in the background. Only the first call takes effect.
+    void start(Options options);
+
+    // Join the sampling thread, e.g. before the source of the load is gone. Recording still works.
+    void stop();
+
+    // Record the phases of a finished task.
+    void record(TaskManager::Timings const& timings);
+
+    // A line of output of a task.
+    void record_event()
+    {
+        events_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // The speed of a download, as reported by its progress.
+    void record_speed(double bytes_per_second);
+
+    // A file has been downloaded.
+    void record_downloaded(std::uint64_t bytes)
+    {
+        downloaded_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    // Events sent to the frontend in one call, with how long each has been queued, see `EventBus`.
+    void record_outbound(std::span<Clock::duration const> latencies);
+
+    // An event for the frontend dropped for a slow frontend.
+    void record_outbound_dropped()
+    {
+        outbound_dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Update the load and the rates since the last sample.
+    void sample();
+
+    std::string to_json() const;
+    std::string to_prometheus() const;
+
+  private:
+    Clock::time_point started_{Clock::now()};
+
+    std::atomic<std::uint64_t> previews_{0};
+    std::atomic<std::uint64_t> downloads_{0};
+    std::atomic<std::uint64_t> failed_{0}; // the process could not be launched
+    std::atomic<std::uint64_t> events_{0};
+    std::atomic<std::uint64_t> downloaded_bytes_{0};
+    std::atomic<std::uint64_t> outbound_events_{0};
+    std::atomic<std::uint64_t> outbound_calls_{0};
+    std::atomic<std::uint64_t> outbound_dropped_{0};
+
+    // In seconds.
+    Histogram queue_wait_;
+    Histogram spawn_;
+    Histogram first_output_;
+    Histogram extraction_;
+    Histogram first_byte_;
+    Histogram download_;
+    Histogram post_processing_;
+    Histogram duration_;
+
+    Histogram speed_; // bytes per second
+    Histogram events_rate_; // lines per second
+    Histogram queue_depth_;
+    Histogram outbound_latency_; // seconds
+
+    // Set by sampling.
+    mutable std::mutex sample_mutex_;
+    Load load_;
+    double events_per_second_{};
+    Clock::time_point sampled_{started_};
+    std::uint64_t sampled_events_{0};
+
+    Options options_;
+    std::mutex thread_mutex_;
+    std::condition_variable cv_;
+    bool stopping_{false};
+    std::thread sampler_;
+
+    // Call `f(name, help, histogram)` for each histogram.
+    template <typename F>
+    void for_each_histogram(F&& f) const;
+
+    void run_sampler();
+    void write_prometheus_file() const;
+};
+
+} // namespace ytweb
@@ -0,0 +1,432 @@
+#include "worker_pool.h"
+
+#include "boost/asio/post.hpp"
+#include "json_text.h"
+
+#include <algorithm>
+#include <charconv>
+#include <exception>
+#include <format>
+
+namespace ytweb
+{
+
+using Stream = AsyncProcess::Stream;
+
+namespace
+{
+
+// Parse the next field separated by a space, and remove it from `str`.
+template <typename Integer>
+bool parse_field(std::string_view& str, Integer& value)
+{
+    auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (ec != std::errc{})
+    {
+        return false;
+    }
+
+    str.remove_prefix(end - str.data());
+    if (str.starts_with(' '))
+    {
+        str.remove_prefix(1);
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+WorkerPool::Job::Job(
+    AsyncProcess::CallbackOnLinebreak on_linebreak,
+    AsyncProcess::CallbackOnEof on_eof,
+    AsyncProcess::CallbackOnExit on_exit
+)
+    : on_linebreak_(std::move(on_linebreak)),
+      on_eof_(std::move(on_eof)),
+      on_exit_(std::move(on_exit)),
+      run_at_(Clock::now())
+{
+}
+
+void WorkerPool::Job::interrupt()
+{
+    std::shared_ptr<AsyncProcess> helper;
+    {
+        std::lock_guard lock(mutex_);
+        if (over_ || interrupted_at_)
+        {
+            return;
+        }
+        interrupted_at_ = Clock::now();
+        helper = helper_;
+    }
+
+    // If the job ends meanwhile, the helper is not reused, as the job is marked interrupted.
+    helper->interrupt();
+}
+
+bool WorkerPool::Job::pause()
+{
+#ifndef _WIN32
+    return while_running([](AsyncProcess& helper) { helper.pause(); });
+#else
+    return false;
+#endif
+}
+
+bool WorkerPool::Job::resume()
+{
+#ifndef _WIN32
+    return while_running([](AsyncProcess& helper) { helper.resume(); });
+#else
+    return false;
+#endif
+}
+
+bool WorkerPool::Job::defer(Clock::time_point when, std::function<void()> callback)
+{
+    std::lock_guard lock(mutex_);
+    if (over_)
+    {
+        return false;
+    }
+    helper_->defer(when, std::move(callback));
+    return true;
+}
+
+void WorkerPool::Job::set_escalation(AsyncProcess::Escalation escalation)
+{
+    std::lock_guard lock(mutex_);
+    if (!over_)
+    {
+        helper_->set_escalation(escalation);
+    }
+}
+
+bool WorkerPool::Job::running() const
+{
+    std::lock_guard lock(mutex_);
+    return !over_;
+}
+
+auto WorkerPool::Job::timings() const -> AsyncProcess::Timings
+{
+    std::lock_guard lock(mutex_);
+    return {.spawn = spawn_, .first_output = first_output_};
+}
+
+auto WorkerPool::Job::cancellation() const -> std::optional<AsyncProcess::Cancellation>
+{
+    std::lock_guard lock(mutex_);
+    return cancellation_;
+}
+
+bool WorkerPool::Job::failed() const
+{
+    std::lock_guard lock(mutex_);
+    return over_ && !interrupted_at_ && exit_code_ != 0;
+}
+
+void WorkerPool::Job::record_output()
+{
+    if (!received_output_)
+    {
+        received_output_ = true;
+
+        std::lock_guard lock(mutex_);
+        first_output_ = Clock::now() - run_at_;
+    }
+}
+
+bool WorkerPool::Job::end(std::optional<int> exit_code)
+{
+    std::lock_guard lock(mutex_);
+    over_ = true;
+    exit_code_ = exit_code;
+
+    if (interrupted_at_)
+    {
+        // The helper tells the last signal once it has exited, otherwise the job has stopped at the first one.
+        auto helper = helper_ ? helper_->cancellation() : std::nullopt;
+        cancellation_ = AsyncProcess::Cancellation{
+            .signal = helper ? helper->signal : AsyncProcess::Signal::Interrupt,
+            .latency = Clock::now() - *interrupted_at_,
+        };
+    }
+
+    helper_.reset();
+    return interrupted_at_.has_value();
+}
+
+bool WorkerPool::Job::while_running(std::function<void(AsyncProcess& helper)> action)
+{
+    std::shared_ptr<AsyncProcess> helper;
+    {
+        std::lock_guard lock(mutex_);
+        if (over_)
+        {
+            return false;
+        }
+        helper = helper_;
+    }
+
+    // The job ends in the strand of the helper, so it is checked there again.
+    helper->defer(Clock::now(), [self = shared_from_this(), helper, action = std::move(action)] {
+        if (self->running())
+        {
+            action(*helper);
+        }
+    });
+    return true;
+}
+
+WorkerPool::WorkerPool(asio::any_io_executor executor, Options options)
+    : executor_(std::move(executor)), options_(std::move(options))
+{
+    for (std::size_t i = 0; i < options_.idle; ++i)
+    {
+        auto worker = launch();
+
+        std::lock_guard lock(mutex_);
+        idle_.push_back(std::move(worker));
+    }
+}
+
+auto WorkerPool::run(
+    std::vector<std::string> const& args,
+    AsyncProcess::CallbackOnLinebreak on_linebreak,
+    AsyncProcess::CallbackOnEof on_eof,
+    AsyncProcess::CallbackOnExit on_exit
+) -> std::shared_ptr<Job>
+{
+    auto job = std::shared_ptr<Job>(new Job(std::move(on_linebreak), std::move(on_eof), std::move(on_exit)));
+
+    Handle worker;
+    while (!worker)
+    {
+        {
+            std::lock_guard lock(mutex_);
+            job->id_ = next_job_id_++;
+            if (!idle_.empty())
+            {
+                worker = std::move(idle_.back());
+                idle_.pop_back();
+            }
+        }
+
+        if (!worker)
+        {
+            worker = launch();
+        }
+
+        std::lock_guard lock(worker->mutex);
+        if (worker->exited)
+        {
+            worker.reset(); // exited while idle
+            continue;
+        }
+        worker->job = job;
+
+        std::lock_guard job_lock(job->mutex_);
+        job->helper_ = worker->process;
+        job->spawn_ = Job::Clock::now() - job->run_at_;
+    }
+
+    std::string line = std::format(R"({{"id":{},"args":[)", job->id_);
+    for (std::size_t i = 0; i < args.size(); ++i)
+    {
+        if (i > 0)
+        {
+            line.push_back(',');
+        }
+        append_json_string(line, args[i]);
+    }
+    line.append("]}\n");
+    worker->process->write(std::move(line));
+
+    // Keep helpers warm for the next jobs, without delaying this one.
+    asio::post(executor_, [this] { replenish(); });
+
+    return job;
+}
+
+void WorkerPool::shutdown()
+{
+    std::lock_guard lock(mutex_);
+    closing_ = true;
+    idle_.clear();
+    for (auto const& worker : workers_)
+    {
+        worker->process->close_stdin();
+    }
+}
+
+std::size_t WorkerPool::size() const
+{
+    std::lock_guard lock(mutex_);
+    return workers_.size();
+}
+
+std::size_t WorkerPool::idle() const
+{
+    std::lock_guard lock(mutex_);
+    return idle_.size();
+}
+
+auto WorkerPool::launch() -> Handle
+{
+    auto worker = std::make_shared<Worker>();
+
+    // The pool keeps the helper alive until it exits, which is the last callback.
+    // A helper which ends in the middle of a job has crashed, which `handle_exit()` reports.
+    auto* raw = worker.get();
+    worker->process = std::make_shared<AsyncProcess>(
+        executor_, options_.python, std::vector<std::string>{options_.script},
+        [this, raw](Stream stream, std::string_view line) { handle_line(*raw, stream, line); }, [] {},
+        [this, raw] { handle_exit(raw); }, LineSplitter::DEFAULT_MAX_LINE_LENGTH, true
+    );
+
+    {
+        std::lock_guard lock(mutex_);
+        workers_.push_back(worker);
+    }
+    worker->process->start();
+
+    return worker;
+}
+
+void WorkerPool::replenish()
+{
+    std::size_t missing{};
+    {
+        std::lock_guard lock(mutex_);
+        if (closing_)
+        {
+            return;
+        }
+        missing = options_.idle - std::min(options_.idle, idle_.size());
+    }
+
+    for (std::size_t i = 0; i < missing; ++i)
+    {
+        Handle worker;
+        try
+        {
+            worker = launch();
+        }
+        catch (std::exception const& /* e */)
+        {
+            return; // the next job will try again, and report the error
+        }
+
+        std::lock_guard lock(mutex_);
+        if (closing_)
+        {
+            worker->process->close_stdin();
+            return;
+        }
+        idle_.push_back(std::move(worker));
+    }
+}
+
+auto WorkerPool::take_job(Worker& worker) -> std::shared_ptr<Job>
+{
+    std::lock_guard lock(worker.mutex);
+    return std::move(worker.job);
+}
+
+void WorkerPool::handle_line(Worker& worker, Stream stream, std::string_view line)
+{
+    std::shared_ptr<Job> job;
+    {
+        std::lock_guard lock(worker.mutex);
+        job = worker.job;
+    }
+
+    if (stream == Stream::Stdout && line.starts_with(DONE_MARKER))
+    {
+        line.remove_prefix(DONE_MARKER.size());
+
+        int id{};
+        int exit_code{};
+        std::size_t memory{};
+        if (!job || !parse_field(line, id) || id != job->id_ || !parse_field(line, exit_code) ||
+            !parse_field(line, memory))
+        {
+            return; // not the end of the current job
+        }
+
+        take_job(worker);
+        ++worker.jobs;
+
+        bool const interrupted = job->end(exit_code);
+        if (exit_code == 0 && !interrupted)
+        {
+            job->on_eof_();
+        }
+        release(worker, memory, interrupted);
+        job->on_exit_();
+        return;
+    }
+
+    // The output between jobs, e.g. warnings while importing, belongs to no one.
+    if (job)
+    {
+        job->record_output();
+        job->on_linebreak_(stream, line);
+    }
+}
+
+void WorkerPool::handle_exit(Worker* worker)
+{
+    std::shared_ptr<Job> job;
+    {
+        std::lock_guard lock(worker->mutex);
+        worker->exited = true;
+        job = std::move(worker->job);
+    }
+
+    // Keep the helper alive until the end of the callback.
+    Handle handle;
+    {
+        std::lock_guard lock(mutex_);
+        std::erase_if(idle_, [worker](Handle const& h) { return h.get() == worker; });
+
+        auto it =
+            std::find_if(workers_.begin(), workers_.end(), [worker](Handle const& h) { return h.get() == worker; });
+        if (it != workers_.end())
+        {
+            handle = std::move(*it);
+            workers_.erase(it);
+        }
+    }
+
+    // The helper has exited in the middle of the job, by an interruption or a crash.
+    if (job)
+    {
+        job->end(std::nullopt);
+        job->on_exit_();
+    }
+}
+
+void WorkerPool::release(Worker& worker, std::size_t memory, bool interrupted)
+{
+    std::lock_guard lock(mutex_);
+
+    bool const recycle =
+        closing_ || interrupted || worker.jobs >= options_.max_jobs || memory > options_.max_memory;
+    if (recycle)
+    {
+        worker.process->close_stdin(); // the helper exits after reading the end of stdin
+        return;
+    }
+
+    auto it =
+        std::find_if(workers_.begin(), workers_.end(), [&worker](Handle const& h) { return h.get() == &worker; });
+    if (it != workers_.end())
+    {
+        idle_.push_back(*it);
+    }
+}
+
+} // namespace ytweb
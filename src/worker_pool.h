@@ -0,0 +1,185 @@
+#pragma once
+
+#include "async_process.h"
+#include "boost/asio/any_io_executor.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ytweb
+{
+
+// Resident helper processes which import yt-dlp once and run many jobs, saving the startup of python for each task.
+//
+// Each job is written to the stdin of an idle helper as a line of JSON: `{"id": <job id>, "args": [...]}`.
+// The helper writes the output of yt-dlp as usual, followed by a line on stdout:
+// `DONE_MARKER <job id> <exit code> <max resident memory in bytes>`.
+// A helper is recycled after `max_jobs` jobs or once it grows larger than `max_memory`.
+class WorkerPool
+{
+  public:
+    // A job run by a helper. Interrupting, pausing or deferring it affects the helper only while the job runs on it,
+    // and a helper is not reused after an interruption.
+    class Job : public std::enable_shared_from_this<Job>
+    {
+      public:
+        // Interrupt the helper, see `AsyncProcess::interrupt()`. Does nothing once the job is over.
+        void interrupt();
+
+        // Suspend and continue the helper, along with its children.
+        // Return false if not supported on this platform, or the job is over.
+        bool pause();
+        bool resume();
+
+        // Call `callback` at `when`, serialized with the callbacks of the output. Return false if the job is over.
+        bool defer(std::chrono::steady_clock::time_point when, std::function<void()> callback);
+
+        void set_escalation(AsyncProcess::Escalation escalation);
+
+        bool running() const;
+
+        // Counted from `run()`: how long it took to hand the job to a helper, and when its first output came.
+        AsyncProcess::Timings timings() const;
+
+        // `std::nullopt` if the job has not been interrupted, or is not over yet.
+        std::optional<AsyncProcess::Cancellation> cancellation() const;
+
+        // Whether the job is over with a non-zero exit code, or its helper has crashed, without being interrupted.
+        bool failed() const;
+
+      private:
+        friend class WorkerPool;
+        using Clock = std::chrono::steady_clock;
+
+        Job(
+            AsyncProcess::CallbackOnLinebreak on_linebreak,
+            AsyncProcess::CallbackOnEof on_eof,
+            AsyncProcess::CallbackOnExit on_exit
+        );
+
+        int id_{0};
+        AsyncProcess::CallbackOnLinebreak on_linebreak_;
+        AsyncProcess::CallbackOnEof on_eof_;
+        AsyncProcess::CallbackOnExit on_exit_;
+
+        // Only touched in the strand of the helper.
+        bool received_output_{false};
+
+        mutable std::mutex mutex_;
+        std::shared_ptr<AsyncProcess> helper_; // while the job runs on it
+        Clock::time_point run_at_;
+        Clock::duration spawn_{};
+        std::optional<Clock::duration> first_output_;
+        std::optional<Clock::time_point> interrupted_at_;
+        std::optional<AsyncProcess::Cancellation> cancellation_;
+        std::optional<int> exit_code_; // unless the helper has crashed
+        bool over_{false};
+
+        // Called in the strand of the helper.
+        void record_output();
+
+        // Detach the job from its helper, with the exit code of the job unless the helper has crashed.
+        // Return whether it has been interrupted, in which case the helper is not reused.
+        bool end(std::optional<int> exit_code);
+
+        // Call `action` on the helper in its strand, unless the job is over by then.
+        bool while_running(std::function<void(AsyncProcess& helper)> action);
+    };
+
+    struct Options
+    {
+        std::string python;  // the interpreter which runs the helper
+        std::string script;  // the helper script
+        std::string command; // the yt-dlp executable the helpers stand in for
+        std::size_t idle{2}; // helpers kept warm for the next jobs
+        std::size_t max_jobs{100};
+        std::size_t max_memory{512 * 1024 * 1024};
+    };
+
+    // The unit separator never appears in the output of yt-dlp.
+    static constexpr std::string_view DONE_MARKER = "\x1f"
+                                                    "done ";
+
+    // Start the idle helpers at once.
+    WorkerPool(asio::any_io_executor executor, Options options);
+
+    // Note: the pool must outlive its helpers. Call `shutdown()` and wait for the executor first.
+    ~WorkerPool() = default;
+
+    WorkerPool(WorkerPool const&) = delete;
+    WorkerPool& operator=(WorkerPool const&) = delete;
+    WorkerPool(WorkerPool&&) = delete;
+    WorkerPool& operator=(WorkerPool&&) = delete;
+
+    // Whether a task running `command` can be served by the helpers.
+    bool serves(std::string_view command) const
+    {
+        return command == options_.command;
+    }
+
+    // Run a job on an idle helper, launching one if there is none.
+    // The callbacks behave as if the job were a process of its own, and the job is already started.
+    // `on_eof` is only called if the job exits with 0, while a failed job only calls `on_exit`, see `Job::failed()`.
+    // Throw if a helper can't be launched.
+    std::shared_ptr<Job> run(
+        std::vector<std::string> const& args,
+        AsyncProcess::CallbackOnLinebreak on_linebreak,
+        AsyncProcess::CallbackOnEof on_eof,
+        AsyncProcess::CallbackOnExit on_exit
+    );
+
+    // Let every helper exit once its current job is done, and launch no more.
+    void shutdown();
+
+    // The number of helpers, busy or idle.
+    std::size_t size() const;
+
+    std::size_t idle() const;
+
+  private:
+    struct Worker
+    {
+        std::shared_ptr<AsyncProcess> process;
+        std::size_t jobs{0};
+
+        // The job is set by `run()` and taken in the strand of the process.
+        std::mutex mutex;
+        std::shared_ptr<Job> job;
+        bool exited{false};
+    };
+
+    using Handle = std::shared_ptr<Worker>;
+
+    asio::any_io_executor executor_;
+    Options options_;
+
+    mutable std::mutex mutex_;
+    std::list<Handle> workers_; // all helpers, until they exit
+    std::vector<Handle> idle_;
+    int next_job_id_{0};
+    bool closing_{false};
+
+    // Launch a helper, which is idle until a job is assigned.
+    Handle launch();
+
+    // Launch helpers until enough of them are idle.
+    void replenish();
+
+    std::shared_ptr<Job> take_job(Worker& worker);
+
+    void handle_line(Worker& worker, AsyncProcess::Stream stream, std::string_view line);
+    void handle_exit(Worker* worker);
+
+    // Return the helper to the idle list, or let it exit.
+    void release(Worker& worker, std::size_t memory, bool interrupted);
+};
+
+} // namespace ytweb
@@ -1,8 +1,12 @@
 #include "async_process.h"
 
+#include "boost/asio/thread_pool.hpp"
 #include "boost/process/v2/environment.hpp"
 
 #include "gtest/gtest.h"
+#include <filesystem>
+#include <future>
+#include <thread>
 
 using namespace std::chrono_literals;
 
@@ -11,37 +15,209 @@ using boost::process::environment::find_executable;
 class AsyncProcess : public ::testing::Test
 {
   public:
-    ytweb::AsyncProcess process{
-        find_executable("python").string(),
-        {YT_DLP_WEB_FAKE_BIN},
-        [&](std::string_view line) { responce += line; },
-        [&]() { eof_called = true; }
-    };
+    boost::asio::thread_pool pool{1};
 
     bool eof_called{false};
 
     std::string responce;
+    std::string errors;
+
+    std::shared_ptr<ytweb::AsyncProcess> process = std::make_shared<ytweb::AsyncProcess>(
+        pool.get_executor(),
+        find_executable("python").string(),
+        std::vector<std::string>{YT_DLP_WEB_FAKE_BIN},
+        [&](ytweb::AsyncProcess::Stream stream, std::string_view line) {
+            (stream == ytweb::AsyncProcess::Stream::Stdout ? responce : errors) += line;
+        },
+        [&]() { eof_called = true; }
+    );
+
+    void SetUp() override
+    {
+        process->start();
+    }
 };
 
 TEST_F(AsyncProcess, LaunchAndInterrupt)
 {
-    EXPECT_TRUE(process.running());
+    EXPECT_TRUE(process->running());
 
-    process.interrupt();
-    process.wait();
+    process->interrupt();
+    process->wait();
 
-    EXPECT_FALSE(process.running());
+    EXPECT_FALSE(process->running());
     EXPECT_NE(responce, "start running");
     EXPECT_FALSE(eof_called);
 }
 
 TEST_F(AsyncProcess, LaunchAndWait)
 {
-    EXPECT_TRUE(process.running());
+    EXPECT_TRUE(process->running());
+
+    process->wait();
+
+    EXPECT_FALSE(process->running());
+    EXPECT_EQ(responce, "start running");
+    EXPECT_TRUE(eof_called);
+}
 
-    process.wait();
+TEST_F(AsyncProcess, ReadStderr)
+{
+    process->wait();
 
-    EXPECT_FALSE(process.running());
     EXPECT_EQ(responce, "start running");
+    EXPECT_EQ(errors, "WARNING: this is a fake yt-dlp");
     EXPECT_TRUE(eof_called);
 }
+
+TEST_F(AsyncProcess, Timings)
+{
+    process->wait();
+
+    auto timings = process->timings();
+    EXPECT_GT(timings.spawn, 0ns);
+    ASSERT_TRUE(timings.first_output.has_value());
+    EXPECT_GE(*timings.first_output, timings.spawn);
+}
+
+TEST_F(AsyncProcess, ExitCallback)
+{
+    bool exit_called{false};
+
+    auto other = std::make_shared<ytweb::AsyncProcess>(
+        pool.get_executor(), find_executable("python").string(), std::vector<std::string>{YT_DLP_WEB_FAKE_BIN},
+        [](ytweb::AsyncProcess::Stream /* stream */, std::string_view /* line */) {}, [] {}, [&] { exit_called = true; }
+    );
+    other->start();
+    other->wait();
+
+    EXPECT_TRUE(exit_called);
+    process->wait();
+}
+
+namespace
+{
+
+auto launch_hang(
+    boost::asio::thread_pool& pool,
+    std::vector<std::string> args,
+    ytweb::AsyncProcess::CallbackOnLinebreak on_linebreak = [](auto /* stream */, auto /* line */) {}
+) -> std::shared_ptr<ytweb::AsyncProcess>
+{
+    args.insert(args.begin(), YT_DLP_WEB_HANG_BIN);
+    return std::make_shared<ytweb::AsyncProcess>(
+        pool.get_executor(), find_executable("python").string(), args, std::move(on_linebreak), [] {}
+    );
+}
+
+} // anonymous namespace
+
+// The interruption doesn't wait for the next output, which never comes.
+TEST_F(AsyncProcess, InterruptSilentProcess)
+{
+    process->wait();
+
+    auto hang = launch_hang(pool, {});
+    hang->start();
+    std::this_thread::sleep_for(500ms); // let python install its SIGINT handler
+    EXPECT_FALSE(hang->cancellation().has_value());
+
+    hang->interrupt();
+    hang->wait();
+
+    auto cancellation = hang->cancellation();
+    ASSERT_TRUE(cancellation.has_value());
+    EXPECT_EQ(cancellation->signal, ytweb::AsyncProcess::Signal::Interrupt);
+    EXPECT_LT(cancellation->latency, 1s);
+}
+
+#ifndef _WIN32
+TEST_F(AsyncProcess, EscalateToKill)
+{
+    process->wait();
+
+    auto hang = launch_hang(pool, {"--ignore-signals"});
+    hang->set_escalation({.interrupt_grace = 100ms, .terminate_grace = 100ms});
+    hang->start();
+    std::this_thread::sleep_for(500ms); // let python ignore the signals
+
+    hang->interrupt();
+    hang->wait();
+
+    auto cancellation = hang->cancellation();
+    ASSERT_TRUE(cancellation.has_value());
+    EXPECT_EQ(cancellation->signal, ytweb::AsyncProcess::Signal::Kill);
+    EXPECT_GE(cancellation->latency, 200ms);
+    EXPECT_LT(cancellation->latency, 2s);
+}
+#endif
+
+// The last errors written when interrupted are still read.
+TEST_F(AsyncProcess, ReadErrorsAfterInterrupt)
+{
+    process->wait();
+
+    std::string hang_errors;
+    auto hang = launch_hang(pool, {}, [&](ytweb::AsyncProcess::Stream stream, std::string_view line) {
+        if (stream == ytweb::AsyncProcess::Stream::Stderr)
+        {
+            hang_errors += line;
+        }
+    });
+    hang->start();
+    std::this_thread::sleep_for(500ms); // let python install its SIGINT handler
+
+    hang->interrupt();
+    hang->wait();
+
+    EXPECT_EQ(hang_errors, "ERROR: Interrupted by user");
+}
+
+#ifndef _WIN32
+// The children are stopped along with the process, even if they ignore SIGINT.
+TEST_F(AsyncProcess, InterruptChildren)
+{
+    process->wait();
+
+    auto marker = std::filesystem::temp_directory_path() / "yt-dlp-web-async-process-test.part";
+    std::filesystem::remove(marker);
+
+    auto hang = launch_hang(pool, {"--fork-child", marker.string()});
+    hang->start();
+    std::this_thread::sleep_for(500ms); // let python fork the child
+
+    hang->interrupt();
+    hang->wait();
+
+    std::this_thread::sleep_for(1s); // the child would have written by now
+    EXPECT_FALSE(std::filesystem::exists(marker));
+    std::filesystem::remove(marker);
+}
+#endif
+
+// Deferred callbacks run while the process is silent.
+TEST_F(AsyncProcess, Defer)
+{
+    process->wait();
+
+    auto hang = launch_hang(pool, {});
+    hang->start();
+
+    std::promise<std::chrono::steady_clock::time_point> called;
+    auto const deferred = std::chrono::steady_clock::now();
+    hang->defer(deferred + 50ms, [&called] { called.set_value(std::chrono::steady_clock::now()); });
+
+    auto future = called.get_future();
+    ASSERT_EQ(future.wait_for(2s), std::future_status::ready);
+    EXPECT_GE(future.get() - deferred, 50ms);
+
+    hang->interrupt();
+    hang->wait();
+}
+
+TEST_F(AsyncProcess, NoCancellationWithoutInterrupt)
+{
+    process->wait();
+
+    EXPECT_FALSE(process->cancellation().has_value());
+}
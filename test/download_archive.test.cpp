@@ -0,0 +1,145 @@
+#include "download_archive.h"
+
+#include "gtest/gtest.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+using ytweb::ArchiveRecorder;
+
+namespace
+{
+
+auto read_file(fs::path const& path)
+{
+    std::ifstream stream(path);
+    std::stringstream content;
+    content << stream.rdbuf();
+    return content.str();
+}
+
+} // anonymous namespace
+
+class DownloadArchive : public ::testing::Test
+{
+  public:
+    fs::path path = fs::temp_directory_path() / "yt-dlp-web-download-archive-test.txt";
+
+    void SetUp() override
+    {
+        fs::remove(path);
+    }
+
+    void TearDown() override
+    {
+        fs::remove(path);
+    }
+};
+
+TEST_F(DownloadArchive, Load)
+{
+    std::ofstream(path) << "youtube dQw4w9WgXcQ\r\nbilibili BV1n2rKYcEyG\n\n";
+
+    ytweb::DownloadArchive archive(path);
+
+    EXPECT_EQ(archive.size(), 2);
+    EXPECT_TRUE(archive.contains("Youtube", "dQw4w9WgXcQ"));
+    EXPECT_TRUE(archive.contains("BiliBili", "BV1n2rKYcEyG"));
+    EXPECT_FALSE(archive.contains("youtube", "BV1n2rKYcEyG"));
+}
+
+TEST_F(DownloadArchive, Record)
+{
+    ytweb::DownloadArchive archive(path);
+    EXPECT_EQ(archive.size(), 0);
+
+    EXPECT_TRUE(archive.record("youtube", "a", "https://example.com/a", true));
+    EXPECT_FALSE(archive.record("youtube", "a", "https://example.com/a", true));
+    EXPECT_TRUE(archive.record("youtube", "b", "", false));
+
+    EXPECT_TRUE(archive.contains("youtube", "b"));
+    EXPECT_TRUE(archive.contains_url("https://example.com/a"));
+    EXPECT_FALSE(archive.contains_url("https://example.com/b"));
+
+    // Only the entry not written by yt-dlp is appended.
+    EXPECT_EQ(read_file(path), "youtube a\n");
+}
+
+TEST_F(DownloadArchive, ConcurrentRecord)
+{
+    ytweb::DownloadArchive archive(path);
+
+    constexpr int THREADS = 4;
+    constexpr int RECORDS = 100;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < THREADS; ++i)
+    {
+        threads.emplace_back([&archive, i] {
+            for (int j = 0; j < RECORDS; ++j)
+            {
+                archive.record("youtube", std::to_string(i * RECORDS + j), "", true);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    // Every line is whole, and the file loads back.
+    EXPECT_EQ(ytweb::DownloadArchive(path).size(), THREADS * RECORDS);
+}
+
+TEST_F(DownloadArchive, Recorder)
+{
+    auto archive = std::make_shared<ytweb::DownloadArchive>(path);
+    ArchiveRecorder recorder(archive, true);
+
+    EXPECT_FALSE(recorder.feed("Extract URL: https://www.youtube.com/watch?v=dQw4w9WgXcQ"));
+    EXPECT_FALSE(recorder.feed("[youtube] dQw4w9WgXcQ: '137+140' with format '137 - 1920x1080 (1080p)+140'"));
+    EXPECT_FALSE(recorder.feed("Archive entry: Youtube dQw4w9WgXcQ"));
+    EXPECT_FALSE(recorder.feed("Start download..."));
+    EXPECT_FALSE(archive->contains("youtube", "dQw4w9WgXcQ"));
+
+    EXPECT_TRUE(recorder.feed("Finished post processing"));
+    EXPECT_TRUE(archive->contains("youtube", "dQw4w9WgXcQ"));
+    EXPECT_TRUE(archive->contains_url("https://www.youtube.com/watch?v=dQw4w9WgXcQ"));
+
+    // Nothing more to record.
+    EXPECT_FALSE(recorder.feed("Finished post processing"));
+}
+
+// The archive keys a video by the extractor key, not by the name of the extractor.
+TEST_F(DownloadArchive, RecordExtractorKey)
+{
+    auto archive = std::make_shared<ytweb::DownloadArchive>(path);
+    ArchiveRecorder recorder(archive, true);
+
+    EXPECT_FALSE(recorder.feed("[twitch:vod] v123456: 'source' with format 'source - 1920x1080'"));
+    EXPECT_FALSE(recorder.feed("Archive entry: TwitchVod v123456"));
+    EXPECT_TRUE(recorder.feed("Finished post processing"));
+
+    EXPECT_TRUE(archive->contains("twitchvod", "v123456"));
+    EXPECT_FALSE(archive->contains("twitch:vod", "v123456"));
+    EXPECT_TRUE(ytweb::DownloadArchive(path).contains("twitchvod", "v123456"));
+}
+
+TEST_F(DownloadArchive, IdentifyMedia)
+{
+    auto identity = ytweb::identify_media(
+        R"({"id": "dQw4w9WgXcQ", "formats": [{"id": "137"}], "extractor_key": "Youtube", "playlist_index": 3})"
+    );
+    ASSERT_TRUE(identity);
+    EXPECT_EQ(identity->extractor, "youtube");
+    EXPECT_EQ(identity->id, "dQw4w9WgXcQ");
+    EXPECT_EQ(identity->playlist_index, 3);
+
+    EXPECT_FALSE(ytweb::identify_media(R"({"id": "dQw4w9WgXcQ"})"));
+    EXPECT_FALSE(ytweb::identify_media("invalid"));
+}
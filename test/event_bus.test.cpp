@@ -0,0 +1,239 @@
+#include "event_bus.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using ytweb::EventBus;
+using Policy = EventBus::Policy;
+using Merge = EventBus::Merge;
+
+namespace
+{
+
+// A frontend which records the calls, and may be held up, as a slow browser.
+class Frontend
+{
+  public:
+    EventBus::Sink sink()
+    {
+        return {
+            .send = [this](std::string_view function, std::string_view data) {
+                record(std::string(function) + ": " + std::string(data));
+            },
+            .run = [this](std::string_view script) { record(std::string(script)); },
+        };
+    }
+
+    void hold()
+    {
+        std::lock_guard lock(mutex_);
+        held_ = true;
+    }
+
+    void release()
+    {
+        {
+            std::lock_guard lock(mutex_);
+            held_ = false;
+        }
+        cv_.notify_all();
+    }
+
+    // Wait until the sender is held up by a call.
+    void wait_held()
+    {
+        std::unique_lock lock(mutex_);
+        cv_.wait(lock, [this] { return holding_; });
+    }
+
+    std::vector<std::string> calls()
+    {
+        std::lock_guard lock(mutex_);
+        return calls_;
+    }
+
+  private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool held_{false};
+    bool holding_{false};
+    std::vector<std::string> calls_;
+
+    void record(std::string call)
+    {
+        std::unique_lock lock(mutex_);
+        calls_.push_back(std::move(call));
+
+        holding_ = held_;
+        cv_.notify_all();
+        cv_.wait(lock, [this] { return !held_; });
+        holding_ = false;
+    }
+};
+
+} // anonymous namespace
+
+TEST(EventBus, MergeInOrder)
+{
+    Frontend frontend;
+    EventBus bus(frontend.sink());
+
+    // The events queue up behind a slow call.
+    frontend.hold();
+    bus.run("first()");
+    frontend.wait_held();
+
+    bus.send("showDownloadInfo", "a", Policy::DropOldest, Merge::Lines, 1);
+    bus.send("showDownloadInfo", "b", Policy::DropOldest, Merge::Lines, 2);
+    bus.send("showDownloadProgress", R"([{"task_id":1}])", Policy::DropOldest, Merge::JsonArray);
+    bus.send("showDownloadProgress", "[]", Policy::DropOldest, Merge::JsonArray);
+    bus.send("showDownloadProgress", R"([{"task_id":2}])", Policy::DropOldest, Merge::JsonArray);
+    bus.run("reportCompletion(1)");
+    bus.send("showPreviewEntries", "x", Policy::Lossless, Merge::None, 3);
+    bus.send("showPreviewEntries", "y", Policy::Lossless, Merge::None, 3);
+
+    frontend.release();
+    bus.flush();
+
+    EXPECT_THAT(
+        frontend.calls(), testing::ElementsAre(
+                              "first()", "showDownloadInfo: a\nb",
+                              R"(showDownloadProgress: [{"task_id":1},{"task_id":2}])", "reportCompletion(1)",
+                              "showPreviewEntries: x", "showPreviewEntries: y"
+                          )
+    );
+
+    auto stats = bus.stats();
+    EXPECT_EQ(stats.events, 9);
+    EXPECT_EQ(stats.calls, 6);
+    EXPECT_EQ(stats.dropped, 0);
+}
+
+TEST(EventBus, DropOldestOfTask)
+{
+    Frontend frontend;
+    int dropped{0};
+    EventBus bus(frontend.sink(), {.max_per_task = 2, .on_dropped = [&dropped] { ++dropped; }});
+
+    frontend.hold();
+    bus.run("first()");
+    frontend.wait_held();
+
+    for (auto line : {"1", "2", "3", "4", "5"})
+    {
+        bus.send("showDownloadInfo", line, Policy::DropOldest, Merge::Lines, 1);
+    }
+    bus.send("showDownloadInfo", "other", Policy::DropOldest, Merge::Lines, 2);
+    bus.send("showPreviewEntries", "entries", Policy::Lossless, Merge::None, 1); // not bounded
+    bus.send("showPreviewEntries", "more entries", Policy::Lossless, Merge::None, 1);
+    bus.send("showPreviewEntries", "even more entries", Policy::Lossless, Merge::None, 1);
+
+    frontend.release();
+    bus.flush();
+
+    EXPECT_THAT(
+        frontend.calls(), testing::ElementsAre(
+                              "first()", "showDownloadInfo: 4\n5\nother", "showPreviewEntries: entries",
+                              "showPreviewEntries: more entries", "showPreviewEntries: even more entries"
+                          )
+    );
+    EXPECT_EQ(bus.stats().dropped, 3);
+    EXPECT_EQ(dropped, 3);
+}
+
+TEST(EventBus, DropOldestOfAll)
+{
+    Frontend frontend;
+    EventBus bus(frontend.sink(), {.max_bytes = 10});
+
+    frontend.hold();
+    bus.run("first()");
+    frontend.wait_held();
+
+    bus.send("showDownloadProgress", "[1111]", Policy::DropOldest, Merge::JsonArray);
+    bus.send("showDownloadProgress", "[2222]", Policy::DropOldest, Merge::JsonArray);
+    bus.run("reportCompletion(1, \"a long tail of stderr, larger than the bound\")");
+    bus.send("showDownloadProgress", "[3333]", Policy::DropOldest, Merge::JsonArray);
+
+    frontend.release();
+    bus.flush();
+
+    EXPECT_THAT(
+        frontend.calls(), testing::ElementsAre(
+                              "first()", "reportCompletion(1, \"a long tail of stderr, larger than the bound\")",
+                              "showDownloadProgress: [3333]"
+                          )
+    );
+    EXPECT_EQ(bus.stats().dropped, 2);
+}
+
+// Dropped events don't pile up in the queue while the frontend is held up.
+TEST(EventBus, BoundedQueue)
+{
+    Frontend frontend;
+    EventBus bus(frontend.sink(), {.max_per_task = 2, .max_bytes = 1024});
+
+    frontend.hold();
+    bus.run("first()");
+    frontend.wait_held();
+
+    std::size_t longest{0};
+    for (int i = 0; i < 10000; ++i)
+    {
+        bus.send("showDownloadInfo", "line", Policy::DropOldest, Merge::Lines, i % 4);
+        bus.send("showDownloadProgress", "[{}]", Policy::DropOldest, Merge::JsonArray);
+        longest = std::max(longest, bus.stats().queued);
+    }
+    EXPECT_LE(longest, 1000);
+
+    frontend.release();
+    bus.flush();
+    EXPECT_EQ(bus.stats().queued, 0);
+    EXPECT_GE(bus.stats().dropped, 20000 - 300);
+}
+
+TEST(EventBus, Latency)
+{
+    Frontend frontend;
+    std::vector<std::size_t> sent;
+    EventBus bus(
+        frontend.sink(), {.on_sent = [&sent](std::span<EventBus::Clock::duration const> latencies) {
+            sent.push_back(latencies.size());
+            for (auto latency : latencies)
+            {
+                EXPECT_GE(latency.count(), 0);
+            }
+        }}
+    );
+
+    frontend.hold();
+    bus.run("first()");
+    frontend.wait_held();
+
+    bus.send("logMessage", "[1]", Policy::DropOldest, Merge::JsonArray);
+    bus.send("logMessage", "[2]", Policy::DropOldest, Merge::JsonArray);
+
+    frontend.release();
+    bus.flush();
+
+    EXPECT_THAT(sent, testing::ElementsAre(1, 2));
+    EXPECT_THAT(frontend.calls(), testing::ElementsAre("first()", "logMessage: [1,2]"));
+}
+
+TEST(EventBus, SendRemainingOnDestruction)
+{
+    Frontend frontend;
+    {
+        EventBus bus(frontend.sink(), {.linger = std::chrono::milliseconds(1000)});
+        bus.run("reportCompletion(1)");
+        bus.run("reportCompletion(2)");
+    }
+    EXPECT_THAT(frontend.calls(), testing::ElementsAre("reportCompletion(1)", "reportCompletion(2)"));
+}
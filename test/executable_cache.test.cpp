@@ -0,0 +1,26 @@
+#include "executable_cache.h"
+
+#include "boost/process/v2/environment.hpp"
+
+#include "gtest/gtest.h"
+#include <string>
+
+using boost::process::environment::find_executable;
+
+TEST(ExecutableCache, FindExecutable)
+{
+    auto python = find_executable("python").string();
+    ASSERT_FALSE(python.empty());
+
+    EXPECT_EQ(ytweb::find_executable_cached("python"), python);
+    EXPECT_EQ(ytweb::find_executable_cached("python"), python);
+
+    ytweb::invalidate_executable_cache();
+    EXPECT_EQ(ytweb::find_executable_cached("python"), python);
+}
+
+TEST(ExecutableCache, NotFound)
+{
+    EXPECT_EQ(ytweb::find_executable_cached("yt-dlp-web-no-such-executable"), "");
+    EXPECT_EQ(ytweb::find_executable_cached("yt-dlp-web-no-such-executable"), "");
+}
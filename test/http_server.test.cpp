@@ -0,0 +1,267 @@
+#include "http_server.h"
+
+#include "boost/beast/core/flat_buffer.hpp"
+#include "boost/beast/http.hpp"
+#include "nlohmann/json.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using ytweb::HttpServer;
+using Json = nlohmann::json;
+
+namespace asio = boost::asio;
+namespace http = boost::beast::http;
+using tcp = asio::ip::tcp;
+
+namespace
+{
+
+auto connect(std::uint16_t port) -> tcp::socket
+{
+    static asio::io_context io_context;
+    tcp::socket socket(io_context);
+    socket.connect({asio::ip::make_address("127.0.0.1"), port});
+    return socket;
+}
+
+auto fetch(
+    std::uint16_t port, http::verb method, std::string const& target, std::string const& body = {},
+    std::vector<std::pair<http::field, std::string>> const& fields = {{http::field::content_type, "application/json"}}
+) -> http::response<http::string_body>
+{
+    auto socket = connect(port);
+
+    http::request<http::string_body> request{method, target, 11};
+    for (auto const& [field, value] : fields)
+    {
+        request.set(field, value);
+    }
+    request.body() = body;
+    request.prepare_payload();
+    http::write(socket, request);
+
+    boost::beast::flat_buffer buffer;
+    http::response<http::string_body> response;
+    http::read(socket, buffer, response);
+    return response;
+}
+
+// Wait for the condition, or a second.
+template <typename F>
+bool eventually(F&& condition)
+{
+    for (auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+         std::chrono::steady_clock::now() < deadline; std::this_thread::sleep_for(std::chrono::milliseconds(5)))
+    {
+        if (condition())
+        {
+            return true;
+        }
+    }
+    return condition();
+}
+
+} // anonymous namespace
+
+class HttpServerTest : public testing::Test
+{
+  protected:
+    HttpServer server_{{.port = 0}};
+
+    std::mutex mutex_;
+    std::vector<std::string> submitted_;
+    std::vector<int> interrupted_;
+
+    void SetUp() override
+    {
+        server_.start({
+            .submit = [this](std::string_view request) -> std::optional<int> {
+                std::lock_guard lock(mutex_);
+                if (request.find("invalid") != std::string_view::npos)
+                {
+                    return std::nullopt;
+                }
+                submitted_.emplace_back(request);
+                return static_cast<int>(submitted_.size());
+            },
+            .interrupt = [this](int task) {
+                std::lock_guard lock(mutex_);
+                interrupted_.push_back(task);
+            },
+            .pause = [](int task) { return task == 1; },
+            .resume = [](int /* task */) { return false; },
+            .metrics = [] { return std::string(R"json({"tasks": {"downloads": 0}})json"); },
+        });
+    }
+};
+
+TEST_F(HttpServerTest, Submit)
+{
+    auto response = fetch(server_.port(), http::verb::post, "/api/requests", R"json({"url_input": "a"})json");
+    EXPECT_EQ(response.result(), http::status::created);
+    EXPECT_EQ(Json::parse(response.body())["task"], 1);
+
+    response = fetch(server_.port(), http::verb::post, "/api/requests", "invalid");
+    EXPECT_EQ(response.result(), http::status::bad_request);
+
+    response = fetch(server_.port(), http::verb::get, "/api/requests");
+    EXPECT_EQ(response.result(), http::status::method_not_allowed);
+
+    response = fetch(server_.port(), http::verb::get, "/api/nothing");
+    EXPECT_EQ(response.result(), http::status::not_found);
+
+    EXPECT_THAT(submitted_, testing::ElementsAre(R"json({"url_input": "a"})json"));
+}
+
+TEST_F(HttpServerTest, SubmitBulk)
+{
+    auto response = fetch(
+        server_.port(), http::verb::post, "/api/requests/bulk",
+        R"json({"request": {"action": "download"}, "urls": ["a", 42, "b"]})json"
+    );
+    EXPECT_EQ(response.result(), http::status::created);
+    EXPECT_EQ(Json::parse(response.body())["tasks"], Json::parse("[1, null, 2]"));
+
+    response = fetch(
+        server_.port(), http::verb::post, "/api/requests/bulk",
+        R"json({"requests": [{"url_input": "c"}, "invalid"]})json"
+    );
+    EXPECT_EQ(response.result(), http::status::created);
+    EXPECT_EQ(Json::parse(response.body())["tasks"], Json::parse("[3, null]"));
+
+    response = fetch(server_.port(), http::verb::post, "/api/requests/bulk", R"json({"urls": "a"})json");
+    EXPECT_EQ(response.result(), http::status::bad_request);
+
+    ASSERT_EQ(submitted_.size(), 3);
+    EXPECT_EQ(Json::parse(submitted_[0]), Json::parse(R"json({"action": "download", "url_input": "a"})json"));
+    EXPECT_EQ(Json::parse(submitted_[1]), Json::parse(R"json({"action": "download", "url_input": "b"})json"));
+    EXPECT_EQ(Json::parse(submitted_[2]), Json::parse(R"json({"url_input": "c"})json"));
+}
+
+TEST_F(HttpServerTest, RejectUnsafe)
+{
+    auto const body = std::string(R"json({"url_input": "a"})json");
+
+    // A form posted by a web page.
+    auto response = fetch(server_.port(), http::verb::post, "/api/requests", body, {});
+    EXPECT_EQ(response.result(), http::status::unsupported_media_type);
+    response = fetch(
+        server_.port(), http::verb::post, "/api/requests/bulk", R"json({"urls": ["a"]})json",
+        {{http::field::content_type, "text/plain"}}
+    );
+    EXPECT_EQ(response.result(), http::status::unsupported_media_type);
+
+    response = fetch(
+        server_.port(), http::verb::post, "/api/requests", body,
+        {{http::field::content_type, "application/json"}, {http::field::origin, "https://example.com"}}
+    );
+    EXPECT_EQ(response.result(), http::status::forbidden);
+    response = fetch(
+        server_.port(), http::verb::post, "/api/tasks/1/interrupt", {}, {{http::field::origin, "null"}}
+    );
+    EXPECT_EQ(response.result(), http::status::forbidden);
+
+    response = fetch(
+        server_.port(), http::verb::post, "/api/requests", R"json({"url_input": "a", "yt_dlp_path": "/bin/sh"})json"
+    );
+    EXPECT_EQ(response.result(), http::status::bad_request);
+    response = fetch(
+        server_.port(), http::verb::post, "/api/requests/bulk",
+        R"json({"request": {"yt_dlp_path": "/bin/sh"}, "urls": ["a"]})json"
+    );
+    EXPECT_EQ(response.result(), http::status::bad_request);
+    response = fetch(
+        server_.port(), http::verb::post, "/api/requests/bulk",
+        R"json({"requests": [{"url_input": "a", "yt_dlp_path": "/bin/sh"}, "{\"yt_dlp_path\": \"/bin/sh\"}"]})json"
+    );
+    EXPECT_EQ(response.result(), http::status::created);
+    EXPECT_EQ(Json::parse(response.body())["tasks"], Json::parse("[null, null]"));
+
+    EXPECT_TRUE(submitted_.empty());
+    EXPECT_TRUE(interrupted_.empty());
+}
+
+TEST_F(HttpServerTest, TaskActions)
+{
+    EXPECT_EQ(fetch(server_.port(), http::verb::post, "/api/tasks/7/interrupt").result(), http::status::no_content);
+    EXPECT_EQ(fetch(server_.port(), http::verb::post, "/api/tasks/1/pause").result(), http::status::no_content);
+    EXPECT_EQ(fetch(server_.port(), http::verb::post, "/api/tasks/2/pause").result(), http::status::conflict);
+    EXPECT_EQ(fetch(server_.port(), http::verb::post, "/api/tasks/1/resume").result(), http::status::conflict);
+    EXPECT_EQ(fetch(server_.port(), http::verb::post, "/api/tasks/x/pause").result(), http::status::not_found);
+    EXPECT_EQ(fetch(server_.port(), http::verb::post, "/api/tasks/1/stop").result(), http::status::not_found);
+
+    EXPECT_THAT(interrupted_, testing::ElementsAre(7));
+}
+
+TEST_F(HttpServerTest, Metrics)
+{
+    auto response = fetch(server_.port(), http::verb::get, "/api/metrics");
+    EXPECT_EQ(response.result(), http::status::ok);
+
+    auto metrics = Json::parse(response.body());
+    EXPECT_EQ(metrics["tasks"]["tasks"]["downloads"], 0);
+    EXPECT_EQ(metrics["events"]["clients"], 0);
+}
+
+TEST_F(HttpServerTest, Events)
+{
+    auto socket = connect(server_.port());
+    http::request<http::empty_body> request{http::verb::get, "/api/events", 11};
+    http::write(socket, request);
+    ASSERT_TRUE(eventually([this] { return server_.stats().clients == 1; }));
+
+    server_.publish("showDownloadInfo", "first\nsecond");
+    server_.publish_call(R"js(reportCompletion(1, ""))js");
+
+    std::string received;
+    std::array<char, 1024> chunk{};
+    while (received.find("event: reportCompletion\ndata: [1, \"\"]\n") == std::string::npos)
+    {
+        auto size = socket.read_some(asio::buffer(chunk));
+        received.append(chunk.data(), size);
+    }
+
+    EXPECT_THAT(received, testing::StartsWith("HTTP/1.1 200 OK\r\n"));
+    EXPECT_THAT(received, testing::HasSubstr("Content-Type: text/event-stream\r\n"));
+    EXPECT_THAT(received, testing::HasSubstr("event: showDownloadInfo\ndata: first\ndata: second\n\n"));
+
+    socket.close();
+    EXPECT_TRUE(eventually([this] { return server_.stats().clients == 0; }));
+}
+
+// A client which doesn't read loses progress, and is disconnected once other events don't fit either.
+TEST(HttpServer, Backpressure)
+{
+    HttpServer server({.port = 0, .max_queued_bytes = 4096});
+    server.start({});
+
+    auto socket = connect(server.port());
+    socket.set_option(asio::socket_base::receive_buffer_size(4096));
+    http::request<http::empty_body> request{http::verb::get, "/api/events", 11};
+    http::write(socket, request);
+    ASSERT_TRUE(eventually([&server] { return server.stats().clients == 1; }));
+
+    std::string const progress(1000, 'p');
+    for (int i = 0; i < 100000 && server.stats().dropped == 0; ++i)
+    {
+        server.publish("showDownloadProgress", progress);
+    }
+    EXPECT_GT(server.stats().dropped, 0);
+    EXPECT_EQ(server.stats().disconnected, 0);
+
+    std::string const info(1000, 'i');
+    for (int i = 0; i < 100 && server.stats().disconnected == 0; ++i)
+    {
+        server.publish("showDownloadInfo", info);
+    }
+    EXPECT_EQ(server.stats().disconnected, 1);
+    EXPECT_TRUE(eventually([&server] { return server.stats().clients == 0; }));
+}
@@ -0,0 +1,132 @@
+#include "line_splitter.h"
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using ytweb::LineSplitter;
+
+namespace
+{
+
+// Feed the data in chunks of at most `chunk_size` bytes, and collect the lines.
+std::vector<std::string> split(LineSplitter& splitter, std::string_view data, std::size_t chunk_size = 1024)
+{
+    std::vector<std::string> lines;
+    while (!data.empty())
+    {
+        auto buffer = splitter.prepare();
+        auto size = std::min({buffer.size(), data.size(), chunk_size});
+        std::copy_n(data.begin(), size, buffer.begin());
+        data.remove_prefix(size);
+
+        splitter.commit(size, [&lines](std::string_view line) { lines.emplace_back(line); });
+    }
+    return lines;
+}
+
+std::vector<std::string> split(std::string_view data, std::size_t chunk_size = 1024)
+{
+    LineSplitter splitter;
+    return split(splitter, data, chunk_size);
+}
+
+} // anonymous namespace
+
+TEST(LineSplitter, SplitLines)
+{
+    LineSplitter splitter;
+
+    EXPECT_EQ(split(splitter, "first\nsecond\n\nthird"), (std::vector<std::string>{"first", "second", ""}));
+    EXPECT_EQ(splitter.rest(), "third");
+}
+
+TEST(LineSplitter, CarriageReturn)
+{
+    EXPECT_EQ(split("a\rb\r\nc\n\rd\r\r"), (std::vector<std::string>{"a", "b", "c", "", "d", ""}));
+}
+
+TEST(LineSplitter, CarriageReturnAcrossChunks)
+{
+    for (std::size_t chunk_size = 1; chunk_size <= 4; ++chunk_size)
+    {
+        EXPECT_EQ(split("ab\r\ncd\r\n", chunk_size), (std::vector<std::string>{"ab", "cd"})) << chunk_size;
+    }
+}
+
+// Progress lines ended by '\r' only, e.g. of ffmpeg, followed by a line ended by '\n'.
+TEST(LineSplitter, CarriageReturnsBeforeLineFeed)
+{
+    std::string data;
+    std::vector<std::string> expected;
+    for (int i = 0; i < 1000; ++i)
+    {
+        expected.push_back(std::to_string(i) + "%");
+        data += expected.back() + "\r";
+    }
+    expected.emplace_back("done");
+    data += "done\nnext\r\n";
+    expected.emplace_back("next");
+
+    for (std::size_t chunk_size : {1, 7, 4096, 100000})
+    {
+        EXPECT_EQ(split(data, chunk_size), expected) << chunk_size;
+    }
+}
+
+TEST(LineSplitter, LinesAcrossChunks)
+{
+    std::string data;
+    std::vector<std::string> expected;
+    for (int i = 0; i < 10000; ++i)
+    {
+        expected.push_back(std::string(static_cast<std::size_t>(i % 300), 'x') + std::to_string(i));
+        data += expected.back() + "\n";
+    }
+
+    for (std::size_t chunk_size : {1, 7, 4096, 100000})
+    {
+        EXPECT_EQ(split(data, chunk_size), expected) << chunk_size;
+    }
+}
+
+TEST(LineSplitter, LongLine)
+{
+    LineSplitter splitter;
+
+    std::string line(1024 * 1024, 'x');
+    auto lines = split(splitter, line + "\nnext\n", 10000);
+
+    ASSERT_EQ(lines.size(), 2);
+    EXPECT_EQ(lines[0], line);
+    EXPECT_EQ(lines[1], "next");
+    EXPECT_LT(splitter.capacity(), 4 * line.size());
+}
+
+// The buffer starts small, and grows only as long as the lines.
+TEST(LineSplitter, Capacity)
+{
+    LineSplitter splitter;
+    EXPECT_LE(splitter.capacity(), 4096);
+
+    split(splitter, std::string(100000, 'x') + "\n", 4096);
+    EXPECT_LT(splitter.capacity(), 4 * 100000);
+
+    LineSplitter small(10000);
+    split(small, std::string(100000, 'x') + "\n", 4096);
+    EXPECT_LE(small.capacity(), 2 * (10000 + 4096));
+}
+
+TEST(LineSplitter, TruncateLongLine)
+{
+    for (std::size_t chunk_size : {1, 3, 1024})
+    {
+        LineSplitter splitter(4);
+        EXPECT_EQ(
+            split(splitter, "abcdefgh\nij\nklmnop\nqrst\nuvwxyz", chunk_size),
+            (std::vector<std::string>{"abcd", "ij", "klmn", "qrst", "uvwx"})
+        ) << chunk_size;
+        EXPECT_EQ(splitter.rest(), "");
+    }
+}
@@ -0,0 +1,159 @@
+#include "load_driver.h"
+
+#include "exception.h"
+#include "nlohmann/json.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include <format>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+using ytweb::LoadDriver;
+using ytweb::ParseError;
+using Json = nlohmann::json;
+
+namespace
+{
+
+// A line as stamped by `bench/yt-dlp-sim.py`.
+std::string stamped(std::string_view line)
+{
+#ifndef _WIN32
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return std::format("{} @@{}@@", line, static_cast<long long>(now.tv_sec) * 1'000'000'000 + now.tv_nsec);
+#else
+    return std::string(line);
+#endif
+}
+
+} // anonymous namespace
+
+TEST(LoadDriver, ParseOptions)
+{
+    auto options = LoadDriver::parse_options(R"json({
+        "tasks": 10,
+        "rate": 5,
+        "interrupt_every": 3,
+        "interrupt_after_ms": 200,
+        "request": {"action": "download", "url_input": "progress:10?n={n}"}
+    })json");
+    EXPECT_EQ(options.tasks, 10);
+    EXPECT_EQ(options.rate, 5);
+    EXPECT_EQ(options.interrupt_every, 3);
+    EXPECT_EQ(options.interrupt_after, std::chrono::milliseconds(200));
+    EXPECT_EQ(Json::parse(options.request)["url_input"], "progress:10?n={n}");
+
+    EXPECT_EQ(LoadDriver::parse_options(R"json({"request": "{}"})json").request, "{}");
+
+    EXPECT_THROW(LoadDriver::parse_options(R"json({"tasks": 10})json"), ParseError);
+    EXPECT_THROW(LoadDriver::parse_options(R"json({"rate": 0, "request": "{}"})json"), ParseError);
+    EXPECT_THROW(LoadDriver::parse_options("not json"), ParseError);
+}
+
+// Tasks which are over before `submit` returns, as when served from a cache.
+TEST(LoadDriver, Run)
+{
+    LoadDriver driver({.tasks = 20, .rate = 1000, .request = R"json({"n": {n}})json"});
+
+    std::vector<std::string> requests;
+    int next_task = 1;
+    auto report = Json::parse(driver.run({
+        .submit = [&](std::string_view request) -> std::optional<int> {
+            requests.emplace_back(request);
+            if (requests.size() == 5)
+            {
+                return std::nullopt; // invalid
+            }
+
+            auto task = next_task++;
+            driver.on_send("showDownloadInfo", stamped("Start download..."));
+            driver.on_script(std::format(R"js(reportCompletion({}, "{}"))js", task, stamped("stale")));
+            return task;
+        },
+        .interrupt = [](int /* task */) { FAIL() << "nothing is interrupted"; },
+        .residue = [] { return LoadDriver::Residue{}; },
+    }));
+
+    ASSERT_EQ(requests.size(), 20);
+    EXPECT_EQ(requests.front(), R"json({"n": 0})json");
+    EXPECT_EQ(requests.back(), R"json({"n": 19})json");
+
+    EXPECT_EQ(report["tasks"]["submitted"], 19);
+    EXPECT_EQ(report["tasks"]["rejected"], 1);
+    EXPECT_EQ(report["tasks"]["completed"], 19);
+    EXPECT_EQ(report["tasks"]["unfinished"], 0);
+    EXPECT_EQ(report["leaks"]["tasks"], 0);
+
+    EXPECT_EQ(report["sent"]["showDownloadInfo"]["calls"], 19);
+    EXPECT_EQ(report["sent"]["reportCompletion"]["calls"], 19);
+    EXPECT_EQ(report["sent"]["reportCompletion"]["latency_us"]["count"], 0); // the stderr of reports is not measured
+#ifndef _WIN32
+    EXPECT_EQ(report["sent"]["showDownloadInfo"]["latency_us"]["count"], 19);
+    EXPECT_GE(report["sent"]["showDownloadInfo"]["latency_us"]["p50"].get<double>(), 0);
+#endif
+}
+
+TEST(LoadDriver, Interrupt)
+{
+    LoadDriver driver({
+        .tasks = 10,
+        .rate = 1000,
+        .request = "{n}",
+        .interrupt_every = 2,
+        .interrupt_after = std::chrono::milliseconds(10),
+    });
+
+    std::vector<int> interrupted;
+    auto report = Json::parse(driver.run({
+        .submit = [&](std::string_view request) -> std::optional<int> {
+            auto task = std::stoi(std::string(request)) + 100;
+            if (task % 2 == 0) // the ones left running
+            {
+                driver.on_script(std::format(R"js(reportCompletion({}, ""))js", task));
+            }
+            return task;
+        },
+        .interrupt = [&](int task) {
+            interrupted.push_back(task);
+            driver.on_script(std::format(R"js(reportInterruption({}, ""))js", task));
+        },
+        .residue = [] { return LoadDriver::Residue{.tasks = 1}; },
+    }));
+
+    EXPECT_THAT(interrupted, testing::ElementsAre(101, 103, 105, 107, 109));
+    EXPECT_EQ(report["tasks"]["completed"], 5);
+    EXPECT_EQ(report["tasks"]["interrupted"], 5);
+    EXPECT_EQ(report["tasks"]["unfinished"], 0);
+    EXPECT_EQ(report["leaks"]["tasks"], 1);
+}
+
+TEST(LoadDriver, Drain)
+{
+    LoadDriver driver({.tasks = 3, .rate = 1000, .request = "{}", .drain_timeout = std::chrono::seconds(0)});
+
+    int next_task = 1;
+    auto report = Json::parse(driver.run({
+        .submit = [&](std::string_view /* request */) -> std::optional<int> { return next_task++; },
+        .interrupt = [](int /* task */) {},
+        .residue = [] { return LoadDriver::Residue{.tasks = 3, .flights = 3}; },
+    }));
+
+    EXPECT_EQ(report["tasks"]["unfinished"], 3);
+    EXPECT_EQ(report["leaks"]["flights"], 3);
+}
+
+#ifdef __linux__
+TEST(ProcessStats, Sample)
+{
+    auto stats = ytweb::ProcessStats::sample();
+    EXPECT_GT(stats.rss_bytes, 0);
+    EXPECT_GE(stats.threads, 1);
+    EXPECT_GE(stats.open_files, 3);
+}
+#endif
@@ -0,0 +1,171 @@
+#include "logger.h"
+
+#include "nlohmann/json.hpp"
+
+#include "gtest/gtest.h"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+using ytweb::Logger;
+using ytweb::LogLevel;
+using Json = nlohmann::json;
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+// Count how many times it is formatted.
+struct Counted
+{
+    int* count;
+};
+
+} // anonymous namespace
+
+template <>
+struct std::formatter<Counted> : std::formatter<std::string_view>
+{
+    auto format(Counted const& counted, std::format_context& ctx) const
+    {
+        ++*counted.count;
+        return std::formatter<std::string_view>::format("counted", ctx);
+    }
+};
+
+class LoggerTest : public ::testing::Test
+{
+  public:
+    std::mutex mutex;
+    std::vector<Json> messages;
+
+    Logger::Sink sink()
+    {
+        return [this](std::string_view batch) {
+            std::lock_guard lock(mutex);
+            for (auto& message : Json::parse(batch))
+            {
+                messages.push_back(std::move(message));
+            }
+        };
+    }
+
+    bool wait_for_messages(std::size_t count)
+    {
+        for (int i = 0; i < 500; ++i)
+        {
+            {
+                std::lock_guard lock(mutex);
+                if (messages.size() >= count)
+                {
+                    return true;
+                }
+            }
+            std::this_thread::sleep_for(10ms);
+        }
+        return false;
+    }
+};
+
+TEST_F(LoggerTest, SendInBatches)
+{
+    {
+        Logger logger(sink());
+        logger.info("Hello, {}!", "World");
+        logger.error("Error {}", 42);
+    }
+
+    ASSERT_EQ(messages.size(), 2);
+    EXPECT_EQ(messages[0]["level"], "info");
+    EXPECT_EQ(messages[0]["message"], "Hello, World!");
+    EXPECT_TRUE(messages[0]["time"].is_number_integer());
+    EXPECT_EQ(messages[1]["level"], "error");
+    EXPECT_EQ(messages[1]["message"], "Error 42");
+}
+
+TEST_F(LoggerTest, SkipDisabledLevels)
+{
+    int count = 0;
+    {
+        Logger logger(sink());
+        logger.set_level(LogLevel::Warning);
+
+        logger.debug("{}", Counted{&count});
+        logger.info("{}", Counted{&count});
+        logger.warning("{}", Counted{&count});
+
+        EXPECT_FALSE(logger.enabled(LogLevel::Info));
+        EXPECT_TRUE(logger.enabled(LogLevel::Error));
+    }
+
+    EXPECT_EQ(count, 1);
+    ASSERT_EQ(messages.size(), 1);
+    EXPECT_EQ(messages[0]["level"], "warning");
+}
+
+TEST_F(LoggerTest, DropWhenFull)
+{
+    {
+        Logger logger(sink(), {.capacity = 2, .flush_interval = 1h});
+        for (int i = 0; i < 5; ++i)
+        {
+            logger.info("{}", i);
+        }
+
+        // Nothing is flushed until the destruction.
+        EXPECT_EQ(logger.dropped(), 3);
+    }
+
+    ASSERT_EQ(messages.size(), 3);
+    EXPECT_EQ(messages[0]["message"], "0");
+    EXPECT_EQ(messages[1]["message"], "1");
+    EXPECT_EQ(messages[2]["level"], "warning");
+    EXPECT_EQ(messages[2]["message"], "3 log messages were dropped.");
+}
+
+TEST_F(LoggerTest, FlushInBackground)
+{
+    Logger logger(sink(), {.flush_interval = 1ms});
+    logger.info("Hello");
+
+    ASSERT_TRUE(wait_for_messages(1));
+    EXPECT_EQ(messages[0]["message"], "Hello");
+}
+
+TEST_F(LoggerTest, RotateLogFile)
+{
+    auto directory = fs::temp_directory_path() / "yt-dlp-web-test-logger";
+    fs::remove_all(directory);
+
+    auto path = directory / "yt-dlp-web.log";
+    auto read = [](fs::path const& path) {
+        std::ifstream file(path);
+        return std::string(std::istreambuf_iterator<char>(file), {});
+    };
+
+    {
+        Logger logger(sink(), {.flush_interval = 1ms});
+        ASSERT_TRUE(logger.set_file({.path = path, .max_bytes = 1, .max_files = 2}));
+
+        // One message per flush, so that each goes to its own file.
+        for (int i = 0; i < 4; ++i)
+        {
+            logger.info("Message {}", i);
+            ASSERT_TRUE(wait_for_messages(i + 1));
+        }
+    }
+
+    EXPECT_TRUE(read(path).ends_with("[info] Message 3\n"));
+    EXPECT_TRUE(read(path.string() + ".1").ends_with("[info] Message 2\n"));
+    EXPECT_TRUE(read(path.string() + ".2").ends_with("[info] Message 1\n"));
+    EXPECT_FALSE(fs::exists(path.string() + ".3"));
+
+    fs::remove_all(directory);
+}
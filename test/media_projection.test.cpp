@@ -0,0 +1,123 @@
+#include "media_projection.h"
+
+#include "nlohmann/json.hpp"
+
+#include "gtest/gtest.h"
+#include <fstream>
+#include <iterator>
+#include <string>
+
+using ytweb::project_media_info;
+using Json = nlohmann::json;
+
+namespace
+{
+
+Json project(std::string_view json)
+{
+    std::string out;
+    EXPECT_TRUE(project_media_info(json, out));
+    return Json::parse(out);
+}
+
+} // anonymous namespace
+
+TEST(MediaProjection, KeepRenderedFields)
+{
+    auto media = project(R"({
+        "id": "abc",
+        "title": "Title",
+        "duration_string": "1:23",
+        "view_count": 42,
+        "like_count": null,
+        "url": "https://example.com/video.mp4",
+        "http_headers": {"User-Agent": "yt-dlp"},
+        "thumbnails": [{"url": "https://example.com/1.jpg"}, {"url": "https://example.com/2.jpg"}]
+    })");
+
+    EXPECT_EQ(media, Json::parse(R"({
+        "title": "Title",
+        "duration_string": "1:23",
+        "view_count": 42,
+        "like_count": null
+    })"));
+}
+
+TEST(MediaProjection, TrimFormats)
+{
+    auto media = project(R"({
+        "formats": [
+            {"format_id": "140", "ext": "m4a", "abr": 129.5, "url": "https://example.com/140", "fragments": [{}]},
+            {"format_id": "137", "ext": "mp4", "fps": 30, "vcodec": "avc1", "http_headers": {"Accept": "*/*"}}
+        ],
+        "requested_formats": [
+            {"format_id": "137", "ext": "mp4"},
+            {"format_id": "140", "ext": "m4a"}
+        ]
+    })");
+
+    EXPECT_EQ(media, Json::parse(R"({
+        "formats": [
+            {"format_id": "140", "ext": "m4a", "abr": 129.5},
+            {"format_id": "137", "ext": "mp4", "fps": 30, "vcodec": "avc1"}
+        ],
+        "requested_formats": [
+            {"format_id": "137"},
+            {"format_id": "140"}
+        ]
+    })"));
+}
+
+TEST(MediaProjection, KeepNumbersAndStrings)
+{
+    std::string out;
+    ASSERT_TRUE(project_media_info(
+        R"({"title": "a \"quoted\"\n\u0001 标题 🎵", "view_count": 18446744073709551615, "duration_string": -1, "formats": [{"tbr": 1e3}]})",
+        out));
+
+    EXPECT_EQ(
+        out,
+        R"({"title":"a \"quoted\"\n\u0001 标题 🎵","view_count":18446744073709551615,"duration_string":-1,"formats":[{"tbr":1e3}]})");
+}
+
+TEST(MediaProjection, AppendToOutput)
+{
+    std::string out = "[";
+    ASSERT_TRUE(project_media_info(R"({"title": "a"})", out));
+    out += ",";
+    ASSERT_TRUE(project_media_info(R"({"title": "b"})", out));
+    out += "]";
+
+    EXPECT_EQ(out, R"([{"title":"a"},{"title":"b"}])");
+}
+
+TEST(MediaProjection, InvalidJson)
+{
+    std::string out = "prefix";
+    EXPECT_FALSE(project_media_info(R"({"title": "a", "formats": [)", out));
+    EXPECT_FALSE(project_media_info("", out));
+    EXPECT_EQ(out, "prefix");
+}
+
+TEST(MediaProjection, MediaInfoFixture)
+{
+    std::ifstream file(YT_DLP_WEB_MEDIA_INFO);
+    ASSERT_TRUE(file);
+    std::string json(std::istreambuf_iterator<char>(file), {});
+
+    auto full = Json::parse(json);
+    auto media = project(json);
+
+    EXPECT_EQ(media["title"], full["title"]);
+    EXPECT_EQ(media["webpage_url"], full["webpage_url"]);
+    EXPECT_FALSE(media.contains("thumbnails"));
+
+    ASSERT_EQ(media["formats"].size(), full["formats"].size());
+    for (std::size_t i = 0; i < media["formats"].size(); ++i)
+    {
+        EXPECT_EQ(media["formats"][i]["format_id"], full["formats"][i]["format_id"]);
+        EXPECT_FALSE(media["formats"][i].contains("url"));
+    }
+
+    EXPECT_LT(media.dump().size(), full.dump().size() / 2);
+}
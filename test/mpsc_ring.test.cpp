@@ -0,0 +1,71 @@
+#include "mpsc_ring.h"
+
+#include "gtest/gtest.h"
+#include <thread>
+#include <vector>
+
+using ytweb::MpscRing;
+
+TEST(MpscRing, PushAndPop)
+{
+    MpscRing<int> ring(3);
+    EXPECT_EQ(ring.capacity(), 4);
+
+    EXPECT_FALSE(ring.try_pop().has_value());
+
+    for (int i = 0; i < 4; ++i)
+    {
+        EXPECT_TRUE(ring.try_push(i));
+    }
+    EXPECT_FALSE(ring.try_push(4));
+
+    EXPECT_EQ(ring.try_pop(), 0);
+    EXPECT_TRUE(ring.try_push(4));
+
+    for (int i = 1; i <= 4; ++i)
+    {
+        EXPECT_EQ(ring.try_pop(), i);
+    }
+    EXPECT_FALSE(ring.try_pop().has_value());
+}
+
+// Run with TSAN to check for data races: `xmake f --policies=build.sanitizer.thread`.
+TEST(MpscRing, ManyProducers)
+{
+    constexpr int PRODUCERS = 4;
+    constexpr int COUNT = 2000;
+
+    MpscRing<int> ring(64);
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; ++p)
+    {
+        producers.emplace_back([&ring, p] {
+            for (int i = 0; i < COUNT; ++i)
+            {
+                while (!ring.try_push(p * COUNT + i))
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    // The values of each producer come out in order.
+    std::vector<int> next(PRODUCERS, 0);
+    for (int received = 0; received < PRODUCERS * COUNT;)
+    {
+        if (auto value = ring.try_pop())
+        {
+            int producer = *value / COUNT;
+            ASSERT_EQ(*value % COUNT, next[producer]++);
+            ++received;
+        }
+    }
+
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+    EXPECT_FALSE(ring.try_pop().has_value());
+}
@@ -0,0 +1,265 @@
+#include "preview_cache.h"
+
+#include "gtest/gtest.h"
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+using ytweb::PreviewCache;
+
+namespace fs = std::filesystem;
+
+TEST(PreviewCache, HitAndMiss)
+{
+    PreviewCache cache;
+
+    EXPECT_EQ(cache.get("a"), std::nullopt);
+
+    cache.put("a", "info of a");
+    EXPECT_EQ(cache.get("a"), "info of a");
+
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.hits, 1);
+    EXPECT_EQ(stats.misses, 1);
+    EXPECT_EQ(stats.entries, 1);
+    EXPECT_EQ(stats.bytes, 10);
+}
+
+TEST(PreviewCache, Peek)
+{
+    PreviewCache cache;
+
+    EXPECT_EQ(cache.peek("a"), std::nullopt);
+    cache.put("a", "info of a");
+    EXPECT_EQ(cache.peek("a"), "info of a");
+
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.hits, 0);
+    EXPECT_EQ(stats.misses, 0);
+}
+
+TEST(PreviewCache, Overwrite)
+{
+    PreviewCache cache;
+
+    cache.put("a", "old");
+    cache.put("a", "new");
+
+    EXPECT_EQ(cache.get("a"), "new");
+    EXPECT_EQ(cache.stats().entries, 1);
+}
+
+TEST(PreviewCache, EvictLeastRecentlyUsed)
+{
+    PreviewCache cache({.max_bytes = 20});
+
+    cache.put("a", "123456789"); // 10 bytes
+    cache.put("b", "123456789");
+    EXPECT_TRUE(cache.get("a").has_value()); // `b` becomes the least recently used
+
+    cache.put("c", "123456789");
+
+    EXPECT_TRUE(cache.get("a").has_value());
+    EXPECT_FALSE(cache.get("b").has_value());
+    EXPECT_TRUE(cache.get("c").has_value());
+    EXPECT_EQ(cache.stats().evictions, 1);
+}
+
+TEST(PreviewCache, TooLargeEntry)
+{
+    PreviewCache cache({.max_bytes = 4});
+
+    cache.put("a", "123456789");
+
+    EXPECT_FALSE(cache.get("a").has_value());
+    EXPECT_EQ(cache.stats().bytes, 0);
+}
+
+TEST(PreviewCache, TooLargeSingleEntry)
+{
+    PreviewCache cache({.max_bytes = 100, .max_entry_bytes = 4});
+
+    cache.put("a", "123456789");
+
+    EXPECT_FALSE(cache.get("a").has_value());
+}
+
+TEST(PreviewCache, Expire)
+{
+    PreviewCache cache({.ttl = 0s});
+
+    cache.put("a", "info of a");
+
+    EXPECT_FALSE(cache.get("a").has_value());
+    EXPECT_EQ(cache.stats().entries, 0);
+}
+
+TEST(PreviewCache, Persist)
+{
+    auto directory = fs::temp_directory_path() / "yt-dlp-web-preview-cache-test";
+    fs::remove_all(directory);
+
+    {
+        PreviewCache cache({.directory = directory});
+        cache.put("a", "info of a\nwith a new line");
+    }
+
+    PreviewCache cache({.directory = directory});
+    EXPECT_EQ(cache.get("a"), "info of a\nwith a new line");
+    EXPECT_FALSE(cache.get("b").has_value());
+
+    fs::remove_all(directory);
+}
+
+TEST(PreviewCache, PruneExpiredFiles)
+{
+    auto directory = fs::temp_directory_path() / "yt-dlp-web-preview-cache-test";
+    fs::remove_all(directory);
+
+    {
+        PreviewCache cache({.ttl = 0s, .directory = directory});
+        cache.put("a", "info of a");
+    }
+
+    PreviewCache cache({.directory = directory});
+    EXPECT_TRUE(fs::is_empty(directory));
+
+    fs::remove_all(directory);
+}
+
+namespace
+{
+
+auto files_in(fs::path const& directory)
+{
+    std::vector<fs::path> files;
+    for (auto const& file : fs::directory_iterator(directory))
+    {
+        files.push_back(file.path().filename());
+    }
+    return files;
+}
+
+} // anonymous namespace
+
+// The directory stays within the cap during a run, and at startup.
+TEST(PreviewCache, EvictFiles)
+{
+    auto directory = fs::temp_directory_path() / "yt-dlp-web-preview-cache-test";
+    fs::remove_all(directory);
+
+    {
+        PreviewCache cache({.max_bytes = 20, .directory = directory});
+        cache.put("a", "123456789");
+        cache.put("b", "123456789");
+        cache.put("c", "123456789"); // evicts `a`
+        EXPECT_EQ(files_in(directory).size(), 2);
+    }
+
+    // The files left are cold until loaded, and count towards the cap.
+    PreviewCache cache({.max_bytes = 20, .directory = directory});
+    EXPECT_EQ(cache.get("b"), "123456789");
+    cache.put("d", "123456789"); // evicts the file of `c`, which is not loaded
+
+    EXPECT_EQ(files_in(directory).size(), 2);
+    EXPECT_EQ(cache.get("c"), std::nullopt);
+    EXPECT_EQ(cache.get("b"), "123456789");
+    EXPECT_EQ(cache.get("d"), "123456789");
+
+    // At startup, the least recently used files beyond the cap are removed.
+    PreviewCache smaller({.max_bytes = 1, .directory = directory});
+    EXPECT_TRUE(fs::is_empty(directory));
+
+    fs::remove_all(directory);
+}
+
+TEST(PreviewCache, RemoveTemporaryFile)
+{
+    auto directory = fs::temp_directory_path() / "yt-dlp-web-preview-cache-test";
+    fs::remove_all(directory);
+
+    PreviewCache cache({.directory = directory});
+    cache.put("a", "info of a");
+    auto files = files_in(directory);
+    ASSERT_EQ(files.size(), 1);
+
+    // The file can't be replaced by a non-empty directory.
+    auto path = directory / files[0];
+    fs::remove(path);
+    fs::create_directories(path / "blocker");
+
+    cache.put("a", "new info of a");
+    EXPECT_EQ(files_in(directory), files);
+    EXPECT_EQ(cache.get("a"), "new info of a");
+
+    fs::remove_all(directory);
+}
+
+// Two keys whose files are the same.
+TEST(PreviewCache, HashCollision)
+{
+    constexpr std::string_view A = "c5bde799c2362419";
+    constexpr std::string_view B = "a1a9a9bf38687075";
+
+    auto directory = fs::temp_directory_path() / "yt-dlp-web-preview-cache-test";
+    fs::remove_all(directory);
+
+    {
+        PreviewCache cache({.max_bytes = 40, .directory = directory});
+        cache.put(A, "a");
+        cache.put(B, "b"); // kept in memory only
+        EXPECT_EQ(files_in(directory).size(), 1);
+        EXPECT_EQ(cache.get(B), "b");
+        EXPECT_EQ(cache.get(A), "a");
+
+        cache.put("c", "123456789"); // evicts `B`, not the file of `A`
+        EXPECT_EQ(cache.get(B), std::nullopt);
+    }
+
+    PreviewCache cache({.directory = directory});
+    EXPECT_EQ(cache.get(A), "a");
+    EXPECT_EQ(cache.get(B), std::nullopt);
+
+    fs::remove_all(directory);
+}
+
+TEST(PreviewCache, Concurrency)
+{
+    auto directory = fs::temp_directory_path() / "yt-dlp-web-preview-cache-test";
+    fs::remove_all(directory);
+
+    PreviewCache cache({.max_bytes = 1000, .directory = directory});
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i)
+    {
+        threads.emplace_back([&cache, i] {
+            for (int j = 0; j < 200; ++j)
+            {
+                auto key = std::to_string((i + j) % 20);
+                if (auto value = cache.get(key))
+                {
+                    EXPECT_EQ(*value, "info of " + key);
+                }
+                else
+                {
+                    cache.put(key, "info of " + key);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    // Each entry in memory has its file, and the files of evicted entries are gone.
+    auto stats = cache.stats();
+    EXPECT_EQ(files_in(directory).size(), stats.entries);
+    EXPECT_LE(stats.bytes, 1000);
+
+    fs::remove_all(directory);
+}
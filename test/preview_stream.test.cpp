@@ -0,0 +1,179 @@
+#include "preview_stream.h"
+
+#include "nlohmann/json.hpp"
+
+#include "gtest/gtest.h"
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+using ytweb::PreviewFanOut;
+using ytweb::PreviewStream;
+using Json = nlohmann::json;
+
+class PreviewStreamTest : public ::testing::Test
+{
+  public:
+    std::vector<Json> batches;
+
+    PreviewStream::Sender sender()
+    {
+        return [this](std::string_view batch) { batches.push_back(Json::parse(batch)); };
+    }
+};
+
+TEST_F(PreviewStreamTest, FirstEntryIsSentAtOnce)
+{
+    PreviewStream stream(1, sender(), {.max_entries = 2, .max_delay = 1h});
+
+    stream.append(R"({"title": "a"})");
+    ASSERT_EQ(batches.size(), 1);
+    EXPECT_EQ(batches[0], Json::parse(R"({"task_id": 1, "first": true, "entries": [{"title": "a"}]})"));
+
+    stream.append(R"({"title": "b"})");
+    EXPECT_EQ(batches.size(), 1);
+
+    stream.append(R"({"title": "c"})");
+    ASSERT_EQ(batches.size(), 2);
+    EXPECT_EQ(batches[1], Json::parse(R"({"task_id": 1, "first": false, "entries": [{"title": "b"}, {"title": "c"}]})"));
+
+    stream.append(R"({"title": "d"})");
+    stream.finish();
+    ASSERT_EQ(batches.size(), 3);
+    EXPECT_EQ(batches[2]["entries"], Json::parse(R"([{"title": "d"}])"));
+}
+
+TEST_F(PreviewStreamTest, SendWhenTooLarge)
+{
+    PreviewStream stream(1, sender(), {.max_entries = 100, .max_bytes = 64, .max_delay = 1h});
+
+    stream.append(R"({"title": "a"})");
+    stream.append(R"({"title": "b"})");
+    EXPECT_EQ(batches.size(), 1);
+
+    stream.append(R"({"title": "a long title which makes the batch too large"})");
+    EXPECT_EQ(batches.size(), 2);
+}
+
+TEST_F(PreviewStreamTest, SendWhenDelayed)
+{
+    PreviewStream stream(1, sender(), {.max_entries = 100, .max_delay = 0ms});
+
+    stream.append(R"({"title": "a"})");
+    stream.append(R"({"title": "b"})");
+
+    EXPECT_EQ(batches.size(), 2);
+}
+
+// Pending entries are sent once due, without waiting for the next entry.
+TEST_F(PreviewStreamTest, FlushWhenDue)
+{
+    PreviewStream stream(1, sender(), {.max_entries = 100, .max_delay = 20ms});
+
+    stream.append(R"({"title": "a"})");
+    EXPECT_FALSE(stream.deadline().has_value());
+
+    stream.append(R"({"title": "b"})");
+    auto deadline = stream.deadline();
+    ASSERT_TRUE(deadline.has_value());
+    stream.flush_due();
+    EXPECT_EQ(batches.size(), 1);
+
+    std::this_thread::sleep_until(*deadline);
+    stream.flush_due();
+    ASSERT_EQ(batches.size(), 2);
+    EXPECT_EQ(batches[1]["entries"], Json::parse(R"([{"title": "b"}])"));
+    EXPECT_FALSE(stream.deadline().has_value());
+}
+
+TEST_F(PreviewStreamTest, EmptyPreview)
+{
+    PreviewStream stream(1, sender());
+
+    stream.append("");
+    stream.finish();
+
+    ASSERT_EQ(batches.size(), 1);
+    EXPECT_EQ(batches[0], Json::parse(R"({"task_id": 1, "first": true, "entries": []})"));
+}
+
+TEST_F(PreviewStreamTest, ProjectEntries)
+{
+    PreviewStream stream(1, sender());
+
+    stream.append(R"({"title": "a", "url": "https://example.com/a.mp4"})");
+    stream.append("not a json");
+    stream.append(R"({"title": "b", "http_headers": {}})");
+    stream.finish();
+
+    ASSERT_EQ(batches.size(), 2);
+    EXPECT_EQ(batches[0]["entries"], Json::parse(R"([{"title": "a"}])"));
+    EXPECT_EQ(batches[1]["entries"], Json::parse(R"([{"title": "b"}])"));
+}
+
+TEST_F(PreviewStreamTest, KeepEntries)
+{
+    PreviewFanOut fan_out([this](int id) { return PreviewStream(id, sender()); }, 1024);
+
+    fan_out.append({1}, R"({"title": "a", "url": "https://example.com/a.mp4"})");
+    fan_out.append({1}, R"({"title": "b"})");
+    fan_out.finish({1});
+
+    EXPECT_EQ(batches.size(), 2);
+    EXPECT_EQ(fan_out.kept(), "{\"title\": \"a\", \"url\": \"https://example.com/a.mp4\"}\n{\"title\": \"b\"}");
+}
+
+TEST_F(PreviewStreamTest, ReplayToLateSubscriber)
+{
+    PreviewFanOut fan_out([this](int id) { return PreviewStream(id, sender()); }, 1024);
+
+    fan_out.append({1}, R"({"title": "a"})");
+    fan_out.append({1, 2}, R"({"title": "b"})");
+    fan_out.finish({1, 2});
+
+    std::vector<Json> entries;
+    for (auto const& batch : batches)
+    {
+        if (batch["task_id"] == 2)
+        {
+            entries.insert(entries.end(), batch["entries"].begin(), batch["entries"].end());
+        }
+    }
+    EXPECT_EQ(entries, (std::vector{Json::parse(R"({"title": "a"})"), Json::parse(R"({"title": "b"})")}));
+}
+
+TEST_F(PreviewStreamTest, ArmOnce)
+{
+    PreviewFanOut fan_out(
+        [this](int id) { return PreviewStream(id, sender(), {.max_entries = 100, .max_delay = 20ms}); }, 1024
+    );
+
+    fan_out.append({1}, R"({"title": "a"})");
+    EXPECT_FALSE(fan_out.arm({1}).has_value()); // sent at once
+
+    fan_out.append({1}, R"({"title": "b"})");
+    auto when = fan_out.arm({1});
+    ASSERT_TRUE(when.has_value());
+    fan_out.append({1}, R"({"title": "c"})");
+    EXPECT_FALSE(fan_out.arm({1}).has_value()); // armed already
+
+    std::this_thread::sleep_until(*when);
+    fan_out.on_timer({1});
+    ASSERT_EQ(batches.size(), 2);
+    EXPECT_EQ(batches[1]["entries"], Json::parse(R"([{"title": "b"}, {"title": "c"}])"));
+    EXPECT_FALSE(fan_out.arm({1}).has_value());
+}
+
+TEST_F(PreviewStreamTest, DropKeptEntriesBeyondLimit)
+{
+    PreviewFanOut fan_out([this](int id) { return PreviewStream(id, sender()); }, 16);
+
+    fan_out.append({1}, R"({"title": "a"})");
+    fan_out.append({1}, R"({"title": "b"})");
+    fan_out.finish({1});
+
+    EXPECT_FALSE(fan_out.kept().has_value());
+    EXPECT_EQ(batches.size(), 2);
+}
@@ -0,0 +1,81 @@
+#include "progress.h"
+
+#include "nlohmann/json.hpp"
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <string>
+
+using ytweb::decode_progress;
+using ytweb::encode_progress;
+using Json = nlohmann::json;
+
+TEST(Progress, Decode)
+{
+    auto progress = decode_progress("downloading|1024|4096|512.5|6|3|/tmp/a|b.mp4");
+
+    ASSERT_TRUE(progress.has_value());
+    EXPECT_EQ(progress->status, "downloading");
+    EXPECT_EQ(progress->downloaded_bytes, 1024);
+    EXPECT_EQ(progress->total_bytes, 4096);
+    EXPECT_EQ(progress->speed, 512.5);
+    EXPECT_EQ(progress->eta, 6);
+    EXPECT_EQ(progress->fragment_index, 3);
+    EXPECT_EQ(progress->filename, "/tmp/a|b.mp4");
+    EXPECT_FALSE(progress->terminal());
+}
+
+TEST(Progress, DecodeMissingFields)
+{
+    auto progress = decode_progress("finished|2048.0|NA|NA|NA|NA|NA");
+
+    ASSERT_TRUE(progress.has_value());
+    EXPECT_EQ(progress->status, "finished");
+    EXPECT_EQ(progress->downloaded_bytes, 2048);
+    EXPECT_FALSE(progress->total_bytes.has_value());
+    EXPECT_FALSE(progress->speed.has_value());
+    EXPECT_FALSE(progress->eta.has_value());
+    EXPECT_FALSE(progress->fragment_index.has_value());
+    EXPECT_EQ(progress->filename, "");
+    EXPECT_TRUE(progress->terminal());
+}
+
+TEST(Progress, DecodeMalformed)
+{
+    EXPECT_FALSE(decode_progress(""));
+    EXPECT_FALSE(decode_progress("downloading|1024|4096"));
+    EXPECT_FALSE(decode_progress("|1024|4096|512.5|6|3|a.mp4"));
+    EXPECT_FALSE(decode_progress("downloading|many|4096|512.5|6|3|a.mp4"));
+    EXPECT_FALSE(decode_progress("downloading|1024|4096|inf|6|3|a.mp4"));
+    EXPECT_FALSE(decode_progress("downloading|-1|4096|512.5|6|3|a.mp4"));
+    EXPECT_FALSE(decode_progress(R"({"status": "downloading"})"));
+}
+
+TEST(Progress, Encode)
+{
+    auto progress = decode_progress("downloading|1024|NA|512.5|6|NA|\"quoted\".mp4");
+    ASSERT_TRUE(progress.has_value());
+
+    std::string out;
+    encode_progress(*progress, 7, out);
+
+    EXPECT_EQ(Json::parse(out), Json::parse(R"({
+        "task_id": 7,
+        "status": "downloading",
+        "downloaded_bytes": 1024,
+        "total_bytes": null,
+        "speed": 512.5,
+        "eta": 6,
+        "fragment_index": null,
+        "filename": "\"quoted\".mp4"
+    })"));
+}
+
+TEST(Progress, TemplateFields)
+{
+    std::string_view fields = ytweb::PROGRESS_TEMPLATE;
+
+    ASSERT_TRUE(fields.starts_with(std::string("download:") + std::string(ytweb::PROGRESS_PREFIX)));
+    EXPECT_EQ(std::count(fields.begin(), fields.end(), '|'), 6);
+    EXPECT_TRUE(fields.ends_with("%(progress.filename)s"));
+}
@@ -0,0 +1,128 @@
+#include "progress_coalescer.h"
+
+#include "nlohmann/json.hpp"
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+using ytweb::ProgressCoalescer;
+using Json = nlohmann::json;
+
+class ProgressCoalescerTest : public ::testing::Test
+{
+  public:
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<Json> batches;
+    std::vector<bool> terminal;
+
+    ProgressCoalescer::Sender sender()
+    {
+        return [this](std::string_view batch, bool is_terminal) {
+            {
+                std::lock_guard lock(mutex);
+                batches.push_back(Json::parse(batch));
+                terminal.push_back(is_terminal);
+            }
+            cv.notify_all();
+        };
+    }
+
+    static std::string progress(int id, std::string_view status, int bytes)
+    {
+        return Json{{"task_id", id}, {"status", status}, {"downloaded_bytes", bytes}}.dump();
+    }
+
+    // The batch sorted by task, as tasks are flushed in no particular order.
+    static Json sorted(Json batch)
+    {
+        std::stable_sort(batch.begin(), batch.end(), [](Json const& a, Json const& b) {
+            return a["task_id"] < b["task_id"];
+        });
+        return batch;
+    }
+};
+
+TEST_F(ProgressCoalescerTest, KeepLatestProgress)
+{
+    ProgressCoalescer coalescer(sender(), 1h);
+
+    coalescer.update(1, progress(1, "downloading", 10));
+    coalescer.update(2, progress(2, "downloading", 20));
+    coalescer.update(1, progress(1, "downloading", 30));
+    coalescer.flush();
+
+    ASSERT_EQ(batches.size(), 1);
+    EXPECT_EQ(
+        sorted(batches[0]),
+        Json::parse(R"([
+            {"task_id": 1, "status": "downloading", "downloaded_bytes": 30},
+            {"task_id": 2, "status": "downloading", "downloaded_bytes": 20}
+        ])")
+    );
+    EXPECT_FALSE(terminal[0]);
+}
+
+TEST_F(ProgressCoalescerTest, DeliverTerminalProgress)
+{
+    ProgressCoalescer coalescer(sender(), 1h);
+
+    coalescer.update(1, progress(1, "downloading", 10));
+    coalescer.update(1, progress(1, "finished", 100), true);
+    coalescer.update(1, progress(1, "downloading", 5));
+    coalescer.update(1, progress(1, "downloading", 50));
+    coalescer.update(1, progress(1, "finished", 200), true);
+    coalescer.update(1, progress(1, "downloading", 1));
+    coalescer.flush();
+
+    ASSERT_EQ(batches.size(), 1);
+    EXPECT_EQ(
+        batches[0],
+        Json::parse(R"([
+            {"task_id": 1, "status": "finished", "downloaded_bytes": 100},
+            {"task_id": 1, "status": "finished", "downloaded_bytes": 200},
+            {"task_id": 1, "status": "downloading", "downloaded_bytes": 1}
+        ])")
+    );
+    EXPECT_TRUE(terminal[0]);
+}
+
+TEST_F(ProgressCoalescerTest, NothingToFlush)
+{
+    ProgressCoalescer coalescer(sender(), 1h);
+
+    coalescer.flush();
+    coalescer.update(1, progress(1, "downloading", 10));
+    coalescer.flush();
+    coalescer.flush();
+
+    EXPECT_EQ(batches.size(), 1);
+}
+
+TEST_F(ProgressCoalescerTest, FlushOnTick)
+{
+    ProgressCoalescer coalescer(sender(), 10ms);
+
+    coalescer.update(1, progress(1, "downloading", 10));
+
+    std::unique_lock lock(mutex);
+    ASSERT_TRUE(cv.wait_for(lock, 5s, [this] { return !batches.empty(); }));
+    EXPECT_EQ(batches[0], Json::parse(R"([{"task_id": 1, "status": "downloading", "downloaded_bytes": 10}])"));
+}
+
+TEST_F(ProgressCoalescerTest, FlushOnDestruction)
+{
+    {
+        ProgressCoalescer coalescer(sender(), 1h);
+        coalescer.update(1, progress(1, "finished", 10), true);
+    }
+
+    ASSERT_EQ(batches.size(), 1);
+    EXPECT_EQ(batches[0], Json::parse(R"([{"task_id": 1, "status": "finished", "downloaded_bytes": 10}])"));
+}
@@ -3,9 +3,12 @@
 #include "boost/process/v2/environment.hpp"
 #include "exception.h"
 #include "nlohmann/json.hpp"
+#include "progress.h"
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <filesystem>
 #include <format>
 #include <string>
 
@@ -95,6 +98,34 @@ TEST(Request, InvalidJSON)
     EXPECT_THROW(Request request(json), ParseError);
 }
 
+TEST(Request, InvalidFields)
+{
+    EXPECT_THROW(Request(R"({"action": 1, "url_input": "a"})"), ParseError);
+    EXPECT_THROW(Request(R"({"action": "download", "url_input": ["a"]})"), ParseError);
+    EXPECT_THROW(Request(R"({"action": "download", "url_input": "a", "yt_dlp_path": null})"), ParseError);
+    EXPECT_THROW(Request(R"({"action": "download", "url_input": "a", "priority": 1})"), ParseError);
+    EXPECT_THROW(Request(R"({"action": "download", "url_input": "a", "priority": "urgent"})"), ParseError);
+}
+
+TEST(Request, InvalidOptions)
+{
+    EXPECT_THROW(make_args(R"({"proxy": 7890})"), ParseError);
+    EXPECT_THROW(make_args(R"({"filters": {"duration": "<60"}})"), ParseError);
+    EXPECT_THROW(make_args(R"({"filters": ["duration < 60", 60]})"), ParseError);
+    EXPECT_THROW(make_args(R"({"force_ip_protocol": "ipv5"})"), ParseError);
+    EXPECT_THROW(make_args(R"({"no_part": ["on"]})"), ParseError);
+}
+
+TEST(Request, DisabledOptions)
+{
+    auto args = make_args(R"({"no_part": false, "force_ip_protocol": "", "filters": []})");
+
+    EXPECT_THAT(args, testing::Not(HasOption("--no-part")));
+    EXPECT_THAT(args, testing::Not(HasOption("--force-ipv4")));
+    EXPECT_THAT(args, testing::Not(HasOption("--force-ipv6")));
+    EXPECT_THAT(args, testing::Not(HasOption("--match-filters")));
+}
+
 TEST(Request, CookiesOptions)
 {
     auto args = make_args(R"json({
@@ -301,3 +332,149 @@ TEST(Request, OutputOptions)
     EXPECT_THAT(args, HasOption("--windows-filenames"));
     EXPECT_THAT(args, HasArgumentOption("--trim-filename", "50"));
 }
+
+TEST(Request, PriorityOption)
+{
+    auto priority = [](std::string_view json) {
+        Json data = Json::parse(json);
+        data.emplace("action", "download");
+        data.emplace("url_input", "http://example.com");
+        return Request(data.dump()).priority();
+    };
+
+    EXPECT_EQ(priority(R"({})"), Request::Priority::Normal);
+    EXPECT_EQ(priority(R"({"priority": "high"})"), Request::Priority::High);
+    EXPECT_EQ(priority(R"({"priority": "low"})"), Request::Priority::Low);
+    EXPECT_EQ(priority(R"({"priority": "normal"})"), Request::Priority::Normal);
+    EXPECT_EQ(priority(R"({"priority": ""})"), Request::Priority::Normal);
+}
+
+TEST(Request, AudioOnlyOption)
+{
+    auto args = [](std::string_view action, std::string_view json) {
+        Json data = Json::parse(json);
+        data.emplace("action", action);
+        data.emplace("url_input", "http://example.com");
+        return Request(data.dump()).args();
+    };
+
+    EXPECT_THAT(args("download", R"({"audio_only": true})"), HasOption("--extract-audio"));
+    EXPECT_THAT(args("download", R"({"audio_only": false})"), testing::Not(HasOption("--extract-audio")));
+    EXPECT_THAT(args("preview", R"({"audio_only": true})"), testing::Not(HasOption("--extract-audio")));
+    EXPECT_THROW(args("download", R"({"audio_only": [true]})"), ParseError);
+}
+
+TEST(Request, ExtractionKey)
+{
+    auto key = [](std::string_view action, std::string_view json) {
+        Json data = Json::parse(json);
+        data.emplace("action", action);
+        data.emplace("url_input", "http://example.com");
+        return Request(data.dump()).extraction_key();
+    };
+
+    // The same media is identified by a preview and a download.
+    EXPECT_EQ(
+        key("preview", R"({"proxy": "socks5://127.0.0.1:7890"})"),
+        key("download", R"({"proxy": "socks5://127.0.0.1:7890"})")
+    );
+
+    // Download options don't change the extracted information.
+    EXPECT_EQ(key("preview", R"({})"), key("download", R"({"limit_rate": "1M", "audio_only": true})"));
+
+    EXPECT_NE(key("preview", R"({})"), key("preview", R"({"proxy": "socks5://127.0.0.1:7890"})"));
+    EXPECT_NE(key("preview", R"({})"), key("preview", R"({"cookies_from_browser": "chrome"})"));
+    EXPECT_NE(key("preview", R"({})"), key("preview", R"({"is_playlist": "no"})"));
+    EXPECT_NE(key("preview", R"({"yt_dlp_path": "/a/yt-dlp"})"), key("preview", R"({"yt_dlp_path": "/b/yt-dlp"})"));
+}
+
+TEST(Request, OutputKey)
+{
+    auto key = [](std::string_view action, std::string_view json) {
+        Json data = Json::parse(json);
+        data.emplace("action", action);
+        data.emplace("url_input", "http://example.com");
+        return Request(data.dump()).output_key();
+    };
+
+    EXPECT_EQ(key("preview", R"({})"), "");
+
+    // Other options don't change where a download writes.
+    EXPECT_EQ(
+        key("download", R"({"output_path": "out", "output_filename": "%(title)s.%(ext)s", "limit_rate": "1M"})"),
+        key("download", R"({"output_path": "./out/", "output_filename": "%(title)s.%(ext)s", "audio_only": true})")
+    );
+    EXPECT_EQ(
+        key("download", R"({})"),
+        key("download", std::format(R"({{"output_path": "home:{}"}})", std::filesystem::current_path().string()))
+    );
+
+    EXPECT_NE(key("download", R"({})"), key("download", R"({"output_path": "out"})"));
+    EXPECT_NE(key("download", R"({})"), key("download", R"({"output_filename": "%(id)s.%(ext)s"})"));
+    EXPECT_NE(key("download", R"({"output_path": "out"})"), key("download", R"({"output_path": "temp:out"})"));
+    EXPECT_NE(key("download", R"({})"), key("download", R"({"url_input": "http://example.com/other"})"));
+}
+
+TEST(Request, LoadInfoJson)
+{
+    Request request(R"json({"action": "download", "url_input": "https://example.com/video", "proxy": "1.2.3.4"})json");
+    auto key = request.extraction_key();
+
+    ASSERT_TRUE(request.can_load_info_json());
+    request.load_info_json("/tmp/info.json");
+
+    EXPECT_FALSE(request.can_load_info_json());
+    EXPECT_THAT(request.args(), HasArgumentOption("--load-info-json", "/tmp/info.json"));
+    EXPECT_THAT(request.args(), testing::Not(HasOption("https://example.com/video")));
+    EXPECT_THAT(request.args(), HasArgumentOption("--proxy", "1.2.3.4"));
+    EXPECT_EQ(request.extraction_key(), key);
+}
+
+TEST(Request, CannotLoadInfoJson)
+{
+    EXPECT_FALSE(Request(R"({"action": "download", "url_input": "", "batch_file": "urls.txt"})").can_load_info_json());
+    EXPECT_FALSE(Request(R"({"action": "download", "url_input": "", "load_info_json": "a.json"})").can_load_info_json());
+}
+
+TEST(Request, DownloadProgressTemplate)
+{
+    Request request(R"json({"action": "download", "url_input": "https://example.com/video"})json");
+
+    EXPECT_THAT(request.args(), HasOption("--newline"));
+    EXPECT_THAT(request.args(), HasArgumentOption("--progress-template", std::string(ytweb::PROGRESS_TEMPLATE)));
+}
+
+TEST(Request, ServeDownloadArchive)
+{
+    Request request(R"({"action": "download", "url_input": "", "batch_file": "urls.txt",
+                        "download_archive": "archive.txt"})");
+    EXPECT_EQ(request.url(), "");
+    EXPECT_EQ(request.download_archive(), "archive.txt");
+    EXPECT_EQ(request.batch_file(), "urls.txt");
+    EXPECT_FALSE(request.has_playlist_items());
+
+    request.drop_download_archive();
+    EXPECT_EQ(request.download_archive(), "");
+    EXPECT_THAT(request.args(), testing::Not(HasOption("--download-archive")));
+    EXPECT_THAT(request.args(), testing::Not(HasOption("archive.txt")));
+
+    request.set_batch_file("filtered.txt");
+    EXPECT_EQ(request.batch_file(), "filtered.txt");
+    EXPECT_THAT(request.args(), HasArgumentOption("--batch-file", "filtered.txt"));
+    EXPECT_THAT(request.args(), testing::Not(HasOption("urls.txt")));
+
+    request.set_playlist_items("1,3");
+    EXPECT_TRUE(request.has_playlist_items());
+    EXPECT_THAT(request.args(), HasArgumentOption("--playlist-items", "1,3"));
+}
+
+TEST(Request, ContinuePartial)
+{
+    Request request(R"({"action": "download", "url_input": "https://example.com", "no_continue": true})");
+    EXPECT_THAT(request.args(), HasOption("--no-continue"));
+
+    request.continue_partial();
+    request.continue_partial();
+    EXPECT_THAT(request.args(), testing::Not(HasOption("--no-continue")));
+    EXPECT_EQ(std::ranges::count(request.args(), "--continue"), 1);
+}
@@ -0,0 +1,89 @@
+#include "single_flight.h"
+
+#include "gtest/gtest.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using ytweb::SingleFlight;
+
+TEST(SingleFlight, JoinSameKey)
+{
+    SingleFlight flights;
+
+    EXPECT_EQ(flights.join("a", 1), 1);
+    EXPECT_EQ(flights.join("a", 2), 1);
+    EXPECT_EQ(flights.join("b", 3), 3);
+
+    EXPECT_EQ(flights.size(), 2);
+    EXPECT_EQ(flights.subscribers(1), (std::vector<int>{1, 2}));
+    EXPECT_EQ(flights.subscribers(3), std::vector<int>{3});
+    EXPECT_EQ(flights.task_of(2), 1);
+    EXPECT_EQ(flights.task_of(4), std::nullopt);
+}
+
+TEST(SingleFlight, Land)
+{
+    SingleFlight flights;
+    flights.join("a", 1);
+    flights.join("a", 2);
+
+    EXPECT_EQ(flights.land(1), (std::vector<int>{1, 2}));
+    EXPECT_TRUE(flights.subscribers(1).empty());
+    EXPECT_EQ(flights.task_of(2), std::nullopt);
+    EXPECT_EQ(flights.size(), 0);
+
+    // A new flight once the last one has landed.
+    EXPECT_EQ(flights.join("a", 3), 3);
+    EXPECT_TRUE(flights.land(1).empty());
+}
+
+TEST(SingleFlight, Leave)
+{
+    SingleFlight flights;
+    flights.join("a", 1);
+    flights.join("a", 2);
+
+    // The task goes on for the others, even if its own request leaves.
+    auto departure = flights.leave(1);
+    ASSERT_TRUE(departure);
+    EXPECT_EQ(departure->task, 1);
+    EXPECT_FALSE(departure->last);
+    EXPECT_EQ(flights.subscribers(1), std::vector<int>{2});
+    EXPECT_FALSE(flights.leave(1));
+
+    departure = flights.leave(2);
+    ASSERT_TRUE(departure);
+    EXPECT_EQ(departure->task, 1);
+    EXPECT_TRUE(departure->last);
+
+    // The abandoned task is not shared anymore.
+    EXPECT_EQ(flights.size(), 0);
+    EXPECT_EQ(flights.join("a", 3), 3);
+}
+
+TEST(SingleFlight, ConcurrentJoin)
+{
+    SingleFlight flights;
+
+    constexpr int THREADS = 8;
+    std::atomic<int> leaders{0};
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < THREADS; ++i)
+    {
+        threads.emplace_back([&, i] {
+            if (flights.join("a", i) == i)
+            {
+                ++leaders;
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_EQ(leaders, 1);
+    EXPECT_EQ(flights.land(*flights.task_of(0)).size(), THREADS);
+}
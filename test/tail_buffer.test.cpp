@@ -0,0 +1,32 @@
+#include "tail_buffer.h"
+
+#include "gtest/gtest.h"
+#include <string>
+
+using ytweb::TailBuffer;
+
+TEST(TailBuffer, KeepLastLines)
+{
+    TailBuffer tail(10);
+    EXPECT_TRUE(tail.empty());
+
+    tail.append("first");
+    tail.append("second");
+    EXPECT_EQ(tail.str(), "second");
+    EXPECT_EQ(tail.dropped(), 1);
+
+    tail.append("");
+    tail.append("3rd");
+    EXPECT_EQ(tail.str(), "second\n\n3rd");
+}
+
+TEST(TailBuffer, LongLine)
+{
+    TailBuffer tail(4);
+
+    tail.append("a");
+    tail.append("abcdefgh");
+
+    EXPECT_EQ(tail.str(), "efgh");
+    EXPECT_EQ(tail.dropped(), 1);
+}
@@ -0,0 +1,218 @@
+#include "task_journal.h"
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+auto count_lines(fs::path const& path)
+{
+    std::ifstream stream(path);
+    std::stringstream content;
+    content << stream.rdbuf();
+    auto text = content.str();
+    return std::ranges::count(text, '\n');
+}
+
+} // anonymous namespace
+
+class TaskJournal : public ::testing::Test
+{
+  public:
+    fs::path path = fs::temp_directory_path() / "yt-dlp-web-task-journal-test.jsonl";
+
+    auto options() const
+    {
+        return ytweb::TaskJournal::Options{.path = path, .sync_interval = 10ms, .checkpoint_interval = 1h};
+    }
+
+    void SetUp() override
+    {
+        fs::remove(path);
+    }
+
+    void TearDown() override
+    {
+        fs::remove(path);
+    }
+};
+
+TEST_F(TaskJournal, Replay)
+{
+    {
+        ytweb::TaskJournal journal(options());
+        EXPECT_EQ(journal.run(), 0);
+        EXPECT_TRUE(journal.unfinished().empty());
+
+        journal.enqueued(0, R"({"url": "a"})");
+        journal.enqueued(1, R"({"url": "b"})");
+        journal.enqueued(2, R"({"url": "c"})");
+        journal.started(1);
+        journal.checkpoint(1, 1024, 4096, "b.mp4");
+        journal.started(2);
+        journal.completed(2);
+    }
+
+    ytweb::TaskJournal journal(options());
+    EXPECT_EQ(journal.run(), 1);
+    EXPECT_EQ(journal.skipped(), 0);
+
+    auto unfinished = journal.unfinished();
+    ASSERT_EQ(unfinished.size(), 2);
+
+    EXPECT_EQ(unfinished[0].key, (ytweb::TaskJournal::Key{0, 0}));
+    EXPECT_EQ(unfinished[0].request, R"({"url": "a"})");
+    EXPECT_FALSE(unfinished[0].started);
+    EXPECT_FALSE(unfinished[0].checkpoint);
+
+    EXPECT_EQ(unfinished[1].key, (ytweb::TaskJournal::Key{0, 1}));
+    EXPECT_TRUE(unfinished[1].started);
+    ASSERT_TRUE(unfinished[1].checkpoint);
+    EXPECT_EQ(unfinished[1].checkpoint->downloaded_bytes, 1024);
+    EXPECT_EQ(unfinished[1].checkpoint->total_bytes, 4096);
+    EXPECT_EQ(unfinished[1].checkpoint->filename, "b.mp4");
+}
+
+TEST_F(TaskJournal, Resume)
+{
+    {
+        ytweb::TaskJournal journal(options());
+        journal.enqueued(0, "a");
+        journal.enqueued(1, "b");
+        journal.interrupted(1);
+    }
+    {
+        ytweb::TaskJournal journal(options());
+        auto unfinished = journal.unfinished();
+        ASSERT_EQ(unfinished.size(), 1);
+
+        // Ids restart in a new run, and don't clash with the previous one.
+        journal.enqueued(0, unfinished[0].request, unfinished[0].key);
+        EXPECT_TRUE(journal.unfinished().empty());
+    }
+
+    // Still unfinished, as a task of the second run.
+    ytweb::TaskJournal journal(options());
+    EXPECT_EQ(journal.run(), 2);
+    auto unfinished = journal.unfinished();
+    ASSERT_EQ(unfinished.size(), 1);
+    EXPECT_EQ(unfinished[0].key, (ytweb::TaskJournal::Key{1, 0}));
+    EXPECT_EQ(unfinished[0].request, "a");
+}
+
+TEST_F(TaskJournal, TornRecord)
+{
+    std::ofstream(path) << R"({"run":0,"id":0,"event":"enqueued","request":"a"})" "\n"
+                        << R"({"run":0,"id":1,"event":"enqueued","request":"b"})" "\n"
+                        << R"({"run":0,"id":0,"event":"comp)";
+
+    ytweb::TaskJournal journal(options());
+    EXPECT_EQ(journal.skipped(), 1);
+    EXPECT_EQ(journal.unfinished().size(), 2);
+}
+
+TEST_F(TaskJournal, Compact)
+{
+    auto opts = options();
+    opts.compact_after = 100;
+    {
+        ytweb::TaskJournal journal(opts);
+        for (int i = 0; i < 1000; ++i)
+        {
+            journal.enqueued(i, "request");
+            journal.started(i);
+            if (i % 100 != 0)
+            {
+                journal.completed(i);
+            }
+        }
+        journal.sync();
+    }
+
+    // Only the unfinished tasks are left.
+    EXPECT_EQ(count_lines(path), 20);
+
+    ytweb::TaskJournal journal(opts);
+    auto unfinished = journal.unfinished();
+    ASSERT_EQ(unfinished.size(), 10);
+    EXPECT_TRUE(std::ranges::is_sorted(unfinished, {}, [](auto const& task) { return task.key.id; }));
+    EXPECT_TRUE(std::ranges::all_of(unfinished, &ytweb::TaskJournal::Unfinished::started));
+}
+
+TEST_F(TaskJournal, CompactionFails)
+{
+    // The journal can't be written aside.
+    auto blocker = fs::path(path).concat(".compact");
+    fs::create_directories(blocker / "blocker");
+
+    auto opts = options();
+    opts.compact_after = 10;
+    {
+        ytweb::TaskJournal journal(opts);
+        for (int i = 0; i < 20; ++i)
+        {
+            journal.enqueued(i, "request");
+        }
+        journal.sync();
+        EXPECT_EQ(count_lines(path), 20);
+
+        journal.completed(0);
+    }
+
+    ytweb::TaskJournal journal(opts);
+    EXPECT_EQ(journal.unfinished().size(), 19);
+
+    fs::remove_all(blocker);
+}
+
+TEST_F(TaskJournal, ThrottleCheckpoints)
+{
+    {
+        ytweb::TaskJournal journal(options());
+        journal.enqueued(0, "a");
+        for (std::uint64_t i = 1; i <= 100; ++i)
+        {
+            journal.checkpoint(0, i, std::nullopt, "a.mp4");
+        }
+        journal.sync();
+
+        // The first one is recorded at once, the others are only kept for compaction.
+        EXPECT_EQ(count_lines(path), 2);
+    }
+
+    ytweb::TaskJournal journal(options());
+    auto unfinished = journal.unfinished();
+    ASSERT_EQ(unfinished.size(), 1);
+    ASSERT_TRUE(unfinished[0].checkpoint);
+    EXPECT_EQ(unfinished[0].checkpoint->downloaded_bytes, 100);
+    EXPECT_FALSE(unfinished[0].checkpoint->total_bytes);
+}
+
+TEST_F(TaskJournal, Close)
+{
+    {
+        ytweb::TaskJournal journal(options());
+        journal.enqueued(0, "a");
+        journal.enqueued(1, "b");
+        journal.completed(0);
+        journal.close();
+
+        // Killed as the app exits.
+        journal.completed(1);
+        journal.enqueued(2, "c");
+    }
+
+    ytweb::TaskJournal journal(options());
+    auto unfinished = journal.unfinished();
+    ASSERT_EQ(unfinished.size(), 1);
+    EXPECT_EQ(unfinished[0].request, "b");
+}
@@ -4,8 +4,13 @@
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include <atomic>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <thread>
+#include <utility>
+#include <vector>
 
 using namespace std::chrono_literals;
 
@@ -16,6 +21,8 @@ class TaskManager : public ::testing::Test
   public:
     ytweb::TaskManager manager;
 
+    // The callbacks of different tasks may run in different threads.
+    std::mutex mutex;
     std::string response;
 
     auto launch()
@@ -23,11 +30,15 @@ class TaskManager : public ::testing::Test
         auto task = manager.launch(
             find_executable("python").string(), {YT_DLP_WEB_FAKE_BIN},
             [&](ytweb::TaskManager::TaskId id, std::string_view line) {
+                std::lock_guard lock(mutex);
                 response += "Task " + std::to_string(id) + ": ";
                 response += line;
                 response += "\n";
             },
-            [&](ytweb::TaskManager::TaskId id) { response += "Task " + std::to_string(id) + " ended\n"; }
+            [&](ytweb::TaskManager::TaskId id) {
+                std::lock_guard lock(mutex);
+                response += "Task " + std::to_string(id) + " ended\n";
+            }
         );
 
         auto thread = std::jthread([this, task] { manager.wait(task); });
@@ -45,14 +56,177 @@ TEST_F(TaskManager, LaunchOneTask)
 {
     auto [task, thread] = launch();
     EXPECT_TRUE(manager.is_running(task));
-    EXPECT_TRUE(response.empty());
 
+    // The output is handled by the threads of the pool from now on, so it is only checked once the task is over.
     thread.join();
 
     EXPECT_FALSE(manager.is_running(task));
     EXPECT_EQ(response, "Task 0: start running\nTask 0: \nTask 0 ended\n");
 }
 
+TEST_F(TaskManager, LaunchReservedId)
+{
+    auto reserved = manager.reserve_id();
+    auto next = manager.reserve_id();
+
+    manager.launch(
+        reserved, find_executable("python").string(), {YT_DLP_WEB_FAKE_BIN},
+        [&](ytweb::TaskManager::TaskId id, std::string_view /* line */) {
+            std::lock_guard lock(mutex);
+            EXPECT_EQ(id, reserved);
+        },
+        [&](ytweb::TaskManager::TaskId id) {
+            std::lock_guard lock(mutex);
+            response += "Task " + std::to_string(id) + " ended\n";
+        }
+    );
+    EXPECT_TRUE(manager.is_running(reserved));
+    EXPECT_FALSE(manager.is_running(next));
+
+    manager.wait(reserved);
+    EXPECT_EQ(response, "Task 0 ended\n");
+}
+
+TEST_F(TaskManager, StderrTail)
+{
+    std::vector<std::string> stderr_lines;
+    manager.set_on_stderr([&](ytweb::TaskManager::TaskId /* id */, std::string_view line) {
+        std::lock_guard lock(mutex);
+        stderr_lines.emplace_back(line);
+    });
+
+    std::string tail;
+    auto task = manager.launch(
+        find_executable("python").string(), {YT_DLP_WEB_FAKE_BIN}, [](ytweb::TaskManager::TaskId, std::string_view) {},
+        [&](ytweb::TaskManager::TaskId id) { tail = manager.stderr_tail(id); }
+    );
+    manager.wait(task);
+
+    EXPECT_EQ(stderr_lines, std::vector<std::string>{"WARNING: this is a fake yt-dlp"});
+    EXPECT_EQ(tail, "WARNING: this is a fake yt-dlp");
+    EXPECT_EQ(manager.stderr_tail(task), "");
+}
+
+TEST_F(TaskManager, Timings)
+{
+    using Mark = ytweb::TaskManager::Mark;
+
+    std::optional<ytweb::TaskManager::Timings> timings;
+    manager.set_on_timings([&](ytweb::TaskManager::TaskId /* id */, ytweb::TaskManager::Timings const& reported) {
+        std::lock_guard lock(mutex);
+        timings = reported;
+    });
+
+    auto task = manager.launch(
+        find_executable("python").string(), {YT_DLP_WEB_FAKE_BIN},
+        [&](ytweb::TaskManager::TaskId id, std::string_view line) {
+            manager.mark(id, line.empty() ? Mark::DownloadStarted : Mark::Extracted);
+            manager.mark(id, Mark::Extracted); // only the first time is kept
+        },
+        [](ytweb::TaskManager::TaskId /* id */) {}, ytweb::TaskManager::TaskType::Preview
+    );
+    manager.wait(task);
+
+    std::lock_guard lock(mutex);
+    ASSERT_TRUE(timings);
+    EXPECT_EQ(timings->type, ytweb::TaskManager::TaskType::Preview);
+    ASSERT_TRUE(timings->started);
+    ASSERT_TRUE(timings->process);
+    ASSERT_TRUE(timings->mark(Mark::Extracted));
+    ASSERT_TRUE(timings->mark(Mark::DownloadStarted));
+    EXPECT_FALSE(timings->mark(Mark::Moved));
+
+    EXPECT_LE(timings->queued, *timings->started);
+    EXPECT_LE(*timings->started, *timings->mark(Mark::Extracted));
+    EXPECT_LE(*timings->mark(Mark::Extracted), *timings->mark(Mark::DownloadStarted));
+    EXPECT_LE(*timings->mark(Mark::DownloadStarted), timings->finished);
+}
+
+#ifndef _WIN32
+TEST_F(TaskManager, ReportCancellation)
+{
+    std::optional<ytweb::AsyncProcess::Cancellation> cancellation;
+    manager.set_escalation({.interrupt_grace = 50ms, .terminate_grace = 50ms});
+    manager.set_on_cancelled([&](ytweb::TaskManager::TaskId /* id */, ytweb::AsyncProcess::Cancellation c) {
+        std::lock_guard lock(mutex);
+        cancellation = c;
+    });
+
+    auto task = manager.launch(
+        find_executable("python").string(), {YT_DLP_WEB_HANG_BIN, "--ignore-signals"},
+        [](ytweb::TaskManager::TaskId, std::string_view) {}, [](ytweb::TaskManager::TaskId) {}
+    );
+    std::this_thread::sleep_for(500ms); // let python ignore the signals
+
+    manager.kill(task);
+    manager.wait(task);
+
+    std::lock_guard lock(mutex);
+    ASSERT_TRUE(cancellation.has_value());
+    EXPECT_EQ(cancellation->signal, ytweb::AsyncProcess::Signal::Kill);
+    EXPECT_GE(cancellation->latency, 100ms);
+}
+#endif
+
+TEST_F(TaskManager, RunInWorkers)
+{
+    manager.set_workers({
+        .python = find_executable("python").string(),
+        .script = YT_DLP_WEB_WORKER_BIN,
+        .command = "fake-yt-dlp",
+        .idle = 1,
+    });
+
+    bool eof{false};
+    auto task = manager.launch(
+        "fake-yt-dlp", {"--simulate"},
+        [&](ytweb::TaskManager::TaskId /* id */, std::string_view line) {
+            std::lock_guard lock(mutex);
+            response += line;
+            response += "\n";
+        },
+        [&](ytweb::TaskManager::TaskId /* id */) { eof = true; }
+    );
+    manager.wait(task);
+
+    EXPECT_THAT(response, testing::HasSubstr("\n--simulate\n"));
+    EXPECT_EQ(manager.stderr_tail(task), "");
+    EXPECT_TRUE(eof);
+}
+
+// A job which fails is reported so, and never as ended.
+TEST_F(TaskManager, ReportFailedJob)
+{
+    manager.set_workers({
+        .python = find_executable("python").string(),
+        .script = YT_DLP_WEB_WORKER_BIN,
+        .command = "fake-yt-dlp",
+        .idle = 1,
+    });
+
+    std::vector<ytweb::TaskManager::TaskState> states;
+    manager.set_on_state_change([&](ytweb::TaskManager::TaskId /* id */, ytweb::TaskManager::TaskState state) {
+        std::lock_guard lock(mutex);
+        states.push_back(state);
+    });
+
+    bool eof{false};
+    auto task = manager.launch(
+        "fake-yt-dlp", {"--fail"}, [](ytweb::TaskManager::TaskId /* id */, std::string_view /* line */) {},
+        [&](ytweb::TaskManager::TaskId /* id */) { eof = true; }
+    );
+    manager.wait(task);
+
+    std::lock_guard lock(mutex);
+    EXPECT_FALSE(eof);
+    EXPECT_THAT(
+        states, testing::ElementsAre(
+                    ytweb::TaskManager::TaskState::Queued, ytweb::TaskManager::TaskState::Running,
+                    ytweb::TaskManager::TaskState::Failed
+                )
+    );
+}
+
 TEST_F(TaskManager, LaunchTwoTasks)
 {
     auto [task1, thread1] = launch();
@@ -60,19 +234,20 @@ TEST_F(TaskManager, LaunchTwoTasks)
 
     EXPECT_TRUE(manager.is_running(task1));
     EXPECT_TRUE(manager.is_running(task2));
-    EXPECT_TRUE(response.empty());
 
+    // The other task may still be writing the response until both are over.
     thread1.join();
     EXPECT_FALSE(manager.is_running(task1));
-    EXPECT_THAT(response, testing::HasSubstr("Task 0: start running\n"));
-    EXPECT_THAT(response, testing::HasSubstr("Task 0: \n"));
-    EXPECT_THAT(response, testing::HasSubstr("Task 0 ended\n"));
-
     thread2.join();
     EXPECT_FALSE(manager.is_running(task2));
-    EXPECT_THAT(response, testing::HasSubstr("Task 0: start running\n"));
-    EXPECT_THAT(response, testing::HasSubstr("Task 0: \n"));
-    EXPECT_THAT(response, testing::HasSubstr("Task 0 ended\n"));
+
+    for (auto task : {task1, task2})
+    {
+        auto prefix = "Task " + std::to_string(task);
+        EXPECT_THAT(response, testing::HasSubstr(prefix + ": start running\n"));
+        EXPECT_THAT(response, testing::HasSubstr(prefix + ": \n"));
+        EXPECT_THAT(response, testing::HasSubstr(prefix + " ended\n"));
+    }
 }
 
 TEST_F(TaskManager, KillTask)
@@ -114,3 +289,259 @@ TEST_F(TaskManager, LaunchTwoTasksAndKillOne)
     EXPECT_THAT(response, testing::HasSubstr("Task 1: \n"));
     EXPECT_THAT(response, testing::HasSubstr("Task 1 ended\n"));
 }
+
+TEST(TaskManagerPool, ManyTasksShareOneThread)
+{
+    ytweb::TaskManager manager{1};
+    std::atomic<int> ended{0};
+
+    std::vector<ytweb::TaskManager::TaskId> tasks;
+    for (int i = 0; i < 16; ++i)
+    {
+        tasks.push_back(manager.launch(
+            find_executable("python").string(), {YT_DLP_WEB_FAKE_BIN}, [](auto /* id */, auto /* line */) {},
+            [&](auto /* id */) { ++ended; }
+        ));
+    }
+
+    for (auto task : tasks)
+    {
+        manager.wait(task);
+    }
+
+    EXPECT_EQ(ended, 16);
+    EXPECT_EQ(manager.size(), 0);
+}
+
+class TaskManagerScheduler : public ::testing::Test
+{
+  public:
+    using TaskId = ytweb::TaskManager::TaskId;
+    using TaskState = ytweb::TaskManager::TaskState;
+
+    ytweb::TaskManager manager;
+
+    std::mutex mutex;
+    std::vector<TaskId> started;
+
+    void SetUp() override
+    {
+        manager.set_on_state_change([this](TaskId id, TaskState state) {
+            if (state == TaskState::Running)
+            {
+                std::lock_guard lock(mutex);
+                started.push_back(id);
+            }
+        });
+    }
+
+    auto launch(
+        ytweb::TaskManager::TaskType type = ytweb::TaskManager::TaskType::Download,
+        ytweb::TaskManager::Priority priority = ytweb::TaskManager::Priority::Normal
+    )
+    {
+        return manager.launch(
+            find_executable("python").string(), {YT_DLP_WEB_FAKE_BIN}, [](auto /* id */, auto /* line */) {},
+            [](auto /* id */) {}, type, priority
+        );
+    }
+};
+
+TEST_F(TaskManagerScheduler, QueueBeyondLimit)
+{
+    manager.set_limits({.total = 1, .preview = 1, .download = 1});
+
+    auto task1 = launch();
+    auto task2 = launch();
+
+    EXPECT_EQ(manager.state(task1), TaskState::Running);
+    EXPECT_EQ(manager.state(task2), TaskState::Queued);
+    EXPECT_FALSE(manager.is_running(task2));
+    EXPECT_EQ(manager.queued(), 1);
+    EXPECT_EQ(manager.running(), 1);
+
+    manager.wait(task2);
+
+    EXPECT_EQ(started, (std::vector{task1, task2}));
+    EXPECT_EQ(manager.size(), 0);
+    EXPECT_EQ(manager.queued(), 0);
+}
+
+TEST_F(TaskManagerScheduler, SeparateLimitsForEachType)
+{
+    manager.set_limits({.total = 2, .preview = 1, .download = 1});
+
+    auto download1 = launch(ytweb::TaskManager::TaskType::Download);
+    auto download2 = launch(ytweb::TaskManager::TaskType::Download);
+    auto preview = launch(ytweb::TaskManager::TaskType::Preview);
+
+    EXPECT_EQ(manager.state(download1), TaskState::Running);
+    EXPECT_EQ(manager.state(download2), TaskState::Queued);
+    EXPECT_EQ(manager.state(preview), TaskState::Running);
+
+    manager.wait(download2);
+    manager.wait(preview);
+}
+
+TEST_F(TaskManagerScheduler, PriorityThenFifo)
+{
+    manager.set_limits({.total = 1, .preview = 1, .download = 1});
+
+    auto first = launch();
+    auto low = launch(ytweb::TaskManager::TaskType::Download, ytweb::TaskManager::Priority::Low);
+    auto normal1 = launch();
+    auto normal2 = launch();
+    auto high = launch(ytweb::TaskManager::TaskType::Download, ytweb::TaskManager::Priority::High);
+
+    manager.wait(low);
+
+    EXPECT_EQ(started, (std::vector{first, high, normal1, normal2, low}));
+}
+
+TEST_F(TaskManagerScheduler, KillQueuedTask)
+{
+    manager.set_limits({.total = 1, .preview = 1, .download = 1});
+
+    auto task1 = launch();
+    auto task2 = launch();
+
+    manager.kill(task2);
+    EXPECT_FALSE(manager.state(task2).has_value());
+
+    manager.wait(task1);
+    EXPECT_EQ(started, (std::vector{task1}));
+    EXPECT_EQ(manager.size(), 0);
+}
+
+// Tasks finishing schedule the queued ones from other threads, but never before they are reported queued.
+TEST_F(TaskManagerScheduler, ReportQueuedBeforeRunning)
+{
+    manager.set_limits({.total = 2, .preview = 2, .download = 2});
+
+    std::vector<std::pair<TaskId, TaskState>> changes;
+    manager.set_on_state_change([this, &changes](TaskId id, TaskState state) {
+        std::lock_guard lock(mutex);
+        changes.emplace_back(id, state);
+    });
+
+    std::vector<TaskId> tasks;
+    for (int i = 0; i < 20; ++i)
+    {
+        tasks.push_back(launch());
+    }
+    for (auto task : tasks)
+    {
+        manager.wait(task);
+    }
+
+    for (auto task : tasks)
+    {
+        std::vector<TaskState> states;
+        for (auto [id, state] : changes)
+        {
+            if (id == task)
+            {
+                states.push_back(state);
+            }
+        }
+        EXPECT_THAT(states, testing::ElementsAre(TaskState::Queued, TaskState::Running)) << "task " << task;
+    }
+}
+
+TEST_F(TaskManagerScheduler, ReportFailedLaunch)
+{
+    std::vector<std::pair<TaskState, std::optional<TaskState>>> changes;
+    manager.set_on_state_change([this, &changes](TaskId id, TaskState state) {
+        std::lock_guard lock(mutex);
+        changes.emplace_back(state, manager.state(id));
+    });
+
+    auto task = manager.launch("/nonexistent/yt-dlp", {}, [](auto /* id */, auto /* line */) {}, [](auto /* id */) {});
+    manager.wait(task);
+
+    // The state is stored before it is reported.
+    ASSERT_EQ(changes.size(), 2);
+    EXPECT_EQ(changes[0].first, TaskState::Queued);
+    EXPECT_EQ(changes[1], std::pair(TaskState::Failed, std::make_optional(TaskState::Failed)));
+    EXPECT_EQ(manager.size(), 0);
+}
+
+#ifndef _WIN32
+TEST_F(TaskManagerScheduler, PauseFreesSlot)
+{
+    manager.set_limits({.total = 1, .preview = 1, .download = 1});
+
+    auto hang = manager.launch(
+        find_executable("python").string(), {YT_DLP_WEB_HANG_BIN}, [](auto /* id */, auto /* line */) {},
+        [](auto /* id */) {}
+    );
+    auto task = launch();
+    EXPECT_EQ(manager.state(task), TaskState::Queued);
+
+    EXPECT_FALSE(manager.resume(hang));
+    ASSERT_TRUE(manager.pause(hang));
+    EXPECT_FALSE(manager.pause(hang));
+    EXPECT_EQ(manager.state(hang), TaskState::Paused);
+
+    // The queued task runs while the other one is paused.
+    manager.wait(task);
+    EXPECT_EQ(started, (std::vector{hang, task}));
+
+    ASSERT_TRUE(manager.resume(hang));
+    EXPECT_EQ(manager.state(hang), TaskState::Running);
+
+    // A paused task can be killed too.
+    ASSERT_TRUE(manager.pause(hang));
+    manager.kill(hang);
+    manager.wait(hang);
+    EXPECT_EQ(manager.size(), 0);
+}
+#endif
+
+// Run with a thread sanitizer to check for data races, e.g. `xmake f --policies=build.sanitizer.thread`.
+TEST(TaskManagerStress, LaunchAndKillFromManyThreads)
+{
+    constexpr int THREADS = 8;
+    constexpr int TASKS_PER_THREAD = 250;
+
+    std::atomic<int> ended{0};
+    std::vector<ytweb::TaskManager::TaskId> tasks(THREADS * TASKS_PER_THREAD);
+
+    {
+        ytweb::TaskManager manager{4};
+        manager.set_limits({.total = 4, .preview = 2, .download = 2});
+
+        std::vector<std::jthread> threads;
+        for (int t = 0; t < THREADS; ++t)
+        {
+            threads.emplace_back([&, t] {
+                auto type = t % 2 == 0 ? ytweb::TaskManager::TaskType::Preview : ytweb::TaskManager::TaskType::Download;
+
+                for (int i = 0; i < TASKS_PER_THREAD; ++i)
+                {
+                    auto task = manager.launch(
+                        find_executable("python").string(), {YT_DLP_WEB_FAKE_BIN}, [](auto /* id */, auto /* line */) {},
+                        [&](auto /* id */) { ++ended; }, type
+                    );
+                    tasks[(t * TASKS_PER_THREAD) + i] = task;
+
+                    // Kill our own task and, racing with other threads, some of theirs.
+                    manager.kill(task);
+                    manager.kill(task - THREADS);
+                    static_cast<void>(manager.is_running(task - 1));
+                    static_cast<void>(manager.state(task - 1));
+                }
+            });
+        }
+        threads.clear(); // join
+
+        for (auto task : tasks)
+        {
+            manager.wait(task);
+            EXPECT_FALSE(manager.state(task).has_value());
+        }
+        EXPECT_EQ(manager.size(), 0);
+    }
+
+    EXPECT_LE(ended, THREADS * TASKS_PER_THREAD);
+}
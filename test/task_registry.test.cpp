@@ -0,0 +1,77 @@
+#include "task_registry.h"
+
+#include "gtest/gtest.h"
+#include <thread>
+#include <vector>
+
+using Registry = ytweb::TaskRegistry<int, int>;
+
+TEST(TaskRegistry, InsertFindErase)
+{
+    Registry registry;
+
+    registry.insert(1, std::make_shared<int>(10));
+    registry.insert(17, std::make_shared<int>(170)); // same shard as 1
+
+    EXPECT_EQ(registry.size(), 2);
+    EXPECT_EQ(*registry.find(1), 10);
+    EXPECT_EQ(*registry.find(17), 170);
+    EXPECT_EQ(registry.find(2), nullptr);
+
+    EXPECT_EQ(*registry.erase(1), 10);
+    EXPECT_EQ(registry.erase(1), nullptr);
+    EXPECT_EQ(registry.find(1), nullptr);
+    EXPECT_EQ(registry.size(), 1);
+}
+
+TEST(TaskRegistry, HandleOutlivesErasure)
+{
+    Registry registry;
+    registry.insert(1, std::make_shared<int>(10));
+
+    auto handle = registry.find(1);
+    registry.erase(1);
+
+    EXPECT_EQ(*handle, 10);
+}
+
+TEST(TaskRegistry, ForEach)
+{
+    Registry registry;
+    for (int i = 0; i < 100; ++i)
+    {
+        registry.insert(i, std::make_shared<int>(i));
+    }
+
+    int sum = 0;
+    registry.for_each([&](int id, Registry::Handle const& handle) {
+        EXPECT_EQ(id, *handle);
+        sum += id;
+    });
+    EXPECT_EQ(sum, 4950);
+}
+
+TEST(TaskRegistry, ConcurrentAccess)
+{
+    constexpr int THREADS = 8;
+    constexpr int TASKS_PER_THREAD = 10000;
+
+    Registry registry;
+
+    std::vector<std::jthread> threads;
+    for (int t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back([&registry, t] {
+            for (int i = 0; i < TASKS_PER_THREAD; ++i)
+            {
+                int id = (t * TASKS_PER_THREAD) + i;
+                registry.insert(id, std::make_shared<int>(id));
+                EXPECT_EQ(*registry.find(id), id);
+                EXPECT_EQ(*registry.erase(id), id);
+            }
+        });
+    }
+    threads.clear(); // join
+
+    EXPECT_EQ(registry.size(), 0);
+}
@@ -0,0 +1,142 @@
+#include "telemetry.h"
+
+#include "nlohmann/json.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+using namespace std::chrono_literals;
+
+using ytweb::Histogram;
+using ytweb::TaskManager;
+using ytweb::Telemetry;
+
+namespace
+{
+
+auto make_timings()
+{
+    auto now = TaskManager::Timings::Clock::now();
+
+    TaskManager::Timings timings;
+    timings.type = TaskManager::TaskType::Download;
+    timings.queued = now;
+    timings.started = now + 2s;
+    timings.process = ytweb::AsyncProcess::Timings{.spawn = 2ms, .first_output = 500ms};
+    timings.marks[static_cast<std::size_t>(TaskManager::Mark::Extracted)] = now + 5s;
+    timings.marks[static_cast<std::size_t>(TaskManager::Mark::DownloadStarted)] = now + 6s;
+    timings.marks[static_cast<std::size_t>(TaskManager::Mark::DownloadFinished)] = now + 36s;
+    timings.finished = now + 40s;
+    return timings;
+}
+
+} // anonymous namespace
+
+TEST(Histogram, Observe)
+{
+    Histogram histogram({1, 10, 100});
+    histogram.observe(0.5);
+    histogram.observe(1); // inclusive
+    histogram.observe(50);
+    histogram.observe(1000);
+
+    auto snapshot = histogram.snapshot();
+    EXPECT_THAT(snapshot.counts, testing::ElementsAre(2, 2, 3, 4));
+    EXPECT_EQ(snapshot.count(), 4);
+    EXPECT_DOUBLE_EQ(snapshot.sum, 1051.5);
+}
+
+TEST(Telemetry, Json)
+{
+    Telemetry telemetry;
+    telemetry.record(make_timings());
+    telemetry.record_event();
+    telemetry.record_event();
+    telemetry.record_speed(1024 * 1024);
+    telemetry.record_downloaded(4096);
+
+    std::vector<Telemetry::Clock::duration> latencies{1ms, 3ms};
+    telemetry.record_outbound(latencies);
+    telemetry.record_outbound_dropped();
+
+    auto json = nlohmann::json::parse(telemetry.to_json());
+    EXPECT_EQ(json["tasks"]["download"], 1);
+    EXPECT_EQ(json["tasks"]["preview"], 0);
+    EXPECT_EQ(json["events"], 2);
+    EXPECT_EQ(json["downloaded_bytes"], 4096);
+    EXPECT_EQ(json["outbound"]["events"], 2);
+    EXPECT_EQ(json["outbound"]["calls"], 1);
+    EXPECT_EQ(json["outbound"]["dropped"], 1);
+
+    auto const& histograms = json["histograms"];
+    EXPECT_EQ(histograms["queue_wait_seconds"]["count"], 1);
+    EXPECT_DOUBLE_EQ(histograms["queue_wait_seconds"]["sum"].get<double>(), 2);
+    EXPECT_DOUBLE_EQ(histograms["extraction_seconds"]["sum"].get<double>(), 3);
+    EXPECT_DOUBLE_EQ(histograms["download_seconds"]["sum"].get<double>(), 30);
+    EXPECT_DOUBLE_EQ(histograms["task_duration_seconds"]["sum"].get<double>(), 40);
+    EXPECT_EQ(histograms["download_speed_bytes_per_second"]["count"], 1);
+    EXPECT_DOUBLE_EQ(histograms["outbound_queue_seconds"]["sum"].get<double>(), 0.004);
+
+    // Phases which were not marked are not observed.
+    EXPECT_EQ(histograms["first_byte_seconds"]["count"], 0);
+    EXPECT_EQ(histograms["post_processing_seconds"]["count"], 0);
+}
+
+TEST(Telemetry, Prometheus)
+{
+    Telemetry telemetry;
+    telemetry.record(make_timings());
+
+    auto text = telemetry.to_prometheus();
+    EXPECT_THAT(text, testing::HasSubstr("# TYPE yt_dlp_web_tasks_total counter\n"));
+    EXPECT_THAT(text, testing::HasSubstr("yt_dlp_web_tasks_total{type=\"download\"} 1\n"));
+    EXPECT_THAT(text, testing::HasSubstr("# TYPE yt_dlp_web_download_seconds histogram\n"));
+    EXPECT_THAT(text, testing::HasSubstr("yt_dlp_web_download_seconds_bucket{le=\"10\"} 0\n"));
+    EXPECT_THAT(text, testing::HasSubstr("yt_dlp_web_download_seconds_bucket{le=\"60\"} 1\n"));
+    EXPECT_THAT(text, testing::HasSubstr("yt_dlp_web_download_seconds_bucket{le=\"+Inf\"} 1\n"));
+    EXPECT_THAT(text, testing::HasSubstr("yt_dlp_web_download_seconds_sum 30\n"));
+    EXPECT_THAT(text, testing::HasSubstr("yt_dlp_web_download_seconds_count 1\n"));
+}
+
+TEST(Telemetry, Sample)
+{
+    auto path = fs::temp_directory_path() / "yt-dlp-web-telemetry-test.prom";
+    fs::remove(path);
+
+    {
+        Telemetry telemetry;
+        telemetry.start({
+            .interval = 10ms,
+            .prometheus_file = path,
+            .load = [] { return Telemetry::Load{.queued = 3, .running = 2}; },
+        });
+        telemetry.record_event();
+
+        for (int i = 0; i < 100 && !fs::exists(path); ++i)
+        {
+            std::this_thread::sleep_for(10ms);
+        }
+        telemetry.stop();
+
+        auto json = nlohmann::json::parse(telemetry.to_json());
+        EXPECT_EQ(json["queued"], 3);
+        EXPECT_EQ(json["running"], 2);
+        EXPECT_GE(json["histograms"]["queue_depth"]["count"], 1);
+    }
+
+    std::ifstream stream(path);
+    std::stringstream content;
+    content << stream.rdbuf();
+    EXPECT_THAT(content.str(), testing::HasSubstr("yt_dlp_web_queued_tasks 3\n"));
+    EXPECT_THAT(content.str(), testing::HasSubstr("yt_dlp_web_events_total 1\n"));
+
+    fs::remove(path);
+}
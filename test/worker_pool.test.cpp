@@ -0,0 +1,203 @@
+#include "worker_pool.h"
+
+#include "boost/asio/thread_pool.hpp"
+#include "boost/process/v2/environment.hpp"
+
+#include "gtest/gtest.h"
+#include <future>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+using boost::process::environment::find_executable;
+
+class WorkerPool : public ::testing::Test
+{
+  public:
+    boost::asio::thread_pool pool{2};
+
+    std::optional<ytweb::WorkerPool> workers;
+
+    void start(ytweb::WorkerPool::Options options = {})
+    {
+        options.python = find_executable("python").string();
+        options.script = YT_DLP_WEB_WORKER_BIN;
+        options.command = "yt-dlp";
+        workers.emplace(pool.get_executor(), std::move(options));
+    }
+
+    void TearDown() override
+    {
+        workers->shutdown();
+        pool.join();
+    }
+
+    struct Result
+    {
+        std::vector<std::string> out;
+        std::vector<std::string> err;
+        bool eof{false};
+        std::shared_ptr<ytweb::WorkerPool::Job> job;
+    };
+
+    // Run a job and wait until it ends.
+    Result run(std::vector<std::string> const& args)
+    {
+        Result result;
+        std::promise<void> exited;
+
+        result.job = workers->run(
+            args,
+            [&](ytweb::AsyncProcess::Stream stream, std::string_view line) {
+                (stream == ytweb::AsyncProcess::Stream::Stdout ? result.out : result.err).emplace_back(line);
+            },
+            [&] { result.eof = true; }, [&] { exited.set_value(); }
+        );
+
+        exited.get_future().wait();
+        return result;
+    }
+};
+
+TEST_F(WorkerPool, ServeCommand)
+{
+    start();
+
+    EXPECT_TRUE(workers->serves("yt-dlp"));
+    EXPECT_FALSE(workers->serves("/opt/yt-dlp"));
+}
+
+TEST_F(WorkerPool, RunJob)
+{
+    start({.idle = 1});
+    EXPECT_EQ(workers->idle(), 1);
+
+    auto result = run({"--simulate", "https://example.com/\"quoted\""});
+
+    ASSERT_EQ(result.out.size(), 2);
+    EXPECT_TRUE(result.out[0].starts_with("pid "));
+    EXPECT_EQ(result.out[1], "--simulate https://example.com/\"quoted\"");
+    EXPECT_EQ(result.err, std::vector<std::string>{"WARNING: this is a fake yt-dlp"});
+    EXPECT_TRUE(result.eof);
+    EXPECT_FALSE(result.job->running());
+    EXPECT_FALSE(result.job->failed());
+}
+
+// The timings are of the job, not of its helper launched long before.
+TEST_F(WorkerPool, JobTimings)
+{
+    start({.idle = 1});
+    std::this_thread::sleep_for(1s);
+
+    auto result = run({"a"});
+
+    auto timings = result.job->timings();
+    EXPECT_LT(timings.spawn, 500ms);
+    ASSERT_TRUE(timings.first_output.has_value());
+    EXPECT_GE(*timings.first_output, timings.spawn);
+    EXPECT_LT(*timings.first_output, 1s);
+}
+
+TEST_F(WorkerPool, FailedJob)
+{
+    start({.idle = 0});
+
+    auto failed = run({"--fail"});
+    EXPECT_FALSE(failed.eof);
+    EXPECT_TRUE(failed.job->failed());
+
+    // The helper is still reused.
+    auto next = run({"a"});
+    EXPECT_TRUE(next.eof);
+    EXPECT_EQ(failed.out[0], next.out[0]);
+}
+
+TEST_F(WorkerPool, CrashedHelper)
+{
+    start({.idle = 0});
+
+    auto crashed = run({"--crash"});
+    EXPECT_FALSE(crashed.eof);
+    EXPECT_TRUE(crashed.job->failed());
+
+    auto next = run({"a"});
+    EXPECT_TRUE(next.eof);
+    EXPECT_FALSE(next.job->failed());
+}
+
+// Without idle helpers kept warm, the next job runs on the helper just released.
+TEST_F(WorkerPool, ReuseHelper)
+{
+    start({.idle = 0});
+
+    auto first = run({"a"});
+    auto second = run({"b"});
+
+    ASSERT_FALSE(first.out.empty());
+    ASSERT_FALSE(second.out.empty());
+    EXPECT_EQ(first.out[0], second.out[0]);
+}
+
+TEST_F(WorkerPool, RecycleAfterMaxJobs)
+{
+    start({.idle = 0, .max_jobs = 1});
+
+    auto first = run({"a"});
+    auto second = run({"b"});
+
+    ASSERT_FALSE(first.out.empty());
+    ASSERT_FALSE(second.out.empty());
+    EXPECT_NE(first.out[0], second.out[0]);
+}
+
+TEST_F(WorkerPool, RecycleWhenTooLarge)
+{
+    start({.idle = 0});
+
+    auto first = run({"--grow"});
+    auto second = run({"b"});
+
+    ASSERT_FALSE(first.out.empty());
+    ASSERT_FALSE(second.out.empty());
+    EXPECT_NE(first.out[0], second.out[0]);
+}
+
+TEST_F(WorkerPool, InterruptJob)
+{
+    start({.idle = 1});
+
+    bool eof{false};
+    std::promise<void> exited;
+    auto job = workers->run(
+        {"--hang"}, [](ytweb::AsyncProcess::Stream /* stream */, std::string_view /* line */) {}, [&] { eof = true; },
+        [&] { exited.set_value(); }
+    );
+
+    job->interrupt();
+    ASSERT_EQ(exited.get_future().wait_for(5s), std::future_status::ready);
+    EXPECT_FALSE(eof);
+    EXPECT_FALSE(job->failed());
+    EXPECT_TRUE(job->cancellation().has_value());
+
+    // The interrupted helper is not reused.
+    auto result = run({"a"});
+    EXPECT_TRUE(result.eof);
+}
+
+// A job over doesn't affect its helper, which runs the next job.
+TEST_F(WorkerPool, InterruptJobOver)
+{
+    start({.idle = 0});
+
+    auto first = run({"a"});
+    first.job->interrupt();
+    EXPECT_FALSE(first.job->pause());
+    EXPECT_FALSE(first.job->cancellation().has_value());
+
+    auto second = run({"b"});
+    EXPECT_TRUE(second.eof);
+    EXPECT_EQ(first.out[0], second.out[0]);
+}
@@ -0,0 +1,29 @@
+# This is a fake yt-dlp executable which never prints anything, used to test interruptions.
+# With `--ignore-signals`, it also ignores SIGINT and SIGTERM, so that it can only be killed.
+# With `--fork-child <path>`, it forks a child which ignores SIGINT and writes to the path after a second,
+# as ffmpeg writes a part file.
+
+import os
+import signal
+import sys
+import time
+
+if "--ignore-signals" in sys.argv:
+    signal.signal(signal.SIGINT, signal.SIG_IGN)
+    signal.signal(signal.SIGTERM, signal.SIG_IGN)
+
+if "--fork-child" in sys.argv:
+    path = sys.argv[sys.argv.index("--fork-child") + 1]
+    if os.fork() == 0:
+        signal.signal(signal.SIGINT, signal.SIG_IGN)
+        time.sleep(1)
+        with open(path, "w") as file:
+            file.write("part")
+        os._exit(0)
+
+try:
+    while True:
+        time.sleep(1)
+except KeyboardInterrupt:
+    print("ERROR: Interrupted by user", file=sys.stderr)
+    sys.exit(1)
@@ -1,7 +1,9 @@
 # This is a fake yt-dlp executable that is used just for testing purposes.
 
+import sys
 import time
 
 print("start running")
+print("WARNING: this is a fake yt-dlp", file=sys.stderr)
 
 time.sleep(0.01)
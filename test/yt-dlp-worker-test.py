@@ -0,0 +1,29 @@
+# This is a fake helper of yt-dlp-web, which speaks the protocol of worker/yt-dlp-worker.py
+# without importing yt-dlp. Each job prints the pid of the helper and its arguments.
+# A job with the argument "--hang" never ends, "--grow" reports a large memory, "--fail" exits with 1,
+# and "--crash" ends the helper in the middle of the job.
+
+import json
+import os
+import sys
+import time
+
+sys.stdout.reconfigure(line_buffering=True)
+
+for line in sys.stdin:
+    job = json.loads(line)
+    args = job["args"]
+
+    print(f"pid {os.getpid()}")
+    print(" ".join(args))
+    print("WARNING: this is a fake yt-dlp", file=sys.stderr, flush=True)
+
+    while "--hang" in args:
+        time.sleep(1)
+
+    if "--crash" in args:
+        os._exit(1)
+
+    memory = 1 << 40 if "--grow" in args else 1 << 20
+    code = 1 if "--fail" in args else 0
+    print(f"\x1fdone {job['id']} {code} {memory}", flush=True)
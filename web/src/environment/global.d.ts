@@ -3,9 +3,10 @@ declare global {
         logMessage: (rawData: Uint8Array) => void;
         showDownloadProgress: (rawData: Uint8Array) => void;
         showDownloadInfo: (rawData: Uint8Array) => void;
-        showPreviewInfo: (rawData: Uint8Array) => void;
-        reportCompletion: (id: number) => void;
-        reportInterruption: (id: number) => void;
+        showPreviewEntries: (rawData: Uint8Array) => void;
+        reportCompletion: (id: number, stderr?: string) => void;
+        reportInterruption: (id: number, stderr?: string) => void;
+        reportTaskState: (id: number, state: string) => void;
     }
 }
 
@@ -41,4 +41,7 @@ declare namespace webui {
 
     export function handleRequest(data: string): Promise<string>;
     export function handleInterrupt(taskId: number): void;
+    export function handlePause(taskId: number): void;
+    export function handleResume(taskId: number): void;
+    export function getMetrics(): Promise<string>;
 }
@@ -6,7 +6,7 @@ import App from '@/App.vue';
 
 import { useLogStore, logLevels, type LogLevel } from '@/store/log';
 import { useMediaDataStore } from '@/store/media-data';
-import { useTasksStore, type DownloadProgress } from '@/store/tasks';
+import { useTasksStore, type DownloadProgress, type TaskStatus } from '@/store/tasks';
 
 import { useNotification } from '@/utils/notification';
 
@@ -22,34 +22,43 @@ function showDownloadProgress(rawData: Uint8Array) {
     const data = new TextDecoder().decode(rawData);
 
     // TODO: Check if the data is valid
-    const progress = JSON.parse(data) as DownloadProgress & { task_id: number };
-    const id = progress.task_id;
-    tasks.setProgress(id, progress);
+    // The latest progress of tasks are sent together in a batch.
+    const batch = JSON.parse(data) as (DownloadProgress & { task_id: number })[];
+    for (const progress of batch) {
+        tasks.setProgress(progress.task_id, progress);
+    }
 }
 
+// The log messages are sent in batches, each with the time it was logged.
 window.logMessage = (rawData: Uint8Array) => {
     const str = new TextDecoder().decode(rawData);
 
-    const { level, message } = JSON.parse(str);
-    if (level === undefined || message === undefined || typeof level !== 'string' || typeof message !== 'string') {
-        log.error(`Invalid log message: ${str}`);
-        return;
-    }
+    for (const { level, time, message } of JSON.parse(str)) {
+        if (level === undefined || message === undefined || typeof level !== 'string' || typeof message !== 'string') {
+            log.error(`Invalid log message: ${JSON.stringify({ level, message })}`);
+            continue;
+        }
 
-    if (!logLevels.includes(level as LogLevel)) {
-        log.error(`Invalid log level: ${level}.`);
-        return;
-    }
+        if (!logLevels.includes(level as LogLevel)) {
+            log.error(`Invalid log level: ${level}.`);
+            continue;
+        }
 
-    log.log(level as LogLevel, message);
+        log.log(level as LogLevel, message, typeof time === 'number' ? new Date(time) : undefined);
+    }
 };
 
 window.showDownloadProgress = showDownloadProgress;
 window.showDownloadInfo = () => {};
-window.showPreviewInfo = (rawData: Uint8Array) => (mediaData.value = JSON.parse(new TextDecoder().decode(rawData)));
+window.showPreviewEntries = (rawData: Uint8Array) => {
+    const { task_id, first, entries } = JSON.parse(new TextDecoder().decode(rawData));
+    mediaData.append(task_id, first, entries);
+};
 
-window.reportCompletion = (id: number) => {
+// The last lines of stderr of the task are attached, if any.
+window.reportCompletion = (id: number, stderr?: string) => {
     tasks.setStatus(id, 'done');
+    tasks.setStderr(id, stderr);
 
     notification.success({
         title: `Completed task ${id}`,
@@ -59,8 +68,9 @@ window.reportCompletion = (id: number) => {
     });
 };
 
-window.reportInterruption = (id: number) => {
+window.reportInterruption = (id: number, stderr?: string) => {
     tasks.setStatus(id, 'interrupted');
+    tasks.setStderr(id, stderr);
 
     notification.error({
         title: `Interrupted task ${id}`,
@@ -69,3 +79,21 @@ window.reportInterruption = (id: number) => {
         keepAliveOnHover: true,
     });
 };
+
+window.reportTaskState = (id: number, state: string) => {
+    if (state !== 'queued' && state !== 'running' && state !== 'paused' && state !== 'error') {
+        log.error(`Invalid state of task ${id}: ${state}.`);
+        return;
+    }
+
+    tasks.setStatus(id, state as TaskStatus);
+
+    if (state === 'error') {
+        notification.error({
+            title: `Failed task ${id}`,
+            description: 'Task has failed. Check the log for more information.',
+            duration: 3000,
+            keepAliveOnHover: true,
+        });
+    }
+};
@@ -59,6 +59,19 @@ test('log multiple messages', () => {
     });
 });
 
+test('log with time', () => {
+    const log = useLogStore();
+    const time = new Date(2020, 0, 1, 0, 0, 0);
+
+    log.log('info', 'Hello, World!', time);
+
+    expect(log.store[0]).toEqual({
+        time,
+        level: 'info',
+        message: 'Hello, World!',
+    });
+});
+
 test('clear log', () => {
     const log = useLogStore();
 
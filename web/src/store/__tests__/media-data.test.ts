@@ -0,0 +1,47 @@
+import { useMediaDataStore } from '@/store/media-data';
+import type { MediaData } from '@/types/MediaData.types';
+import { test, expect, beforeEach } from 'vitest';
+import { setActivePinia, createPinia } from 'pinia';
+
+function entry(title: string) {
+    return { title } as MediaData;
+}
+
+beforeEach(() => {
+    setActivePinia(createPinia());
+});
+
+test('append batches', () => {
+    const mediaData = useMediaDataStore();
+
+    mediaData.append(1, true, [entry('a')]);
+    mediaData.append(1, false, [entry('b'), entry('c')]);
+
+    expect(mediaData.entries.map((e) => e.title)).toEqual(['a', 'b', 'c']);
+    expect(mediaData.value?.title).toBe('a');
+
+    mediaData.select(2);
+    expect(mediaData.value?.title).toBe('c');
+    expect(mediaData.selected).toBe(2);
+});
+
+test('first batch replaces the previous preview', () => {
+    const mediaData = useMediaDataStore();
+
+    mediaData.append(1, true, [entry('a')]);
+    mediaData.append(2, true, [entry('b')]);
+    mediaData.append(1, false, [entry('c')]);
+
+    expect(mediaData.entries.map((e) => e.title)).toEqual(['b']);
+    expect(mediaData.value?.title).toBe('b');
+});
+
+test('empty preview', () => {
+    const mediaData = useMediaDataStore();
+
+    mediaData.append(1, true, [entry('a')]);
+    mediaData.append(2, true, []);
+
+    expect(mediaData.entries).toHaveLength(0);
+    expect(mediaData.value).toBeFalsy();
+});
@@ -0,0 +1,49 @@
+import { useTasksStore } from '@/store/tasks';
+import { test, expect, beforeEach } from 'vitest';
+import { setActivePinia, createPinia } from 'pinia';
+
+beforeEach(() => {
+    setActivePinia(createPinia());
+});
+
+test('set status', () => {
+    const tasks = useTasksStore();
+
+    tasks.append({ id: 1, type: 'download', status: 'queued', request: {} });
+    tasks.setStatus(1, 'running');
+
+    expect(tasks.value.get(1)?.status).toBe('running');
+});
+
+test('status reported before append', () => {
+    const tasks = useTasksStore();
+
+    tasks.setStatus(1, 'running');
+    tasks.append({ id: 1, type: 'download', status: 'queued', request: {} });
+    tasks.append({ id: 2, type: 'download', status: 'queued', request: {} });
+
+    expect(tasks.value.get(1)?.status).toBe('running');
+    expect(tasks.value.get(2)?.status).toBe('queued');
+});
+
+test('pause and resume', () => {
+    const tasks = useTasksStore();
+
+    tasks.append({ id: 1, type: 'download', status: 'running', request: {} });
+    tasks.setStatus(1, 'paused');
+    expect(tasks.value.get(1)?.status).toBe('paused');
+
+    tasks.setStatus(1, 'running');
+    expect(tasks.value.get(1)?.status).toBe('running');
+});
+
+test('set stderr', () => {
+    const tasks = useTasksStore();
+
+    tasks.append({ id: 1, type: 'download', status: 'running', request: {} });
+    tasks.setStderr(1, undefined);
+    expect(tasks.value.get(1)?.stderr).toBeUndefined();
+
+    tasks.setStderr(1, 'ERROR: Unsupported URL');
+    expect(tasks.value.get(1)?.stderr).toBe('ERROR: Unsupported URL');
+});
@@ -17,9 +17,9 @@ export const useLogStore = defineStore('log', () => {
         store.value = [];
     }
 
-    function log(level: LogLevel, message: string) {
+    function log(level: LogLevel, message: string, time = new Date()) {
         store.value.push({
-            time: new Date(),
+            time,
             level,
             message,
         });
@@ -3,12 +3,53 @@ import { ref } from 'vue';
 import type { MediaData } from '@/types/MediaData.types';
 
 export const useMediaDataStore = defineStore('mediaData', () => {
+    // The entry shown in the preview.
     const value = ref<MediaData | null>();
 
+    // All entries of the current preview, more than one for a playlist.
+    const entries = ref<MediaData[]>([]);
+    const selected = ref(0);
+
+    // The task that the entries come from.
+    let taskId: number | null = null;
+
+    /**
+     * Append entries of a preview, which arrive in batches.
+     * The first batch of a task replaces the entries of the previous preview.
+     */
+    function append(id: number, first: boolean, batch: MediaData[]) {
+        if (first) {
+            taskId = id;
+            entries.value = [];
+            selected.value = 0;
+            value.value = null;
+        } else if (id !== taskId) {
+            return; // stale entries of an older preview
+        }
+
+        entries.value.push(...batch);
+        value.value ??= entries.value[0];
+    }
+
+    function select(index: number) {
+        if (index >= 0 && index < entries.value.length) {
+            selected.value = index;
+            value.value = entries.value[index];
+        }
+    }
+
     return {
         value,
+        entries,
+        selected,
+
+        append,
+        select,
 
         clear() {
+            taskId = null;
+            entries.value = [];
+            selected.value = 0;
             value.value = null;
         },
     };
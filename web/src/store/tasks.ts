@@ -3,20 +3,20 @@ import { ref } from 'vue';
 
 type Request = Record<string, string | string[]>;
 
-export const taskStatus = ['running', 'done', 'error', 'interrupted'] as const;
+export const taskStatus = ['queued', 'running', 'paused', 'done', 'error', 'interrupted'] as const;
 export const taskTypes = ['preview', 'download'] as const;
 
 export type TaskStatus = (typeof taskStatus)[number];
 export type TaskType = (typeof taskTypes)[number];
 
 export interface DownloadProgress {
-    downloaded_bytes: number;
-    total_bytes: number;
+    downloaded_bytes: number | null;
+    total_bytes: number | null;
     filename: string;
     status: string;
-    elapsed: number;
-    ctx_id: number | null;
-    speed: number;
+    speed: number | null;
+    eta: number | null;
+    fragment_index: number | null;
 }
 
 export interface Task {
@@ -25,13 +25,20 @@ export interface Task {
     status: TaskStatus;
     request: Request;
     progress?: Omit<DownloadProgress, 'task_id'>;
+    stderr?: string;
 }
 
 export const useTasksStore = defineStore('tasks', () => {
     const value = ref<Map<Task['id'], Omit<Task, 'id'>>>(new Map());
 
+    // The backend may report a status before `handleRequest` has returned the task id.
+    const earlyStatus = new Map<Task['id'], TaskStatus>();
+
     function append(task: Task) {
-        value.value.set(task.id, task);
+        const status = earlyStatus.get(task.id);
+        earlyStatus.delete(task.id);
+
+        value.value.set(task.id, status ? { ...task, status } : task);
     }
 
     function remove(id: Task['id']) {
@@ -42,6 +49,8 @@ export const useTasksStore = defineStore('tasks', () => {
         const task = value.value.get(id);
         if (task) {
             task.status = status;
+        } else {
+            earlyStatus.set(id, status);
         }
     }
 
@@ -52,11 +61,19 @@ export const useTasksStore = defineStore('tasks', () => {
         }
     }
 
+    function setStderr(id: Task['id'], stderr: string | undefined) {
+        const task = value.value.get(id);
+        if (task && stderr) {
+            task.stderr = stderr;
+        }
+    }
+
     return {
         value,
         append,
         remove,
         setStatus,
         setProgress,
+        setStderr,
     };
 });
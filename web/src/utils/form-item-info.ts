@@ -33,6 +33,17 @@ const globalInput: FormItemSet = {
             name: 'quality',
             options: [{ value: '', label: 'Best Video and Audio' }],
         },
+        {
+            label: 'Priority',
+            description: 'Tasks with a higher priority leave the wait queue first.',
+            type: 'select',
+            name: 'priority',
+            options: [
+                { value: '', label: 'Normal' },
+                { value: 'high', label: 'High' },
+                { value: 'low', label: 'Low' },
+            ],
+        },
     ],
 };
 
@@ -15,7 +15,7 @@ export async function retryTask(id: Task['id']) {
     tasks.remove(id);
 
     const newId = parseInt(await webui.handleRequest(JSON.stringify({ ...task.request, action: task.type })));
-    tasks.append({ ...task, id: newId, status: 'running' });
+    tasks.append({ ...task, id: newId, status: 'queued' });
 
     log.info(`Retried task ${id} -> task ${newId}.`);
 
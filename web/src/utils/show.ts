@@ -1,4 +1,4 @@
-export function bytesToSize(bytes: number) {
+export function bytesToSize(bytes: number | null) {
     if (!bytes) bytes = 0;
 
     const sizes = ['Bytes', 'KB', 'MB', 'GB', 'TB'];
@@ -9,3 +9,9 @@ export function bytesToSize(bytes: number) {
     }
     return `${bytes.toFixed(2)} ${sizes[i]}`;
 }
+
+// The percentage of downloaded bytes, or 0 if the total is unknown.
+export function downloadPercentage(downloaded: number | null, total: number | null) {
+    if (!downloaded || !total) return 0;
+    return (downloaded / total) * 100;
+}
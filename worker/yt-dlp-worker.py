@@ -0,0 +1,73 @@
+# A resident helper of yt-dlp-web, which imports yt-dlp once and runs many jobs,
+# saving the startup of python and the loading of extractors for each task.
+#
+# Each job is a line of JSON on stdin: {"id": <job id>, "args": [<arguments of yt-dlp>]}.
+# The output of yt-dlp goes to stdout and stderr as usual, followed by a line on stdout:
+#   "\x1fdone <job id> <exit code> <max resident memory in bytes>"
+# The helper exits at the end of stdin, or after the job during which it is interrupted.
+
+import json
+import signal
+import sys
+
+try:
+    import resource
+except ImportError:  # Windows
+    resource = None
+
+import yt_dlp
+
+interrupted = False
+running = False
+
+
+# Only a running job is interrupted at once. Between jobs, e.g. while waiting on stdin, the helper exits
+# after the next job instead of dying with a traceback.
+def on_interrupt(signum, frame):
+    global interrupted
+    interrupted = True
+    if running:
+        raise KeyboardInterrupt
+
+
+def max_memory():
+    if resource is None:
+        return 0
+    rss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    return rss if sys.platform == "darwin" else rss * 1024  # in kilobytes on Linux
+
+
+def run(args):
+    global running
+    try:
+        running = True
+        yt_dlp.main(args)
+    except SystemExit as e:
+        if e.code is None or isinstance(e.code, int):
+            return e.code or 0
+        print(e.code, file=sys.stderr)
+        return 1
+    except KeyboardInterrupt:
+        return 1
+    finally:
+        running = False
+    return 0
+
+
+def main():
+    signal.signal(signal.SIGINT, on_interrupt)
+    sys.stdout.reconfigure(line_buffering=True)
+
+    for line in sys.stdin:
+        job = json.loads(line)
+        code = run(job["args"])
+
+        sys.stderr.flush()
+        print(f"\x1fdone {job['id']} {code} {max_memory()}", flush=True)
+
+        if interrupted:
+            break
+
+
+if __name__ == "__main__":
+    main()
@@ -23,6 +23,9 @@ target("main", function()
             os.tryrm(server_dir)
             os.ln("$(projectdir)/web/dist", server_dir)
         end
+
+        -- helper script for `--worker`
+        os.cp("$(projectdir)/worker/yt-dlp-worker.py", target:targetdir())
     end)
 end)
 
@@ -48,5 +51,36 @@ if has_config("enable_test") then
         -- fake yt-dlp executable for testing
         -- python is required
         add_defines('YT_DLP_WEB_FAKE_BIN="$(projectdir)/test/yt-dlp-test.py"')
+        add_defines('YT_DLP_WEB_HANG_BIN="$(projectdir)/test/yt-dlp-hang.py"')
+        add_defines('YT_DLP_WEB_WORKER_BIN="$(projectdir)/test/yt-dlp-worker-test.py"')
+        add_defines('YT_DLP_WEB_MEDIA_INFO="$(projectdir)/web/src/dev/media-info.json"')
+    end)
+end
+
+option("enable_bench", function()
+    set_default(false)
+end)
+
+if has_config("enable_bench") then
+    add_requires("benchmark")
+
+    target("bench", function()
+        set_default(false)
+        set_kind("binary")
+        set_optimize("fastest")
+
+        add_files("src/*.cpp|main.cpp|app.cpp") -- exclude main.cpp
+        add_includedirs("src")
+
+        add_files("bench/*.cpp")
+
+        add_packages("nlohmann_json", "boost")
+        add_packages("benchmark")
+
+        add_defines('YT_DLP_WEB_MEDIA_INFO="$(projectdir)/web/src/dev/media-info.json"')
+
+        -- fake yt-dlp executable whose output rate, line length and runtime are configurable
+        -- python is required
+        add_defines('YT_DLP_WEB_FAKE_BIN="$(projectdir)/bench/yt-dlp-fake.py"')
     end)
 end